@@ -4,12 +4,51 @@
 #include "MainWindow.g.cpp"
 #endif
 
+#include "engine/mapped_file.h"
+#include "engine/text.h"
+#include "engine/topology.h"
+
+#include <cmath>
+#include <exception>
+#include <memory>
 #include <thread>
 #include <winrt/Windows.ApplicationModel.DataTransfer.h>
+#include <winrt/Windows.Storage.h>
 
 using namespace winrt;
 using namespace Microsoft::UI::Xaml;
 
+namespace
+{
+    uint32_t LengthFromBox(Controls::NumberBox const& box)
+    {
+        double value = box.Value();
+        return std::isnan(value) || value < 0 ? 0 : static_cast<uint32_t>(value);
+    }
+
+    // Projects are kept next to the archive; the engine checkpoints to the
+    // same file while it runs.
+    std::string ProjectPathFor(std::string const& archivePath)
+    {
+        return archivePath + ".runlock";
+    }
+
+    // Candidates shown in StatusText after "Generate Passwords".
+    constexpr size_t PreviewCandidates = 5;
+
+    // "Generate Passwords" writes its list next to the archive as well.
+    std::string CandidatesPathFor(std::string const& archivePath)
+    {
+        return archivePath + ".candidates";
+    }
+
+    bool SameRules(::runlock::engine::Project const& a, ::runlock::engine::Project const& b)
+    {
+        return a.rules == b.rules && a.minLength == b.minLength && a.maxLength == b.maxLength
+            && a.markovPath == b.markovPath;
+    }
+}
+
 namespace winrt::runlock::implementation
 {
     MainWindow::MainWindow()
@@ -18,15 +57,38 @@ namespace winrt::runlock::implementation
 //        Loaded({ this, &MainWindow::Window_Loaded });
     }
 
+    MainWindow::~MainWindow()
+    {
+        if (m_engine)
+        {
+            m_engine->Stop();
+        }
+        if (m_engineThread.joinable())
+        {
+            m_engineThread.join();
+        }
+        if (m_generator)
+        {
+            m_generator->Cancel();
+        }
+        if (m_generatorThread.joinable())
+        {
+            m_generatorThread.join();
+        }
+    }
+
     void MainWindow::Window_Loaded(IInspectable const&, RoutedEventArgs const&)
     {
-        uint32_t cores = std::thread::hardware_concurrency();
-        if (cores == 0) { cores = 1; }
-        for (uint32_t i = 1; i <= cores; ++i)
+        // Processors this process may use, which can be fewer than the
+        // machine has; the check box below limits workers to one per core.
+        auto const& topology = ::runlock::engine::CpuTopology::Detect();
+        uint32_t threads = static_cast<uint32_t>(topology.Cpus().size());
+        for (uint32_t i = 1; i <= threads; ++i)
         {
             CpuCoresComboBox().Items().Append(box_value(i));
         }
         CpuCoresComboBox().SelectedIndex(0);
+        Controls::ToolTipService::SetToolTip(CpuCoresComboBox(), box_value(to_hstring(topology.Describe())));
     }
 
     void MainWindow::BrowseArchive_Click(IInspectable const&, RoutedEventArgs const&)
@@ -49,25 +111,153 @@ namespace winrt::runlock::implementation
         e.AcceptedOperation(Windows::ApplicationModel::DataTransfer::DataPackageOperation::Copy);
     }
 
-    void MainWindow::PasswordRules_Drop(IInspectable const&, DragEventArgs const&)
+    // Dropped files become "@path" word list rules rather than text: the
+    // engine maps the file itself, so multi-gigabyte lists never pass
+    // through the TextBox.
+    fire_and_forget MainWindow::PasswordRules_Drop(IInspectable const&, DragEventArgs e)
     {
-        // TODO: Populate password rules from dropped text file
+        auto lifetime = get_strong();
+        auto view = e.DataView();
+        if (!view.Contains(Windows::ApplicationModel::DataTransfer::StandardDataFormats::StorageItems()))
+        {
+            co_return;
+        }
+        auto items = co_await view.GetStorageItemsAsync();
+
+        std::wstring rules(PasswordRulesBox().Text());
+        for (auto const& item : items)
+        {
+            if (!item.IsOfType(Windows::Storage::StorageItemTypes::File))
+            {
+                continue;
+            }
+            if (!rules.empty() && rules.back() != L'\r' && rules.back() != L'\n')
+            {
+                rules += L'\r';
+            }
+            rules += L'@';
+            rules += item.Path();
+        }
+        PasswordRulesBox().Text(rules);
     }
 
+    // Compiling the rules gives the exact count at once; the preview and the
+    // list (next to the archive, when one is selected) are produced on a
+    // background thread that keeps one block in memory. Cancel takes effect
+    // after the block being written.
     void MainWindow::GeneratePasswords_Click(IInspectable const&, RoutedEventArgs const&)
     {
-        // TODO: Generate list of passwords
-        CancelGenerateButton().IsEnabled(true);
+        auto project = ProjectFromControls();
+        ::runlock::engine::GeneratorOptions options;
+        options.rules = project.rules;
+        options.minLength = project.minLength;
+        options.maxLength = project.maxLength;
+        options.markovPath = project.markovPath;
+        if (!project.archivePath.empty())
+        {
+            options.outputPath = CandidatesPathFor(project.archivePath);
+        }
+        options.previewCount = PreviewCandidates;
+        auto preview = std::make_shared<std::wstring>();
+        options.onPreview = [preview](std::string_view candidate)
+        {
+            *preview += (preview->empty() ? L"" : L", ") + std::wstring(to_hstring(candidate));
+        };
+        options.onProgress = [dispatcher = DispatcherQueue(), weak = get_weak()](uint64_t written, uint64_t total)
+        {
+            dispatcher.TryEnqueue([weak, written, total]
+            {
+                if (auto self = weak.get())
+                {
+                    self->OnGenerateProgress(written, total);
+                }
+            });
+        };
+        std::string outputPath = options.outputPath;
+
+        if (m_generatorThread.joinable())
+        {
+            m_generatorThread.join();
+        }
+        try
+        {
+            m_generator = std::make_unique<::runlock::engine::Generator>(std::move(options));
+        }
+        catch (std::exception const& e)
+        {
+            StatusText().Text(L"Error: " + to_hstring(e.what()));
+            return;
+        }
+        StatusText().Text((m_generator->MayReject() ? L"At most " : L"") + to_hstring(m_generator->Count()) + L" candidates");
         GenerateButton().IsEnabled(false);
+        CancelGenerateButton().IsEnabled(true);
+
+        m_generatorThread = std::thread([generator = m_generator.get(), preview, outputPath,
+            dispatcher = DispatcherQueue(), weak = get_weak()]
+        {
+            hstring status;
+            try
+            {
+                auto result = generator->Run();
+                status = to_hstring(result.total) + L" candidates: " + hstring(*preview)
+                    + (result.total > PreviewCandidates ? L", \u2026" : L"");
+                if (result.cancelled)
+                {
+                    status = status + L"; cancelled after writing " + to_hstring(result.written) + L" to "
+                        + to_hstring(outputPath);
+                }
+                else if (!outputPath.empty())
+                {
+                    status = status + L"; written to " + to_hstring(outputPath);
+                }
+            }
+            catch (std::exception const& e)
+            {
+                status = L"Error: " + to_hstring(e.what());
+            }
+            dispatcher.TryEnqueue([weak, status]
+            {
+                if (auto self = weak.get())
+                {
+                    self->OnGenerateFinished(status);
+                }
+            });
+        });
     }
 
     void MainWindow::CancelGenerate_Click(IInspectable const&, RoutedEventArgs const&)
     {
-        // TODO: Cancel password generation
+        if (m_generator)
+        {
+            m_generator->Cancel();
+        }
         CancelGenerateButton().IsEnabled(false);
+    }
+
+    void MainWindow::OnGenerateProgress(uint64_t written, uint64_t total)
+    {
+        if (m_unlockState != UnlockState::Stopped)
+        {
+            return;     // the progress bar and status belong to the run
+        }
+        double fraction = total == 0 ? 1.0 : static_cast<double>(written) / static_cast<double>(total);
+        UnlockProgressBar().Value(fraction * 100.0);
+        StatusText().Text(L"Generating: " + to_hstring(written) + L" of " + to_hstring(total));
+    }
+
+    void MainWindow::OnGenerateFinished(hstring const& status)
+    {
         GenerateButton().IsEnabled(true);
+        CancelGenerateButton().IsEnabled(false);
+        if (m_unlockState == UnlockState::Stopped)
+        {
+            StatusText().Text(status);
+        }
     }
 
+    // Start, then Pause and Resume; StopButton ends the run. Pausing parks
+    // the engine's workers after their current batch, so it frees the cores
+    // without losing their place.
     void MainWindow::UnlockButton_Click(IInspectable const&, RoutedEventArgs const&)
     {
         switch (m_unlockState)
@@ -75,29 +265,204 @@ namespace winrt::runlock::implementation
         case UnlockState::Stopped:
             m_unlockState = UnlockState::Running;
             UnlockButton().Content(box_value(L"Pause"));
+            StopButton().IsEnabled(true);
             StatusText().Text(L"Running...");
+            StartEngine();
             break;
         case UnlockState::Running:
             m_unlockState = UnlockState::Paused;
             UnlockButton().Content(box_value(L"Resume"));
             StatusText().Text(L"Paused");
+            if (m_engine)
+            {
+                m_engine->Pause();
+            }
             break;
         case UnlockState::Paused:
-            m_unlockState = UnlockState::Stopped;
-            UnlockButton().Content(box_value(L"Start"));
-            StatusText().Text(L"Stopped");
+            m_unlockState = UnlockState::Running;
+            UnlockButton().Content(box_value(L"Pause"));
+            StatusText().Text(L"Running...");
+            if (m_engine)
+            {
+                m_engine->Resume();
+            }
             break;
         }
     }
 
+    void MainWindow::StopButton_Click(IInspectable const&, RoutedEventArgs const&)
+    {
+        if (m_unlockState == UnlockState::Stopped)
+        {
+            return;
+        }
+        // OnEngineFinished resets the buttons once the batches in flight
+        // are done and their ranges recorded.
+        StopButton().IsEnabled(false);
+        UnlockButton().IsEnabled(false);
+        StatusText().Text(L"Stopping...");
+        if (m_engine)
+        {
+            m_engine->Stop();
+        }
+    }
+
+    ::runlock::engine::Project MainWindow::ProjectFromControls()
+    {
+        ::runlock::engine::Project project;
+        project.archivePath = to_string(ArchivePathBox().Text());
+        project.rules = to_string(PasswordRulesBox().Text());
+        project.minLength = LengthFromBox(MinLengthBox());
+        project.maxLength = LengthFromBox(MaxLengthBox());
+        project.markovPath = m_progress.markovPath;     // no control of its own; kept from a loaded project
+        if (auto selected = CpuCoresComboBox().SelectedItem())
+        {
+            project.threads = unbox_value<uint32_t>(selected);
+        }
+        return project;
+    }
+
+    void MainWindow::StartEngine()
+    {
+        auto project = ProjectFromControls();
+        ::runlock::engine::EngineOptions options;
+        options.archivePath = project.archivePath;
+        options.rules = project.rules;
+        options.minLength = project.minLength;
+        options.maxLength = project.maxLength;
+        options.markovPath = project.markovPath;
+        options.threads = project.threads;
+        options.physicalCores = unbox_value_or<bool>(PhysicalCoresCheckBox().IsChecked(), false);
+        options.pinThreads = true;
+        options.projectPath = ProjectPathFor(project.archivePath);
+        if (SameRules(project, m_progress))
+        {
+            options.done = m_progress.done;
+            options.keyspaceSize = m_progress.keyspaceSize;
+            project.keyspaceSize = m_progress.keyspaceSize;
+        }
+        m_progress = project;
+        options.onProgress = [dispatcher = DispatcherQueue(), weak = get_weak()](::runlock::engine::EngineProgress const& progress)
+        {
+            dispatcher.TryEnqueue([weak, progress]
+            {
+                if (auto self = weak.get())
+                {
+                    self->OnEngineProgress(progress);
+                }
+            });
+        };
+
+        if (m_engineThread.joinable())
+        {
+            m_engineThread.join();
+        }
+        m_engine = std::make_unique<::runlock::engine::Engine>(std::move(options));
+        m_engineThread = std::thread([engine = m_engine.get(), dispatcher = DispatcherQueue(), weak = get_weak()]
+        {
+            hstring status;
+            ::runlock::engine::RangeSet done;
+            try
+            {
+                auto result = engine->Run();
+                status = result.found
+                    ? L"Password found: " + to_hstring(result.password)
+                        + (result.origin.empty() ? L"" : L" (" + to_hstring(result.origin) + L")")
+                    : L"Password not found (" + to_hstring(result.tested) + L" tested)";
+                done = std::move(result.done);
+            }
+            catch (std::exception const& e)
+            {
+                status = L"Error: " + to_hstring(e.what());
+            }
+            dispatcher.TryEnqueue([weak, status, done = std::move(done)]
+            {
+                if (auto self = weak.get())
+                {
+                    self->OnEngineFinished(status, done);
+                }
+            });
+        });
+    }
+
+    void MainWindow::OnEngineProgress(::runlock::engine::EngineProgress const& progress)
+    {
+        UnlockProgressBar().Value(progress.fraction * 100.0);
+        if (m_unlockState == UnlockState::Running)
+        {
+            wchar_t rate[64];
+            swprintf_s(rate, L"%.1f%% at %.0f/s", progress.fraction * 100.0, progress.rate);
+            StatusText().Text(L"Running: " + hstring(rate) + L", ETA "
+                + to_hstring(::runlock::engine::FormatDuration(progress.eta)));
+        }
+    }
+
+    void MainWindow::OnEngineFinished(hstring const& status, ::runlock::engine::RangeSet done)
+    {
+        m_unlockState = UnlockState::Stopped;
+        UnlockButton().Content(box_value(L"Start"));
+        UnlockButton().IsEnabled(true);
+        StopButton().IsEnabled(false);
+        StatusText().Text(status);
+        if (!done.Empty())
+        {
+            m_progress.done = std::move(done);
+        }
+    }
+
     void MainWindow::SaveProject_Click(IInspectable const&, RoutedEventArgs const&)
     {
-        // TODO: Save project settings
+        auto project = ProjectFromControls();
+        std::string path = ProjectPathFor(project.archivePath);
+        if (m_unlockState != UnlockState::Stopped)
+        {
+            StatusText().Text(L"Progress is saved to " + to_hstring(path) + L" while running");
+            return;
+        }
+        try
+        {
+            project.archiveSize = ::runlock::engine::MappedFile(project.archivePath).Size();
+            if (SameRules(project, m_progress))
+            {
+                project.done = m_progress.done;
+            }
+            ::runlock::engine::SaveProject(project, path);
+            StatusText().Text(L"Project saved to " + to_hstring(path));
+        }
+        catch (std::exception const& e)
+        {
+            StatusText().Text(L"Error: " + to_hstring(e.what()));
+        }
     }
 
     void MainWindow::LoadProject_Click(IInspectable const&, RoutedEventArgs const&)
     {
-        // TODO: Load project settings
+        if (m_unlockState != UnlockState::Stopped)
+        {
+            return;
+        }
+        std::string path = ProjectPathFor(to_string(ArchivePathBox().Text()));
+        try
+        {
+            auto project = ::runlock::engine::LoadProject(path);
+            ArchivePathBox().Text(to_hstring(project.archivePath));
+            PasswordRulesBox().Text(to_hstring(project.rules));
+            MinLengthBox().Value(project.minLength);
+            MaxLengthBox().Value(project.maxLength);
+            if (project.threads != 0 && project.threads <= CpuCoresComboBox().Items().Size())
+            {
+                CpuCoresComboBox().SelectedIndex(static_cast<int32_t>(project.threads - 1));
+            }
+            StatusText().Text(project.password
+                ? L"Password found: " + to_hstring(*project.password)
+                : L"Project loaded (" + to_hstring(project.done.Count()) + L" of "
+                    + to_hstring(project.keyspaceSize) + L" candidates tested)");
+            m_progress = std::move(project);
+        }
+        catch (std::exception const& e)
+        {
+            StatusText().Text(L"Error: " + to_hstring(e.what()));
+        }
     }
 
     int32_t MainWindow::MyProperty()
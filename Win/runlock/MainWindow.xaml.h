@@ -1,12 +1,19 @@
 #pragma once
 
 #include "MainWindow.g.h"
+#include "engine/engine.h"
+#include "engine/generator.h"
+#include "engine/project.h"
+
+#include <memory>
+#include <thread>
 
 namespace winrt::runlock::implementation
 {
     struct MainWindow : MainWindowT<MainWindow>
     {
         MainWindow();
+        ~MainWindow();
 
         int32_t MyProperty();
         void MyProperty(int32_t value);
@@ -15,17 +22,34 @@ namespace winrt::runlock::implementation
         void Archive_DragOver(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::DragEventArgs const& args);
         void Archive_Drop(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::DragEventArgs const& args);
         void PasswordRules_DragOver(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::DragEventArgs const& args);
-        void PasswordRules_Drop(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::DragEventArgs const& args);
+        winrt::fire_and_forget PasswordRules_Drop(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::DragEventArgs args);
         void GeneratePasswords_Click(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
         void CancelGenerate_Click(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
         void UnlockButton_Click(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
+        void StopButton_Click(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
         void SaveProject_Click(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
         void LoadProject_Click(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
         void Window_Loaded(winrt::Windows::Foundation::IInspectable const& sender, winrt::Microsoft::UI::Xaml::RoutedEventArgs const& args);
 
     private:
+        void StartEngine();
+        void OnEngineProgress(::runlock::engine::EngineProgress const& progress);
+        void OnEngineFinished(winrt::hstring const& status, ::runlock::engine::RangeSet done);
+        void OnGenerateProgress(uint64_t written, uint64_t total);
+        void OnGenerateFinished(winrt::hstring const& status);
+        ::runlock::engine::Project ProjectFromControls();
+
         enum class UnlockState { Stopped, Running, Paused };
         UnlockState m_unlockState{ UnlockState::Stopped };
+        std::unique_ptr<::runlock::engine::Engine> m_engine;
+        std::thread m_engineThread;
+
+        std::unique_ptr<::runlock::engine::Generator> m_generator;
+        std::thread m_generatorThread;
+
+        // Rules, bounds and tested ranges of the last run or loaded project;
+        // the ranges are resumed only while the rules are unchanged.
+        ::runlock::engine::Project m_progress;
     };
 }
 
@@ -0,0 +1,236 @@
+#include "aes.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr uint8_t Xtime(uint8_t x)
+        {
+            return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+        }
+
+        constexpr uint8_t Multiply(uint8_t a, uint8_t b)
+        {
+            uint8_t product = 0;
+            for (; b != 0; b >>= 1, a = Xtime(a))
+            {
+                if (b & 1)
+                {
+                    product ^= a;
+                }
+            }
+            return product;
+        }
+
+        constexpr uint8_t Rotl8(uint8_t x, int n)
+        {
+            return static_cast<uint8_t>((x << n) | (x >> (8 - n)));
+        }
+
+        constexpr uint32_t Rotr32(uint32_t x, int n)
+        {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        constexpr uint32_t Word(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3)
+        {
+            return (uint32_t(b0) << 24) | (uint32_t(b1) << 16) | (uint32_t(b2) << 8) | b3;
+        }
+
+        struct Tables
+        {
+            uint8_t sbox[256] = {};
+            uint8_t inverse[256] = {};
+            uint32_t te[4][256] = {};
+            uint32_t td[4][256] = {};
+        };
+
+        constexpr Tables MakeTables()
+        {
+            Tables t;
+            // Walk the multiplicative group with generator 3 (p) and its
+            // inverse (q), applying the affine transform to q.
+            uint8_t p = 1, q = 1;
+            do
+            {
+                p = static_cast<uint8_t>(p ^ Xtime(p));
+                q ^= static_cast<uint8_t>(q << 1);
+                q ^= static_cast<uint8_t>(q << 2);
+                q ^= static_cast<uint8_t>(q << 4);
+                if (q & 0x80)
+                {
+                    q ^= 0x09;
+                }
+                t.sbox[p] = q ^ Rotl8(q, 1) ^ Rotl8(q, 2) ^ Rotl8(q, 3) ^ Rotl8(q, 4) ^ 0x63;
+            } while (p != 1);
+            t.sbox[0] = 0x63;
+
+            for (int x = 0; x < 256; ++x)
+            {
+                uint8_t s = t.sbox[x];
+                t.inverse[s] = static_cast<uint8_t>(x);
+                t.te[0][x] = Word(Multiply(s, 2), s, s, Multiply(s, 3));
+            }
+            for (int x = 0; x < 256; ++x)
+            {
+                uint8_t s = t.inverse[x];
+                t.td[0][x] = Word(Multiply(s, 14), Multiply(s, 9), Multiply(s, 13), Multiply(s, 11));
+            }
+            for (int i = 1; i < 4; ++i)
+            {
+                for (int x = 0; x < 256; ++x)
+                {
+                    t.te[i][x] = Rotr32(t.te[0][x], 8 * i);
+                    t.td[i][x] = Rotr32(t.td[0][x], 8 * i);
+                }
+            }
+            return t;
+        }
+
+        constexpr Tables T = MakeTables();
+
+        inline uint32_t LoadBE32(const uint8_t* p)
+        {
+            return Word(p[0], p[1], p[2], p[3]);
+        }
+
+        inline void StoreBE32(uint8_t* p, uint32_t v)
+        {
+            p[0] = uint8_t(v >> 24);
+            p[1] = uint8_t(v >> 16);
+            p[2] = uint8_t(v >> 8);
+            p[3] = uint8_t(v);
+        }
+
+        inline uint32_t SubWord(uint32_t w)
+        {
+            return Word(T.sbox[w >> 24], T.sbox[(w >> 16) & 0xff], T.sbox[(w >> 8) & 0xff], T.sbox[w & 0xff]);
+        }
+
+        inline uint32_t InvMixColumn(uint32_t w)
+        {
+            return T.td[0][T.sbox[w >> 24]] ^ T.td[1][T.sbox[(w >> 16) & 0xff]]
+                ^ T.td[2][T.sbox[(w >> 8) & 0xff]] ^ T.td[3][T.sbox[w & 0xff]];
+        }
+    }
+
+    Aes::Aes(const uint8_t* key, size_t keyBits)
+    {
+        if (keyBits != 128 && keyBits != 192 && keyBits != 256)
+        {
+            throw std::invalid_argument("AES key must be 128, 192 or 256 bits");
+        }
+        const int nk = static_cast<int>(keyBits / 32);
+        m_rounds = nk + 6;
+        const int total = 4 * (m_rounds + 1);
+
+        for (int i = 0; i < nk; ++i)
+        {
+            m_encrypt[i] = LoadBE32(key + i * 4);
+        }
+        uint8_t rcon = 1;
+        for (int i = nk; i < total; ++i)
+        {
+            uint32_t temp = m_encrypt[i - 1];
+            if (i % nk == 0)
+            {
+                temp = SubWord(Rotr32(temp, 24)) ^ (uint32_t(rcon) << 24);
+                rcon = Xtime(rcon);
+            }
+            else if (nk > 6 && i % nk == 4)
+            {
+                temp = SubWord(temp);
+            }
+            m_encrypt[i] = m_encrypt[i - nk] ^ temp;
+        }
+
+        // Equivalent inverse cipher: round keys in reverse order, with
+        // InvMixColumns applied to all but the first and last.
+        for (int round = 0; round <= m_rounds; ++round)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                uint32_t w = m_encrypt[(m_rounds - round) * 4 + j];
+                m_decrypt[round * 4 + j] = (round == 0 || round == m_rounds) ? w : InvMixColumn(w);
+            }
+        }
+    }
+
+    void Aes::EncryptBlock(const uint8_t in[AesBlockSize], uint8_t out[AesBlockSize]) const
+    {
+        const uint32_t* rk = m_encrypt;
+        uint32_t s0 = LoadBE32(in) ^ rk[0];
+        uint32_t s1 = LoadBE32(in + 4) ^ rk[1];
+        uint32_t s2 = LoadBE32(in + 8) ^ rk[2];
+        uint32_t s3 = LoadBE32(in + 12) ^ rk[3];
+        for (int round = 1; round < m_rounds; ++round)
+        {
+            rk += 4;
+            uint32_t t0 = T.te[0][s0 >> 24] ^ T.te[1][(s1 >> 16) & 0xff] ^ T.te[2][(s2 >> 8) & 0xff] ^ T.te[3][s3 & 0xff] ^ rk[0];
+            uint32_t t1 = T.te[0][s1 >> 24] ^ T.te[1][(s2 >> 16) & 0xff] ^ T.te[2][(s3 >> 8) & 0xff] ^ T.te[3][s0 & 0xff] ^ rk[1];
+            uint32_t t2 = T.te[0][s2 >> 24] ^ T.te[1][(s3 >> 16) & 0xff] ^ T.te[2][(s0 >> 8) & 0xff] ^ T.te[3][s1 & 0xff] ^ rk[2];
+            uint32_t t3 = T.te[0][s3 >> 24] ^ T.te[1][(s0 >> 16) & 0xff] ^ T.te[2][(s1 >> 8) & 0xff] ^ T.te[3][s2 & 0xff] ^ rk[3];
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+        rk += 4;
+        StoreBE32(out, Word(T.sbox[s0 >> 24], T.sbox[(s1 >> 16) & 0xff], T.sbox[(s2 >> 8) & 0xff], T.sbox[s3 & 0xff]) ^ rk[0]);
+        StoreBE32(out + 4, Word(T.sbox[s1 >> 24], T.sbox[(s2 >> 16) & 0xff], T.sbox[(s3 >> 8) & 0xff], T.sbox[s0 & 0xff]) ^ rk[1]);
+        StoreBE32(out + 8, Word(T.sbox[s2 >> 24], T.sbox[(s3 >> 16) & 0xff], T.sbox[(s0 >> 8) & 0xff], T.sbox[s1 & 0xff]) ^ rk[2]);
+        StoreBE32(out + 12, Word(T.sbox[s3 >> 24], T.sbox[(s0 >> 16) & 0xff], T.sbox[(s1 >> 8) & 0xff], T.sbox[s2 & 0xff]) ^ rk[3]);
+    }
+
+    void Aes::DecryptBlock(const uint8_t in[AesBlockSize], uint8_t out[AesBlockSize]) const
+    {
+        const uint32_t* rk = m_decrypt;
+        uint32_t s0 = LoadBE32(in) ^ rk[0];
+        uint32_t s1 = LoadBE32(in + 4) ^ rk[1];
+        uint32_t s2 = LoadBE32(in + 8) ^ rk[2];
+        uint32_t s3 = LoadBE32(in + 12) ^ rk[3];
+        for (int round = 1; round < m_rounds; ++round)
+        {
+            rk += 4;
+            uint32_t t0 = T.td[0][s0 >> 24] ^ T.td[1][(s3 >> 16) & 0xff] ^ T.td[2][(s2 >> 8) & 0xff] ^ T.td[3][s1 & 0xff] ^ rk[0];
+            uint32_t t1 = T.td[0][s1 >> 24] ^ T.td[1][(s0 >> 16) & 0xff] ^ T.td[2][(s3 >> 8) & 0xff] ^ T.td[3][s2 & 0xff] ^ rk[1];
+            uint32_t t2 = T.td[0][s2 >> 24] ^ T.td[1][(s1 >> 16) & 0xff] ^ T.td[2][(s0 >> 8) & 0xff] ^ T.td[3][s3 & 0xff] ^ rk[2];
+            uint32_t t3 = T.td[0][s3 >> 24] ^ T.td[1][(s2 >> 16) & 0xff] ^ T.td[2][(s1 >> 8) & 0xff] ^ T.td[3][s0 & 0xff] ^ rk[3];
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+        rk += 4;
+        StoreBE32(out, Word(T.inverse[s0 >> 24], T.inverse[(s3 >> 16) & 0xff], T.inverse[(s2 >> 8) & 0xff], T.inverse[s1 & 0xff]) ^ rk[0]);
+        StoreBE32(out + 4, Word(T.inverse[s1 >> 24], T.inverse[(s0 >> 16) & 0xff], T.inverse[(s3 >> 8) & 0xff], T.inverse[s2 & 0xff]) ^ rk[1]);
+        StoreBE32(out + 8, Word(T.inverse[s2 >> 24], T.inverse[(s1 >> 16) & 0xff], T.inverse[(s0 >> 8) & 0xff], T.inverse[s3 & 0xff]) ^ rk[2]);
+        StoreBE32(out + 12, Word(T.inverse[s3 >> 24], T.inverse[(s2 >> 16) & 0xff], T.inverse[(s1 >> 8) & 0xff], T.inverse[s0 & 0xff]) ^ rk[3]);
+    }
+
+    void AesCbcEncrypt(const Aes& aes, uint8_t iv[AesBlockSize], const uint8_t* in, uint8_t* out, size_t size)
+    {
+        for (size_t offset = 0; offset + AesBlockSize <= size; offset += AesBlockSize)
+        {
+            uint8_t block[AesBlockSize];
+            for (size_t i = 0; i < AesBlockSize; ++i)
+            {
+                block[i] = in[offset + i] ^ iv[i];
+            }
+            aes.EncryptBlock(block, out + offset);
+            std::memcpy(iv, out + offset, AesBlockSize);
+        }
+    }
+
+    void AesCbcDecrypt(const Aes& aes, uint8_t iv[AesBlockSize], const uint8_t* in, uint8_t* out, size_t size)
+    {
+        for (size_t offset = 0; offset + AesBlockSize <= size; offset += AesBlockSize)
+        {
+            uint8_t cipher[AesBlockSize];
+            std::memcpy(cipher, in + offset, AesBlockSize);
+            aes.DecryptBlock(cipher, out + offset);
+            for (size_t i = 0; i < AesBlockSize; ++i)
+            {
+                out[offset + i] ^= iv[i];
+            }
+            std::memcpy(iv, cipher, AesBlockSize);
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace runlock::engine
+{
+    constexpr size_t AesBlockSize = 16;
+
+    // Table-driven AES (FIPS 197). RAR 2.9-4.x uses AES-128 and RAR5
+    // AES-256, both in CBC mode.
+    class Aes
+    {
+    public:
+        // keyBits is 128, 192 or 256; throws std::invalid_argument otherwise.
+        Aes(const uint8_t* key, size_t keyBits);
+
+        void EncryptBlock(const uint8_t in[AesBlockSize], uint8_t out[AesBlockSize]) const;
+        void DecryptBlock(const uint8_t in[AesBlockSize], uint8_t out[AesBlockSize]) const;
+
+    private:
+        uint32_t m_encrypt[60];
+        uint32_t m_decrypt[60];
+        int m_rounds;
+    };
+
+    // CBC over size bytes (a multiple of the block size). iv carries the
+    // chaining value in and out, so consecutive calls continue one stream;
+    // in and out may be the same buffer.
+    void AesCbcEncrypt(const Aes& aes, uint8_t iv[AesBlockSize], const uint8_t* in, uint8_t* out, size_t size);
+    void AesCbcDecrypt(const Aes& aes, uint8_t iv[AesBlockSize], const uint8_t* in, uint8_t* out, size_t size);
+}
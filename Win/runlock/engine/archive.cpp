@@ -0,0 +1,396 @@
+#include "archive.h"
+#include "archive_image.h"
+#include "content_check.h"
+#include "mapped_file.h"
+#include "text.h"
+#include "unrar_api.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        struct CallbackContext
+        {
+            const std::wstring* password = nullptr;
+
+            // Set while testing the target entry with a content expectation.
+            const ContentCheck* check = nullptr;
+            uint8_t prefix[ContentCheck::PrefixSize];
+            size_t prefixSize = 0;
+            bool rejected = false;
+
+            // The library wanted another volume of a split set and was refused.
+            bool volumeRefused = false;
+
+            // Collects the first bytes of the entry and cancels the test
+            // (-1) once they are known to be wrong.
+            int ProcessData(const uint8_t* data, size_t size)
+            {
+                if (check == nullptr || prefixSize == sizeof(prefix))
+                {
+                    return 1;
+                }
+                size_t take = std::min(size, sizeof(prefix) - prefixSize);
+                std::memcpy(prefix + prefixSize, data, take);
+                prefixSize += take;
+                if (prefixSize == sizeof(prefix) && !check->Plausible(prefix, prefixSize))
+                {
+                    rejected = true;
+                    return -1;
+                }
+                return 1;
+            }
+        };
+
+        int CALLBACK UnrarCallback(UINT msg, LPARAM userData, LPARAM p1, LPARAM p2)
+        {
+            auto context = reinterpret_cast<CallbackContext*>(userData);
+            switch (msg)
+            {
+            case UCM_NEEDPASSWORDW:
+            {
+                if (context->password == nullptr || p2 <= 0)
+                {
+                    return -1;
+                }
+                auto buffer = reinterpret_cast<wchar_t*>(p1);
+                size_t count = std::min(context->password->size(), static_cast<size_t>(p2) - 1);
+                std::wmemcpy(buffer, context->password->data(), count);
+                buffer[count] = L'\0';
+                return 1;
+            }
+            case UCM_NEEDPASSWORD:
+                // The wide variant is always offered first by current libraries;
+                // the narrow one would lose non-ASCII characters.
+                return -1;
+            case UCM_PROCESSDATA:
+                return p2 <= 0 ? 1 : context->ProcessData(reinterpret_cast<const uint8_t*>(p1), static_cast<size_t>(p2));
+            case UCM_CHANGEVOLUME:
+            case UCM_CHANGEVOLUMEW:
+                // Only the volume that was opened is ever read. RAR_VOL_NOTIFY
+                // announces a volume the library found by itself, RAR_VOL_ASK
+                // one it could not; following either would cost every
+                // attempt extra opens, possibly on slow storage.
+                context->volumeRefused = true;
+                return -1;
+            default:
+                return 1;
+            }
+        }
+
+        struct ArchiveHandle
+        {
+            const UnrarApi* api = nullptr;
+            HANDLE handle = nullptr;
+
+            ~ArchiveHandle()
+            {
+                if (handle != nullptr)
+                {
+                    api->CloseArchive(handle);
+                }
+            }
+        };
+
+        bool IsPasswordError(int code)
+        {
+            return code == ERAR_BAD_PASSWORD || code == ERAR_MISSING_PASSWORD || code == ERAR_BAD_DATA;
+        }
+
+        uint64_t Combine(unsigned int low, unsigned int high)
+        {
+            return (static_cast<uint64_t>(high) << 32) | low;
+        }
+
+        ArchiveInfo ListArchiveWithUnrar(const std::string& path)
+        {
+            const UnrarApi& api = LoadUnrar();
+
+            std::wstring widePath = Utf8ToWide(path);
+            CallbackContext context;
+            RAROpenArchiveDataEx data{};
+            data.ArcNameW = widePath.data();
+            data.OpenMode = RAR_OM_LIST;
+            data.Callback = &UnrarCallback;
+            data.UserData = reinterpret_cast<LPARAM>(&context);
+
+            ArchiveHandle archive{ &api, api.OpenArchiveEx(&data) };
+
+            ArchiveInfo info;
+            info.path = path;
+            info.volume = (data.Flags & ROADF_VOLUME) != 0;
+            info.firstVolume = (data.Flags & ROADF_FIRSTVOLUME) != 0;
+            info.solid = (data.Flags & ROADF_SOLID) != 0;
+            info.encryptedHeaders = (data.Flags & ROADF_ENCHEADERS) != 0;
+
+            if (archive.handle == nullptr)
+            {
+                if (IsPasswordError(data.OpenResult))
+                {
+                    info.encryptedHeaders = true;
+                    return info;
+                }
+                throw std::runtime_error(path + ": " + UnrarErrorText(data.OpenResult));
+            }
+            if (info.encryptedHeaders)
+            {
+                return info;
+            }
+
+            auto header = std::make_unique<RARHeaderDataEx>();
+            for (uint32_t index = 0;; ++index)
+            {
+                int code = archive.api->ReadHeaderEx(archive.handle, header.get());
+                if (code == ERAR_END_ARCHIVE || context.volumeRefused)
+                {
+                    break;      // the end of this volume
+                }
+                if (code != ERAR_SUCCESS)
+                {
+                    throw std::runtime_error(path + ": " + UnrarErrorText(code));
+                }
+
+                ArchiveEntry entry;
+                entry.name = WideToUtf8(header->FileNameW);
+                entry.packSize = Combine(header->PackSize, header->PackSizeHigh);
+                entry.unpSize = Combine(header->UnpSize, header->UnpSizeHigh);
+                entry.method = header->Method;
+                entry.index = index;
+                entry.encrypted = (header->Flags & RHDF_ENCRYPTED) != 0;
+                entry.solid = (header->Flags & RHDF_SOLID) != 0;
+                entry.directory = (header->Flags & RHDF_DIRECTORY) != 0;
+                entry.splitBefore = (header->Flags & RHDF_SPLITBEFORE) != 0;
+                entry.splitAfter = (header->Flags & RHDF_SPLITAFTER) != 0;
+                info.entries.push_back(std::move(entry));
+
+                code = archive.api->ProcessFile(archive.handle, RAR_SKIP, nullptr, nullptr);
+                if (context.volumeRefused)
+                {
+                    break;
+                }
+                if (code != ERAR_SUCCESS)
+                {
+                    throw std::runtime_error(path + ": " + UnrarErrorText(code));
+                }
+            }
+            return info;
+        }
+    }
+
+    const char* UnrarErrorText(int code)
+    {
+        switch (code)
+        {
+        case ERAR_SUCCESS: return "success";
+        case ERAR_END_ARCHIVE: return "end of archive";
+        case ERAR_NO_MEMORY: return "not enough memory";
+        case ERAR_BAD_DATA: return "archive data is corrupt";
+        case ERAR_BAD_ARCHIVE: return "not a valid RAR archive";
+        case ERAR_UNKNOWN_FORMAT: return "unknown archive format";
+        case ERAR_EOPEN: return "cannot open archive";
+        case ERAR_ECREATE: return "cannot create file";
+        case ERAR_ECLOSE: return "cannot close file";
+        case ERAR_EREAD: return "read error";
+        case ERAR_EWRITE: return "write error";
+        case ERAR_SMALL_BUF: return "buffer too small";
+        case ERAR_MISSING_PASSWORD: return "password required";
+        case ERAR_EREFERENCE: return "cannot resolve file reference";
+        case ERAR_BAD_PASSWORD: return "wrong password";
+        case ERAR_LARGE_DICT: return "dictionary too large";
+        default: return "unknown error";
+        }
+    }
+
+    ArchiveInfo ListArchive(const std::string& path)
+    {
+        MappedFile archive(path);
+        RarHeaderParser parser(archive.Data(), archive.Size());
+        if (parser.Format() == RarFormat::Unknown)
+        {
+            ArchiveInfo info = ListArchiveWithUnrar(path);
+            info.size = archive.Size();
+            return info;
+        }
+
+        ArchiveInfo info;
+        info.path = path;
+        info.size = archive.Size();
+        info.format = parser.Format();
+        uint32_t index = 0;
+        BlockView block;
+        while (parser.Next(block))
+        {
+            if (block.kind == BlockKind::Main)
+            {
+                MainView main;
+                DecodeMain(block, main);
+                info.volume = main.volume;
+                info.firstVolume = main.firstVolume;
+                info.solid = main.solid;
+                info.encryptedHeaders = main.encryptedHeaders;
+            }
+            else if (block.kind == BlockKind::File)
+            {
+                FileView file;
+                if (!DecodeFile(block, file))
+                {
+                    throw std::runtime_error(path + ": damaged file header");
+                }
+                ArchiveEntry entry;
+                entry.name = DecodeFileName(file, info.format);
+                entry.packSize = file.packSize;
+                entry.unpSize = file.unpSize;
+                entry.method = file.method;
+                entry.index = index++;
+                entry.encrypted = file.encrypted;
+                entry.solid = file.solid;
+                entry.directory = file.directory;
+                entry.splitBefore = file.splitBefore;
+                entry.splitAfter = file.splitAfter;
+                info.entries.push_back(std::move(entry));
+            }
+        }
+        if (parser.EncryptedHeaders() != nullptr)
+        {
+            info.encryptedHeaders = true;
+        }
+        else if (!parser.Error().empty())
+        {
+            throw std::runtime_error(path + ": " + parser.Error());
+        }
+        return info;
+    }
+
+    int PickTargetEntry(const ArchiveInfo& info)
+    {
+        // An entry continued in another volume cannot be tested to its end
+        // (volume changes are refused), and testing a solid entry
+        // decompresses everything before it: an entry wholly inside this
+        // volume beats a split one, then a non-solid entry beats a smaller
+        // solid one.
+        auto rank = [](const ArchiveEntry& entry)
+        {
+            return std::make_tuple(entry.splitBefore || entry.splitAfter, entry.solid, entry.packSize);
+        };
+        int best = -1;
+        for (const auto& entry : info.entries)
+        {
+            if (!entry.encrypted || entry.directory)
+            {
+                continue;
+            }
+            if (best < 0 || rank(entry) < rank(info.entries[best]))
+            {
+                best = static_cast<int>(entry.index);
+            }
+        }
+        return best;
+    }
+
+    DllVerifier::DllVerifier(std::string archivePath, int targetIndex, ContentCheck check, bool keyChecked)
+        : m_path(Utf8ToWide(archivePath))
+        , m_targetIndex(targetIndex)
+        , m_check(check)
+        , m_keyChecked(keyChecked)
+        , m_header(std::make_unique<RARHeaderDataEx>())
+    {
+        LoadUnrar();
+    }
+
+    DllVerifier::DllVerifier(std::shared_ptr<const ArchiveImage> image, ContentCheck check, bool keyChecked)
+        : DllVerifier(image->Path(), 0, check, keyChecked)
+    {
+        m_image = std::move(image);
+    }
+
+    DllVerifier::~DllVerifier() = default;
+
+    bool DllVerifier::Verify(std::string_view password)
+    {
+        const UnrarApi& api = LoadUnrar();
+
+        m_password = Utf8ToWide(password);
+        CallbackContext context;
+        context.password = &m_password;
+        RAROpenArchiveDataEx data{};
+        data.ArcNameW = m_path.data();
+        data.OpenMode = RAR_OM_EXTRACT;
+        data.Callback = &UnrarCallback;
+        data.UserData = reinterpret_cast<LPARAM>(&context);
+
+        ArchiveHandle archive{ &api, api.OpenArchiveEx(&data) };
+        if (archive.handle == nullptr)
+        {
+            if (IsPasswordError(data.OpenResult))
+            {
+                return false;
+            }
+            throw std::runtime_error(WideToUtf8(m_path) + ": " + UnrarErrorText(data.OpenResult));
+        }
+
+        RARHeaderDataEx& header = *m_header;
+        for (int index = 0;; ++index)
+        {
+            int code = api.ReadHeaderEx(archive.handle, &header);
+            if (code == ERAR_END_ARCHIVE)
+            {
+                throw std::runtime_error(WideToUtf8(m_path) + ": target entry not found");
+            }
+            if (IsPasswordError(code))
+            {
+                return false;
+            }
+            if (code != ERAR_SUCCESS)
+            {
+                throw std::runtime_error(WideToUtf8(m_path) + ": " + UnrarErrorText(code));
+            }
+
+            bool isTarget = m_targetIndex < 0
+                ? (header.Flags & RHDF_DIRECTORY) == 0
+                : index == m_targetIndex;
+            context.check = isTarget && m_check.Known() ? &m_check : nullptr;
+            code = api.ProcessFile(archive.handle, isTarget ? RAR_TEST : RAR_SKIP, nullptr, nullptr);
+            if (isTarget)
+            {
+                if (context.rejected)
+                {
+                    return false;   // cancelled from UCM_PROCESSDATA
+                }
+                if (code == ERAR_SUCCESS)
+                {
+                    return true;
+                }
+                if (context.volumeRefused)
+                {
+                    // A split target ran into the end of this volume, short
+                    // of the CRC at the end of the entry. Getting there
+                    // proves nothing by itself.
+                    if (code == ERAR_BAD_PASSWORD || code == ERAR_MISSING_PASSWORD)
+                    {
+                        return false;
+                    }
+                    return m_keyChecked || (context.check != nullptr && context.prefixSize == sizeof(context.prefix));
+                }
+                if (IsPasswordError(code))
+                {
+                    return false;
+                }
+                throw std::runtime_error(WideToUtf8(m_path) + ": " + UnrarErrorText(code));
+            }
+            if (IsPasswordError(code))
+            {
+                return false;
+            }
+            if (code != ERAR_SUCCESS)
+            {
+                throw std::runtime_error(WideToUtf8(m_path) + ": " + UnrarErrorText(code));
+            }
+        }
+    }
+}
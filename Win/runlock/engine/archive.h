@@ -0,0 +1,106 @@
+#pragma once
+
+#include "content_check.h"
+#include "rar_headers.h"
+#include "verifier.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct RARHeaderDataEx;
+
+namespace runlock::engine
+{
+    class ArchiveImage;
+
+    struct ArchiveEntry
+    {
+        std::string name;
+        uint64_t packSize = 0;
+        uint64_t unpSize = 0;
+        uint32_t method = 0;
+        uint32_t index = 0;
+        bool encrypted = false;
+        bool solid = false;
+        bool directory = false;
+        bool splitBefore = false;
+        bool splitAfter = false;
+    };
+
+    struct ArchiveInfo
+    {
+        std::string path;
+        uint64_t size = 0;
+        RarFormat format = RarFormat::Unknown;
+        bool volume = false;
+        bool firstVolume = false;
+        bool solid = false;
+        bool encryptedHeaders = false;
+        std::vector<ArchiveEntry> entries;
+    };
+
+    // Lists the archive with the native header parser, falling back to the
+    // UnRAR library for formats the parser does not know. Archives with
+    // encrypted headers cannot be listed without the password; for those only
+    // the archive flags are filled in. Throws std::runtime_error on failure.
+    ArchiveInfo ListArchive(const std::string& path);
+
+    // Picks the entry that is cheapest to test: the smallest encrypted file,
+    // preferring entries that lie wholly inside this volume of a split set
+    // and then entries that do not continue a solid stream. Returns -1 when
+    // nothing is encrypted at entry level (or the headers are encrypted and
+    // the entries are unknown).
+    int PickTargetEntry(const ArchiveInfo& info);
+
+    // Human readable text for an ERAR_* code.
+    const char* UnrarErrorText(int code);
+
+    // Confirms a password by opening the archive and running RAR_TEST on one
+    // entry. This is the ground truth every faster check defers to. Each
+    // instance is used by a single thread.
+    //
+    // With a known content expectation the decompressed data is watched
+    // through UCM_PROCESSDATA and the test is cancelled as soon as its first
+    // bytes fail the check, so a wrong password costs one chunk of
+    // decompression rather than the whole entry.
+    //
+    // Requests for other volumes of a split set are refused, so a test never
+    // reads beyond the file it was given. A target that continues in the
+    // next volume stops short of its CRC, and a wrong RAR 2.9 key decodes
+    // garbage up to there just as well. Such a target only passes when
+    // something conclusive vouched for the key: the content check over a
+    // full prefix, or (keyChecked) a check value, header or stored data CRC
+    // the caller ran before.
+    //
+    // The UnRAR API cannot rewind a handle, so every attempt opens the
+    // archive again; what does not depend on the password is kept between
+    // attempts.
+    class DllVerifier : public Verifier
+    {
+    public:
+        // targetIndex < 0 tests the first file entry, which is what archives
+        // with encrypted headers need.
+        DllVerifier(std::string archivePath, int targetIndex, ContentCheck check = {}, bool keyChecked = false);
+
+        // Tests the entry of an image shared with the other workers.
+        DllVerifier(std::shared_ptr<const ArchiveImage> image, ContentCheck check = {}, bool keyChecked = false);
+
+        ~DllVerifier() override;
+
+        // True when the archive accepts the password. Throws on I/O or
+        // archive errors that have nothing to do with the password.
+        bool Verify(std::string_view password) override;
+
+    private:
+        std::shared_ptr<const ArchiveImage> m_image;
+        std::wstring m_path;
+        int m_targetIndex;
+        ContentCheck m_check;
+        bool m_keyChecked;
+        std::wstring m_password;
+        std::unique_ptr<RARHeaderDataEx> m_header;
+    };
+}
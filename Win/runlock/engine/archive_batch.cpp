@@ -0,0 +1,176 @@
+#include "archive_batch.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace runlock::engine
+{
+    // Checks a batch against each group in turn and reports the earliest
+    // candidate any of them accepts.
+    class ArchiveBatch::Batched : public Verifier
+    {
+    public:
+        explicit Batched(const ArchiveBatch& batch)
+            : m_batch(batch)
+        {
+            Rebuild();
+            for (const auto& group : m_groups)
+            {
+                m_preferred = std::max(m_preferred, group->PreferredBatch());
+            }
+        }
+
+        bool Verify(std::string_view password) override
+        {
+            Refresh();
+            return std::any_of(m_groups.begin(), m_groups.end(),
+                [&](const auto& group) { return group->Verify(password); });
+        }
+
+        size_t VerifyBatch(CandidateBatch& batch, size_t first, size_t count) override
+        {
+            Refresh();
+            size_t hit = NoMatch;
+            for (const auto& group : m_groups)
+            {
+                if (hit == first)
+                {
+                    break;
+                }
+                // Later groups only need to beat the earliest hit so far.
+                hit = std::min(hit, group->VerifyBatch(batch, first, std::min(count, hit - first)));
+            }
+            return hit;
+        }
+
+        size_t PreferredBatch() const override { return m_preferred; }
+
+    private:
+        void Refresh()
+        {
+            if (m_batch.m_generation.load(std::memory_order_acquire) != m_generation)
+            {
+                Rebuild();
+            }
+        }
+
+        void Rebuild()
+        {
+            m_generation = m_batch.m_generation.load(std::memory_order_acquire);
+            m_groups = m_batch.CreateGroups();
+        }
+
+        const ArchiveBatch& m_batch;
+        uint64_t m_generation = 0;
+        std::vector<std::unique_ptr<Verifier>> m_groups;
+        size_t m_preferred = 1;
+    };
+
+    ArchiveBatch::ArchiveBatch(const std::vector<std::string>& paths)
+        : m_archives(paths.size())
+    {
+        std::map<std::string, size_t> groups;
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            Archive& archive = m_archives[i];
+            archive.info = ListArchive(paths[i]);
+            int target = PickTargetEntry(archive.info);
+            if (target < 0 && !archive.info.encryptedHeaders)
+            {
+                throw std::runtime_error(paths[i] + ": archive is not encrypted");
+            }
+            archive.factory = std::make_unique<VerifierFactory>(archive.info, target);
+
+            std::string key = archive.factory->DerivationKey();
+            auto group = key.empty() ? groups.end() : groups.find(key);
+            if (group != groups.end())
+            {
+                m_groups[group->second].push_back(i);
+                continue;
+            }
+            if (!key.empty())
+            {
+                groups.emplace(key, m_groups.size());
+            }
+            m_groups.push_back({ i });
+        }
+        m_closed = m_archives.size();
+    }
+
+    ArchiveBatch::~ArchiveBatch() = default;
+
+    std::vector<std::unique_ptr<Verifier>> ArchiveBatch::CreateGroups() const
+    {
+        std::vector<std::unique_ptr<Verifier>> verifiers;
+        for (const auto& group : m_groups)
+        {
+            std::vector<const VerifierFactory*> closed;
+            for (size_t archive : group)
+            {
+                if (!m_archives[archive].open.load(std::memory_order_relaxed))
+                {
+                    closed.push_back(m_archives[archive].factory.get());
+                }
+            }
+            if (!closed.empty())
+            {
+                verifiers.push_back(VerifierFactory::CreateShared(closed));
+            }
+        }
+        return verifiers;
+    }
+
+    std::unique_ptr<Verifier> ArchiveBatch::Create() const
+    {
+        if (m_archives.size() == 1)
+        {
+            return m_archives[0].factory->Create();
+        }
+        return std::make_unique<Batched>(*this);
+    }
+
+    std::string ArchiveBatch::Describe() const
+    {
+        if (m_archives.size() == 1)
+        {
+            return m_archives[0].factory->Describe();
+        }
+        std::set<std::string> checks;
+        for (const auto& group : m_groups)
+        {
+            checks.insert(m_archives[group.front()].factory->Describe());
+        }
+        std::string text = std::to_string(m_archives.size()) + " archives, "
+            + std::to_string(m_groups.size()) + (m_groups.size() == 1 ? " derivation" : " derivations")
+            + " per candidate: ";
+        for (auto check = checks.begin(); check != checks.end(); ++check)
+        {
+            text += (check == checks.begin() ? "" : "; ") + *check;
+        }
+        return text;
+    }
+
+    std::vector<size_t> ArchiveBatch::Open(std::string_view password)
+    {
+        std::vector<size_t> opened;
+        for (size_t i = 0; i < m_archives.size(); ++i)
+        {
+            Archive& archive = m_archives[i];
+            // A single archive's own verifier accepted the password already.
+            if (!archive.open.load(std::memory_order_relaxed)
+                && (m_archives.size() == 1 || archive.factory->Create()->Verify(password)))
+            {
+                archive.open.store(true, std::memory_order_relaxed);
+                opened.push_back(i);
+            }
+        }
+        if (!opened.empty())
+        {
+            m_closed.fetch_sub(opened.size(), std::memory_order_release);
+            m_generation.fetch_add(1, std::memory_order_release);
+        }
+        return opened;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "archive.h"
+#include "verifier.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // The archives one run tries candidates against: one normally, a queue
+    // of them in batch mode (archives of one backup job that likely share a
+    // password). Archives whose fast check derives its key from the same
+    // inputs (VerifierFactory::DerivationKey: format, salt and iteration
+    // count) form a group, and each candidate's key is derived once per
+    // group and compared with every member's check, instead of once per
+    // archive. Archives without a fast check are groups of their own.
+    //
+    // Verifiers cover only archives that are not open yet: once Open()
+    // records a password, every worker's verifier rebuilds itself without
+    // the archives it opened before its next batch, and groups with
+    // nothing left stop costing a derivation.
+    class ArchiveBatch
+    {
+    public:
+        // Inspects every archive. Throws std::runtime_error when one cannot
+        // be read, is not encrypted or offers no usable check.
+        explicit ArchiveBatch(const std::vector<std::string>& paths);
+        ~ArchiveBatch();
+
+        size_t Size() const { return m_archives.size(); }
+        size_t GroupCount() const { return m_groups.size(); }
+        const ArchiveInfo& Info(size_t archive) const { return m_archives[archive].info; }
+
+        // A verifier, for one worker, that accepts a candidate opening any
+        // archive not open yet.
+        std::unique_ptr<Verifier> Create() const;
+
+        // Short name of the checks, for logs and the CLI.
+        std::string Describe() const;
+
+        // Which of the archives not open yet a candidate opens; those are
+        // marked open. Called for candidates a verifier accepted, from one
+        // thread at a time. With several archives each is tested again,
+        // which costs one key derivation per archive.
+        std::vector<size_t> Open(std::string_view password);
+
+        bool AllOpen() const { return m_closed.load(std::memory_order_acquire) == 0; }
+
+    private:
+        class Batched;
+
+        struct Archive
+        {
+            ArchiveInfo info;
+            std::unique_ptr<VerifierFactory> factory;
+            std::atomic<bool> open{ false };
+        };
+
+        // Verifiers for the groups that still have archives to open.
+        std::vector<std::unique_ptr<Verifier>> CreateGroups() const;
+
+        std::vector<Archive> m_archives;
+        std::vector<std::vector<size_t>> m_groups;     // archive indexes per derivation key
+        std::atomic<size_t> m_closed{ 0 };
+        std::atomic<uint64_t> m_generation{ 0 };      // bumped by every Open() that opens something
+    };
+}
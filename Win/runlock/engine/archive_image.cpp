@@ -0,0 +1,246 @@
+#include "archive_image.h"
+#include "crc32.h"
+#include "mapped_file.h"
+#include "rar_headers.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr uint8_t Marker15[] = { 'R', 'a', 'r', '!', 0x1a, 0x07, 0x00 };
+        constexpr uint8_t Marker50[] = { 'R', 'a', 'r', '!', 0x1a, 0x07, 0x01, 0x00 };
+
+        // RAR 1.5 main header flags that describe other volumes or blocks
+        // the image does not carry.
+        constexpr uint32_t Mhd15Volume = 0x0001;
+        constexpr uint32_t Mhd15NewNumbering = 0x0010;
+        constexpr uint32_t Mhd15Protect = 0x0040;
+        constexpr uint32_t Mhd15FirstVolume = 0x0100;
+
+        void Append(std::vector<uint8_t>& out, const uint8_t* data, size_t size)
+        {
+            out.insert(out.end(), data, data + size);
+        }
+
+        // RAR 1.5 block: CRC16, type, flags, size, then the rest of the
+        // header as given.
+        void AppendBlock15(std::vector<uint8_t>& out, uint8_t type, uint32_t flags, const uint8_t* rest, size_t restSize)
+        {
+            size_t start = out.size();
+            size_t size = 7 + restSize;
+            uint8_t head[7] = { 0, 0, type, uint8_t(flags), uint8_t(flags >> 8), uint8_t(size), uint8_t(size >> 8) };
+            Append(out, head, sizeof(head));
+            Append(out, rest, restSize);
+            uint32_t crc = Crc32(out.data() + start + 2, size - 2);
+            out[start] = uint8_t(crc);
+            out[start + 1] = uint8_t(crc >> 8);
+        }
+
+        // RAR5 block with single-byte fields only: CRC32, size, type,
+        // header flags 0 and a zero type-specific flags field.
+        void AppendBlock50(std::vector<uint8_t>& out, uint8_t type)
+        {
+            uint8_t block[8] = { 0, 0, 0, 0, 3, type, 0, 0 };
+            uint32_t crc = Crc32(block + 4, 4);
+            for (int i = 0; i < 4; ++i)
+            {
+                block[i] = uint8_t(crc >> (8 * i));
+            }
+            Append(out, block, sizeof(block));
+        }
+
+        // Writes go out in pieces of this size, so no single call needs a
+        // size type wider than 32 bits.
+        constexpr size_t WriteChunk = size_t(1) << 20;
+
+        // The image: synthesized headers around the entry, which stays in
+        // the mapped archive until it is written out.
+        struct Layout
+        {
+            std::vector<uint8_t> head;      // marker, main header
+            const uint8_t* entry = nullptr; // entry header and data
+            size_t entrySize = 0;
+            std::vector<uint8_t> tail;      // end block
+
+            size_t Size() const { return head.size() + entrySize + tail.size(); }
+        };
+
+        // The image layout, or an empty one when the entry cannot be cut out.
+        Layout Cut(const MappedFile& archive, int targetIndex)
+        {
+            Layout image;
+            RarHeaderParser parser(archive.Data(), archive.Size());
+            if (parser.Format() == RarFormat::Unknown || targetIndex < 0)
+            {
+                return image;
+            }
+
+            BlockView main;
+            bool haveMain = false;
+            int index = -1;
+            BlockView block;
+            while (parser.Next(block))
+            {
+                if (block.kind == BlockKind::Main)
+                {
+                    main = block;
+                    haveMain = true;
+                }
+                if (block.kind != BlockKind::File || ++index != targetIndex)
+                {
+                    continue;
+                }
+                FileView file;
+                if (!haveMain || !DecodeFile(block, file) || file.solid || file.splitBefore || file.splitAfter
+                    || block.dataSize > ArchiveImage::MaxBytes)
+                {
+                    return image;
+                }
+
+                image.entry = block.begin;
+                image.entrySize = block.headerSize + static_cast<size_t>(block.dataSize);
+                if (parser.Format() == RarFormat::Rar15)
+                {
+                    Append(image.head, Marker15, sizeof(Marker15));
+                    uint32_t flags = main.flags & ~(Mhd15Volume | Mhd15NewNumbering | Mhd15Protect | Mhd15FirstVolume);
+                    AppendBlock15(image.head, uint8_t(main.type), flags, main.begin + 7, main.headerSize - 7);
+                    AppendBlock15(image.tail, 0x7b, 0x4000, nullptr, 0);
+                }
+                else
+                {
+                    // A fresh main header also drops the locator record,
+                    // whose offsets would point outside the image.
+                    Append(image.head, Marker50, sizeof(Marker50));
+                    AppendBlock50(image.head, 1);
+                    AppendBlock50(image.tail, 5);
+                }
+                return image;
+            }
+            return image;
+        }
+    }
+
+    std::shared_ptr<const ArchiveImage> ArchiveImage::Build(const std::string& archivePath, int targetIndex)
+    {
+        MappedFile archive(archivePath);
+        Layout layout = Cut(archive, targetIndex);
+        if (layout.head.empty() || layout.Size() > MaxBytes)
+        {
+            return nullptr;
+        }
+
+        std::shared_ptr<ArchiveImage> image(new ArchiveImage());
+        image->m_size = layout.Size();
+#ifdef _WIN32
+        wchar_t directory[MAX_PATH + 1];
+        wchar_t name[MAX_PATH + 1];
+        DWORD length = ::GetTempPathW(MAX_PATH + 1, directory);
+        if (length == 0 || length > MAX_PATH || ::GetTempFileNameW(directory, L"rlk", 0, name) == 0)
+        {
+            throw std::runtime_error("cannot create a temporary archive image");
+        }
+        image->m_path = WideToUtf8(name);
+        image->m_temporary = true;
+        HANDLE file = ::CreateFileW(name, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+        bool ok = file != INVALID_HANDLE_VALUE;
+        auto write = [&](const uint8_t* data, size_t size)
+        {
+            for (size_t done = 0; ok && done < size;)
+            {
+                DWORD chunk = static_cast<DWORD>(std::min(size - done, WriteChunk));
+                DWORD written = 0;
+                ok = ::WriteFile(file, data + done, chunk, &written, nullptr) && written > 0;
+                done += written;
+            }
+        };
+#else
+        int fd = -1;
+#ifdef __linux__
+        fd = ::memfd_create("runlock-image", MFD_CLOEXEC);
+        if (fd >= 0)
+        {
+            image->m_fd = fd;
+            image->m_path = "/proc/self/fd/" + std::to_string(fd);
+        }
+#endif
+        if (fd < 0)
+        {
+            const char* tmp = std::getenv("TMPDIR");
+            std::string path = std::string(tmp != nullptr && *tmp != '\0' ? tmp : "/tmp") + "/runlock-XXXXXX";
+            fd = ::mkstemp(path.data());
+            if (fd < 0)
+            {
+                throw std::runtime_error("cannot create a temporary archive image");
+            }
+            image->m_path = path;
+            image->m_temporary = true;
+        }
+        bool ok = true;
+        auto write = [&](const uint8_t* data, size_t size)
+        {
+            for (size_t done = 0; ok && done < size;)
+            {
+                ssize_t written = ::write(fd, data + done, std::min(size - done, WriteChunk));
+                ok = written > 0;
+                done += ok ? static_cast<size_t>(written) : 0;
+            }
+        };
+#endif
+        write(layout.head.data(), layout.head.size());
+        write(layout.entry, layout.entrySize);
+        write(layout.tail.data(), layout.tail.size());
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(file);
+        }
+#else
+        if (image->m_fd != fd)
+        {
+            ::close(fd);
+        }
+#endif
+        if (!ok)
+        {
+            throw std::runtime_error("cannot write the temporary archive image " + image->m_path);
+        }
+        return image;
+    }
+
+    ArchiveImage::~ArchiveImage()
+    {
+#ifdef _WIN32
+        if (m_temporary)
+        {
+            ::DeleteFileW(Utf8ToWide(m_path).c_str());
+        }
+#else
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+        }
+        if (m_temporary)
+        {
+            ::unlink(m_path.c_str());
+        }
+#endif
+    }
+}
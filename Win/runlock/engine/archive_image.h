@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace runlock::engine
+{
+    // A copy of an archive cut down to what testing one entry needs: the
+    // marker, a main header without volume or recovery information, the
+    // entry's header and data, and an end block. Built once and opened by
+    // every DllVerifier, so an attempt parses a single header from memory
+    // instead of walking the original archive's directory on disk.
+    //
+    // The image lives in an anonymous memory file where the platform has
+    // one (Linux) and in a temporary file otherwise; either way it is
+    // removed when the last reference goes away.
+    class ArchiveImage
+    {
+    public:
+        // Largest image Build() makes. A bigger entry is tested in the
+        // original archive, which costs a directory walk per attempt rather
+        // than a copy of the entry in memory or on the temporary drive.
+        static constexpr size_t MaxBytes = size_t(64) << 20;
+
+        // Returns nullptr when the entry cannot be tested on its own (it
+        // continues a solid stream or another volume, the headers are
+        // encrypted, or the format is not one the header parser knows) or
+        // the image would exceed MaxBytes.
+        static std::shared_ptr<const ArchiveImage> Build(const std::string& archivePath, int targetIndex);
+
+        ~ArchiveImage();
+
+        ArchiveImage(const ArchiveImage&) = delete;
+        ArchiveImage& operator=(const ArchiveImage&) = delete;
+
+        // Path the UnRAR library opens; the entry is the first one in it.
+        const std::string& Path() const { return m_path; }
+        size_t Size() const { return m_size; }
+
+    private:
+        ArchiveImage() = default;
+
+        std::string m_path;
+        size_t m_size = 0;
+        int m_fd = -1;              // memory file descriptor, kept open for the path to stay valid
+        bool m_temporary = false;   // m_path is a file to delete
+    };
+}
@@ -0,0 +1,259 @@
+#include "fixtures.h"
+
+#include "aes.h"
+#include "crc32.h"
+#include "rar3_kdf.h"
+#include "rar5.h"
+#include "sha256.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+using namespace runlock::engine;
+
+namespace runlock::bench
+{
+    namespace
+    {
+        using Bytes = std::vector<uint8_t>;
+
+        void Append(Bytes& out, const void* data, size_t size)
+        {
+            out.insert(out.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        }
+
+        void AppendLe(Bytes& out, uint64_t value, size_t size)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        void AppendVint(Bytes& out, uint64_t value)
+        {
+            do
+            {
+                uint8_t byte = value & 0x7f;
+                value >>= 7;
+                out.push_back(value != 0 ? byte | 0x80 : byte);
+            } while (value != 0);
+        }
+
+        // Content padded with zeros to whole AES blocks, then encrypted.
+        Bytes Encrypt(Bytes data, const uint8_t* key, size_t keyBits, const uint8_t iv[AesBlockSize])
+        {
+            data.resize((data.size() + AesBlockSize - 1) / AesBlockSize * AesBlockSize);
+            uint8_t chain[AesBlockSize];
+            std::memcpy(chain, iv, sizeof(chain));
+            AesCbcEncrypt(Aes(key, keyBits), chain, data.data(), data.data(), data.size());
+            return data;
+        }
+
+        // RAR5 block: CRC32 of size and body, the size as a vint, the body.
+        void AppendRar5Block(Bytes& out, const Bytes& body)
+        {
+            Bytes sized;
+            AppendVint(sized, body.size());
+            Append(sized, body.data(), body.size());
+            AppendLe(out, Crc32(sized.data(), sized.size()), 4);
+            Append(out, sized.data(), sized.size());
+        }
+
+        // RAR 1.5-4.x block: CRC16 (low half of CRC32) over type..body.
+        void AppendRar3Block(Bytes& out, uint8_t type, uint16_t flags, const Bytes& body)
+        {
+            Bytes header;
+            header.push_back(type);
+            AppendLe(header, flags, 2);
+            AppendLe(header, 7 + body.size(), 2);
+            Append(header, body.data(), body.size());
+            AppendLe(out, Crc32(header.data(), header.size()) & 0xffff, 2);
+            Append(out, header.data(), header.size());
+        }
+
+        // Writes bit strings most significant bit first, as RAR's unpacker
+        // reads them.
+        class BitWriter
+        {
+        public:
+            void Put(uint32_t value, size_t bits)
+            {
+                while (bits-- > 0)
+                {
+                    if (m_used % 8 == 0)
+                    {
+                        m_bytes.push_back(0);
+                    }
+                    if ((value >> bits) & 1)
+                    {
+                        m_bytes.back() |= static_cast<uint8_t>(0x80 >> (m_used % 8));
+                    }
+                    ++m_used;
+                }
+            }
+
+            const Bytes& Data() const { return m_bytes; }
+
+        private:
+            Bytes m_bytes;
+            size_t m_used = 0;
+        };
+
+        // RAR 2.9 LZ stream (method 0x33, unpack version 29) holding content
+        // as literals: one table block in which every main code symbol is 9
+        // bits long, so symbol N is the 9-bit code N, then symbol 256 with
+        // "new file, no new table" to end the file.
+        Bytes CompressLiterals(std::string_view content)
+        {
+            BitWriter out;
+            out.Put(0, 2);                      // LZ block, fresh tables
+            // Bit length code: symbols 5, 6 and 9 are two bits long, which
+            // makes them 00, 01 and 10; the rest are absent.
+            for (uint32_t symbol = 0; symbol < 20; ++symbol)
+            {
+                out.Put(symbol == 5 || symbol == 6 || symbol == 9 ? 2 : 0, 4);
+            }
+            const struct { size_t count; uint32_t code; } lengths[] = {
+                { 299, 2 },     // main: 9 bits
+                { 60, 1 },      // distance: 6 bits
+                { 17, 0 },      // low distance: 5 bits
+                { 28, 0 },      // repeat length: 5 bits
+            };
+            for (const auto& table : lengths)
+            {
+                for (size_t i = 0; i < table.count; ++i)
+                {
+                    out.Put(table.code, 2);
+                }
+            }
+            for (unsigned char c : content)
+            {
+                out.Put(c, 9);
+            }
+            out.Put(256, 9);
+            out.Put(0, 2);
+            return out.Data();
+        }
+
+        // File header and data of an encrypted RAR 1.5-4.x entry.
+        void AppendRar3File(Bytes& archive, const Rar3Keys& keys, const uint8_t salt[Rar3SaltSize],
+            const FixtureFile& entry, uint8_t method, const Bytes& packed)
+        {
+            Bytes data = Encrypt(packed, keys.key, 128, keys.iv);
+
+            Bytes file;
+            AppendLe(file, data.size(), 4);
+            AppendLe(file, entry.content.size(), 4);
+            file.push_back(2);                      // Windows
+            AppendLe(file, Crc32(entry.content.data(), entry.content.size()), 4);
+            AppendLe(file, 0, 4);                   // DOS time
+            file.push_back(29);                     // unpack version
+            file.push_back(method);
+            AppendLe(file, entry.name.size(), 2);
+            AppendLe(file, 0x20, 4);                // attributes
+            Append(file, entry.name.data(), entry.name.size());
+            Append(file, salt, Rar3SaltSize);
+
+            AppendRar3Block(archive, 0x74, 0x8000 | 0x04 | 0x400, file);    // long block, password, salt
+            Append(archive, data.data(), data.size());
+        }
+
+        void Save(const std::string& path, const Bytes& bytes)
+        {
+            std::ofstream file(path, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            if (!file.flush())
+            {
+                throw std::runtime_error("cannot write " + path);
+            }
+        }
+    }
+
+    void WriteRar5Fixture(const std::string& path, const std::string& password, uint32_t lg2Count, const FixtureFile& stored)
+    {
+        uint8_t salt[Rar5SaltSize];
+        uint8_t iv[AesBlockSize];
+        for (uint8_t i = 0; i < 16; ++i)
+        {
+            salt[i] = i;
+            iv[i] = static_cast<uint8_t>(0x10 + i);
+        }
+        Rar5Keys keys;
+        DeriveRar5Keys(password, salt, lg2Count, keys);
+        uint8_t check[Rar5CheckSize];
+        FoldRar5Check(keys.checkValue, check);
+        uint8_t checkDigest[Sha256DigestSize];
+        Sha256 hash;
+        hash.Update(check, sizeof(check));
+        hash.Final(checkDigest);
+        Bytes data = Encrypt(Bytes(stored.content.begin(), stored.content.end()), keys.key, 256, iv);
+
+        // Encryption record: version 0, password check present, no MAC.
+        Bytes record;
+        AppendVint(record, 1);      // record type: encryption
+        AppendVint(record, 0);
+        AppendVint(record, 0x01);
+        record.push_back(static_cast<uint8_t>(lg2Count));
+        Append(record, salt, sizeof(salt));
+        Append(record, iv, sizeof(iv));
+        Append(record, check, sizeof(check));
+        Append(record, checkDigest, 4);
+        Bytes extra;
+        AppendVint(extra, record.size());
+        Append(extra, record.data(), record.size());
+
+        Bytes file;
+        AppendVint(file, 2);                    // file header
+        AppendVint(file, 0x01 | 0x02);          // extra area, data area
+        AppendVint(file, extra.size());
+        AppendVint(file, data.size());
+        AppendVint(file, 0x04);                 // CRC32 present
+        AppendVint(file, stored.content.size());
+        AppendVint(file, 0x20);                 // attributes
+        AppendLe(file, Crc32(stored.content.data(), stored.content.size()), 4);
+        AppendVint(file, 0);                    // version 0, stored
+        AppendVint(file, 0);                    // Windows
+        AppendVint(file, stored.name.size());
+        Append(file, stored.name.data(), stored.name.size());
+        Append(file, extra.data(), extra.size());
+
+        Bytes archive{ 'R', 'a', 'r', '!', 0x1a, 0x07, 0x01, 0x00 };
+        AppendRar5Block(archive, Bytes{ 1, 0, 0 });    // main header
+        AppendRar5Block(archive, file);
+        Append(archive, data.data(), data.size());
+        AppendRar5Block(archive, Bytes{ 5, 0, 0 });    // end of archive
+        Save(path, archive);
+    }
+
+    void WriteRar3Fixture(const std::string& path, const std::string& password, const FixtureFile& stored)
+    {
+        const uint8_t salt[Rar3SaltSize] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        Rar3Keys keys;
+        DeriveRar3Keys(password, salt, keys);
+
+        Bytes archive{ 'R', 'a', 'r', '!', 0x1a, 0x07, 0x00 };
+        AppendRar3Block(archive, 0x73, 0, Bytes(6));                    // main header
+        AppendRar3File(archive, keys, salt, stored, 0x30, Bytes(stored.content.begin(), stored.content.end()));
+        AppendRar3Block(archive, 0x7b, 0x4000, {});                      // end of archive
+        Save(path, archive);
+    }
+
+    void WriteRar3CompressedFixture(const std::string& path, const std::string& password, const FixtureFile& compressed)
+    {
+        const uint8_t salt[Rar3SaltSize] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        Rar3Keys keys;
+        DeriveRar3Keys(password, salt, keys);
+        FixtureFile stored{ "stored.txt", compressed.content };
+
+        Bytes archive{ 'R', 'a', 'r', '!', 0x1a, 0x07, 0x00 };
+        AppendRar3Block(archive, 0x73, 0, Bytes(6));                    // main header
+        AppendRar3File(archive, keys, salt, compressed, 0x33, CompressLiterals(compressed.content));
+        AppendRar3File(archive, keys, salt, stored, 0x30, Bytes(stored.content.begin(), stored.content.end()));
+        AppendRar3Block(archive, 0x7b, 0x4000, {});                      // end of archive
+        Save(path, archive);
+    }
+}
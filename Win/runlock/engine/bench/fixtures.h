@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace runlock::bench
+{
+    // Writes a minimal archive holding one stored, encrypted file with the
+    // given password, built with the engine's own AES, CRC and key
+    // derivation so no rar tool is needed. The data CRC is stored in the
+    // clear, so the UnRAR library can confirm the password.
+
+    // The stored file; the bench uses the defaults, the tests other names
+    // and payloads.
+    struct FixtureFile
+    {
+        std::string name = "bench.txt";
+        std::string content = "runlock benchmark fixture: the quick brown fox jumps over the lazy dog.\n";
+    };
+
+    // RAR5: AES-256, password check record, 2^lg2Count KDF iterations.
+    void WriteRar5Fixture(const std::string& path, const std::string& password, uint32_t lg2Count,
+        const FixtureFile& file = {});
+
+    // RAR 2.9-4.x: AES-128 with a salt (the fixed 2^18-round key schedule).
+    void WriteRar3Fixture(const std::string& path, const std::string& password, const FixtureFile& file = {});
+
+    // RAR 2.9-4.x with the file compressed (method 0x33, its bytes as LZ
+    // literals) followed by a stored copy named stored.txt under the same
+    // salt, so the verifier runs the Huffman table check on the compressed
+    // entry and the stored CRC keeps the archive conclusive without UnRAR.
+    void WriteRar3CompressedFixture(const std::string& path, const std::string& password, const FixtureFile& file = {});
+}
@@ -0,0 +1,576 @@
+// runlock-bench: per-stage throughput of the recovery pipeline on archives
+// it writes itself, as JSON on stdout (progress goes to stderr).
+
+#include "fixtures.h"
+
+#include "archive.h"
+#include "candidate_batch.h"
+#include "cpu_features.h"
+#include "keyspace.h"
+#include "rar3_kdf.h"
+#include "rar5_kdf.h"
+#include "text.h"
+#include "unrar_api.h"
+#include "verifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace runlock::engine;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    // Every global operator new in the process; each measurement reports
+    // how many happened while it was timing.
+    std::atomic<uint64_t> allocations{ 0 };
+}
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// Out of line, so the compiler does not pair an inlined free() with a
+// new-expression and warn about mismatched allocation functions.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+    constexpr std::string_view Password = "bench-pass";
+    constexpr std::string_view CandidateMask = "?l?l?l?l?l?l?l?l";
+    constexpr std::string_view MutationRules =
+        "%mutate :\n%mutate c\n%mutate u $1\n%mutate sa@ so0 se3\n%mutate c $2$0$2$4\n%mutate t\n%mutate r\n%mutate d\n";
+    constexpr size_t BatchSize = 4096;
+
+    void PrintUsage()
+    {
+        std::cout <<
+            "usage: runlock-bench [options]\n"
+            "\n"
+            "  -s, --seconds S    time per measurement (default: 1)\n"
+            "  -t, --threads N    highest thread count; runs 1, 2, 4, ... N (default: all)\n"
+            "      --lg2 N        RAR5 KDF cost of the fixture, 2^N iterations (default: 15)\n"
+            "      --stages LIST  comma-separated stages to run (default: all)\n"
+            "      --unrar PATH   UnRAR library for the confirm stages\n"
+            "      --keep DIR     write the fixtures to DIR and keep them\n"
+            "  -h, --help         show this help\n"
+            "\n"
+            "Stages: generate, generate-batch, mutate, combine, utf16, rar3-encode,\n"
+            "kdf-rar5, kdf-rar3, check-rar5, check-rar3, check-rar3-lz, confirm-rar5,\n"
+            "confirm-rar3, confirm-rar3-lz (the confirm stages need the UnRAR library).\n"
+            "\n"
+            "Exit status: 0 done, 1 a fixture failed its own verification, 2 error.\n";
+    }
+
+    std::string JsonString(std::string_view text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out += escape;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out + '"';
+    }
+
+    // Per-thread work for one stage: called once on its thread to set up,
+    // it returns the step that processes one batch and reports how many
+    // candidates that was.
+    using Step = std::function<size_t()>;
+    using Stage = std::function<Step(uint32_t thread)>;
+
+    struct NamedStage
+    {
+        std::string name;
+        Stage stage;
+    };
+
+    struct Measurement
+    {
+        uint64_t candidates = 0;
+        double seconds = 0.0;
+        uint64_t allocations = 0;   // in any thread while timing
+    };
+
+    // Runs the stage on `threads` threads for about `seconds`, timing from
+    // the moment every thread has finished its setup.
+    Measurement Measure(const Stage& stage, uint32_t threads, double seconds)
+    {
+        std::latch ready(threads + 1);
+        std::atomic<bool> go{ false };
+        std::atomic<uint64_t> total{ 0 };
+        Clock::time_point deadline;
+        std::exception_ptr failure;
+        std::mutex failureMutex;
+
+        std::vector<std::thread> workers;
+        for (uint32_t id = 0; id < threads; ++id)
+        {
+            workers.emplace_back([&, id]
+            {
+                Step step;
+                try
+                {
+                    step = stage(id);
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(failureMutex);
+                    failure = std::current_exception();
+                }
+                ready.arrive_and_wait();
+                go.wait(false);
+                uint64_t count = 0;
+                while (step && Clock::now() < deadline)
+                {
+                    count += step();
+                }
+                total += count;
+            });
+        }
+        ready.arrive_and_wait();
+        uint64_t allocated = allocations.load(std::memory_order_relaxed);
+        auto started = Clock::now();
+        deadline = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        go = true;
+        go.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+        allocated = allocations.load(std::memory_order_relaxed) - allocated;
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+        return { total.load(), elapsed, allocated };
+    }
+
+    // Distinct wrong candidates for each thread.
+    std::vector<std::string> Candidates(const Keyspace& keyspace, uint32_t thread, size_t count)
+    {
+        std::vector<std::string> candidates;
+        uint64_t first = keyspace.Size() / 64 * thread;
+        for (size_t i = 0; i < count; ++i)
+        {
+            candidates.push_back(keyspace.At(first + i));
+        }
+        return candidates;
+    }
+
+    struct Fixture
+    {
+        std::string format;
+        std::string path;
+        uint32_t lg2Count;
+        std::string check;
+        bool verified = false;
+    };
+
+    // Confirms the fixture with the engine's own verifier: the password
+    // passes and a wrong one does not.
+    Fixture Verify(Fixture fixture)
+    {
+        VerifierFactory factory(ListArchive(fixture.path), 0);
+        fixture.check = factory.Describe();
+        auto verifier = factory.Create();
+        fixture.verified = verifier->Verify(Password) && !verifier->Verify("not-the-password");
+        return fixture;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 1.0;
+    uint32_t maxThreads = 0;
+    uint32_t lg2Count = 15;
+    std::string stagesFilter;
+    std::string unrarPath;
+    std::string keepDir;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char*
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("missing value for " + std::string(arg));
+                }
+                return argv[++i];
+            };
+            auto number = [&](double low, double high)
+            {
+                const char* text = value();
+                char* end = nullptr;
+                double parsed = std::strtod(text, &end);
+                if (end == text || *end != '\0' || !(parsed >= low && parsed <= high))
+                {
+                    throw std::runtime_error("invalid value for " + std::string(arg) + ": " + text);
+                }
+                return parsed;
+            };
+
+            if (arg == "-h" || arg == "--help") { PrintUsage(); return 0; }
+            else if (arg == "-s" || arg == "--seconds") { seconds = number(0.01, 3600); }
+            else if (arg == "-t" || arg == "--threads") { maxThreads = static_cast<uint32_t>(number(1, 4096)); }
+            else if (arg == "--lg2") { lg2Count = static_cast<uint32_t>(number(0, Rar5MaxLg2Count)); }
+            else if (arg == "--stages") { stagesFilter = "," + std::string(value()) + ","; }
+            else if (arg == "--unrar") { unrarPath = value(); }
+            else if (arg == "--keep") { keepDir = value(); }
+            else { throw std::runtime_error("unknown option " + std::string(arg)); }
+        }
+        if (maxThreads == 0)
+        {
+            maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        namespace fs = std::filesystem;
+        fs::path directory = keepDir;
+        if (keepDir.empty())
+        {
+            directory = fs::temp_directory_path() / ("runlock-bench-" + std::to_string(std::random_device()()));
+        }
+        fs::create_directories(directory);
+        std::string rar5Path = (directory / "bench5.rar").string();
+        std::string rar3Path = (directory / "bench3.rar").string();
+        std::string rar3LzPath = (directory / "bench3lz.rar").string();
+        runlock::bench::WriteRar5Fixture(rar5Path, std::string(Password), lg2Count);
+        runlock::bench::WriteRar3Fixture(rar3Path, std::string(Password));
+        runlock::bench::WriteRar3CompressedFixture(rar3LzPath, std::string(Password));
+
+        const UnrarApi* unrar = TryLoadUnrar(unrarPath);
+        std::vector<Fixture> fixtures{
+            Verify({ "rar5", rar5Path, lg2Count, {} }),
+            Verify({ "rar3", rar3Path, 18, {} }),
+            Verify({ "rar3-lz", rar3LzPath, 18, {} }),
+        };
+
+        Keyspace keyspace = Keyspace::Compile(CandidateMask);
+        // Base words under a small mangling rule set, for the mutate stage.
+        std::string mutationRules(MutationRules);
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            mutationRules += "word" + std::to_string(i) + "\n";
+        }
+        Keyspace mutated = Keyspace::Compile(mutationRules);
+        // Name, year and symbol in every order with two separators, for the combine stage.
+        std::string combineRules = "%combine permute\n%tokens\n";
+        for (size_t i = 0; i < 64; ++i)
+        {
+            combineRules += "name" + std::to_string(i) + "\n";
+        }
+        combineRules += "%tokens\n";
+        for (size_t year = 1950; year < 2050; ++year)
+        {
+            combineRules += std::to_string(year) + "\n";
+        }
+        combineRules += "%tokens\n!\n@\n$\n=%\n&\n*\n?\n+\n-\n.\n_\n~\n^\n;\n:\n=#\n%separator\n%separator .\n%end\n";
+        Keyspace combined = Keyspace::Compile(combineRules);
+        const Rar5KdfKernel& rar5Kernel = SelectRar5Kernel();
+        const Rar3KdfKernel& rar3Kernel = SelectRar3Kernel();
+        std::atomic<size_t> sink{ 0 };      // keeps results of the pure stages observable
+
+        std::vector<NamedStage> stages;
+        stages.emplace_back("generate", [&](uint32_t thread) -> Step
+        {
+            auto buffer = std::make_shared<std::string>(keyspace.MaxBytes(), '\0');
+            auto index = std::make_shared<uint64_t>(keyspace.Size() / 64 * thread);
+            return [&, buffer, index]
+            {
+                size_t bytes = 0;
+                for (size_t i = 0; i < BatchSize; ++i)
+                {
+                    bytes += keyspace.View((*index)++, buffer->data()).size();
+                }
+                sink.fetch_add(bytes, std::memory_order_relaxed);
+                return BatchSize;
+            };
+        });
+        stages.emplace_back("generate-batch", [&](uint32_t thread) -> Step
+        {
+            // As the engine does it: a batch at a time into fixed-stride slots.
+            auto buffer = std::make_shared<std::string>(BatchSize * keyspace.MaxBytes(), '\0');
+            auto views = std::make_shared<std::vector<std::string_view>>(BatchSize);
+            auto index = std::make_shared<uint64_t>(keyspace.Size() / 64 * thread);
+            return [&, buffer, views, index]
+            {
+                keyspace.Fill(*index, BatchSize, buffer->data(), keyspace.MaxBytes(), views->data());
+                *index += BatchSize;
+                size_t bytes = 0;
+                for (const auto& view : *views)
+                {
+                    bytes += view.size();
+                }
+                sink.fetch_add(bytes, std::memory_order_relaxed);
+                return BatchSize;
+            };
+        });
+        stages.emplace_back("mutate", [&](uint32_t thread) -> Step
+        {
+            auto buffer = std::make_shared<std::string>(BatchSize * mutated.MaxBytes(), '\0');
+            auto views = std::make_shared<std::vector<std::string_view>>(BatchSize);
+            auto index = std::make_shared<uint64_t>(mutated.Size() / 64 * thread);
+            return [&, buffer, views, index]
+            {
+                size_t count = static_cast<size_t>(std::min<uint64_t>(BatchSize, mutated.Size() - *index));
+                mutated.Fill(*index, count, buffer->data(), mutated.MaxBytes(), views->data());
+                *index = (*index + count) % mutated.Size();
+                size_t bytes = 0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    bytes += (*views)[i].size();
+                }
+                sink.fetch_add(bytes, std::memory_order_relaxed);
+                return count;
+            };
+        });
+        stages.emplace_back("combine", [&](uint32_t thread) -> Step
+        {
+            auto buffer = std::make_shared<std::string>(BatchSize * combined.MaxBytes(), '\0');
+            auto views = std::make_shared<std::vector<std::string_view>>(BatchSize);
+            auto index = std::make_shared<uint64_t>(combined.Size() / 64 * thread);
+            return [&, buffer, views, index]
+            {
+                size_t count = static_cast<size_t>(std::min<uint64_t>(BatchSize, combined.Size() - *index));
+                combined.Fill(*index, count, buffer->data(), combined.MaxBytes(), views->data());
+                *index = (*index + count) % combined.Size();
+                size_t bytes = 0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    bytes += (*views)[i].size();
+                }
+                sink.fetch_add(bytes, std::memory_order_relaxed);
+                return count;
+            };
+        });
+        stages.emplace_back("utf16", [&](uint32_t thread) -> Step
+        {
+            auto candidates = std::make_shared<std::vector<std::string>>(Candidates(keyspace, thread, BatchSize));
+            return [&, candidates]
+            {
+                size_t units = 0;
+                for (const auto& candidate : *candidates)
+                {
+                    units += Utf8ToWide(candidate).size();
+                }
+                sink.fetch_add(units, std::memory_order_relaxed);
+                return candidates->size();
+            };
+        });
+        stages.emplace_back("rar3-encode", [&](uint32_t thread) -> Step
+        {
+            // Into the batch's UTF-16 lane, as Rar3Verifier reads it.
+            auto candidates = std::make_shared<std::vector<std::string>>(Candidates(keyspace, thread, BatchSize));
+            auto batch = std::make_shared<CandidateBatch>(BatchSize, keyspace.MaxBytes());
+            std::copy(candidates->begin(), candidates->end(), batch->Views());
+            return [&, batch]
+            {
+                batch->Resize(BatchSize);
+                size_t bytes = 0;
+                for (size_t i = 0; i < batch->Size(); ++i)
+                {
+                    bytes += batch->Utf16Size(i);
+                }
+                sink.fetch_add(bytes, std::memory_order_relaxed);
+                return batch->Size();
+            };
+        });
+        stages.emplace_back("kdf-rar5", [&](uint32_t thread) -> Step
+        {
+            auto candidates = std::make_shared<std::vector<std::string>>(Candidates(keyspace, thread, rar5Kernel.lanes));
+            auto keys = std::make_shared<std::vector<HmacSha256Key>>(rar5Kernel.lanes);
+            auto out = std::make_shared<std::vector<Rar5Keys>>(rar5Kernel.lanes);
+            return [&, candidates, keys, out]
+            {
+                static const uint8_t salt[Rar5SaltSize] = {};
+                for (size_t i = 0; i < rar5Kernel.lanes; ++i)
+                {
+                    PrepareHmacSha256Key((*candidates)[i], (*keys)[i]);
+                }
+                rar5Kernel.derive(keys->data(), salt, lg2Count, out->data());
+                return rar5Kernel.lanes;
+            };
+        });
+        stages.emplace_back("kdf-rar3", [&](uint32_t thread) -> Step
+        {
+            // Encoded once here, so the step times the key schedule alone
+            // (rar3-encode times the encoding).
+            auto encoded = std::make_shared<std::vector<std::string>>();
+            auto pointers = std::make_shared<std::vector<const uint8_t*>>();
+            for (const auto& candidate : Candidates(keyspace, thread, rar3Kernel.lanes))
+            {
+                encoded->push_back(EncodeRar3Password(candidate));
+            }
+            for (const auto& bytes : *encoded)
+            {
+                pointers->push_back(reinterpret_cast<const uint8_t*>(bytes.data()));
+            }
+            auto out = std::make_shared<std::vector<Rar3Keys>>(rar3Kernel.lanes);
+            return [&, encoded, pointers, out]
+            {
+                static const uint8_t salt[Rar3SaltSize] = {};
+                rar3Kernel.derive(pointers->data(), encoded->front().size(), salt, out->data());
+                return rar3Kernel.lanes;
+            };
+        });
+        for (const auto& fixture : fixtures)
+        {
+            auto factory = std::make_shared<VerifierFactory>(ListArchive(fixture.path), 0);
+            stages.emplace_back("check-" + fixture.format, [&, factory](uint32_t thread) -> Step
+            {
+                // The engine's loop: fill the batch, verify it in place.
+                std::shared_ptr<Verifier> verifier = factory->Create();
+                auto batch = std::make_shared<CandidateBatch>(verifier->PreferredBatch(), keyspace.MaxBytes());
+                auto index = std::make_shared<uint64_t>(keyspace.Size() / 64 * thread);
+                return [&, verifier, batch, index]
+                {
+                    size_t count = batch->Capacity();
+                    keyspace.Fill(*index, count, batch->Slot(0), batch->Stride(), batch->Views());
+                    *index += count;
+                    batch->Resize(count);
+                    if (verifier->VerifyBatch(*batch, 0, count) != Verifier::NoMatch)
+                    {
+                        throw std::runtime_error("a wrong candidate passed the check");
+                    }
+                    return count;
+                };
+            });
+        }
+        if (unrar != nullptr)
+        {
+            for (const auto& fixture : fixtures)
+            {
+                stages.emplace_back("confirm-" + fixture.format, [&, path = fixture.path](uint32_t thread) -> Step
+                {
+                    auto verifier = std::make_shared<DllVerifier>(path, 0);
+                    auto candidate = std::make_shared<std::string>(keyspace.At(keyspace.Size() / 64 * thread));
+                    return [verifier, candidate]
+                    {
+                        verifier->Verify(*candidate);
+                        return size_t(1);
+                    };
+                });
+            }
+        }
+
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t count = 1; count < maxThreads; count *= 2)
+        {
+            threadCounts.push_back(count);
+        }
+        threadCounts.push_back(maxThreads);
+
+        const CpuFeatures& cpu = DetectCpuFeatures();
+        std::ostringstream json;
+        json << "{\n"
+             << "  \"tool\": \"runlock-bench\",\n"
+             << "  \"format_version\": 1,\n"
+             << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+             << "  \"cpu\": { \"avx2\": " << std::boolalpha << cpu.avx2 << ", \"avx512\": " << cpu.avx512
+             << ", \"sha_ni\": " << cpu.shaNi << " },\n"
+             << "  \"kernels\": { \"rar5\": " << JsonString(rar5Kernel.name) << ", \"rar3\": "
+             << JsonString(rar3Kernel.name) << " },\n"
+             << "  \"unrar\": " << (unrar != nullptr) << ",\n"
+             << "  \"seconds_per_run\": " << seconds << ",\n"
+             << "  \"fixtures\": [\n";
+        for (size_t i = 0; i < fixtures.size(); ++i)
+        {
+            const auto& fixture = fixtures[i];
+            json << "    { \"format\": " << JsonString(fixture.format) << ", \"kdf_lg2\": " << fixture.lg2Count
+                 << ", \"password\": " << JsonString(Password) << ", \"check\": " << JsonString(fixture.check)
+                 << ", \"verified\": " << fixture.verified << " }" << (i + 1 < fixtures.size() ? "," : "") << "\n";
+        }
+        json << "  ],\n  \"results\": [";
+
+        bool first = true;
+        for (const auto& [name, stage] : stages)
+        {
+            if (!stagesFilter.empty() && stagesFilter.find("," + name + ",") == std::string::npos)
+            {
+                continue;
+            }
+            for (uint32_t threads : threadCounts)
+            {
+                Measurement result = Measure(stage, threads, seconds);
+                double rate = result.seconds > 0.0 ? static_cast<double>(result.candidates) / result.seconds : 0.0;
+                double perCandidate = result.candidates > 0
+                    ? static_cast<double>(result.allocations) / static_cast<double>(result.candidates) : 0.0;
+                std::fprintf(stderr, "%-13s %4u threads %14.1f candidates/s %10.4f allocations/candidate\n",
+                    name.c_str(), threads, rate, perCandidate);
+                json << (first ? "\n" : ",\n") << "    { \"stage\": " << JsonString(name) << ", \"threads\": " << threads
+                     << ", \"candidates\": " << result.candidates << ", \"seconds\": " << result.seconds
+                     << ", \"per_second\": " << rate << ", \"allocations\": " << result.allocations << " }";
+                first = false;
+            }
+        }
+        json << "\n  ]\n}\n";
+        std::cout << json.str();
+
+        if (keepDir.empty())
+        {
+            std::error_code ignored;
+            fs::remove_all(directory, ignored);
+        }
+        bool verified = std::all_of(fixtures.begin(), fixtures.end(), [](const Fixture& f) { return f.verified; });
+        return verified ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "runlock-bench: " << e.what() << "\n";
+        return 2;
+    }
+}
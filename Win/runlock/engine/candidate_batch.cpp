@@ -0,0 +1,53 @@
+#include "candidate_batch.h"
+#include "rar3_kdf.h"
+
+#include <algorithm>
+#include <new>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        size_t AlignUp(size_t size, size_t alignment)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    CandidateBatch::CandidateBatch(size_t capacity, size_t maxBytes)
+        : m_capacity(capacity)
+        , m_stride(std::max<size_t>(maxBytes, 1))
+        // A UTF-8 sequence never encodes to more UTF-16 bytes than twice its own length.
+        , m_utf16Stride(std::min(2 * m_stride, Rar3MaxPasswordBytes))
+    {
+        size_t views = AlignUp(capacity * sizeof(std::string_view), 64);
+        size_t sizes = AlignUp(capacity * sizeof(uint32_t), 64);
+        size_t bytes = AlignUp(capacity * m_stride, 64);
+        // 64 spare bytes to align the start of the block.
+        m_block = std::make_unique<std::byte[]>(64 + views + sizes + bytes + capacity * m_utf16Stride);
+        std::byte* cursor = m_block.get() + (64 - reinterpret_cast<uintptr_t>(m_block.get()) % 64) % 64;
+        m_views = new (cursor) std::string_view[capacity];
+        m_utf16Sizes = reinterpret_cast<uint32_t*>(cursor + views);
+        m_bytes = reinterpret_cast<char*>(cursor + views + sizes);
+        m_utf16 = reinterpret_cast<uint8_t*>(cursor + views + sizes + bytes);
+    }
+
+    void CandidateBatch::Resize(size_t size)
+    {
+        m_size = std::min(size, m_capacity);
+        m_utf16Ready = false;
+    }
+
+    void CandidateBatch::EncodeUtf16()
+    {
+        if (m_utf16Ready)
+        {
+            return;
+        }
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            m_utf16Sizes[i] = static_cast<uint32_t>(EncodeRar3Password(m_views[i], m_utf16 + i * m_utf16Stride));
+        }
+        m_utf16Ready = true;
+    }
+}
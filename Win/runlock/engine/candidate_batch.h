@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // One verifier call's worth of candidates, as structure of arrays: the
+    // UTF-8 bytes in fixed-stride slots, a view of each candidate (its
+    // slot, or memory a keyspace segment owns) carrying its length, and the
+    // UTF-16LE form the RAR 2.9 key schedule hashes with its byte counts.
+    // All of it is carved from one block allocated up front; a worker keeps
+    // its batch for the whole run and refills it, so the hot loop allocates
+    // nothing, and a pinned worker's block sits on its own NUMA node.
+    class CandidateBatch
+    {
+    public:
+        // Room for `capacity` candidates of up to maxBytes UTF-8 bytes.
+        CandidateBatch(size_t capacity, size_t maxBytes);
+
+        size_t Capacity() const { return m_capacity; }
+        size_t Size() const { return m_size; }
+        size_t Stride() const { return m_stride; }
+
+        // Slot i's bytes, Stride() of them, and the view array, for
+        // Keyspace::Fill to write into.
+        char* Slot(size_t i) { return m_bytes + i * m_stride; }
+        std::string_view* Views() { return m_views; }
+
+        const std::string_view& operator[](size_t i) const { return m_views[i]; }
+
+        // Makes the first `size` views the batch; the encoded forms of the
+        // previous batch are dropped, the memory is not.
+        void Resize(size_t size);
+
+        // Candidate i as EncodeRar3Password would return it. The whole
+        // batch is encoded on the first call after Resize().
+        const uint8_t* Utf16(size_t i) { EncodeUtf16(); return m_utf16 + i * m_utf16Stride; }
+        size_t Utf16Size(size_t i) { EncodeUtf16(); return m_utf16Sizes[i]; }
+
+    private:
+        void EncodeUtf16();
+
+        size_t m_capacity;
+        size_t m_stride;
+        size_t m_utf16Stride;
+        size_t m_size = 0;
+        bool m_utf16Ready = false;
+        std::unique_ptr<std::byte[]> m_block;
+        std::string_view* m_views;
+        uint32_t* m_utf16Sizes;
+        char* m_bytes;
+        uint8_t* m_utf16;
+    };
+}
@@ -0,0 +1,232 @@
+#include "candidate_file.h"
+#include "crc32.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr char Magic[8] = { 'r', 'l', 'c', 'a', 'n', 'd', '1', '\n' };
+        constexpr size_t BlockHeaderBytes = 12;
+
+        void PutVarint(std::string& out, size_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        bool GetVarint(std::string_view& in, size_t& value)
+        {
+            value = 0;
+            for (unsigned shift = 0; shift < 28 && !in.empty(); shift += 7)
+            {
+                uint8_t byte = static_cast<uint8_t>(in.front());
+                in.remove_prefix(1);
+                value |= static_cast<size_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void PutLe32(char* out, uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                out[i] = static_cast<char>(value >> (8 * i));
+            }
+        }
+
+        uint32_t GetLe32(const uint8_t* in)
+        {
+            return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+        }
+    }
+
+    CandidateFileWriter::CandidateFileWriter(const std::string& path, size_t blockBytes)
+        : m_path(path)
+        , m_blockBytes(std::max<size_t>(blockBytes, 4096))
+    {
+#ifdef _WIN32
+        HANDLE file = ::CreateFileW(Utf8ToWide(path).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("cannot create " + path);
+        }
+        m_file = file;
+#else
+        m_file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_file < 0)
+        {
+            throw std::runtime_error("cannot create " + path);
+        }
+#endif
+        m_payload.reserve(m_blockBytes + 1024);
+        Write(Magic, sizeof(Magic));
+    }
+
+    CandidateFileWriter::~CandidateFileWriter()
+    {
+#ifdef _WIN32
+        ::CloseHandle(m_file);
+#else
+        ::close(m_file);
+#endif
+    }
+
+    bool CandidateFileWriter::Add(std::string_view candidate)
+    {
+        size_t shared = 0;
+        size_t limit = std::min(candidate.size(), m_previous.size());
+        while (shared < limit && candidate[shared] == m_previous[shared])
+        {
+            ++shared;
+        }
+        PutVarint(m_payload, shared);
+        PutVarint(m_payload, candidate.size() - shared);
+        m_payload.append(candidate.substr(shared));
+        m_previous.assign(candidate);
+        ++m_blockCount;
+        ++m_count;
+        if (m_payload.size() < m_blockBytes)
+        {
+            return false;
+        }
+        WriteBlock();
+        return true;
+    }
+
+    void CandidateFileWriter::Finish()
+    {
+        if (m_blockCount != 0)
+        {
+            WriteBlock();
+        }
+        WriteBlock();       // the empty end marker
+#ifdef _WIN32
+        bool ok = ::FlushFileBuffers(m_file) != 0;
+#else
+        bool ok = ::fsync(m_file) == 0;
+#endif
+        if (!ok)
+        {
+            throw std::runtime_error("cannot write " + m_path);
+        }
+    }
+
+    void CandidateFileWriter::WriteBlock()
+    {
+        char header[BlockHeaderBytes];
+        PutLe32(header, static_cast<uint32_t>(m_payload.size()));
+        PutLe32(header + 4, m_blockCount);
+        PutLe32(header + 8, Crc32(m_payload.data(), m_payload.size()));
+        Write(header, sizeof(header));
+        Write(m_payload.data(), m_payload.size());
+        m_payload.clear();
+        m_previous.clear();
+        m_blockCount = 0;
+    }
+
+    void CandidateFileWriter::Write(const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        for (size_t done = 0; done < size;)
+        {
+#ifdef _WIN32
+            DWORD written = 0;
+            bool ok = ::WriteFile(m_file, bytes + done, static_cast<DWORD>(std::min<size_t>(size - done, 1u << 30)),
+                &written, nullptr) && written != 0;
+#else
+            ssize_t written = ::write(m_file, bytes + done, size - done);
+            bool ok = written > 0;
+#endif
+            if (!ok)
+            {
+                throw std::runtime_error("cannot write " + m_path);
+            }
+            done += static_cast<size_t>(written);
+        }
+        m_bytes += size;
+    }
+
+    CandidateFileReader::CandidateFileReader(const std::string& path)
+        : m_path(path)
+        , m_file(path)
+    {
+        if (m_file.Size() < sizeof(Magic) || std::memcmp(m_file.Data(), Magic, sizeof(Magic)) != 0)
+        {
+            throw std::runtime_error(path + " is not a candidate list");
+        }
+        m_offset = sizeof(Magic);
+    }
+
+    bool CandidateFileReader::Next(std::string& candidate)
+    {
+        while (m_remaining == 0)
+        {
+            if (m_complete || !NextBlock())
+            {
+                return false;
+            }
+        }
+        size_t shared = 0;
+        size_t suffix = 0;
+        if (!GetVarint(m_block, shared) || !GetVarint(m_block, suffix)
+            || shared > m_previous.size() || suffix > m_block.size())
+        {
+            throw std::runtime_error(m_path + ": damaged block at offset " + std::to_string(m_offset));
+        }
+        m_previous.resize(shared);
+        m_previous.append(m_block.substr(0, suffix));
+        m_block.remove_prefix(suffix);
+        --m_remaining;
+        candidate = m_previous;
+        return true;
+    }
+
+    bool CandidateFileReader::NextBlock()
+    {
+        // A block cut short by an interrupted write ends the list.
+        if (m_file.Size() - m_offset < BlockHeaderBytes)
+        {
+            return false;
+        }
+        const uint8_t* header = m_file.Data() + m_offset;
+        size_t size = GetLe32(header);
+        if (m_file.Size() - m_offset - BlockHeaderBytes < size)
+        {
+            return false;
+        }
+        m_block = std::string_view(reinterpret_cast<const char*>(header + BlockHeaderBytes), size);
+        if (Crc32(m_block.data(), m_block.size()) != GetLe32(header + 8))
+        {
+            throw std::runtime_error(m_path + ": damaged block at offset " + std::to_string(m_offset));
+        }
+        m_remaining = GetLe32(header + 4);
+        m_complete = m_remaining == 0;
+        m_previous.clear();
+        m_offset += BlockHeaderBytes + size;
+        return true;
+    }
+}
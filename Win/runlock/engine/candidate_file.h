@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // Materialized candidate lists ("Generate Passwords" output): a magic
+    // header and a run of independent blocks, each
+    //
+    //   uint32 payload size, uint32 candidate count, uint32 CRC-32 of payload
+    //   payload: per candidate, varint shared-prefix length with the previous
+    //            candidate of the block, varint suffix length, suffix bytes
+    //
+    // ending with an empty block. Neighbouring candidates of a mask differ
+    // only at the end, so front coding shrinks them to a few bytes each, and
+    // every block decodes on its own.
+    class CandidateFileWriter
+    {
+    public:
+        // Throws std::runtime_error when the file cannot be created. Memory
+        // use is one block of about blockBytes.
+        CandidateFileWriter(const std::string& path, size_t blockBytes);
+        ~CandidateFileWriter();
+
+        CandidateFileWriter(const CandidateFileWriter&) = delete;
+        CandidateFileWriter& operator=(const CandidateFileWriter&) = delete;
+
+        // Appends a candidate; true when that filled a block and it was
+        // written out.
+        bool Add(std::string_view candidate);
+
+        // Writes the pending block and the end marker. Without it the file
+        // ends at the last full block, which readers accept as a prefix.
+        void Finish();
+
+        uint64_t Count() const { return m_count; }
+        uint64_t Bytes() const { return m_bytes; }
+
+    private:
+        void WriteBlock();
+        void Write(const void* data, size_t size);
+
+        std::string m_path;
+        size_t m_blockBytes;
+        std::string m_payload;
+        std::string m_previous;
+        uint32_t m_blockCount = 0;
+        uint64_t m_count = 0;
+        uint64_t m_bytes = 0;
+#ifdef _WIN32
+        void* m_file = nullptr;
+#else
+        int m_file = -1;
+#endif
+    };
+
+    class CandidateFileReader
+    {
+    public:
+        // Throws std::runtime_error when the file cannot be read or is not a
+        // candidate file.
+        explicit CandidateFileReader(const std::string& path);
+
+        // Next candidate, or false at the end. Throws std::runtime_error
+        // when a block is damaged.
+        bool Next(std::string& candidate);
+
+        // False when the file stops before its end marker (a cancelled or
+        // interrupted generation).
+        bool Complete() const { return m_complete; }
+
+    private:
+        bool NextBlock();
+
+        std::string m_path;
+        MappedFile m_file;
+        size_t m_offset = 0;
+        std::string_view m_block;
+        uint32_t m_remaining = 0;
+        std::string m_previous;
+        bool m_complete = false;
+    };
+}
@@ -0,0 +1,108 @@
+#include "candidate_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Bits per expected string when memory is not the limit: about one
+        // false positive in 40000 with the matching hash count.
+        constexpr double TargetBitsPerString = 24.0;
+        constexpr unsigned MaxHashes = 16;
+        constexpr unsigned FieldsPerHash = 7;   // 9-bit positions in 64 bits
+
+        uint64_t Mix(uint64_t x)
+        {
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdull;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ull;
+            x ^= x >> 33;
+            return x;
+        }
+
+        uint64_t Hash(std::string_view text)
+        {
+            uint64_t h = 0x9e3779b97f4a7c15ull ^ (text.size() * 0xc2b2ae3d27d4eb4full);
+            size_t i = 0;
+            for (; i + 8 <= text.size(); i += 8)
+            {
+                uint64_t chunk;
+                std::memcpy(&chunk, text.data() + i, sizeof(chunk));
+                h = (h ^ Mix(chunk)) * 0x9e3779b97f4a7c15ull;
+            }
+            uint64_t tail = 0;
+            std::memcpy(&tail, text.data() + i, text.size() - i);
+            return Mix(h ^ Mix(tail ^ 0x165667b19e3779f9ull));
+        }
+    }
+
+    CandidateFilter::CandidateFilter(uint64_t expected, size_t maxBytes)
+    {
+        expected = std::max<uint64_t>(expected, 1);
+        double wanted = std::ceil(static_cast<double>(expected) * TargetBitsPerString / BlockBits);
+        uint64_t affordable = std::max<uint64_t>(maxBytes / sizeof(Block), 1);
+        m_blockCount = std::min<uint64_t>(static_cast<uint64_t>(wanted), affordable);
+        m_blockCount = std::clamp<uint64_t>(m_blockCount, 1, uint64_t(1) << 32);
+
+        double bitsPerString = static_cast<double>(m_blockCount) * BlockBits / static_cast<double>(expected);
+        m_hashes = static_cast<unsigned>(std::clamp(std::lround(bitsPerString * std::log(2.0)), 1l, long(MaxHashes)));
+        m_blocks = std::make_unique<Block[]>(static_cast<size_t>(m_blockCount));
+    }
+
+    bool CandidateFilter::TestAndAdd(std::string_view candidate)
+    {
+        uint64_t h = Hash(candidate);
+        // The high half picks the block (multiply-shift, no modulo). Bit
+        // positions come from fresh 9-bit fields of a remixed hash: double
+        // hashing inside a 512-bit block has only 2^17 distinct patterns,
+        // which would put a floor under the false-positive rate.
+        uint64_t block = ((h >> 32) * m_blockCount) >> 32;
+        uint64_t masks[BlockBits / 64] = {};
+        uint64_t bits = Mix(h);
+        for (unsigned i = 0; i < m_hashes; ++i)
+        {
+            if (i != 0 && i % FieldsPerHash == 0)
+            {
+                bits = Mix(h + i);
+            }
+            unsigned bit = static_cast<unsigned>(bits % BlockBits);
+            bits /= BlockBits;
+            masks[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+
+        Block& line = m_blocks[static_cast<size_t>(block)];
+        bool present = true;
+        for (unsigned w = 0; w < BlockBits / 64; ++w)
+        {
+            if (masks[w] != 0 && (line.words[w].load(std::memory_order_relaxed) & masks[w]) != masks[w])
+            {
+                present = false;
+                line.words[w].fetch_or(masks[w], std::memory_order_relaxed);
+            }
+        }
+        return present;
+    }
+
+    double CandidateFilter::FalsePositiveRate(uint64_t inserted) const
+    {
+        // Per-block load varies, so average the classic estimate over a
+        // Poisson-distributed number of strings per block.
+        double mean = static_cast<double>(inserted) / static_cast<double>(m_blockCount);
+        double weight = std::exp(-mean);
+        if (weight == 0.0)
+        {
+            return std::pow(1.0 - std::exp(-m_hashes * mean / BlockBits), m_hashes);
+        }
+        double rate = 0.0;
+        for (unsigned n = 0; n < 4 * mean + 64; ++n)
+        {
+            rate += weight * std::pow(1.0 - std::pow(1.0 - 1.0 / BlockBits, double(m_hashes) * n), m_hashes);
+            weight *= mean / (n + 1);
+        }
+        return rate;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // Approximate set of the candidates already handed to a verifier, shared
+    // by all workers: a blocked Bloom filter whose 512-bit blocks are one
+    // cache line each, so a lookup or insert touches a single line.
+    //
+    // Lock-free. Two workers adding the same string at the same moment may
+    // both be told it is new, which only costs a repeated test. A false
+    // positive skips a candidate that was never tested, so the filter is
+    // sized for a rate far below one in ten thousand whenever the memory
+    // budget allows, and reports the rate it reached.
+    class CandidateFilter
+    {
+    public:
+        // Sized for `expected` distinct strings, using at most maxBytes.
+        CandidateFilter(uint64_t expected, size_t maxBytes);
+
+        // Adds the candidate; true when it was (probably) added before.
+        bool TestAndAdd(std::string_view candidate);
+
+        size_t Bytes() const { return static_cast<size_t>(m_blockCount) * sizeof(Block); }
+        unsigned HashCount() const { return m_hashes; }
+
+        // Expected false-positive probability after `inserted` distinct strings.
+        double FalsePositiveRate(uint64_t inserted) const;
+
+    private:
+        static constexpr unsigned BlockBits = 512;
+
+        struct alignas(64) Block
+        {
+            std::atomic<uint64_t> words[BlockBits / 64];
+        };
+
+        std::unique_ptr<Block[]> m_blocks;
+        uint64_t m_blockCount = 0;
+        unsigned m_hashes = 0;
+    };
+}
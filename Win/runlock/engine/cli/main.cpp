@@ -0,0 +1,650 @@
+// runlock-cli: headless front end for the recovery engine.
+
+#include "archive.h"
+#include "candidate_file.h"
+#include "cluster.h"
+#include "engine.h"
+#include "generator.h"
+#include "keyspace.h"
+#include "mapped_file.h"
+#include "project.h"
+#include "rar_headers.h"
+#include "topology.h"
+#include "text.h"
+#include "unrar_api.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+using namespace runlock::engine;
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cout <<
+            "usage: runlock-cli [options] <archive.rar> [more.rar ...]\n"
+            "\n"
+            "Several archives are searched together (batch mode): the candidates are\n"
+            "walked once, and archives sharing salt and KDF parameters share the key\n"
+            "derivation. Batch runs take no --project.\n"
+            "\n"
+            "  -r, --rules FILE   password rules, one per line (\"-\" reads stdin)\n"
+            "  -t, --threads N    worker threads (default: all hardware threads)\n"
+            "      --physical     at most one worker per physical core (default: all threads)\n"
+            "      --pin          bind each worker thread to its own processor\n"
+            "      --topology     print the processors, cores and NUMA nodes in use and exit\n"
+            "      --min N        minimum password length\n"
+            "      --max N        maximum password length\n"
+            "      --markov FILE  try mask characters in the order they are likeliest in\n"
+            "                     FILE, a sample of real passwords (one per line)\n"
+            "      --unrar PATH   UnRAR library to load\n"
+            "  -p, --project FILE checkpoint file; an existing one is resumed, and supplies\n"
+            "                     the archive and rules when they are not given\n"
+            "      --checkpoint N seconds between checkpoints (default: 30)\n"
+            "      --dedup MB     skip candidates the rules already produced, using up to\n"
+            "                     MB megabytes for the filter (default: off)\n"
+            "      --progress N   print progress to stderr every N seconds\n"
+            "  -l, --list         list the archives and exit\n"
+            "  -k, --keyspace     print the number of candidates the rules expand to and exit\n"
+            "      --preview N    print the first N candidates and exit\n"
+            "  -g, --generate FILE\n"
+            "                     write every candidate to FILE as a compressed list and exit\n"
+            "      --unpack FILE  print the candidates of a list written by --generate\n"
+            "      --serve ADDRESS\n"
+            "                     coordinate a cluster run: hand out ranges of the keyspace to\n"
+            "                     --join workers on ADDRESS (host:port, :port or unix:/path)\n"
+            "      --range N      candidates per range handed out (default: 1/1024 of the keyspace)\n"
+            "      --lease N      seconds a silent worker keeps its range (default: 60)\n"
+            "      --join ADDRESS work ranges for the coordinator at ADDRESS; the archive\n"
+            "                     argument, if given, is this machine's copy of the job's archive\n"
+            "  -h, --help         show this help\n"
+            "\n"
+            "Exit status: 0 password found (for every archive), 1 not found, 2 error.\n"
+            "A --join worker exits with 0 when the coordinator sends it away.\n";
+    }
+
+    std::string ReadAll(const std::string& path)
+    {
+        if (path == "-")
+        {
+            return { std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>() };
+        }
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("cannot read " + path);
+        }
+        std::ostringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    // Fills in what the command line left open from a saved project and
+    // refuses to resume it with different rules, which would renumber the
+    // candidates. The keyspace size goes along for the engine to refuse
+    // the same rules over changed word lists.
+    void Resume(const Project& project, const std::string& path, EngineOptions& options, bool haveRules,
+        bool haveMin, bool haveMax, bool haveMarkov, bool haveThreads)
+    {
+        if (options.archivePath.empty())
+        {
+            options.archivePath = project.archivePath;
+        }
+        bool sameRules = (!haveRules || options.rules == project.rules)
+            && (!haveMin || options.minLength == project.minLength)
+            && (!haveMax || options.maxLength == project.maxLength)
+            && (!haveMarkov || options.markovPath == project.markovPath);
+        if (!sameRules)
+        {
+            throw std::runtime_error(path + ": project was saved with different rules, length bounds or ordering");
+        }
+        if (MappedFile(options.archivePath).Size() != project.archiveSize)
+        {
+            throw std::runtime_error(path + ": " + options.archivePath + " is not the archive the project was saved for");
+        }
+        options.rules = project.rules;
+        options.minLength = project.minLength;
+        options.maxLength = project.maxLength;
+        options.markovPath = project.markovPath;
+        if (!haveThreads)
+        {
+            options.threads = project.threads;
+        }
+        options.done = project.done;
+        options.keyspaceSize = project.keyspaceSize;
+    }
+
+    // The first Ctrl+C calls `stop` (Engine::Stop after the batches in
+    // flight, so the project records exactly what was tested; or
+    // Generator::Cancel); a second one ends the process at once. On POSIX the
+    // signal is blocked in every worker thread and taken by a sigwait()
+    // thread, so `stop` never runs in a handler.
+#ifdef _WIN32
+    std::atomic<const std::function<void()>*> g_interruptStop{ nullptr };
+
+    BOOL WINAPI OnConsoleInterrupt(DWORD type)
+    {
+        auto stop = type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT ? g_interruptStop.exchange(nullptr) : nullptr;
+        if (stop == nullptr)
+        {
+            return FALSE;
+        }
+        std::fputs("runlock-cli: stopping, press Ctrl+C again to abort\n", stderr);
+        (*stop)();
+        return TRUE;
+    }
+
+    class InterruptStop
+    {
+    public:
+        explicit InterruptStop(std::function<void()> stop)
+            : m_stop(std::move(stop))
+        {
+            g_interruptStop = &m_stop;
+            ::SetConsoleCtrlHandler(OnConsoleInterrupt, TRUE);
+        }
+
+        ~InterruptStop()
+        {
+            ::SetConsoleCtrlHandler(OnConsoleInterrupt, FALSE);
+            g_interruptStop = nullptr;
+        }
+
+    private:
+        std::function<void()> m_stop;
+    };
+#else
+    class InterruptStop
+    {
+    public:
+        explicit InterruptStop(std::function<void()> stop)
+        {
+            sigemptyset(&m_signals);
+            sigaddset(&m_signals, SIGINT);
+            pthread_sigmask(SIG_BLOCK, &m_signals, &m_previous);
+            m_waiter = std::thread([this, stop = std::move(stop)]
+            {
+                int signal = 0;
+                for (int count = 0; sigwait(&m_signals, &signal) == 0 && !m_finished; ++count)
+                {
+                    if (count > 0)
+                    {
+                        std::_Exit(130);
+                    }
+                    std::fputs("runlock-cli: stopping, press Ctrl+C again to abort\n", stderr);
+                    stop();
+                }
+            });
+        }
+
+        ~InterruptStop()
+        {
+            m_finished = true;
+            pthread_kill(m_waiter.native_handle(), SIGINT);
+            m_waiter.join();
+            pthread_sigmask(SIG_SETMASK, &m_previous, nullptr);
+        }
+
+    private:
+        sigset_t m_signals;
+        sigset_t m_previous;
+        std::atomic<bool> m_finished{ false };
+        std::thread m_waiter;
+    };
+#endif
+
+    uint32_t ParseCount(std::string_view option, const char* value)
+    {
+        char* end = nullptr;
+        unsigned long parsed = std::strtoul(value, &end, 10);
+        if (end == value || *end != '\0' || parsed > UINT32_MAX)
+        {
+            throw std::runtime_error("invalid value for " + std::string(option) + ": " + value);
+        }
+        return static_cast<uint32_t>(parsed);
+    }
+
+    // The count goes to stderr before anything is generated, the preview to
+    // stdout; Ctrl+C cancels a list after its current block.
+    int Generate(GeneratorOptions options)
+    {
+        options.onPreview = [](std::string_view candidate) { std::cout << candidate << "\n"; };
+        Generator generator(std::move(options));
+        std::fprintf(stderr, "%s%llu candidates\n", generator.MayReject() ? "at most " : "",
+            static_cast<unsigned long long>(generator.Count()));
+        GeneratorResult result;
+        {
+            InterruptStop interrupt([&generator] { generator.Cancel(); });
+            result = generator.Run();
+        }
+        if (result.bytes != 0)
+        {
+            std::fprintf(stderr, "wrote %llu of %llu candidates in %llu bytes (%.2f per candidate, %.3f s)%s\n",
+                static_cast<unsigned long long>(result.written), static_cast<unsigned long long>(result.total),
+                static_cast<unsigned long long>(result.bytes),
+                result.written != 0 ? static_cast<double>(result.bytes) / static_cast<double>(result.written) : 0.0,
+                result.seconds, result.cancelled ? ", cancelled" : "");
+        }
+        return result.cancelled ? 1 : 0;
+    }
+
+    int Unpack(const std::string& path)
+    {
+        CandidateFileReader reader(path);
+        std::string candidate;
+        while (reader.Next(candidate))
+        {
+            std::cout << candidate << "\n";
+        }
+        if (!reader.Complete())
+        {
+            std::cerr << "runlock-cli: " << path << " ends early (generation was cancelled)\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // Runs the job described by `options` as a cluster coordinator. The
+    // keyspace is compiled here only for its size; workers compile their own.
+    int Serve(const EngineOptions& options, const std::string& address, uint64_t rangeSize, uint32_t leaseSeconds,
+        uint32_t statusSeconds)
+    {
+        GeneratorOptions rules;
+        rules.rules = options.rules;
+        rules.minLength = options.minLength;
+        rules.maxLength = options.maxLength;
+        rules.markovPath = options.markovPath;
+
+        CoordinatorOptions serve;
+        serve.address = address;
+        serve.job.archivePath = options.archivePath;
+        serve.job.archiveSize = MappedFile(options.archivePath).Size();
+        serve.job.rules = options.rules;
+        serve.job.minLength = options.minLength;
+        serve.job.maxLength = options.maxLength;
+        serve.job.markovPath = options.markovPath;
+        serve.job.threads = options.threads;
+        serve.job.keyspaceSize = Generator(std::move(rules)).Count();
+        serve.job.done = options.done;
+        serve.projectPath = options.projectPath;
+        serve.checkpointSeconds = options.checkpointSeconds;
+        serve.rangeSize = rangeSize;
+        serve.leaseSeconds = leaseSeconds;
+        serve.statusSeconds = statusSeconds;
+        serve.onLog = [](const std::string& line) { std::cerr << line << "\n"; };
+
+        uint64_t keyspace = serve.job.keyspaceSize;
+        Coordinator coordinator(std::move(serve));
+        std::fprintf(stderr, "serving %llu of %llu candidates on %s\n",
+            static_cast<unsigned long long>(options.done.Complement(keyspace).Count()),
+            static_cast<unsigned long long>(keyspace), address.c_str());
+        CoordinatorResult result;
+        {
+            InterruptStop interrupt([&coordinator] { coordinator.Stop(); });
+            result = coordinator.Run();
+        }
+
+        std::fprintf(stderr, "%llu of %llu candidates tested by %u workers in %.3f s (%u leases expired)\n",
+            static_cast<unsigned long long>(result.done.Count()), static_cast<unsigned long long>(result.keyspace),
+            result.workers, result.seconds, result.expired);
+        if (!result.saveError.empty())
+        {
+            std::cerr << "runlock-cli: warning: " << result.saveError << "\n";
+        }
+        if (result.found)
+        {
+            std::cout << result.password << "\n";
+            std::cerr << "found by " << result.worker << "\n";
+            return 0;
+        }
+        std::cout << (result.stopped ? "stopped" : "not found") << "\n";
+        return 1;
+    }
+
+    int Join(ClusterWorkerOptions options)
+    {
+        options.onLog = [](const std::string& line) { std::cerr << line << "\n"; };
+        ClusterWorker worker(std::move(options));
+        ClusterWorkerResult result;
+        {
+            InterruptStop interrupt([&worker] { worker.Stop(); });
+            result = worker.Run();
+        }
+        double rate = result.seconds > 0.0 ? static_cast<double>(result.tested) / result.seconds : 0.0;
+        std::fprintf(stderr, "tested %llu candidates in %llu ranges in %.3f s (%.1f/s)\n",
+            static_cast<unsigned long long>(result.tested), static_cast<unsigned long long>(result.ranges),
+            result.seconds, rate);
+        if (result.found)
+        {
+            std::cout << result.password << "\n";
+        }
+        return 0;
+    }
+
+    // One line per worker in the order they are started, as the options
+    // would place them.
+    void PrintTopology(const EngineOptions& options)
+    {
+        const CpuTopology& topology = CpuTopology::Detect();
+        std::cout << topology.Describe() << "\n";
+        uint32_t threads = ResolveThreadCount(options.threads, options.physicalCores);
+        auto placement = topology.Place(threads, options.physicalCores);
+        for (uint32_t i = 0; i < threads; ++i)
+        {
+            const LogicalCpu& cpu = placement[i];
+            std::cout << "worker " << i << ": cpu " << cpu.id << ", core " << cpu.core << ", node " << cpu.node
+                      << (cpu.primary ? "" : ", second thread");
+            if (topology.SpeedClasses() > 1)
+            {
+                std::cout << ", speed " << cpu.performance;
+            }
+            std::cout << "\n";
+        }
+    }
+
+    // Streams the listing straight from header views over the mapped archive.
+    void List(const std::string& path)
+    {
+        MappedFile archive(path);
+        RarHeaderParser parser(archive.Data(), archive.Size());
+        if (parser.Format() == RarFormat::Unknown)
+        {
+            ArchiveInfo info = ListArchive(path);
+            for (const auto& entry : info.entries)
+            {
+                std::cout << (entry.encrypted ? '*' : ' ') << ' ' << entry.packSize << '\t'
+                          << entry.unpSize << '\t' << entry.name << "\n";
+            }
+            return;
+        }
+
+        std::cout << path << (parser.Format() == RarFormat::Rar50 ? " (RAR5)" : " (RAR 1.5-4.x)") << "\n";
+        BlockView block;
+        while (parser.Next(block))
+        {
+            if (block.kind == BlockKind::Main)
+            {
+                MainView main;
+                DecodeMain(block, main);
+                if (main.solid || main.volume)
+                {
+                    std::cout << (main.solid ? "solid " : "") << (main.volume ? "volume" : "") << "\n";
+                }
+            }
+            FileView file;
+            if (block.kind != BlockKind::File || !DecodeFile(block, file))
+            {
+                continue;
+            }
+            std::cout << (file.encrypted ? '*' : ' ') << (block.crcOk ? ' ' : '!') << ' ' << file.packSize
+                      << '\t' << file.unpSize << '\t' << DecodeFileName(file, parser.Format()) << "\n";
+        }
+        if (auto encrypted = parser.EncryptedHeaders())
+        {
+            std::cout << "headers are encrypted";
+            if (parser.Format() == RarFormat::Rar50)
+            {
+                std::cout << " (KDF 2^" << encrypted->crypt.lg2Count << ", "
+                          << (encrypted->crypt.check != nullptr ? "password check present" : "no password check") << ")";
+            }
+            std::cout << "\n";
+        }
+        else if (!parser.Error().empty())
+        {
+            throw std::runtime_error(path + ": " + parser.Error());
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    EngineOptions options;
+    std::string rulesPath;
+    std::string unrarPath;
+    bool haveMin = false;
+    bool haveMax = false;
+    bool haveThreads = false;
+    bool list = false;
+    bool keyspaceOnly = false;
+    bool topology = false;
+    std::optional<uint32_t> preview;
+    std::string generatePath;
+    std::string unpackPath;
+    uint32_t progressSeconds = 0;
+    std::string serveAddress;
+    std::string joinAddress;
+    uint64_t rangeSize = 0;
+    uint32_t leaseSeconds = 60;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char*
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("missing value for " + std::string(arg));
+                }
+                return argv[++i];
+            };
+
+            if (arg == "-h" || arg == "--help") { PrintUsage(); return 0; }
+            else if (arg == "-r" || arg == "--rules") { rulesPath = value(); }
+            else if (arg == "-t" || arg == "--threads") { options.threads = ParseCount(arg, value()); haveThreads = true; }
+            else if (arg == "--physical") { options.physicalCores = true; }
+            else if (arg == "--pin") { options.pinThreads = true; }
+            else if (arg == "--topology") { topology = true; }
+            else if (arg == "--min") { options.minLength = ParseCount(arg, value()); haveMin = true; }
+            else if (arg == "--max") { options.maxLength = ParseCount(arg, value()); haveMax = true; }
+            else if (arg == "--markov") { options.markovPath = value(); }
+            else if (arg == "--unrar") { unrarPath = value(); }
+            else if (arg == "-p" || arg == "--project") { options.projectPath = value(); }
+            else if (arg == "--checkpoint") { options.checkpointSeconds = ParseCount(arg, value()); }
+            else if (arg == "--progress") { progressSeconds = ParseCount(arg, value()); }
+            else if (arg == "--dedup") { options.dedupMegabytes = ParseCount(arg, value()); }
+            else if (arg == "-l" || arg == "--list") { list = true; }
+            else if (arg == "-k" || arg == "--keyspace") { keyspaceOnly = true; }
+            else if (arg == "--preview") { preview = ParseCount(arg, value()); }
+            else if (arg == "-g" || arg == "--generate") { generatePath = value(); }
+            else if (arg == "--unpack") { unpackPath = value(); }
+            else if (arg == "--serve") { serveAddress = value(); }
+            else if (arg == "--range") { rangeSize = ParseCount(arg, value()); }
+            else if (arg == "--lease") { leaseSeconds = ParseCount(arg, value()); }
+            else if (arg == "--join") { joinAddress = value(); }
+            else if (!arg.empty() && arg[0] == '-' && arg != "-") { throw std::runtime_error("unknown option " + std::string(arg)); }
+            else if (options.archivePath.empty()) { options.archivePath = arg; }
+            else { options.batchPaths.emplace_back(arg); }
+        }
+        if (topology)
+        {
+            PrintTopology(options);
+            return 0;
+        }
+        if (keyspaceOnly)
+        {
+            if (rulesPath.empty())
+            {
+                throw std::runtime_error("no password rules given (use --rules)");
+            }
+            Keyspace keyspace = Keyspace::Compile(ReadAll(rulesPath), { options.minLength, options.maxLength, nullptr });
+            std::cout << keyspace.Size() << "\n";
+            if (keyspace.MayReject())
+            {
+                std::cerr << "runlock-cli: an upper bound: the constraints rule out some mutated or combined candidates\n";
+            }
+            return 0;
+        }
+        if (!unpackPath.empty())
+        {
+            return Unpack(unpackPath);
+        }
+        if (!joinAddress.empty())
+        {
+            if (!unrarPath.empty())
+            {
+                LoadUnrar(unrarPath);
+            }
+            ClusterWorkerOptions join;
+            join.address = joinAddress;
+            join.archivePath = options.archivePath;
+            join.threads = options.threads;
+            join.physicalCores = options.physicalCores;
+            join.pinThreads = options.pinThreads;
+            return Join(std::move(join));
+        }
+        if (preview || !generatePath.empty())
+        {
+            if (rulesPath.empty())
+            {
+                throw std::runtime_error("no password rules given (use --rules)");
+            }
+            GeneratorOptions generate;
+            generate.rules = ReadAll(rulesPath);
+            generate.minLength = options.minLength;
+            generate.maxLength = options.maxLength;
+            generate.markovPath = options.markovPath;
+            generate.outputPath = generatePath;
+            generate.previewCount = preview.value_or(0);
+            return Generate(std::move(generate));
+        }
+        std::optional<Project> project;
+        if (!options.projectPath.empty() && std::ifstream(options.projectPath))
+        {
+            project = LoadProject(options.projectPath);
+            if (project->password)
+            {
+                std::cout << *project->password << "\n";
+                return 0;
+            }
+        }
+        if (options.archivePath.empty() && !project)
+        {
+            PrintUsage();
+            return 2;
+        }
+
+        if (!unrarPath.empty())
+        {
+            LoadUnrar(unrarPath);
+        }
+        if (list)
+        {
+            List(options.archivePath);
+            for (const auto& path : options.batchPaths)
+            {
+                List(path);
+            }
+            return 0;
+        }
+        if (!rulesPath.empty())
+        {
+            options.rules = ReadAll(rulesPath);
+        }
+        if (project)
+        {
+            Resume(*project, options.projectPath, options, !rulesPath.empty(), haveMin, haveMax,
+                !options.markovPath.empty(), haveThreads);
+        }
+        else if (rulesPath.empty())
+        {
+            throw std::runtime_error("no password rules given (use --rules)");
+        }
+
+        if (!serveAddress.empty())
+        {
+            if (!options.batchPaths.empty())
+            {
+                throw std::runtime_error("a cluster run takes one archive");
+            }
+            return Serve(options, serveAddress, rangeSize, leaseSeconds, progressSeconds);
+        }
+        if (progressSeconds != 0)
+        {
+            options.progressMilliseconds = progressSeconds * 1000;
+            options.onProgress = [](const EngineProgress& progress)
+            {
+                std::fprintf(stderr, "%6.2f%%  %llu of %llu  %.1f/s  ETA %s  (generate %.1f%%, verify %.1f%%)\n",
+                    progress.fraction * 100.0, static_cast<unsigned long long>(progress.done),
+                    static_cast<unsigned long long>(progress.keyspace), progress.rate, FormatDuration(progress.eta).c_str(),
+                    progress.generateShare * 100.0, progress.verifyShare * 100.0);
+            };
+        }
+        Engine engine(options);
+        EngineResult result;
+        {
+            InterruptStop interrupt([&engine] { engine.Stop(); });
+            result = engine.Run();
+        }
+
+        double rate = result.seconds > 0.0 ? static_cast<double>(result.tested) / result.seconds : 0.0;
+        std::fprintf(stderr, "tested %llu of %llu candidates in %.3f s (%.1f/s, %u threads, %s)\n",
+            static_cast<unsigned long long>(result.tested), static_cast<unsigned long long>(result.keyspace),
+            result.seconds, rate, ResolveThreadCount(options.threads, options.physicalCores), result.verification.c_str());
+        if (result.rejected != 0)
+        {
+            std::fprintf(stderr, "skipped %llu candidates the constraints rule out\n",
+                static_cast<unsigned long long>(result.rejected));
+        }
+        if (result.filterBytes != 0)
+        {
+            std::fprintf(stderr, "skipped %llu duplicates (filter %llu KiB, %u hashes, ~%.2g false-positive rate)\n",
+                static_cast<unsigned long long>(result.duplicates), static_cast<unsigned long long>(result.filterBytes >> 10),
+                result.filterHashes, result.filterFalsePositives);
+        }
+        if (!result.saveError.empty())
+        {
+            std::cerr << "runlock-cli: warning: " << result.saveError << "\n";
+        }
+        if (!options.batchPaths.empty())
+        {
+            for (const auto& outcome : result.archives)
+            {
+                std::cout << outcome.path << ": " << (outcome.found ? outcome.password : "not found") << "\n";
+                if (outcome.found && !outcome.origin.empty())
+                {
+                    std::cerr << outcome.path << ": found at " << outcome.origin << "\n";
+                }
+            }
+            if (!result.found && result.stopped)
+            {
+                std::cout << "stopped\n";
+            }
+            return result.found ? 0 : 1;
+        }
+        if (!result.found)
+        {
+            std::cout << (result.stopped ? "password not found (stopped)\n" : "password not found\n");
+            return 1;
+        }
+        if (!result.origin.empty())
+        {
+            std::cerr << "found at " << result.origin << "\n";
+        }
+        std::cout << result.password << "\n";
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "runlock-cli: " << e.what() << "\n";
+        return 2;
+    }
+}
@@ -0,0 +1,945 @@
+#include "cluster.h"
+#include "archive_batch.h"
+#include "engine.h"
+#include "keyspace.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+#ifdef _WIN32
+        using NativeSocket = SOCKET;
+        const NativeSocket NoSocket = INVALID_SOCKET;
+
+        void CloseNative(NativeSocket socket)
+        {
+            ::closesocket(socket);
+        }
+
+        int PollSockets(pollfd* sockets, size_t count, int milliseconds)
+        {
+            return ::WSAPoll(sockets, static_cast<ULONG>(count), milliseconds);
+        }
+
+        void StartSockets()
+        {
+            static const bool started = []
+            {
+                WSADATA data;
+                return ::WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+            if (!started)
+            {
+                throw std::runtime_error("cannot initialize Winsock");
+            }
+        }
+#else
+        using NativeSocket = int;
+        constexpr NativeSocket NoSocket = -1;
+
+        void CloseNative(NativeSocket socket)
+        {
+            ::close(socket);
+        }
+
+        int PollSockets(pollfd* sockets, size_t count, int milliseconds)
+        {
+            return ::poll(sockets, static_cast<nfds_t>(count), milliseconds);
+        }
+
+        void StartSockets()
+        {
+        }
+#endif
+
+        constexpr std::string_view Hello = "hello runlock-cluster 1";
+        constexpr std::string_view UnixPrefix = "unix:";
+
+        // Seconds a worker is told to wait when every free range is leased.
+        constexpr uint32_t WaitSeconds = 5;
+
+        // Longest first line of a message, and the most a "found" or "job"
+        // payload may declare; larger ones are malformed, which also keeps
+        // the size arithmetic of TakeMessage far from overflowing.
+        constexpr size_t MaxLineBytes = 4096;
+        constexpr uint64_t MaxPasswordBytes = MaxLineBytes;
+        constexpr uint64_t MaxJobBytes = 16 << 20;
+
+        class Socket
+        {
+        public:
+            Socket() = default;
+            explicit Socket(NativeSocket socket) : m_socket(socket) {}
+            ~Socket() { Close(); }
+
+            Socket(Socket&& other) noexcept : m_socket(other.Release()) {}
+            Socket& operator=(Socket&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    Close();
+                    m_socket = other.Release();
+                }
+                return *this;
+            }
+
+            NativeSocket Native() const { return m_socket; }
+            explicit operator bool() const { return m_socket != NoSocket; }
+
+            NativeSocket Release()
+            {
+                NativeSocket socket = m_socket;
+                m_socket = NoSocket;
+                return socket;
+            }
+
+            void Close()
+            {
+                if (m_socket != NoSocket)
+                {
+                    CloseNative(m_socket);
+                    m_socket = NoSocket;
+                }
+            }
+
+            // Throws std::runtime_error when the peer is gone.
+            void Send(std::string_view bytes) const
+            {
+#ifdef MSG_NOSIGNAL
+                constexpr int flags = MSG_NOSIGNAL;     // a closed peer is an error, not SIGPIPE
+#else
+                constexpr int flags = 0;
+#endif
+                while (!bytes.empty())
+                {
+                    auto sent = ::send(m_socket, bytes.data(), static_cast<int>(std::min<size_t>(bytes.size(), 1 << 20)), flags);
+                    if (sent <= 0)
+                    {
+                        throw std::runtime_error("connection lost");
+                    }
+                    bytes.remove_prefix(static_cast<size_t>(sent));
+                }
+            }
+
+            // Appends what arrived to buffer; false when the peer closed the
+            // connection or it failed.
+            bool Receive(std::string& buffer) const
+            {
+                char chunk[4096];
+                auto received = ::recv(m_socket, chunk, sizeof(chunk), 0);
+                if (received <= 0)
+                {
+                    return false;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+                return true;
+            }
+
+        private:
+            NativeSocket m_socket = NoSocket;
+        };
+
+        struct AddressInfoDeleter
+        {
+            void operator()(addrinfo* info) const { ::freeaddrinfo(info); }
+        };
+
+        // Resolves "host:port" (host may be empty for a listener) to TCP
+        // addresses.
+        std::unique_ptr<addrinfo, AddressInfoDeleter> Resolve(const std::string& address, bool listen)
+        {
+            size_t colon = address.rfind(':');
+            if (colon == std::string::npos)
+            {
+                throw std::runtime_error("address " + address + " has no port (host:port or unix:/path)");
+            }
+            std::string host = address.substr(0, colon);
+            std::string port = address.substr(colon + 1);
+            if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+            {
+                host = host.substr(1, host.size() - 2);
+            }
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = listen ? AI_PASSIVE : 0;
+            addrinfo* result = nullptr;
+            if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0)
+            {
+                throw std::runtime_error("cannot resolve " + address);
+            }
+            return std::unique_ptr<addrinfo, AddressInfoDeleter>(result);
+        }
+
+#ifndef _WIN32
+        sockaddr_un UnixAddress(const std::string& address)
+        {
+            std::string path = address.substr(UnixPrefix.size());
+            sockaddr_un local{};
+            local.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(local.sun_path))
+            {
+                throw std::runtime_error("invalid Unix socket path in " + address);
+            }
+            path.copy(local.sun_path, path.size());
+            return local;
+        }
+#endif
+
+        Socket Listen(const std::string& address)
+        {
+            StartSockets();
+            if (address.compare(0, UnixPrefix.size(), UnixPrefix) == 0)
+            {
+#ifdef _WIN32
+                throw std::runtime_error("Unix sockets are not supported here: " + address);
+#else
+                sockaddr_un local = UnixAddress(address);
+                ::unlink(local.sun_path);   // a stale socket from an earlier run
+                Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+                if (!socket || ::bind(socket.Native(), reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0
+                    || ::listen(socket.Native(), SOMAXCONN) != 0)
+                {
+                    throw std::runtime_error("cannot listen on " + address);
+                }
+                return socket;
+#endif
+            }
+            auto addresses = Resolve(address, true);
+            for (addrinfo* candidate = addresses.get(); candidate != nullptr; candidate = candidate->ai_next)
+            {
+                Socket socket(::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol));
+                if (!socket)
+                {
+                    continue;
+                }
+                int yes = 1;
+                ::setsockopt(socket.Native(), SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+                if (::bind(socket.Native(), candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0
+                    && ::listen(socket.Native(), SOMAXCONN) == 0)
+                {
+                    return socket;
+                }
+            }
+            throw std::runtime_error("cannot listen on " + address);
+        }
+
+        Socket Connect(const std::string& address)
+        {
+            StartSockets();
+            if (address.compare(0, UnixPrefix.size(), UnixPrefix) == 0)
+            {
+#ifdef _WIN32
+                throw std::runtime_error("Unix sockets are not supported here: " + address);
+#else
+                sockaddr_un local = UnixAddress(address);
+                Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+                if (!socket || ::connect(socket.Native(), reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+                {
+                    throw std::runtime_error("cannot connect to " + address);
+                }
+                return socket;
+#endif
+            }
+            auto addresses = Resolve(address, false);
+            for (addrinfo* candidate = addresses.get(); candidate != nullptr; candidate = candidate->ai_next)
+            {
+                Socket socket(::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol));
+                if (socket && ::connect(socket.Native(), candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0)
+                {
+                    int yes = 1;
+                    ::setsockopt(socket.Native(), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+                    return socket;
+                }
+            }
+            throw std::runtime_error("cannot connect to " + address);
+        }
+
+        // One protocol message: its first line split into the keyword and
+        // the rest, and the payload that follows some keywords.
+        struct Message
+        {
+            std::string key;
+            std::string rest;
+            std::string payload;        // "job" and "found"
+            RangeSet ranges;            // "done"
+        };
+
+        uint64_t ParseNumber(std::string_view& text)
+        {
+            uint64_t value = 0;
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (error != std::errc() || end == text.data())
+            {
+                throw std::runtime_error("malformed cluster message");
+            }
+            text.remove_prefix(static_cast<size_t>(end - text.data()));
+            if (!text.empty() && text.front() == ' ')
+            {
+                text.remove_prefix(1);
+            }
+            return value;
+        }
+
+        // Takes one complete message off the front of buffer; false when
+        // more bytes are needed. Throws std::runtime_error for malformed
+        // input.
+        bool TakeMessage(std::string& buffer, Message& message)
+        {
+            size_t newline = buffer.find('\n');
+            if (newline == std::string::npos)
+            {
+                if (buffer.size() > MaxLineBytes)
+                {
+                    throw std::runtime_error("malformed cluster message");
+                }
+                return false;
+            }
+            std::string_view line(buffer.data(), newline);
+            size_t space = line.find(' ');
+            std::string key(line.substr(0, space));
+            std::string_view rest = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+            size_t end = newline + 1;
+
+            Message taken;
+            if (key == "job" || key == "found")
+            {
+                std::string_view size = rest;
+                uint64_t bytes = ParseNumber(size);
+                if (bytes > (key == "job" ? MaxJobBytes : MaxPasswordBytes))
+                {
+                    throw std::runtime_error("malformed cluster message");
+                }
+                if (buffer.size() < end + bytes + 1)
+                {
+                    return false;
+                }
+                if (buffer[end + bytes] != '\n')
+                {
+                    throw std::runtime_error("malformed cluster message");
+                }
+                taken.payload = buffer.substr(end, static_cast<size_t>(bytes));
+                end += static_cast<size_t>(bytes) + 1;
+            }
+            else if (key == "done")
+            {
+                std::string_view fields = rest;
+                ParseNumber(fields);
+                ParseNumber(fields);
+                for (uint64_t count = ParseNumber(fields); count > 0; --count)
+                {
+                    size_t next = buffer.find('\n', end);
+                    if (next == std::string::npos)
+                    {
+                        return false;
+                    }
+                    std::string_view range(buffer.data() + end, next - end);
+                    uint64_t first = ParseNumber(range);
+                    uint64_t last = ParseNumber(range);
+                    if (first < last)
+                    {
+                        taken.ranges.Add(first, last);
+                    }
+                    end = next + 1;
+                }
+            }
+            taken.key = std::move(key);
+            taken.rest = std::string(rest);
+            message = std::move(taken);
+            buffer.erase(0, end);
+            return true;
+        }
+
+        std::string Block(std::string_view key, std::string_view payload)
+        {
+            return std::string(key) + ' ' + std::to_string(payload.size()) + '\n' + std::string(payload) + '\n';
+        }
+
+        std::string DoneMessage(uint64_t first, uint64_t last, const RangeSet& ranges)
+        {
+            std::string out = "done " + std::to_string(first) + ' ' + std::to_string(last) + ' '
+                + std::to_string(ranges.Ranges().size()) + '\n';
+            for (const auto& range : ranges.Ranges())
+            {
+                out += std::to_string(range.first) + ' ' + std::to_string(range.last) + '\n';
+            }
+            return out;
+        }
+
+        std::string DefaultWorkerName()
+        {
+            char host[256] = {};
+            if (::gethostname(host, sizeof(host) - 1) != 0)
+            {
+                host[0] = '\0';
+            }
+#ifdef _WIN32
+            unsigned long id = ::GetCurrentProcessId();
+#else
+            unsigned long id = static_cast<unsigned long>(::getpid());
+#endif
+            return std::string(host[0] != '\0' ? host : "worker") + '.' + std::to_string(id);
+        }
+
+        // Blocking request/reply side of a connection.
+        class Channel
+        {
+        public:
+            explicit Channel(Socket socket) : m_socket(std::move(socket)) {}
+
+            void Send(std::string_view bytes) { m_socket.Send(bytes); }
+
+            Message Read()
+            {
+                Message message;
+                while (!TakeMessage(m_buffer, message))
+                {
+                    if (!m_socket.Receive(m_buffer))
+                    {
+                        throw std::runtime_error("the coordinator closed the connection");
+                    }
+                }
+                return message;
+            }
+
+        private:
+            Socket m_socket;
+            std::string m_buffer;
+        };
+    }
+
+    Coordinator::Coordinator(CoordinatorOptions options)
+        : m_options(std::move(options))
+        , m_archive(std::make_unique<ArchiveBatch>(std::vector<std::string>{ m_options.job.archivePath }))
+        , m_listener(static_cast<intptr_t>(Listen(m_options.address).Release()))
+    {
+    }
+
+    Coordinator::~Coordinator()
+    {
+        Socket listener(static_cast<NativeSocket>(m_listener));
+    }
+
+    CoordinatorResult Coordinator::Run()
+    {
+        using Clock = std::chrono::steady_clock;
+        auto started = Clock::now();
+        auto log = [&](const std::string& text)
+        {
+            if (m_options.onLog)
+            {
+                m_options.onLog(text);
+            }
+        };
+
+        CoordinatorResult result;
+        result.keyspace = m_options.job.keyspaceSize;
+        result.done = m_options.job.done;
+        const uint64_t rangeSize = m_options.rangeSize != 0 ? m_options.rangeSize
+            : std::max<uint64_t>(result.keyspace / 1024, 1);
+        const auto leaseTime = std::chrono::seconds(std::max<uint32_t>(m_options.leaseSeconds, 1));
+
+        Project job = m_options.job;
+        job.done = RangeSet();
+        job.password.reset();
+        const std::string jobMessage = "lease " + std::to_string(leaseTime.count()) + '\n'
+            + Block("job", SerializeProject(job));
+
+        struct Lease
+        {
+            uint64_t first = 0;
+            uint64_t last = 0;
+            Clock::time_point deadline;
+        };
+        struct Client
+        {
+            Socket socket;
+            std::string buffer;
+            std::string name;
+            bool joined = false;
+            std::optional<Lease> lease;
+        };
+        std::vector<std::unique_ptr<Client>> clients;
+
+        auto leased = [&]()
+        {
+            RangeSet set;
+            for (const auto& client : clients)
+            {
+                if (client->lease)
+                {
+                    set.Add(client->lease->first, client->lease->last);
+                }
+            }
+            return set;
+        };
+        auto complete = [&]() { return result.done.Count() >= result.keyspace; };
+        auto finishing = [&]() { return result.found || complete() || m_stopping.load(); };
+
+        auto save = [&]()
+        {
+            if (m_options.projectPath.empty())
+            {
+                return;
+            }
+            Project project = m_options.job;
+            project.done = result.done;
+            if (result.found)
+            {
+                project.password = result.password;
+            }
+            try
+            {
+                SaveProject(project, m_options.projectPath);
+            }
+            catch (const std::runtime_error& e)
+            {
+                result.saveError = e.what();
+            }
+        };
+
+        // Hands out the lowest free range, or says why there is none.
+        auto next = [&](Client& client)
+        {
+            if (finishing())
+            {
+                return std::string("stop\n");
+            }
+            RangeSet busy = result.done;
+            busy.Add(leased());
+            RangeSet free = busy.Complement(result.keyspace);
+            if (free.Empty())
+            {
+                return "wait " + std::to_string(WaitSeconds) + '\n';
+            }
+            auto range = free.Ranges().front();
+            range.last = std::min(range.last, range.first + rangeSize);
+            client.lease = Lease{ range.first, range.last, Clock::now() + leaseTime };
+            return "range " + std::to_string(range.first) + ' ' + std::to_string(range.last) + '\n';
+        };
+
+        // False when the client has to go.
+        auto handle = [&](Client& client, Message& message)
+        {
+            if (!client.joined)
+            {
+                std::string line = message.key + ' ' + message.rest;
+                if (line.size() <= Hello.size() + 1 || line.compare(0, Hello.size(), Hello) != 0 || line[Hello.size()] != ' ')
+                {
+                    log("rejected a connection that does not speak the cluster protocol");
+                    return false;
+                }
+                client.joined = true;
+                client.name = line.substr(Hello.size() + 1);
+                ++result.workers;
+                log(client.name + " joined");
+                client.socket.Send(jobMessage);
+                return true;
+            }
+            if (message.key == "next")
+            {
+                client.socket.Send(next(client));
+            }
+            else if (message.key == "alive")
+            {
+                if (client.lease)
+                {
+                    client.lease->deadline = Clock::now() + leaseTime;
+                }
+                client.socket.Send(finishing() ? "stop\n" : "ok\n");
+            }
+            else if (message.key == "done")         // also late, after the lease was taken back
+            {
+                for (const auto& range : message.ranges.Ranges())
+                {
+                    result.done.Add(range.first, std::min(range.last, result.keyspace));
+                }
+                std::string_view fields = message.rest;
+                uint64_t first = ParseNumber(fields);
+                if (client.lease && client.lease->first == first)
+                {
+                    client.lease.reset();
+                }
+            }
+            else if (message.key == "found")
+            {
+                // Only a password that opens the archive here ends the job;
+                // a worker reporting one that does not is dropped.
+                if (!result.found)
+                {
+                    if (!m_archive->Create()->Verify(message.payload))
+                    {
+                        log(client.name + " reported a password that does not open the archive");
+                        return false;
+                    }
+                    result.found = true;
+                    result.password = message.payload;
+                    result.worker = client.name;
+                    log(client.name + " found the password");
+                    save();
+                }
+            }
+            else if (message.key == "error")
+            {
+                log(client.name + ": " + message.rest);
+                return false;
+            }
+            else
+            {
+                log(client.name + " sent an unknown message: " + message.key);
+                return false;
+            }
+            return true;
+        };
+
+        auto drop = [&](size_t index, const char* why)
+        {
+            Client& client = *clients[index];
+            if (client.lease)
+            {
+                ++result.expired;
+            }
+            if (client.joined)
+            {
+                log(client.name + " " + why + (client.lease ? "; its range returns to the pool" : ""));
+            }
+            clients.erase(clients.begin() + static_cast<ptrdiff_t>(index));
+        };
+
+        NativeSocket listener = static_cast<NativeSocket>(m_listener);
+        auto nextCheckpoint = Clock::now() + std::chrono::seconds(std::max<uint32_t>(m_options.checkpointSeconds, 1));
+        auto nextStatus = Clock::now() + std::chrono::seconds(m_options.statusSeconds);
+        std::optional<Clock::time_point> drainUntil;
+        while (true)
+        {
+            // Once the job is over, every reply to "next" or "alive" is
+            // "stop", and workers get one lease period to report the range
+            // they were on.
+            if (finishing())
+            {
+                if (!drainUntil)
+                {
+                    drainUntil = Clock::now() + leaseTime;
+                }
+                bool reporting = std::any_of(clients.begin(), clients.end(),
+                    [](const auto& client) { return client->lease.has_value(); });
+                if (!reporting || Clock::now() >= *drainUntil)
+                {
+                    break;
+                }
+            }
+
+            std::vector<pollfd> sockets(clients.size() + 1);
+            sockets[0].fd = listener;
+            sockets[0].events = POLLIN;
+            for (size_t i = 0; i < clients.size(); ++i)
+            {
+                sockets[i + 1].fd = clients[i]->socket.Native();
+                sockets[i + 1].events = POLLIN;
+            }
+            PollSockets(sockets.data(), sockets.size(), 1000);
+
+            for (size_t i = clients.size(); i-- > 0;)
+            {
+                if ((sockets[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+                {
+                    continue;
+                }
+                Client& client = *clients[i];
+                bool keep = client.socket.Receive(client.buffer);
+                try
+                {
+                    Message message;
+                    while (keep && TakeMessage(client.buffer, message))
+                    {
+                        keep = handle(client, message);
+                    }
+                }
+                catch (const std::runtime_error& e)
+                {
+                    log((client.joined ? client.name : std::string("a connection")) + ": " + e.what());
+                    keep = false;
+                }
+                if (!keep)
+                {
+                    drop(i, "left");
+                }
+            }
+            if ((sockets[0].revents & POLLIN) != 0)
+            {
+                // Accepted while finishing too, only to be closed: left
+                // pending, the connection would keep poll() returning at
+                // once until the job ends.
+                Socket socket(::accept(listener, nullptr, nullptr));
+                if (socket && !finishing())
+                {
+                    auto client = std::make_unique<Client>();
+                    client->socket = std::move(socket);
+                    clients.push_back(std::move(client));
+                }
+            }
+
+            auto now = Clock::now();
+            for (size_t i = clients.size(); i-- > 0;)
+            {
+                if (clients[i]->lease && now >= clients[i]->lease->deadline)
+                {
+                    ++result.expired;
+                    clients[i]->lease.reset();
+                    log(clients[i]->name + " missed its lease; its range returns to the pool");
+                }
+            }
+            if (!m_options.projectPath.empty() && now >= nextCheckpoint)
+            {
+                save();
+                nextCheckpoint = now + std::chrono::seconds(std::max<uint32_t>(m_options.checkpointSeconds, 1));
+            }
+            if (m_options.statusSeconds != 0 && now >= nextStatus)
+            {
+                size_t busy = static_cast<size_t>(std::count_if(clients.begin(), clients.end(),
+                    [](const auto& client) { return client->lease.has_value(); }));
+                char status[160];
+                std::snprintf(status, sizeof(status), "%.2f%% of %llu done, %zu workers, %zu ranges leased",
+                    result.keyspace == 0 ? 100.0 : 100.0 * static_cast<double>(result.done.Count()) / static_cast<double>(result.keyspace),
+                    static_cast<unsigned long long>(result.keyspace), clients.size(), busy);
+                log(status);
+                nextStatus = now + std::chrono::seconds(m_options.statusSeconds);
+            }
+        }
+
+        // Workers between ranges may be asking for the next one.
+        for (auto& client : clients)
+        {
+            try
+            {
+                if (client->joined && !client->lease)
+                {
+                    client->socket.Send("stop\n");
+                }
+            }
+            catch (const std::runtime_error&)
+            {
+            }
+        }
+        clients.clear();
+        save();
+        result.stopped = !result.found && !complete();
+        result.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        return result;
+    }
+
+    ClusterWorker::ClusterWorker(ClusterWorkerOptions options)
+        : m_options(std::move(options))
+    {
+        if (m_options.name.empty())
+        {
+            m_options.name = DefaultWorkerName();
+        }
+    }
+
+    void ClusterWorker::Stop()
+    {
+        m_stopping.store(true);
+        if (Engine* engine = m_engine.load())
+        {
+            engine->Stop();
+        }
+    }
+
+    ClusterWorkerResult ClusterWorker::Run()
+    {
+        auto started = std::chrono::steady_clock::now();
+        auto log = [&](const std::string& text)
+        {
+            if (m_options.onLog)
+            {
+                m_options.onLog(text);
+            }
+        };
+
+        Channel channel(Connect(m_options.address));
+        channel.Send(std::string(Hello) + ' ' + m_options.name + '\n');
+        Message message = channel.Read();
+        std::string_view field = message.rest;
+        uint64_t leaseSeconds = message.key == "lease" ? ParseNumber(field) : 0;
+        message = channel.Read();
+        if (leaseSeconds == 0 || message.key != "job")
+        {
+            throw std::runtime_error(m_options.address + " is not a runlock coordinator");
+        }
+        Project job = ParseProject(message.payload, m_options.address);
+
+        EngineOptions options;
+        options.archivePath = m_options.archivePath.empty() ? job.archivePath : m_options.archivePath;
+        options.rules = job.rules;
+        options.minLength = job.minLength;
+        options.maxLength = job.maxLength;
+        options.markovPath = job.markovPath;
+        options.threads = m_options.threads;
+        options.physicalCores = m_options.physicalCores;
+        options.pinThreads = m_options.pinThreads;
+        // The rules and the archive are compiled once for the job, before
+        // the first lease, and every range reuses them.
+        try
+        {
+            if (MappedFile(options.archivePath).Size() != job.archiveSize)
+            {
+                throw std::runtime_error(options.archivePath + " is not the archive of the job");
+            }
+            options.setup = EngineSetup::Create(options);
+        }
+        catch (const std::runtime_error& e)
+        {
+            channel.Send("error " + std::string(e.what()) + '\n');
+            throw;
+        }
+        if (options.setup->keyspace->Size() != job.keyspaceSize)
+        {
+            channel.Send("error the rules compile to a different keyspace here\n");
+            throw std::runtime_error("the job's rules compile to " + std::to_string(options.setup->keyspace->Size())
+                + " candidates here, not " + std::to_string(job.keyspaceSize) + " (different word lists?)");
+        }
+        log("joined " + m_options.address + " for " + options.archivePath);
+
+        ClusterWorkerResult result;
+        while (!m_stopping.load())
+        {
+            try
+            {
+                channel.Send("next\n");
+                message = channel.Read();
+            }
+            catch (const std::runtime_error& e)
+            {
+                // Nothing is lost between ranges: the last one was reported.
+                log(e.what());
+                break;
+            }
+            if (message.key == "stop")
+            {
+                break;
+            }
+            if (message.key == "wait")
+            {
+                std::string_view rest = message.rest;
+                auto until = std::chrono::steady_clock::now() + std::chrono::seconds(ParseNumber(rest));
+                while (!m_stopping.load() && std::chrono::steady_clock::now() < until)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                continue;
+            }
+            if (message.key != "range")
+            {
+                throw std::runtime_error("unexpected message from the coordinator: " + message.key);
+            }
+            std::string_view rest = message.rest;
+            uint64_t first = ParseNumber(rest);
+            uint64_t last = ParseNumber(rest);
+
+            RangeSet range;
+            range.Add(first, last);
+            options.done = range.Complement(job.keyspaceSize);
+            // Heartbeats ride on the engine's progress samples, from its
+            // monitor thread while this one waits in Run().
+            options.progressMilliseconds = static_cast<uint32_t>(leaseSeconds * 1000 / 4);
+            Engine* running = nullptr;
+            bool told = false;
+            options.onProgress = [&](const EngineProgress&)
+            {
+                if (told)
+                {
+                    return;
+                }
+                try
+                {
+                    channel.Send("alive\n");
+                    told = channel.Read().key == "stop";
+                }
+                catch (const std::runtime_error&)
+                {
+                    told = true;        // the coordinator is gone; its lease will lapse
+                }
+                if (told)
+                {
+                    running->Stop();
+                }
+            };
+            Engine worker(options);
+            running = &worker;
+            m_engine.store(&worker);
+            if (m_stopping.load())
+            {
+                worker.Stop();
+            }
+            EngineResult outcome;
+            try
+            {
+                outcome = worker.Run();
+            }
+            catch (const std::runtime_error& e)
+            {
+                m_engine.store(nullptr);
+                channel.Send("error " + std::string(e.what()) + '\n');
+                throw;
+            }
+            m_engine.store(nullptr);
+
+            RangeSet covered;
+            for (const auto& tested : outcome.done.Ranges())
+            {
+                uint64_t from = std::max(tested.first, first);
+                uint64_t to = std::min(tested.last, last);
+                if (from < to)
+                {
+                    covered.Add(from, to);
+                }
+            }
+            if (outcome.found)
+            {
+                channel.Send(Block("found", outcome.password));
+                result.found = true;
+                result.password = outcome.password;
+                log("found the password in range " + std::to_string(first) + '-' + std::to_string(last));
+            }
+            channel.Send(DoneMessage(first, last, covered));
+            ++result.ranges;
+            result.tested += outcome.tested;
+            if (told || outcome.found)
+            {
+                break;
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+}
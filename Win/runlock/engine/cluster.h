@@ -0,0 +1,144 @@
+#pragma once
+
+#include "project.h"
+#include "range_set.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace runlock::engine
+{
+    class ArchiveBatch;
+    class Engine;
+
+    // Keyspace sharding over sockets. A coordinator hands out fixed-size
+    // index ranges of one job to worker processes, each of which runs the
+    // ordinary multi-threaded Engine on its range (compiling the rules and
+    // inspecting the archive once per job, not per range: EngineSetup).
+    // Addresses are "host:port" (TCP; ":port" listens on every interface)
+    // or "unix:/path" (a Unix domain socket, not on Windows).
+    //
+    // The protocol is line-oriented text, one request and one reply at a
+    // time, initiated by the worker:
+    //
+    //   worker                              coordinator
+    //   hello runlock-cluster 1 <name>  ->  lease <seconds>
+    //                                       job <n>\n<project text>
+    //   next                            ->  range <first> <last> | wait <seconds> | stop
+    //   alive                           ->  ok | stop
+    //   found <n>\n<password>           ->  (no reply)
+    //   done <first> <last> <k>\n<k ranges tested>  ->  (no reply)
+    //   error <text>                    ->  (no reply; the worker leaves)
+    //
+    // A range is leased to one worker. The worker's "alive" heartbeats,
+    // sent four times per lease period, renew it; when the lease runs out
+    // or the connection drops, whatever the worker did not report as done
+    // goes back to the pool for the next "next". Reports arriving after
+    // that are still counted. A reported password ends the job only once
+    // the coordinator has opened its own copy of the archive with it; a
+    // worker whose password does not open it is dropped. Workers that
+    // connect once the job is over are disconnected at once.
+    //
+    // The job is a Project without done ranges, so word lists and the
+    // Markov sample must exist under the same paths on every worker; the
+    // archive may be given per worker and is checked by size. There is no
+    // authentication: listen on loopback, a Unix socket or a trusted
+    // network only.
+    struct CoordinatorOptions
+    {
+        std::string address;
+        // keyspaceSize must be set; done ranges are skipped. archivePath is
+        // opened here too, to check reported passwords.
+        Project job;
+        std::string projectPath;        // checkpoint file, as for a local run; empty = none
+        uint32_t checkpointSeconds = 30;
+        uint64_t rangeSize = 0;         // candidates per lease, 0 = about 1/1024 of the keyspace
+        uint32_t leaseSeconds = 60;
+
+        // Joins, leaves, expired leases, hits, and a status line every
+        // statusSeconds (0 = none). Called from the thread in Run().
+        std::function<void(const std::string&)> onLog;
+        uint32_t statusSeconds = 0;
+    };
+
+    struct CoordinatorResult
+    {
+        bool found = false;
+        bool stopped = false;           // Stop() ended the job before the keyspace did
+        std::string password;
+        std::string worker;             // name of the worker that found it
+        RangeSet done;
+        uint64_t keyspace = 0;
+        uint32_t workers = 0;           // connections that said hello
+        uint32_t expired = 0;           // leases taken back from silent or lost workers
+        double seconds = 0.0;
+        std::string saveError;
+    };
+
+    class Coordinator
+    {
+    public:
+        // Throws std::runtime_error when the address cannot be listened on
+        // or the job's archive cannot be checked (as Engine::Run does).
+        explicit Coordinator(CoordinatorOptions options);
+        ~Coordinator();
+
+        // Serves workers until the password is found, the keyspace is
+        // covered or Stop() is called; then tells every worker to stop and
+        // waits up to one lease period for their last reports.
+        CoordinatorResult Run();
+
+        // Safe from any thread; seen within a second.
+        void Stop() { m_stopping.store(true); }
+
+    private:
+        CoordinatorOptions m_options;
+        std::unique_ptr<ArchiveBatch> m_archive;    // verifies the passwords workers report
+        intptr_t m_listener;
+        std::atomic<bool> m_stopping{ false };
+    };
+
+    struct ClusterWorkerOptions
+    {
+        std::string address;
+        std::string archivePath;        // local copy of the job's archive, empty = the job's own path
+        uint32_t threads = 0;           // 0 = all hardware threads
+        bool physicalCores = false;     // EngineOptions::physicalCores
+        bool pinThreads = false;        // EngineOptions::pinThreads
+        std::string name;               // for the coordinator's log, empty = host name and process id
+        std::function<void(const std::string&)> onLog;
+    };
+
+    struct ClusterWorkerResult
+    {
+        uint64_t ranges = 0;
+        uint64_t tested = 0;
+        bool found = false;             // by this worker
+        std::string password;
+        double seconds = 0.0;
+    };
+
+    // Connects to a coordinator and works ranges until it says stop.
+    class ClusterWorker
+    {
+    public:
+        explicit ClusterWorker(ClusterWorkerOptions options);
+
+        // Returns when the coordinator says stop or goes away between
+        // ranges. Throws std::runtime_error when it cannot be reached or is
+        // not a coordinator, and for the same errors as Engine::Run.
+        ClusterWorkerResult Run();
+
+        // Safe from any thread: stops the range being worked on, reports
+        // what it covered and leaves.
+        void Stop();
+
+    private:
+        ClusterWorkerOptions m_options;
+        std::atomic<bool> m_stopping{ false };
+        std::atomic<Engine*> m_engine{ nullptr };
+    };
+}
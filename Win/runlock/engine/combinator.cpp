@@ -0,0 +1,231 @@
+#include "combinator.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        bool MultiplyChecked(uint64_t a, uint64_t b, uint64_t& product)
+        {
+            if (a != 0 && b > UINT64_MAX / a)
+            {
+                return false;
+            }
+            product = a * b;
+            return true;
+        }
+
+        uint64_t Factorial(size_t n)
+        {
+            uint64_t value = 1;
+            for (size_t i = 2; i <= n; ++i)
+            {
+                value *= i;
+            }
+            return value;
+        }
+
+        // Appends the strings to the pool and their offsets, plus the end.
+        std::vector<size_t> Pack(const std::vector<std::string>& strings, std::string& pool, size_t& widest)
+        {
+            std::vector<size_t> offsets;
+            for (const auto& text : strings)
+            {
+                offsets.push_back(pool.size());
+                pool += text;
+                widest = std::max(widest, text.size());
+            }
+            offsets.push_back(pool.size());
+            return offsets;
+        }
+    }
+
+    TokenCombinator::TokenCombinator(const std::vector<std::vector<std::string>>& lists, std::vector<std::string> separators, bool permute)
+    {
+        if (lists.empty())
+        {
+            throw std::runtime_error("%combine has no token lists");
+        }
+        if (lists.size() > MaxLists)
+        {
+            throw std::runtime_error("%combine takes at most " + std::to_string(MaxLists) + " token lists");
+        }
+        if (separators.empty())
+        {
+            separators.emplace_back();
+        }
+
+        bool fits = true;
+        for (const auto& list : lists)
+        {
+            if (list.empty())
+            {
+                throw std::runtime_error("%combine token list is empty");
+            }
+            size_t widest = 0;
+            m_tokens.push_back(Pack(list, m_pool, widest));
+            m_maxBytes += widest;
+            fits = fits && MultiplyChecked(m_product, list.size(), m_product);
+        }
+        size_t widestSeparator = 0;
+        m_separators = Pack(separators, m_pool, widestSeparator);
+        m_maxBytes += widestSeparator * (lists.size() - 1);
+        m_orders = permute ? Factorial(lists.size()) : 1;
+
+        uint64_t combinations = 0;
+        fits = fits && MultiplyChecked(m_product, separators.size(), combinations)
+            && MultiplyChecked(combinations, m_orders, m_size);
+        if (!fits)
+        {
+            throw std::runtime_error("%combine expands to more than 2^64 candidates");
+        }
+    }
+
+    std::string_view TokenCombinator::Token(size_t list, uint64_t index) const
+    {
+        const std::vector<size_t>& offsets = m_tokens[list];
+        return std::string_view(m_pool.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    void TokenCombinator::Arrange(Cursor& cursor) const
+    {
+        // Lehmer code: digit i (base n - i) picks among the lists not yet placed.
+        uint8_t left[MaxLists];
+        size_t count = m_tokens.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            left[i] = static_cast<uint8_t>(i);
+        }
+        uint64_t rank = cursor.order;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t weight = Factorial(count - 1 - i);
+            size_t pick = static_cast<size_t>(rank / weight);
+            rank %= weight;
+            cursor.lists[i] = left[pick];
+            std::memmove(left + pick, left + pick + 1, count - pick - 1);
+        }
+    }
+
+    void TokenCombinator::Seek(uint64_t index, Cursor& cursor) const
+    {
+        uint64_t tuple = index % m_product;
+        uint64_t rest = index / m_product;
+        uint64_t separators = m_separators.size() - 1;
+        cursor.separator = rest % separators;
+        cursor.order = rest / separators;
+        for (size_t list = m_tokens.size(); list-- > 0;)
+        {
+            uint64_t size = m_tokens[list].size() - 1;
+            cursor.digits[list] = tuple % size;
+            tuple /= size;
+        }
+        Arrange(cursor);
+    }
+
+    void TokenCombinator::Advance(Cursor& cursor) const
+    {
+        for (size_t list = m_tokens.size(); list-- > 0;)
+        {
+            if (++cursor.digits[list] < m_tokens[list].size() - 1)
+            {
+                return;
+            }
+            cursor.digits[list] = 0;
+        }
+        if (++cursor.separator < m_separators.size() - 1)
+        {
+            return;
+        }
+        cursor.separator = 0;
+        ++cursor.order;
+        Arrange(cursor);
+    }
+
+    size_t TokenCombinator::Write(const Cursor& cursor, char* out) const
+    {
+        std::string_view separator(m_pool.data() + m_separators[cursor.separator],
+            m_separators[cursor.separator + 1] - m_separators[cursor.separator]);
+        char* at = out;
+        for (size_t place = 0; place < m_tokens.size(); ++place)
+        {
+            if (place != 0)
+            {
+                std::memcpy(at, separator.data(), separator.size());
+                at += separator.size();
+            }
+            size_t list = cursor.lists[place];
+            std::string_view token = Token(list, cursor.digits[list]);
+            std::memcpy(at, token.data(), token.size());
+            at += token.size();
+        }
+        return static_cast<size_t>(at - out);
+    }
+
+    size_t TokenCombinator::Generate(uint64_t index, char* out) const
+    {
+        Cursor cursor;
+        Seek(index, cursor);
+        return Write(cursor, out);
+    }
+
+    void TokenCombinator::Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const
+    {
+        Cursor cursor;
+        Seek(first, cursor);
+        for (size_t i = 0; i < count; ++i, out += stride)
+        {
+            if (i != 0)
+            {
+                Advance(cursor);
+            }
+            views[i] = std::string_view(out, Write(cursor, out));
+        }
+    }
+
+    std::string TokenCombinator::Origin(uint64_t index) const
+    {
+        if (m_orders == 1)
+        {
+            return {};
+        }
+        Cursor cursor;
+        Seek(index, cursor);
+        std::string origin = "token lists in order";
+        for (size_t place = 0; place < m_tokens.size(); ++place)
+        {
+            origin += (place == 0 ? " " : ", ") + std::to_string(cursor.lists[place] + 1);
+        }
+        return origin;
+    }
+
+    std::vector<std::string> TokenCombinator::ReadTokens(const std::string& path)
+    {
+        MappedFile file(path);
+        std::string_view text(reinterpret_cast<const char*>(file.Data()), file.Size());
+        if (text.starts_with("\xEF\xBB\xBF"))
+        {
+            text.remove_prefix(3);
+        }
+        std::vector<std::string> tokens;
+        while (!text.empty())
+        {
+            size_t end = text.find('\n');
+            std::string_view line = text.substr(0, end);
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if (!line.empty())
+            {
+                tokens.emplace_back(line);
+            }
+        }
+        return tokens;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "keyspace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // The %combine rule: one token from each of several lists, joined by a
+    // separator, optionally with the lists in every order. Candidate N is
+    //   N = (order * separators + separator) * product + tuple
+    // where tuple is a mixed-radix number with a digit per list (the last
+    // list's digit varying fastest) and order a permutation's rank,
+    // decoded from its Lehmer code (factorial-base digits). Every part is a
+    // division away from N, so a range splits or resumes from one integer
+    // however large the product. Tokens sit back to back in one pool and
+    // candidates are copied from it straight into the output, token by
+    // token; a batch decodes its first index and then steps the digits.
+    class TokenCombinator : public Segment
+    {
+    public:
+        // Up to this many lists; 16! orders still fit in 64 bits.
+        static constexpr size_t MaxLists = 16;
+
+        // An empty separator list joins tokens directly. Throws
+        // std::runtime_error for no lists, an empty list, too many lists or
+        // more than 2^64 candidates.
+        TokenCombinator(const std::vector<std::vector<std::string>>& lists, std::vector<std::string> separators, bool permute);
+
+        uint64_t Size() const override { return m_size; }
+        size_t MaxBytes() const override { return m_maxBytes; }
+        bool Distinct() const override { return false; }    // lists may share tokens
+        size_t Generate(uint64_t index, char* out) const override;
+        std::string Origin(uint64_t index) const override;
+        void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const override;
+
+        // The lines of a token file, without terminators, a UTF-8 BOM or
+        // empty lines. Throws std::runtime_error.
+        static std::vector<std::string> ReadTokens(const std::string& path);
+
+    private:
+        struct Cursor
+        {
+            uint64_t order;
+            uint64_t separator;
+            uint8_t lists[MaxLists];        // list at each place of the candidate
+            uint64_t digits[MaxLists];      // token of each list
+        };
+
+        void Seek(uint64_t index, Cursor& cursor) const;
+        void Advance(Cursor& cursor) const;
+        void Arrange(Cursor& cursor) const;
+        size_t Write(const Cursor& cursor, char* out) const;
+
+        std::string_view Token(size_t list, uint64_t index) const;
+
+        std::string m_pool;                             // tokens and separators, back to back
+        std::vector<std::vector<size_t>> m_tokens;      // per list, offsets into m_pool and its end
+        std::vector<size_t> m_separators;               // the same for the separators
+        uint64_t m_product = 1;
+        uint64_t m_orders = 1;
+        uint64_t m_size = 0;
+        size_t m_maxBytes = 0;
+    };
+}
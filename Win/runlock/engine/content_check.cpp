@@ -0,0 +1,214 @@
+#include "content_check.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        struct Signature
+        {
+            std::string_view extension;
+            size_t offset;
+            std::string_view magic;
+        };
+
+        using namespace std::string_view_literals;
+
+        // Extensions with several valid signatures are listed once per
+        // signature; any of them matches.
+        constexpr Signature Signatures[] =
+        {
+            { "7z", 0, "7z\xBC\xAF\x27\x1C"sv },
+            { "bmp", 0, "BM"sv },
+            { "bz2", 0, "BZh"sv },
+            { "class", 0, "\xCA\xFE\xBA\xBE"sv },
+            { "cab", 0, "MSCF"sv },
+            { "dll", 0, "MZ"sv },
+            { "doc", 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"sv },
+            { "docx", 0, "PK"sv },
+            { "epub", 0, "PK"sv },
+            { "exe", 0, "MZ"sv },
+            { "flac", 0, "fLaC"sv },
+            { "gif", 0, "GIF8"sv },
+            { "gz", 0, "\x1F\x8B"sv },
+            { "ico", 0, "\0\0\1\0"sv },
+            { "jar", 0, "PK"sv },
+            { "jpeg", 0, "\xFF\xD8\xFF"sv },
+            { "jpg", 0, "\xFF\xD8\xFF"sv },
+            { "m4a", 4, "ftyp"sv },
+            { "mkv", 0, "\x1A\x45\xDF\xA3"sv },
+            { "mov", 4, "ftyp"sv },
+            { "mov", 4, "moov"sv },
+            { "mov", 4, "mdat"sv },
+            { "mov", 4, "wide"sv },
+            { "mov", 4, "free"sv },
+            { "mov", 4, "skip"sv },
+            { "mov", 4, "pnot"sv },
+            { "mp4", 4, "ftyp"sv },
+            { "msi", 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"sv },
+            { "odp", 0, "PK"sv },
+            { "ods", 0, "PK"sv },
+            { "odt", 0, "PK"sv },
+            { "ogg", 0, "OggS"sv },
+            { "pdf", 0, "%PDF"sv },
+            { "png", 0, "\x89PNG\r\n\x1A\n"sv },
+            { "ppt", 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"sv },
+            { "pptx", 0, "PK"sv },
+            { "psd", 0, "8BPS"sv },
+            { "rar", 0, "Rar!\x1A\x07"sv },
+            { "rtf", 0, "{\\rtf"sv },
+            { "so", 0, "\x7F" "ELF"sv },
+            { "sqlite", 0, "SQLite format 3\0"sv },
+            { "tgz", 0, "\x1F\x8B"sv },
+            { "tif", 0, "II*\0"sv },
+            { "tif", 0, "MM\0*"sv },
+            { "tif", 0, "II+\0"sv },       // BigTIFF
+            { "tif", 0, "MM\0+"sv },
+            { "tiff", 0, "II*\0"sv },
+            { "tiff", 0, "MM\0*"sv },
+            { "tiff", 0, "II+\0"sv },
+            { "tiff", 0, "MM\0+"sv },
+            { "wav", 0, "RIFF"sv },
+            { "webm", 0, "\x1A\x45\xDF\xA3"sv },
+            { "webp", 0, "RIFF"sv },
+            { "xls", 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"sv },
+            { "xlsx", 0, "PK"sv },
+            { "xz", 0, "\xFD" "7zXZ\0"sv },
+            { "zip", 0, "PK"sv },
+        };
+
+        constexpr std::string_view TextExtensions[] =
+        {
+            "bat", "c", "cfg", "cmd", "conf", "cpp", "cs", "css", "csv", "h", "hpp", "htm", "html",
+            "ini", "java", "js", "json", "log", "md", "php", "pl", "ps1", "py", "rb", "sh", "sql",
+            "svg", "tex", "txt", "xml", "yaml", "yml",
+        };
+
+        std::string LowerExtension(std::string_view name)
+        {
+            size_t dot = name.find_last_of('.');
+            size_t slash = name.find_last_of("/\\");
+            if (dot == std::string_view::npos || (slash != std::string_view::npos && slash > dot))
+            {
+                return {};
+            }
+            std::string extension(name.substr(dot + 1));
+            for (char& c : extension)
+            {
+                if (c >= 'A' && c <= 'Z')
+                {
+                    c = static_cast<char>(c - 'A' + 'a');
+                }
+            }
+            return extension;
+        }
+
+        // UTF-16 or UTF-32 text without a byte order mark: the NUL bytes
+        // of the high halves keep to one or two byte positions out of each
+        // four, where garbage spreads its few NULs evenly.
+        bool LooksLikeWideText(const uint8_t* data, size_t size)
+        {
+            size_t zeros[4] = {};
+            for (size_t i = 0; i < size; ++i)
+            {
+                zeros[i % 4] += data[i] == 0;
+            }
+            size_t even = zeros[0] + zeros[2];
+            size_t odd = zeros[1] + zeros[3];
+            return std::max(even, odd) * 4 >= size && std::min(even, odd) * 16 <= size;
+        }
+
+        // Text in a single-byte encoding or UTF-8 has few control
+        // characters; decompressed garbage has about one in ten. Wide text
+        // passes as it is, and a stray NUL only counts as one more control
+        // character, so unusual text is let through rather than a hit lost.
+        bool LooksLikeText(const uint8_t* data, size_t size)
+        {
+            if (size >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF)))
+            {
+                return true;    // UTF-16 with a byte order mark
+            }
+            if (LooksLikeWideText(data, size))
+            {
+                return true;
+            }
+            size_t control = 0;
+            for (size_t i = 0; i < size; ++i)
+            {
+                uint8_t c = data[i];
+                if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != 0x1A && c != 0x1B)
+                {
+                    ++control;
+                }
+            }
+            return control * 32 <= size;
+        }
+    }
+
+    ContentCheck ContentCheck::ForName(std::string_view name)
+    {
+        ContentCheck check;
+        std::string extension = LowerExtension(name);
+        if (extension.empty())
+        {
+            return check;
+        }
+        for (const auto& signature : Signatures)
+        {
+            if (signature.extension == extension)
+            {
+                check.m_kind = Kind::Signature;
+                check.m_extension = signature.extension;
+                return check;
+            }
+        }
+        for (auto text : TextExtensions)
+        {
+            if (text == extension)
+            {
+                check.m_kind = Kind::Text;
+                return check;
+            }
+        }
+        return check;
+    }
+
+    const char* ContentCheck::Describe() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Signature: return "file signature";
+        case Kind::Text: return "text";
+        default: return "none";
+        }
+    }
+
+    bool ContentCheck::Plausible(const uint8_t* data, size_t size) const
+    {
+        switch (m_kind)
+        {
+        case Kind::Signature:
+            for (const auto& signature : Signatures)
+            {
+                if (signature.extension != m_extension)
+                {
+                    continue;
+                }
+                size_t end = signature.offset + signature.magic.size();
+                if (size < end
+                    || std::memcmp(data + signature.offset, signature.magic.data(), signature.magic.size()) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        case Kind::Text:
+            return LooksLikeText(data, std::min(size, PrefixSize));
+        default:
+            return true;
+        }
+    }
+}
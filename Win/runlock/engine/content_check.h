@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // What the first bytes of an entry must look like, guessed from its name:
+    // a file signature for common binary formats, or readable text for text
+    // extensions. Lets a test through the UnRAR library give up on a wrong
+    // password after the first decompressed chunk instead of at the final CRC.
+    class ContentCheck
+    {
+    public:
+        // Number of leading bytes Plausible() wants to see.
+        static constexpr size_t PrefixSize = 4096;
+
+        // No expectation: every prefix is plausible.
+        ContentCheck() = default;
+
+        static ContentCheck ForName(std::string_view name);
+
+        bool Known() const { return m_kind != Kind::None; }
+
+        // Short description for logs: "file signature", "text" or "none".
+        const char* Describe() const;
+
+        // True when the first `size` bytes of an entry can be its real
+        // content. size may be smaller than PrefixSize for short entries.
+        bool Plausible(const uint8_t* data, size_t size) const;
+
+    private:
+        enum class Kind
+        {
+            None,
+            Signature,
+            Text,
+        };
+
+        Kind m_kind = Kind::None;
+        std::string_view m_extension;
+    };
+}
@@ -0,0 +1,81 @@
+#include "cpu_features.h"
+
+#include <cstdint>
+
+#ifdef RUNLOCK_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+#ifdef RUNLOCK_X86
+        void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+        {
+#ifdef _MSC_VER
+            int out[4];
+            __cpuidex(out, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; ++i)
+            {
+                regs[i] = static_cast<uint32_t>(out[i]);
+            }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        uint64_t ReadXcr0()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+        }
+
+        CpuFeatures Detect()
+        {
+            CpuFeatures features;
+            uint32_t regs[4];
+            CpuId(0, 0, regs);
+            uint32_t maxLeaf = regs[0];
+            if (maxLeaf < 7)
+            {
+                return features;
+            }
+
+            CpuId(1, 0, regs);
+            bool ssse3 = (regs[2] & (1u << 9)) != 0;
+            bool sse41 = (regs[2] & (1u << 19)) != 0;
+            bool osxsave = (regs[2] & (1u << 27)) != 0;
+            uint64_t xcr0 = osxsave ? ReadXcr0() : 0;
+            bool ymm = (xcr0 & 0x6) == 0x6;
+            bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+            CpuId(7, 0, regs);
+            features.avx2 = ymm && (regs[1] & (1u << 5)) != 0;
+            features.avx512 = zmm && (regs[1] & (1u << 16)) != 0;
+            features.shaNi = ssse3 && sse41 && (regs[1] & (1u << 29)) != 0;
+            return features;
+        }
+#else
+        CpuFeatures Detect()
+        {
+            return {};
+        }
+#endif
+    }
+
+    const CpuFeatures& DetectCpuFeatures()
+    {
+        static const CpuFeatures features = Detect();
+        return features;
+    }
+}
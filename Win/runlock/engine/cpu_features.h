@@ -0,0 +1,19 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RUNLOCK_X86 1
+#endif
+
+namespace runlock::engine
+{
+    // Instruction set extensions the engine has kernels for. A feature is
+    // only reported when the OS also saves the register state it needs.
+    struct CpuFeatures
+    {
+        bool avx2 = false;
+        bool avx512 = false;    // AVX-512 F
+        bool shaNi = false;     // SHA extensions (with SSE4.1 / SSSE3)
+    };
+
+    const CpuFeatures& DetectCpuFeatures();
+}
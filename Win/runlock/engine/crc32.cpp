@@ -0,0 +1,54 @@
+#include "crc32.h"
+
+#include <array>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Slicing-by-4 tables; table[0] is the classic byte-wise table.
+        using Tables = std::array<std::array<uint32_t, 256>, 4>;
+
+        constexpr Tables MakeTables()
+        {
+            Tables tables{};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    c = (c & 1) != 0 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                tables[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (size_t t = 1; t < tables.size(); ++t)
+                {
+                    uint32_t previous = tables[t - 1][i];
+                    tables[t][i] = tables[0][previous & 0xFF] ^ (previous >> 8);
+                }
+            }
+            return tables;
+        }
+
+        constexpr Tables CrcTables = MakeTables();
+    }
+
+    uint32_t Crc32(const void* data, size_t size, uint32_t crc)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        crc = ~crc;
+        for (; size >= 4; size -= 4, p += 4)
+        {
+            crc ^= uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+            crc = CrcTables[3][crc & 0xFF] ^ CrcTables[2][(crc >> 8) & 0xFF]
+                ^ CrcTables[1][(crc >> 16) & 0xFF] ^ CrcTables[0][crc >> 24];
+        }
+        for (; size > 0; --size, ++p)
+        {
+            crc = CrcTables[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace runlock::engine
+{
+    // CRC-32 (IEEE 802.3, reflected), as used by RAR for headers and data.
+    // Pass the previous result as crc to continue over several buffers.
+    uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0);
+}
@@ -0,0 +1,568 @@
+#include "engine.h"
+#include "archive_batch.h"
+#include "candidate_batch.h"
+#include "candidate_filter.h"
+#include "keyspace.h"
+#include "markov.h"
+#include "project.h"
+#include "topology.h"
+#include "verifier.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace runlock::engine
+{
+    uint32_t ResolveThreadCount(uint32_t requested, bool physicalCores)
+    {
+        const CpuTopology& topology = CpuTopology::Detect();
+        if (physicalCores)
+        {
+            return requested != 0 ? std::min(requested, topology.Cores()) : topology.Cores();
+        }
+        return requested != 0 ? requested : static_cast<uint32_t>(topology.Cpus().size());
+    }
+
+    uint64_t PartitionStart(uint64_t size, uint32_t parts, uint32_t part)
+    {
+        return size / parts * part + std::min<uint64_t>(part, size % parts);
+    }
+
+    std::shared_ptr<EngineSetup> EngineSetup::Create(const EngineOptions& options)
+    {
+        std::vector<std::string> paths{ options.archivePath };
+        paths.insert(paths.end(), options.batchPaths.begin(), options.batchPaths.end());
+        auto setup = std::make_shared<EngineSetup>();
+        setup->archives = std::make_unique<ArchiveBatch>(paths);
+        KeyspaceOptions keyspaceOptions;
+        keyspaceOptions.minLength = options.minLength;
+        keyspaceOptions.maxLength = options.maxLength;
+        if (!options.markovPath.empty())
+        {
+            keyspaceOptions.order = MarkovModel::Train(options.markovPath);
+        }
+        setup->keyspace = std::make_unique<const Keyspace>(Keyspace::Compile(options.rules, keyspaceOptions));
+        return setup;
+    }
+
+    EngineSetup::~EngineSetup() = default;
+
+    Engine::Engine(EngineOptions options)
+        : m_options(std::move(options))
+    {
+    }
+
+    void Engine::Pause()
+    {
+        RunState expected = RunState::Running;
+        m_state.compare_exchange_strong(expected, RunState::Paused);
+    }
+
+    void Engine::Resume()
+    {
+        RunState expected = RunState::Paused;
+        if (m_state.compare_exchange_strong(expected, RunState::Running))
+        {
+            m_state.notify_all();
+        }
+    }
+
+    void Engine::Stop()
+    {
+        m_state.store(RunState::Stopped);
+        m_state.notify_all();
+    }
+
+    bool Engine::Proceed()
+    {
+        RunState state = m_state.load(std::memory_order_acquire);
+        while (state == RunState::Paused)
+        {
+            m_state.wait(RunState::Paused, std::memory_order_acquire);
+            state = m_state.load(std::memory_order_acquire);
+        }
+        return state == RunState::Running;
+    }
+
+    namespace
+    {
+        // One worker's progress, on its own cache line so the per-batch
+        // stores do not contend.
+        struct alignas(64) WorkerProgress
+        {
+            std::atomic<uint64_t> done{ 0 };            // candidates walked, all chunks
+            std::atomic<uint64_t> generateNanos{ 0 };
+            std::atomic<uint64_t> verifyNanos{ 0 };
+            uint64_t duplicates = 0;    // written by the worker, read after join
+            uint64_t rejected = 0;      // likewise
+        };
+
+        // What one worker has left to claim, as positions in the untested
+        // keyspace, and what it has walked, as candidate indices. The owner
+        // claims chunks from the front of [next, end), thieves take the back
+        // half; both, and the monitor, hold `lock` for it.
+        struct alignas(64) WorkerShare
+        {
+            std::mutex lock;
+            uint64_t next = 0;
+            uint64_t end = 0;
+            RangeSet finished;                          // earlier chunks
+            RangeSet chunk;                             // the one in hand
+            std::atomic<uint64_t> chunkDone{ 0 };       // its walked prefix; stored without the lock
+        };
+
+        // Time constant of the rate average behind the ETA.
+        constexpr double RateSmoothingSeconds = 10.0;
+
+        // Target time for one chunk at the worker's measured rate: long
+        // enough that the share lock is cold, short enough that the last
+        // chunks of a run end close together.
+        constexpr double ChunkSeconds = 0.05;
+
+        uint64_t NanosBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+        }
+    }
+
+    EngineResult Engine::Run()
+    {
+        auto started = std::chrono::steady_clock::now();
+
+        if (!m_options.batchPaths.empty() && !m_options.projectPath.empty())
+        {
+            throw std::runtime_error("a project holds one archive; batch runs are not checkpointed");
+        }
+        std::vector<std::string> paths{ m_options.archivePath };
+        paths.insert(paths.end(), m_options.batchPaths.begin(), m_options.batchPaths.end());
+        std::shared_ptr<EngineSetup> setup = m_options.setup ? m_options.setup : EngineSetup::Create(m_options);
+        ArchiveBatch& archives = *setup->archives;
+        const Keyspace& keyspace = *setup->keyspace;
+        if (m_options.keyspaceSize != 0 && m_options.keyspaceSize != keyspace.Size())
+        {
+            // Same rules over changed word lists: the saved ranges would
+            // mark other candidates as tested.
+            throw std::runtime_error("the rules compile to " + std::to_string(keyspace.Size())
+                + " candidates now, not the " + std::to_string(m_options.keyspaceSize)
+                + " the saved progress was counted in (changed word lists?)");
+        }
+        if (m_options.done.End() > keyspace.Size())
+        {
+            throw std::runtime_error("the saved progress does not fit the rules' keyspace");
+        }
+        uint32_t threads = ResolveThreadCount(m_options.threads, m_options.physicalCores);
+        std::vector<LogicalCpu> placement = CpuTopology::Detect().Place(threads, m_options.physicalCores);
+
+        EngineResult result;
+        result.keyspace = keyspace.Size();
+        result.verification = archives.Describe();
+        for (const auto& path : paths)
+        {
+            result.archives.push_back(ArchiveOutcome{ path, false, {}, {} });
+        }
+        std::mutex resultMutex;
+        std::exception_ptr failure;
+
+        // Untested candidates, cut into one near-equal share per worker.
+        RangeSet remaining = m_options.done.Complement(keyspace.Size());
+        uint64_t untested = remaining.Count();
+        std::vector<WorkerShare> shares(threads);
+        for (uint32_t i = 0; i < threads; ++i)
+        {
+            shares[i].next = PartitionStart(untested, threads, i);
+            shares[i].end = PartitionStart(untested, threads, i + 1);
+        }
+        std::vector<WorkerProgress> progress(threads);
+
+        // Files worker `id`'s finished chunk and hands it the next one of up
+        // to `size` candidates: from its own share, else after moving the
+        // back half of the largest other share over. False when nothing is
+        // left anywhere.
+        auto claim = [&](uint32_t id, uint64_t size)
+        {
+            WorkerShare& own = shares[id];
+            {
+                std::lock_guard lock(own.lock);
+                own.finished.Add(own.chunk);
+                own.chunk = RangeSet();
+                own.chunkDone.store(0, std::memory_order_relaxed);
+            }
+            while (true)
+            {
+                {
+                    std::lock_guard lock(own.lock);
+                    if (own.next < own.end)
+                    {
+                        uint64_t count = std::min(size, own.end - own.next);
+                        own.chunk = remaining.Slice(own.next, count);
+                        own.next += count;
+                        return true;
+                    }
+                }
+                uint32_t victim = id;
+                uint64_t largest = 0;
+                for (uint32_t i = 0; i < threads; ++i)
+                {
+                    std::lock_guard lock(shares[i].lock);
+                    if (i != id && shares[i].end - shares[i].next > largest)
+                    {
+                        victim = i;
+                        largest = shares[i].end - shares[i].next;
+                    }
+                }
+                if (victim == id)
+                {
+                    return false;
+                }
+                uint64_t first;
+                uint64_t last;
+                {
+                    std::lock_guard lock(shares[victim].lock);
+                    last = shares[victim].end;
+                    first = last - (last - shares[victim].next + 1) / 2;
+                    shares[victim].end = first;
+                }
+                // Lost a race for it when empty; look again.
+                std::lock_guard lock(own.lock);
+                own.next = first;
+                own.end = last;
+            }
+        };
+
+        std::unique_ptr<CandidateFilter> filter;
+        if (m_options.dedupMegabytes != 0 && keyspace.MayRepeat())
+        {
+            filter = std::make_unique<CandidateFilter>(untested, size_t(m_options.dedupMegabytes) << 20);
+        }
+
+        auto worker = [&](uint32_t id)
+        {
+            try
+            {
+                // Pinned before anything is allocated, so first touch puts
+                // the worker's memory on its own NUMA node.
+                if (m_options.pinThreads)
+                {
+                    PinCurrentThread(placement[id]);
+                }
+                auto verifier = archives.Create();
+                const size_t batch = verifier->PreferredBatch();
+                // The worker's candidates live here for the whole run.
+                CandidateBatch candidates(batch, keyspace.MaxBytes());
+                // positions[i]: the index just past candidates[i], so a hit
+                // knows how far the chunk was covered even with repeats and
+                // rejected candidates skipped; rejectedAt[i]: the rejected
+                // count then, to tell the two apart.
+                std::vector<uint64_t> positions(batch);
+                std::vector<uint64_t> rejectedAt(batch);
+                uint64_t done = 0;
+                uint64_t duplicates = 0;
+                uint64_t rejected = 0;
+                uint64_t generateNanos = 0;
+                uint64_t verifyNanos = 0;
+                uint64_t chunkSize = batch;
+                while (Proceed() && claim(id, chunkSize))
+                {
+                    // Working time only: waiting in claim() or parked in
+                    // Proceed() is neither generating nor verifying.
+                    const uint64_t chunkStarted = generateNanos + verifyNanos;
+                    uint64_t chunkDone = 0;
+                    for (const auto& range : shares[id].chunk.Ranges())
+                    {
+                        uint64_t index = range.first;
+                        while (index < range.last && Proceed())
+                        {
+                            size_t count = 0;
+                            uint64_t next = index;
+                            auto generating = std::chrono::steady_clock::now();
+                            while (count < batch && next < range.last)
+                            {
+                                size_t fill = static_cast<size_t>(std::min<uint64_t>(batch - count, range.last - next));
+                                const size_t filled = count;
+                                std::string_view* views = candidates.Views();
+                                keyspace.Fill(next, fill, candidates.Slot(filled), candidates.Stride(), views + filled);
+                                for (size_t i = 0; i < fill; ++i)
+                                {
+                                    std::string_view candidate = views[filled + i];
+                                    ++next;
+                                    if (Segment::Rejected(candidate))
+                                    {
+                                        ++rejected;
+                                        continue;
+                                    }
+                                    if (filter && filter->TestAndAdd(candidate))
+                                    {
+                                        ++duplicates;
+                                        continue;
+                                    }
+                                    // Close the gap skipped repeats left, so the
+                                    // next fill cannot overwrite a kept candidate.
+                                    char* slot = candidates.Slot(count);
+                                    if (candidate.data() == candidates.Slot(filled + i) && candidate.data() != slot)
+                                    {
+                                        std::memcpy(slot, candidate.data(), candidate.size());
+                                        candidate = std::string_view(slot, candidate.size());
+                                    }
+                                    views[count] = candidate;
+                                    rejectedAt[count] = rejected;
+                                    positions[count++] = next;
+                                }
+                            }
+                            auto generated = std::chrono::steady_clock::now();
+                            generateNanos += NanosBetween(generating, generated);
+
+                            candidates.Resize(count);
+                            size_t hit = count == 0 ? Verifier::NoMatch : verifier->VerifyBatch(candidates, 0, count);
+                            while (hit != Verifier::NoMatch)
+                            {
+                                {
+                                    std::lock_guard lock(resultMutex);
+                                    for (size_t archive : archives.Open(candidates[hit]))
+                                    {
+                                        auto& outcome = result.archives[archive];
+                                        outcome.found = true;
+                                        outcome.password = candidates[hit];
+                                        outcome.origin = keyspace.Origin(positions[hit] - 1);
+                                    }
+                                }
+                                if (archives.AllOpen())
+                                {
+                                    Stop();
+                                    // Candidates skipped after the hit do not count as covered.
+                                    uint64_t skipped = (next - positions[hit]) - (count - hit - 1);
+                                    duplicates -= skipped - (rejected - rejectedAt[hit]);
+                                    rejected = rejectedAt[hit];
+                                    next = positions[hit];
+                                    break;
+                                }
+                                // Batch mode: the rest of the batch still goes
+                                // against the archives that are closed.
+                                size_t rest = hit + 1;
+                                hit = rest < count ? verifier->VerifyBatch(candidates, rest, count - rest) : Verifier::NoMatch;
+                            }
+                            verifyNanos += NanosBetween(generated, std::chrono::steady_clock::now());
+                            done += next - index;
+                            chunkDone += next - index;
+                            index = next;
+                            shares[id].chunkDone.store(chunkDone, std::memory_order_relaxed);
+                            progress[id].done.store(done, std::memory_order_relaxed);
+                            progress[id].generateNanos.store(generateNanos, std::memory_order_relaxed);
+                            progress[id].verifyNanos.store(verifyNanos, std::memory_order_relaxed);
+                        }
+                    }
+                    // The next chunk lasts about ChunkSeconds at this chunk's
+                    // rate, in whole batches.
+                    double seconds = static_cast<double>(generateNanos + verifyNanos - chunkStarted) / 1e9;
+                    double target = seconds > 0.0 ? static_cast<double>(chunkDone) / seconds * ChunkSeconds : 0.0;
+                    uint64_t batches = static_cast<uint64_t>(std::min(target, 1e12)) / batch;
+                    chunkSize = std::max<uint64_t>(batches, 1) * batch;
+                }
+                progress[id].duplicates = duplicates;
+                progress[id].rejected = rejected;
+            }
+            catch (...)
+            {
+                std::lock_guard lock(resultMutex);
+                if (!failure)
+                {
+                    failure = std::current_exception();
+                }
+                Stop();
+            }
+        };
+
+        // What has been tested: the resumed ranges plus each worker's
+        // finished chunks and the walked prefix of the one in hand.
+        auto snapshot = [&]()
+        {
+            RangeSet done = m_options.done;
+            for (auto& share : shares)
+            {
+                std::lock_guard lock(share.lock);
+                done.Add(share.finished);
+                done.Add(share.chunk.Slice(0, share.chunkDone.load(std::memory_order_relaxed)));
+            }
+            return done;
+        };
+
+        Project project;
+        project.archivePath = m_options.archivePath;
+        project.archiveSize = archives.Info(0).size;
+        project.rules = m_options.rules;
+        project.minLength = m_options.minLength;
+        project.maxLength = m_options.maxLength;
+        project.markovPath = m_options.markovPath;
+        project.threads = m_options.threads;
+        project.keyspaceSize = keyspace.Size();
+        auto save = [&]()
+        {
+            project.done = snapshot();
+            {
+                std::lock_guard lock(resultMutex);
+                if (result.archives[0].found)
+                {
+                    project.password = result.archives[0].password;
+                }
+            }
+            try
+            {
+                SaveProject(project, m_options.projectPath);
+            }
+            catch (const std::runtime_error& e)
+            {
+                std::lock_guard lock(resultMutex);
+                result.saveError = e.what();
+            }
+        };
+
+        uint64_t previousCovered = 0;
+        auto previousSample = std::chrono::steady_clock::now();
+        double rate = -1.0;
+        auto report = [&]()
+        {
+            EngineProgress sample;
+            uint64_t generateNanos = 0;
+            uint64_t verifyNanos = 0;
+            for (const auto& counters : progress)
+            {
+                sample.covered += counters.done.load(std::memory_order_relaxed);
+                generateNanos += counters.generateNanos.load(std::memory_order_relaxed);
+                verifyNanos += counters.verifyNanos.load(std::memory_order_relaxed);
+            }
+            auto now = std::chrono::steady_clock::now();
+            double interval = std::chrono::duration<double>(now - previousSample).count();
+            sample.paused = IsPaused();
+            // A pause keeps the last rate, so the ETA does not jump after it.
+            if (interval > 0.0 && !sample.paused)
+            {
+                // Exponential average whose weight follows the real interval,
+                // so late or missed samples do not skew it.
+                double instant = static_cast<double>(sample.covered - previousCovered) / interval;
+                rate = rate < 0.0 ? instant : rate + (1.0 - std::exp(-interval / RateSmoothingSeconds)) * (instant - rate);
+            }
+            previousCovered = sample.covered;
+            previousSample = now;
+
+            sample.done = m_options.done.Count() + sample.covered;
+            sample.keyspace = keyspace.Size();
+            sample.fraction = sample.keyspace == 0 ? 1.0 : static_cast<double>(sample.done) / static_cast<double>(sample.keyspace);
+            sample.rate = std::max(rate, 0.0);
+            sample.eta = sample.rate > 0.0 ? static_cast<double>(sample.keyspace - sample.done) / sample.rate : -1.0;
+            sample.seconds = std::chrono::duration<double>(now - started).count();
+            if (generateNanos + verifyNanos != 0)
+            {
+                sample.generateShare = static_cast<double>(generateNanos) / static_cast<double>(generateNanos + verifyNanos);
+                sample.verifyShare = 1.0 - sample.generateShare;
+            }
+            m_options.onProgress(sample);
+        };
+
+        // One thread does both low-frequency jobs: progress samples and
+        // checkpoints, each on its own schedule.
+        bool checkpoints = !m_options.projectPath.empty();
+        bool sampling = static_cast<bool>(m_options.onProgress);
+        std::mutex monitorMutex;
+        std::condition_variable monitorWake;
+        bool finished = false;
+        std::thread monitor;
+        if (checkpoints || sampling)
+        {
+            monitor = std::thread([&]
+            {
+                auto checkpointInterval = std::chrono::seconds(std::max<uint32_t>(m_options.checkpointSeconds, 1));
+                auto sampleInterval = std::chrono::milliseconds(std::max<uint32_t>(m_options.progressMilliseconds, 10));
+                auto nextCheckpoint = std::chrono::steady_clock::now() + checkpointInterval;
+                auto nextSample = std::chrono::steady_clock::now() + sampleInterval;
+                std::unique_lock lock(monitorMutex);
+                while (true)
+                {
+                    auto wake = sampling && (!checkpoints || nextSample < nextCheckpoint) ? nextSample : nextCheckpoint;
+                    if (monitorWake.wait_until(lock, wake, [&] { return finished; }))
+                    {
+                        break;
+                    }
+                    lock.unlock();
+                    auto now = std::chrono::steady_clock::now();
+                    if (sampling && now >= nextSample)
+                    {
+                        report();
+                        nextSample = now + sampleInterval;
+                    }
+                    if (checkpoints && now >= nextCheckpoint)
+                    {
+                        save();
+                        nextCheckpoint = now + checkpointInterval;
+                    }
+                    lock.lock();
+                }
+            });
+        }
+
+        std::vector<std::thread> workers;
+        for (uint32_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back(worker, i);
+        }
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+        if (monitor.joinable())
+        {
+            {
+                std::lock_guard lock(monitorMutex);
+                finished = true;
+            }
+            monitorWake.notify_one();
+            monitor.join();
+            if (checkpoints)
+            {
+                save();
+            }
+            if (sampling)
+            {
+                report();
+            }
+        }
+
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+
+        auto first = std::find_if(result.archives.begin(), result.archives.end(),
+            [](const ArchiveOutcome& outcome) { return outcome.found; });
+        if (first != result.archives.end())
+        {
+            result.password = first->password;
+            result.origin = first->origin;
+        }
+        result.found = archives.AllOpen();
+        result.done = snapshot();
+        result.stopped = !result.found && result.done.Count() < keyspace.Size();
+        result.tested = result.done.Count() - m_options.done.Count();
+        for (const auto& counters : progress)
+        {
+            result.duplicates += counters.duplicates;
+            result.rejected += counters.rejected;
+        }
+        result.tested -= result.duplicates + result.rejected;
+        if (filter)
+        {
+            result.filterBytes = filter->Bytes();
+            result.filterHashes = filter->HashCount();
+            result.filterFalsePositives = filter->FalsePositiveRate(result.tested);
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+}
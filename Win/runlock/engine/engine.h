@@ -0,0 +1,177 @@
+#pragma once
+
+#include "range_set.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace runlock::engine
+{
+    class ArchiveBatch;
+    class Keyspace;
+    struct EngineSetup;
+
+    // A sample of a running Engine, taken every progressMilliseconds.
+    struct EngineProgress
+    {
+        uint64_t covered = 0;           // keyspace indexes this run got through (skipped repeats included)
+        uint64_t done = 0;              // the same with earlier runs' ranges
+        uint64_t keyspace = 0;
+        double fraction = 0.0;          // done / keyspace
+        double rate = 0.0;              // candidates per second, smoothed over about ten seconds
+        double eta = -1.0;              // seconds to exhaust the keyspace at that rate; < 0 while unknown
+        double seconds = 0.0;           // since Run() started
+        double generateShare = 0.0;     // of worker time: producing candidates (and the duplicate filter)
+        double verifyShare = 0.0;       // of worker time: the verifiers (key derivation, checks, UnRAR)
+        bool paused = false;
+    };
+
+    struct EngineOptions
+    {
+        std::string archivePath;
+        std::vector<std::string> batchPaths;    // more archives tried with the same candidates (batch mode)
+        std::string rules;          // PasswordRulesBox text
+        uint32_t minLength = 0;     // MinLengthBox, 0 = no bound
+        uint32_t maxLength = 0;     // MaxLengthBox, 0 = no bound
+        uint32_t threads = 0;       // CpuCoresComboBox, 0 = all hardware threads (or cores)
+        bool physicalCores = false; // leave SMT siblings idle: at most one worker per core
+        bool pinThreads = false;    // bind each worker to its processor (CpuTopology::Place)
+        std::string markovPath;     // password sample that orders masks likeliest-first, empty = lexicographic
+
+        RangeSet done;              // candidates tested by an earlier run (LoadProject)
+        uint64_t keyspaceSize = 0;  // keyspace `done` was counted in (Project::keyspaceSize), 0 = unknown
+        std::string projectPath;    // checkpoint file written during the run, empty = none
+        uint32_t checkpointSeconds = 30;
+
+        uint32_t dedupMegabytes = 0;    // duplicate filter budget, 0 = test repeats again
+
+        // Rules and archives compiled ahead by EngineSetup::Create for these
+        // same options, instead of again in Run(); null = compile them.
+        std::shared_ptr<EngineSetup> setup;
+
+        // Called from the engine's monitor thread, never from a worker, and
+        // once more when the run ends. Must not block for long.
+        std::function<void(const EngineProgress&)> onProgress;
+        uint32_t progressMilliseconds = 500;
+    };
+
+    // What a run found for one of its archives.
+    struct ArchiveOutcome
+    {
+        std::string path;
+        bool found = false;
+        std::string password;
+        std::string origin;
+    };
+
+    struct EngineResult
+    {
+        bool found = false;         // every archive opened
+        bool stopped = false;       // Stop() ended the run before the keyspace did
+        std::string password;       // of the first archive opened, in the order given
+        std::string origin;         // Keyspace::Origin of the password, e.g. its word list line
+        std::vector<ArchiveOutcome> archives;   // archivePath, then batchPaths
+        uint64_t tested = 0;
+        uint64_t keyspace = 0;
+        std::string verification;   // which check rejected the candidates
+        double seconds = 0.0;
+        RangeSet done;              // every candidate tested so far, earlier runs included
+        std::string saveError;      // last failure to write the project file, if any
+
+        uint64_t duplicates = 0;    // candidates skipped by the duplicate filter
+        uint64_t rejected = 0;      // mutated or combined candidates the constraints ruled out
+        size_t filterBytes = 0;     // 0 when no filter was used
+        unsigned filterHashes = 0;
+        double filterFalsePositives = 0.0;  // estimated chance a skipped candidate was new
+    };
+
+    // What Engine::Run() builds before it tests anything: the keyspace of
+    // the rules (word list scans and Markov training included) and the
+    // inspected archives. Runs over further ranges of one job, a cluster
+    // worker's leases, share one through EngineOptions::setup; they must
+    // not overlap, since an archive one of them opens stays open.
+    struct EngineSetup
+    {
+        // Throws as Engine::Run() does for bad rules or archives.
+        static std::shared_ptr<EngineSetup> Create(const EngineOptions& options);
+        ~EngineSetup();
+
+        std::unique_ptr<const Keyspace> keyspace;
+        std::unique_ptr<ArchiveBatch> archives;
+    };
+
+    // Number of workers actually started for a requested count.
+    uint32_t ResolveThreadCount(uint32_t requested, bool physicalCores = false);
+
+    // Start of part `part` when [0, size) is cut into `parts` near-equal ranges.
+    uint64_t PartitionStart(uint64_t size, uint32_t parts, uint32_t part);
+
+    // UI-independent recovery run: opens the archive, compiles the rules and
+    // verifies candidates on a pool of worker threads until a password is
+    // found, the keyspace is exhausted or Stop() is called.
+    //
+    // Each worker starts with an equal share of the untested keyspace and
+    // takes it in chunks sized to about ChunkSeconds of its own measured
+    // rate, so a slow core holds little work at a time. A worker whose
+    // share runs out takes the back half of the largest share left, which
+    // keeps every core busy until the last chunks and evens out hybrid
+    // CPUs, SMT siblings and other load. With pinThreads each worker is
+    // bound to its processor before it allocates its buffers and verifier,
+    // so on NUMA systems that memory comes from its own node.
+    //
+    // Workers publish how far they got through their chunk, and how long
+    // they spent generating and verifying, with relaxed stores to counters
+    // on their own cache lines once per batch; the share's lock is taken
+    // once per chunk. A monitor thread reads them: every
+    // progressMilliseconds it sums them into an EngineProgress for
+    // onProgress, and with a project path it turns them into a Project every
+    // checkpointSeconds (and once more at the end). A crash repeats at most
+    // the candidates of one interval.
+    //
+    // Batch mode (batchPaths) walks the keyspace once for all archives,
+    // deriving each candidate's key once per group of archives that share
+    // salt and iteration count (ArchiveBatch), and ends when every archive
+    // is open or the keyspace is exhausted. It keeps no project: a project
+    // describes one archive.
+    //
+    // With dedupMegabytes set and rules that can produce a candidate more
+    // than once (several rules, or a word list), every candidate passes
+    // through a shared CandidateFilter first and repeats are not verified
+    // again. The filter is not saved with the project, so a resumed run
+    // only skips repeats of what it tested itself.
+    class Engine
+    {
+    public:
+        explicit Engine(EngineOptions options);
+
+        // Blocks until the run ends. Throws RuleError for bad rules and
+        // std::runtime_error if the archive cannot be opened or has nothing
+        // encrypted to test.
+        EngineResult Run();
+
+        // Run control, safe to call from any thread and before or after
+        // Run(). Workers look at the state once per batch: Pause() parks
+        // them on the state word itself (futex / WaitOnAddress through
+        // std::atomic::wait, no spinning) after their current batch,
+        // Resume() wakes them where they left off, and Stop() makes Run()
+        // return once the batches in flight are verified, with exactly those
+        // ranges in EngineResult::done. Stopping is final.
+        void Pause();
+        void Resume();
+        void Stop();
+        bool IsPaused() const { return m_state.load(std::memory_order_relaxed) == RunState::Paused; }
+
+    private:
+        enum class RunState : uint32_t { Running, Paused, Stopped };
+
+        // Waits out a pause; false once the run is stopping.
+        bool Proceed();
+
+        EngineOptions m_options;
+        std::atomic<RunState> m_state{ RunState::Running };
+    };
+}
@@ -0,0 +1,94 @@
+#include "generator.h"
+#include "candidate_file.h"
+#include "markov.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Indexes the preview walks at most looking for candidates that
+        // are not rejected.
+        constexpr uint64_t PreviewScan = 1 << 20;
+
+        Keyspace CompileRules(const GeneratorOptions& options)
+        {
+            KeyspaceOptions keyspaceOptions;
+            keyspaceOptions.minLength = options.minLength;
+            keyspaceOptions.maxLength = options.maxLength;
+            if (!options.markovPath.empty())
+            {
+                keyspaceOptions.order = MarkovModel::Train(options.markovPath);
+            }
+            return Keyspace::Compile(options.rules, keyspaceOptions);
+        }
+    }
+
+    Generator::Generator(GeneratorOptions options)
+        : m_options(std::move(options))
+        , m_keyspace(CompileRules(m_options))
+    {
+    }
+
+    GeneratorResult Generator::Run()
+    {
+        auto started = std::chrono::steady_clock::now();
+        GeneratorResult result;
+        result.total = m_keyspace.Size();
+        std::vector<char> buffer(std::max<size_t>(m_keyspace.MaxBytes(), 1));
+
+        // Rejected candidates are skipped, so a preview of mostly rejected
+        // output looks only so far ahead.
+        size_t previewed = 0;
+        uint64_t scan = std::min<uint64_t>(result.total, std::max<uint64_t>(m_options.previewCount, PreviewScan));
+        if (m_options.onPreview && m_options.previewCount != 0)
+        {
+            m_keyspace.ForEach(0, scan, buffer.data(), [&](std::string_view candidate)
+            {
+                if (!Segment::Rejected(candidate))
+                {
+                    m_options.onPreview(candidate);
+                    ++previewed;
+                }
+                return previewed < m_options.previewCount;
+            });
+        }
+
+        if (!m_options.outputPath.empty())
+        {
+            CandidateFileWriter writer(m_options.outputPath, m_options.blockBytes);
+            bool finished = m_cancelled.load(std::memory_order_relaxed) ? false
+                : m_keyspace.ForEach(0, result.total, buffer.data(), [&](std::string_view candidate)
+                {
+                    if (Segment::Rejected(candidate) || !writer.Add(candidate))
+                    {
+                        return true;
+                    }
+                    if (m_options.onProgress)
+                    {
+                        m_options.onProgress(writer.Count(), result.total);
+                    }
+                    return !m_cancelled.load(std::memory_order_relaxed);
+                });
+
+            // A cancelled list keeps its whole blocks but no end marker.
+            result.cancelled = !finished;
+            if (finished)
+            {
+                writer.Finish();
+                if (m_options.onProgress)
+                {
+                    m_options.onProgress(writer.Count(), result.total);
+                }
+            }
+            result.written = writer.Count();
+            result.bytes = writer.Bytes();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "keyspace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace runlock::engine
+{
+    struct GeneratorOptions
+    {
+        std::string rules;          // PasswordRulesBox text
+        uint32_t minLength = 0;
+        uint32_t maxLength = 0;
+        std::string markovPath;     // same ordering as the Engine would use
+
+        std::string outputPath;     // candidate list to write (CandidateFileWriter), empty = preview only
+        uint32_t blockBytes = 1 << 20;  // spill block size, which is also the memory ceiling
+
+        // The first previewCount candidates, in order, before anything is
+        // written.
+        size_t previewCount = 20;
+        std::function<void(std::string_view)> onPreview;
+
+        // After every block written, with the candidates written so far.
+        std::function<void(uint64_t written, uint64_t total)> onProgress;
+    };
+
+    struct GeneratorResult
+    {
+        uint64_t total = 0;         // keyspace size, rejected candidates included
+        uint64_t written = 0;       // candidates in the output file
+        uint64_t bytes = 0;         // its size
+        bool cancelled = false;
+        double seconds = 0.0;
+    };
+
+    // "Generate Passwords": compiles the rules up front, so the exact
+    // candidate count (an upper bound when MayReject()) is known before a
+    // single candidate is produced, then previews the first ones and, given
+    // an output path, writes the whole keyspace as a compressed candidate
+    // list. Memory stays at one block
+    // however large the keyspace is; Cancel() is seen after the current
+    // block at the latest, leaving a file of whole blocks.
+    class Generator
+    {
+    public:
+        // Throws RuleError for bad rules and std::runtime_error for an
+        // unreadable word list or password sample.
+        explicit Generator(GeneratorOptions options);
+
+        uint64_t Count() const { return m_keyspace.Size(); }
+
+        // True when Count() is an upper bound: constraints rule out some
+        // mutated or combined candidates, which are not written.
+        bool MayReject() const { return m_keyspace.MayReject(); }
+
+        // Blocks until the list is written or cancelled. Throws
+        // std::runtime_error when the output cannot be written.
+        GeneratorResult Run();
+
+        // Safe to call from any thread, before or during Run().
+        void Cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+    private:
+        GeneratorOptions m_options;
+        Keyspace m_keyspace;
+        std::atomic<bool> m_cancelled{ false };
+    };
+}
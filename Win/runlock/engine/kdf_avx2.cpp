@@ -0,0 +1,57 @@
+#include "kdf_kernels.h"
+#include "sha1.h"
+#include "sha256.h"
+
+#ifdef RUNLOCK_X86
+
+#include <immintrin.h>
+#include <cstring>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr size_t Lanes = Avx2Lanes;
+        using Vec = __m256i;
+
+        inline Vec Set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+        inline Vec Add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+        inline Vec Xor(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+        inline Vec Xor3(Vec a, Vec b, Vec c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+        inline Vec Ch(Vec e, Vec f, Vec g) { return _mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g))); }
+        inline Vec Maj(Vec a, Vec b, Vec c) { return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))); }
+        template<int N> Vec Rotr(Vec x) { return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N)); }
+        template<int N> Vec Shr(Vec x) { return _mm256_srli_epi32(x, N); }
+        inline Vec Load(const uint32_t* p) { return _mm256_load_si256(reinterpret_cast<const Vec*>(p)); }
+        inline void Store(uint32_t* p, Vec v) { _mm256_store_si256(reinterpret_cast<Vec*>(p), v); }
+
+#include "rar3_kdf_lanes.inl"
+#include "rar5_kdf_lanes.inl"
+    }
+
+    void DeriveRar5KeysAvx2(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out)
+    {
+        DeriveRar5Lanes(keys, salt, lg2Count, out);
+    }
+
+    void DeriveRar3KeysAvx2(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out)
+    {
+        DeriveRar3Lanes(passwords, size, salt, out);
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
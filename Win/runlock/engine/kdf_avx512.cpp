@@ -0,0 +1,66 @@
+#include "kdf_kernels.h"
+#include "sha1.h"
+#include "sha256.h"
+
+#ifdef RUNLOCK_X86
+
+#include <immintrin.h>
+#include <cstring>
+
+// GCC 12 flags the deliberately undefined pass-through operand of the
+// unmasked AVX-512 intrinsics as uninitialized.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr size_t Lanes = Avx512Lanes;
+        using Vec = __m512i;
+
+        // Ternary logic immediates: 0x96 = a ^ b ^ c, 0xCA = a ? b : c,
+        // 0xE8 = majority.
+        inline Vec Set1(uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+        inline Vec Add(Vec a, Vec b) { return _mm512_add_epi32(a, b); }
+        inline Vec Xor(Vec a, Vec b) { return _mm512_xor_si512(a, b); }
+        inline Vec Xor3(Vec a, Vec b, Vec c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+        inline Vec Ch(Vec e, Vec f, Vec g) { return _mm512_ternarylogic_epi32(e, f, g, 0xCA); }
+        inline Vec Maj(Vec a, Vec b, Vec c) { return _mm512_ternarylogic_epi32(a, b, c, 0xE8); }
+        template<int N> Vec Rotr(Vec x) { return _mm512_ror_epi32(x, N); }
+        template<int N> Vec Shr(Vec x) { return _mm512_srli_epi32(x, N); }
+        inline Vec Load(const uint32_t* p) { return _mm512_load_si512(p); }
+        inline void Store(uint32_t* p, Vec v) { _mm512_store_si512(p, v); }
+
+#include "rar3_kdf_lanes.inl"
+#include "rar5_kdf_lanes.inl"
+    }
+
+    void DeriveRar5KeysAvx512(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out)
+    {
+        DeriveRar5Lanes(keys, salt, lg2Count, out);
+    }
+
+    void DeriveRar3KeysAvx512(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out)
+    {
+        DeriveRar3Lanes(passwords, size, salt, out);
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
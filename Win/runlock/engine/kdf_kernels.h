@@ -0,0 +1,102 @@
+#pragma once
+
+#include "cpu_features.h"
+#include "rar3_kdf.h"
+#include "rar5_kdf.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Length in bits of every message after U1: a 32-byte digest following
+    // the 64-byte HMAC pad block, so words 8..15 of its block are constant.
+    constexpr uint32_t Rar5DigestBlockBits = (64 + 32) * 8;
+
+    // RAR5 runs PBKDF2 on past the key to get the hash key and check value:
+    // stage 0 ends after 2^lg2Count iterations, stages 1 and 2 add 16 each.
+    inline uint32_t Rar5StageIterations(uint32_t lg2Count, int stage)
+    {
+        return stage == 0 ? (1u << lg2Count) - 1 : 16;
+    }
+
+    inline uint8_t* Rar5StageOutput(Rar5Keys& keys, int stage)
+    {
+        return stage == 0 ? keys.key : stage == 1 ? keys.hashKey : keys.checkValue;
+    }
+
+    // U1 = HMAC(P, salt || INT(1)), the one PBKDF2 step that is not a
+    // 32-byte digest block; the kernels run it per lane before their loop.
+    void Rar5FirstIteration(const HmacSha256Key& key, const uint8_t salt[Rar5SaltSize], uint32_t u[8]);
+
+    void DeriveRar5KeysScalar(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out);
+    void DeriveRar3KeysScalar(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out);
+
+#ifdef RUNLOCK_X86
+    constexpr size_t Avx2Lanes = 8;
+    constexpr size_t Avx512Lanes = 16;
+    constexpr size_t ShaNiLanes = 4;
+
+    void DeriveRar5KeysAvx2(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out);
+    void DeriveRar5KeysAvx512(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out);
+    void DeriveRar5KeysShaNi(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out);
+
+    void DeriveRar3KeysAvx2(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out);
+    void DeriveRar3KeysAvx512(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out);
+#endif
+
+    // Candidates per second of run(), which derives `lanes` candidates per
+    // call, measured over at least one call and minSeconds.
+    template<typename Run>
+    double MeasureThroughput(size_t lanes, double minSeconds, Run&& run)
+    {
+        using Clock = std::chrono::steady_clock;
+        auto started = Clock::now();
+        double seconds = 0;
+        size_t runs = 0;
+        do
+        {
+            run();
+            ++runs;
+            seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        } while (seconds < minSeconds);
+        return runs * lanes / seconds;
+    }
+
+    // Shared selection policy: the kernel named by RUNLOCK_KDF when this
+    // family has one by that name, otherwise the highest measure() (which
+    // returns 0 for a kernel whose output disagrees with the portable one).
+    template<typename Kernel, typename Measure>
+    const Kernel& ChooseKernel(const std::vector<const Kernel*>& kernels, Measure&& measure)
+    {
+        if (const char* env = std::getenv("RUNLOCK_KDF"); env != nullptr && *env != '\0')
+        {
+            for (auto kernel : kernels)
+            {
+                if (std::strcmp(kernel->name, env) == 0)
+                {
+                    return *kernel;
+                }
+            }
+        }
+
+        const Kernel* best = kernels.front();
+        double bestRate = 0;
+        for (auto kernel : kernels)
+        {
+            double rate = measure(*kernel);
+            if (rate > bestRate)
+            {
+                best = kernel;
+                bestRate = rate;
+            }
+        }
+        return *best;
+    }
+}
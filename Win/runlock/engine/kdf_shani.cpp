@@ -0,0 +1,127 @@
+#include "kdf_kernels.h"
+#include "sha256.h"
+
+#ifdef RUNLOCK_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sha,sse4.1,ssse3"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sha,sse4.1,ssse3")
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // The SHA instructions keep the state as ABEF / CDGH word pairs.
+        struct PackedState
+        {
+            __m128i abef;
+            __m128i cdgh;
+        };
+
+        PackedState Pack(const uint32_t state[8])
+        {
+            __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+            __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+            __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+            __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+            return { _mm_alignr_epi8(cdab, efgh, 8), _mm_blend_epi16(efgh, cdab, 0xF0) };
+        }
+
+        // Compresses eight digest words (as DCBA / HGFE vectors, the order
+        // the result comes back in) plus the constant padding, starting from
+        // init; returns the new digest in the same order.
+        inline void CompressDigestBlock(const PackedState& init, __m128i& dcba, __m128i& hgfe)
+        {
+            __m128i msg[4] = { dcba, hgfe, _mm_set_epi32(0, 0, 0, static_cast<int>(0x80000000)),
+                _mm_set_epi32(static_cast<int>(Rar5DigestBlockBits), 0, 0, 0) };
+            __m128i state0 = init.abef;
+            __m128i state1 = init.cdgh;
+#if defined(__GNUC__)
+#pragma GCC unroll 16
+#endif
+            for (int g = 0; g < 16; ++g)
+            {
+                __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Sha256RoundConstants + g * 4));
+                __m128i current = msg[g & 3];
+                __m128i wk = _mm_add_epi32(current, k);
+                state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+                if (g >= 3 && g <= 14)
+                {
+                    __m128i& next = msg[(g + 1) & 3];
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(current, msg[(g + 3) & 3], 4));
+                    next = _mm_sha256msg2_epu32(next, current);
+                }
+                wk = _mm_shuffle_epi32(wk, 0x0E);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+                if (g >= 1 && g <= 12)
+                {
+                    __m128i& previous = msg[(g - 1) & 3];
+                    previous = _mm_sha256msg1_epu32(previous, current);
+                }
+            }
+            state0 = _mm_add_epi32(state0, init.abef);
+            state1 = _mm_add_epi32(state1, init.cdgh);
+
+            __m128i feba = _mm_shuffle_epi32(state0, 0x1B);
+            __m128i dchg = _mm_shuffle_epi32(state1, 0xB1);
+            dcba = _mm_blend_epi16(feba, dchg, 0xF0);
+            hgfe = _mm_alignr_epi8(dchg, feba, 8);
+        }
+    }
+
+    // One stream per lane, advanced in lockstep so the independent
+    // dependency chains overlap in the SHA units.
+    void DeriveRar5KeysShaNi(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out)
+    {
+        constexpr size_t Lanes = ShaNiLanes;
+        PackedState inner[Lanes], outer[Lanes];
+        __m128i u[Lanes][2], fn[Lanes][2];
+        for (size_t i = 0; i < Lanes; ++i)
+        {
+            inner[i] = Pack(keys[i].inner);
+            outer[i] = Pack(keys[i].outer);
+            uint32_t first[8];
+            Rar5FirstIteration(keys[i], salt, first);
+            u[i][0] = fn[i][0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            u[i][1] = fn[i][1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 4));
+        }
+
+        for (int stage = 0; stage < 3; ++stage)
+        {
+            for (uint32_t n = Rar5StageIterations(lg2Count, stage); n != 0; --n)
+            {
+                for (size_t i = 0; i < Lanes; ++i)
+                {
+                    CompressDigestBlock(inner[i], u[i][0], u[i][1]);
+                }
+                for (size_t i = 0; i < Lanes; ++i)
+                {
+                    CompressDigestBlock(outer[i], u[i][0], u[i][1]);
+                    fn[i][0] = _mm_xor_si128(fn[i][0], u[i][0]);
+                    fn[i][1] = _mm_xor_si128(fn[i][1], u[i][1]);
+                }
+            }
+            for (size_t i = 0; i < Lanes; ++i)
+            {
+                uint32_t state[8];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(state), fn[i][0]);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), fn[i][1]);
+                Sha256Store(state, Rar5StageOutput(out[i], stage));
+            }
+        }
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
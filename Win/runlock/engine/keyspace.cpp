@@ -0,0 +1,1365 @@
+#include "keyspace.h"
+#include "combinator.h"
+#include "markov.h"
+#include "mask_kernels.h"
+#include "mutation.h"
+#include "text.h"
+#include "wordlist.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <unordered_set>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Longest candidate a mask may describe; RAR itself stops at 127 characters.
+        constexpr size_t MaxPositions = 128;
+        constexpr char32_t MaxRangeSpan = 0x10000;
+
+        struct Symbol
+        {
+            char bytes[4];
+            uint8_t size;
+        };
+
+        using Charset = std::vector<Symbol>;
+
+        bool MultiplyChecked(uint64_t a, uint64_t b, uint64_t& product)
+        {
+            if (a != 0 && b > UINT64_MAX / a)
+            {
+                return false;
+            }
+            product = a * b;
+            return true;
+        }
+
+        size_t WidestBytes(const std::vector<Charset>& positions)
+        {
+            size_t bytes = 0;
+            for (const auto& charset : positions)
+            {
+                uint8_t widest = 0;
+                for (const auto& symbol : charset)
+                {
+                    widest = std::max(widest, symbol.size);
+                }
+                bytes += widest;
+            }
+            return bytes;
+        }
+
+        // Mixed-radix space: one digit per position, the last position varying
+        // fastest, so consecutive indexes are lexicographic neighbours.
+        class MaskSegment : public Segment
+        {
+        public:
+            MaskSegment(std::vector<Charset> positions, uint64_t size)
+                : m_positions(std::move(positions))
+                , m_size(size)
+                , m_maxBytes(WidestBytes(m_positions))
+            {
+                // Single-byte masks get a fill kernel; the byte strings are its tables.
+                if (m_maxBytes == m_positions.size())
+                {
+                    for (const auto& charset : m_positions)
+                    {
+                        std::string& bytes = m_bytes.emplace_back();
+                        for (const auto& symbol : charset)
+                        {
+                            bytes += symbol.bytes[0];
+                        }
+                    }
+                    m_fill = SelectMaskFill(m_bytes.size(), m_bytes.back());
+                }
+            }
+
+            uint64_t Size() const override { return m_size; }
+            size_t MaxBytes() const override { return m_maxBytes; }
+            bool Distinct() const override { return true; }     // charsets have no repeats
+
+            size_t Generate(uint64_t index, char* out) const override
+            {
+                uint32_t digits[MaxPositions];
+                for (size_t i = m_positions.size(); i-- > 0;)
+                {
+                    uint64_t radix = m_positions[i].size();
+                    digits[i] = static_cast<uint32_t>(index % radix);
+                    index /= radix;
+                }
+
+                char* cursor = out;
+                for (size_t i = 0; i < m_positions.size(); ++i)
+                {
+                    const Symbol& symbol = m_positions[i][digits[i]];
+                    std::memcpy(cursor, symbol.bytes, symbol.size);
+                    cursor += symbol.size;
+                }
+                return static_cast<size_t>(cursor - out);
+            }
+
+            void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const override
+            {
+                if (m_fill == nullptr)
+                {
+                    Segment::Fill(first, count, out, stride, views);
+                    return;
+                }
+                m_fill(m_bytes.data(), first, count, out, stride);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    views[i] = std::string_view(out + i * stride, m_bytes.size());
+                }
+            }
+
+        private:
+            std::vector<Charset> m_positions;
+            uint64_t m_size;
+            size_t m_maxBytes;
+            std::vector<std::string> m_bytes;   // per position, when every symbol is one byte
+            MaskFill m_fill = nullptr;
+        };
+
+        // The same candidates as MaskSegment, likeliest first. Each position
+        // ranks its characters by how often they followed the previous
+        // position's character in the model's sample, so a candidate is a
+        // rank per position. The space is walked in shells of growing rank
+        // limits: shell k holds the candidates whose highest rank lies in
+        // [limit(k-1), limit(k)), so every candidate made only of top-ranked
+        // characters comes before any that needs a rarer one. Within a shell,
+        // part j holds those whose first position at or above the lower limit
+        // is j; each part is a plain mixed-radix block, which keeps the space
+        // dense and index-addressable.
+        class OrderedMaskSegment : public Segment
+        {
+        public:
+            OrderedMaskSegment(std::vector<Charset> positions, uint64_t size, const MarkovModel& model)
+                : m_positions(std::move(positions))
+                , m_size(size)
+                , m_maxBytes(WidestBytes(m_positions))
+            {
+                RankCharacters(model);
+                BuildShells();
+            }
+
+            uint64_t Size() const override { return m_size; }
+            size_t MaxBytes() const override { return m_maxBytes; }
+            bool Distinct() const override { return true; }
+
+            size_t Generate(uint64_t index, char* out) const override
+            {
+                auto shell = std::upper_bound(m_shells.begin(), m_shells.end(), index,
+                    [](uint64_t value, const Shell& s) { return value < s.parts.back(); });
+                auto part = std::upper_bound(shell->parts.begin(), shell->parts.end(), index);
+                size_t first = static_cast<size_t>(part - shell->parts.begin());
+                index -= first == 0 ? shell->begin : shell->parts[first - 1];
+
+                uint32_t ranks[MaxPositions];
+                for (size_t i = m_positions.size(); i-- > 0;)
+                {
+                    uint64_t low = std::min<uint64_t>(shell->low, m_positions[i].size());
+                    uint64_t radix = Radix(i, first, shell->low, shell->high);
+                    ranks[i] = static_cast<uint32_t>(index % radix + (i == first ? low : 0));
+                    index /= radix;
+                }
+
+                char* cursor = out;
+                uint32_t previous = 0;
+                for (size_t i = 0; i < m_positions.size(); ++i)
+                {
+                    const Position& position = m_ranked[i];
+                    uint32_t row = position.conditioned ? previous : 0;
+                    previous = position.order[static_cast<size_t>(row) * m_positions[i].size() + ranks[i]];
+                    const Symbol& symbol = m_positions[i][previous];
+                    std::memcpy(cursor, symbol.bytes, symbol.size);
+                    cursor += symbol.size;
+                }
+                return static_cast<size_t>(cursor - out);
+            }
+
+        private:
+            // Above this many (previous, next) pairs a position is ranked on
+            // its own character counts instead, e.g. for wide Unicode classes.
+            static constexpr size_t MaxPairTable = 1 << 20;
+
+            struct Position
+            {
+                bool conditioned = false;
+                // Row r lists the charset indexes by rank after the previous
+                // position produced its r-th character (one row if unconditioned).
+                std::vector<uint32_t> order;
+            };
+
+            struct Shell
+            {
+                uint64_t begin;
+                uint32_t low;                   // ranks below this were in earlier shells
+                uint32_t high;                  // and ranks from this on in later ones
+                std::vector<uint64_t> parts;    // end index of part j
+            };
+
+            static unsigned ByteOf(const Symbol& symbol)
+            {
+                return symbol.size == 1 ? static_cast<uint8_t>(symbol.bytes[0]) : MarkovModel::Start;
+            }
+
+            void RankCharacters(const MarkovModel& model)
+            {
+                m_ranked.resize(m_positions.size());
+                for (size_t i = 0; i < m_positions.size(); ++i)
+                {
+                    const Charset& charset = m_positions[i];
+                    Position& position = m_ranked[i];
+                    position.conditioned = i > 0 && m_positions[i - 1].size() * charset.size() <= MaxPairTable;
+                    size_t rows = position.conditioned ? m_positions[i - 1].size() : 1;
+                    for (size_t row = 0; row < rows; ++row)
+                    {
+                        unsigned previous = position.conditioned ? ByteOf(m_positions[i - 1][row]) : MarkovModel::Start;
+                        size_t base = position.order.size();
+                        for (uint32_t c = 0; c < charset.size(); ++c)
+                        {
+                            position.order.push_back(c);
+                        }
+                        // Unknown bytes (non-ASCII symbols) score zero and
+                        // keep their rule order behind the known ones.
+                        auto score = [&](uint32_t c)
+                        {
+                            unsigned byte = ByteOf(charset[c]);
+                            return byte == MarkovModel::Start
+                                ? std::pair<uint64_t, uint64_t>(0, 0)
+                                : std::pair(i > 0 && !position.conditioned ? 0 : model.Pair(previous, static_cast<uint8_t>(byte)),
+                                    model.Single(static_cast<uint8_t>(byte)));
+                        };
+                        std::stable_sort(position.order.begin() + base, position.order.end(),
+                            [&](uint32_t a, uint32_t b) { return score(a) > score(b); });
+                    }
+                }
+            }
+
+            uint64_t Radix(size_t i, size_t first, uint32_t low, uint32_t high) const
+            {
+                uint64_t size = m_positions[i].size();
+                if (i < first)
+                {
+                    return std::min<uint64_t>(low, size);
+                }
+                if (i == first)
+                {
+                    return std::min<uint64_t>(high, size) - std::min<uint64_t>(low, size);
+                }
+                return std::min<uint64_t>(high, size);
+            }
+
+            void BuildShells()
+            {
+                uint32_t widest = 0;
+                for (const auto& charset : m_positions)
+                {
+                    widest = std::max(widest, static_cast<uint32_t>(charset.size()));
+                }
+                // Limits grow by half each time: 1, 2, 3, 4, 6, 9, 13, ...
+                uint64_t end = 0;
+                for (uint32_t low = 0, high = 1; low < widest; low = high, high = std::max(high + 1, high + high / 2))
+                {
+                    Shell shell{ end, low, std::min(high, widest), {} };
+                    for (size_t first = 0; first < m_positions.size(); ++first)
+                    {
+                        uint64_t count = 1;
+                        for (size_t i = 0; i < m_positions.size() && count != 0; ++i)
+                        {
+                            count *= Radix(i, first, shell.low, shell.high);
+                        }
+                        end += count;
+                        shell.parts.push_back(end);
+                    }
+                    if (end != shell.begin)
+                    {
+                        m_shells.push_back(std::move(shell));
+                    }
+                }
+            }
+
+            std::vector<Charset> m_positions;
+            uint64_t m_size;
+            size_t m_maxBytes;
+            std::vector<Position> m_ranked;
+            std::vector<Shell> m_shells;
+        };
+
+        // A run of consecutive literal lines, kept as one segment so pasted
+        // word lists do not cost a segment (and a binary search step) per word.
+        class WordSegment : public Segment
+        {
+        public:
+            void Add(std::string word)
+            {
+                m_maxBytes = std::max(m_maxBytes, word.size());
+                m_words.push_back(std::move(word));
+            }
+
+            bool Empty() const { return m_words.empty(); }
+
+            uint64_t Size() const override { return m_words.size(); }
+            size_t MaxBytes() const override { return m_maxBytes; }
+            bool Distinct() const override { return m_words.size() < 2; }
+
+            size_t Generate(uint64_t index, char* out) const override
+            {
+                const std::string& word = m_words[static_cast<size_t>(index)];
+                std::memcpy(out, word.data(), word.size());
+                return word.size();
+            }
+
+        private:
+            std::vector<std::string> m_words;
+            size_t m_maxBytes = 0;
+        };
+
+        // Mutated or combined output under the constraints in force for its
+        // rule: every index stays, and the candidates the constraints rule
+        // out come out as rejected views.
+        class FilteredSegment : public Segment
+        {
+        public:
+            FilteredSegment(std::unique_ptr<Segment> output, const Constraints& constraints)
+                : m_output(std::move(output))
+                , m_constraints(constraints)
+            {
+            }
+
+            uint64_t Size() const override { return m_output->Size(); }
+            size_t MaxBytes() const override { return m_output->MaxBytes(); }
+            bool Distinct() const override { return m_output->Distinct(); }
+            bool MayReject() const override { return true; }
+            std::string Origin(uint64_t index) const override { return m_output->Origin(index); }
+
+            size_t Generate(uint64_t index, char* out) const override
+            {
+                return m_output->Generate(index, out);
+            }
+
+            std::string_view View(uint64_t index, char* out) const override
+            {
+                return Filter(m_output->View(index, out));
+            }
+
+            void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const override
+            {
+                m_output->Fill(first, count, out, stride, views);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    views[i] = Filter(views[i]);
+                }
+            }
+
+            bool ForEach(uint64_t first, uint64_t last, char* out,
+                const std::function<bool(std::string_view)>& visit) const override
+            {
+                return m_output->ForEach(first, last, out,
+                    [&](std::string_view candidate) { return visit(Filter(candidate)); });
+            }
+
+        private:
+            std::string_view Filter(std::string_view candidate) const
+            {
+                return m_constraints.Accepts(candidate) ? candidate : std::string_view();
+            }
+
+            std::unique_ptr<Segment> m_output;
+            Constraints m_constraints;
+        };
+
+        char32_t CodePoint(const Symbol& symbol)
+        {
+            size_t pos = 0;
+            return DecodeUtf8(std::string_view(symbol.bytes, symbol.size), pos);
+        }
+
+        std::u32string CodePoints(std::string_view text)
+        {
+            std::u32string points;
+            for (size_t pos = 0; pos < text.size();)
+            {
+                points += DecodeUtf8(text, pos);
+            }
+            return points;
+        }
+
+        bool InClass(const std::u32string& members, char32_t cp)
+        {
+            return std::binary_search(members.begin(), members.end(), cp);
+        }
+
+        // A mask under %require and %repeat, holding only the candidates
+        // that meet them. After the first i positions a candidate is in a
+        // state: the required classes it has a character of, and with a
+        // repeat limit its last character and how many times in a row that
+        // came. m_completions[i][state] counts the ways to fill the other
+        // positions from there, so candidate N is found by taking at each
+        // position the character whose completions cover what is left of N.
+        // A batch seeks its first candidate that way and steps to the next
+        // one by carrying, like an odometer that skips dead ends.
+        class ConstrainedMaskSegment : public Segment
+        {
+        public:
+            ConstrainedMaskSegment(std::vector<Charset> positions, const Constraints& constraints, size_t line)
+                : m_positions(std::move(positions))
+                , m_maxBytes(WidestBytes(m_positions))
+                // A run cannot be longer than the mask.
+                , m_maxRepeat(constraints.maxRepeat < m_positions.size() ? constraints.maxRepeat : 0)
+                , m_runs(std::max<uint32_t>(m_maxRepeat, 1))
+                , m_full((1u << constraints.required.size()) - 1)
+            {
+                const size_t count = m_positions.size();
+                m_classes.resize(count);
+                m_same.resize(count);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    for (const auto& symbol : m_positions[i])
+                    {
+                        char32_t cp = CodePoint(symbol);
+                        uint8_t classes = 0;
+                        for (size_t k = 0; k < constraints.required.size(); ++k)
+                        {
+                            classes |= InClass(constraints.required[k], cp) ? 1u << k : 0u;
+                        }
+                        m_classes[i].push_back(classes);
+                        uint32_t same = NoSymbol;
+                        if (m_maxRepeat != 0 && i > 0)
+                        {
+                            const Charset& previous = m_positions[i - 1];
+                            for (uint32_t p = 0; p < previous.size() && same == NoSymbol; ++p)
+                            {
+                                same = CodePoint(previous[p]) == cp ? p : NoSymbol;
+                            }
+                        }
+                        m_same[i].push_back(same);
+                    }
+                }
+
+                uint64_t states = 0;
+                m_completions.resize(count + 1);
+                for (size_t i = 0; i <= count; ++i)
+                {
+                    states += uint64_t(m_full + 1) * m_runs * Lasts(i);
+                }
+                if (states > MaxStates)
+                {
+                    throw RuleError(line, "constraints are too complex to count for this rule");
+                }
+                for (size_t i = count + 1; i-- > 0;)
+                {
+                    std::vector<uint64_t>& layer = m_completions[i];
+                    layer.resize(size_t(m_full + 1) * m_runs * Lasts(i));
+                    for (uint32_t state = 0; state < layer.size(); ++state)
+                    {
+                        if (i == count)
+                        {
+                            layer[state] = state / (m_runs * Lasts(i)) == m_full ? 1 : 0;
+                            continue;
+                        }
+                        uint64_t ways = 0;
+                        for (uint32_t t = 0; t < m_positions[i].size(); ++t)
+                        {
+                            uint32_t next = Next(i, state, t);
+                            ways += next == NoSymbol ? 0 : m_completions[i + 1][next];
+                        }
+                        layer[state] = ways;
+                    }
+                }
+            }
+
+            uint64_t Size() const override { return m_completions[0][0]; }
+            size_t MaxBytes() const override { return m_maxBytes; }
+            bool Distinct() const override { return true; }
+
+            size_t Generate(uint64_t index, char* out) const override
+            {
+                Cursor cursor;
+                Seek(index, cursor);
+                return Write(cursor, out);
+            }
+
+            void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const override
+            {
+                Cursor cursor;
+                Seek(first, cursor);
+                for (size_t i = 0; i < count; ++i, out += stride)
+                {
+                    if (i != 0)
+                    {
+                        Advance(cursor);
+                    }
+                    views[i] = std::string_view(out, Write(cursor, out));
+                }
+            }
+
+            bool ForEach(uint64_t first, uint64_t last, char* out,
+                const std::function<bool(std::string_view)>& visit) const override
+            {
+                Cursor cursor;
+                for (uint64_t index = first; index < last; ++index)
+                {
+                    if (index == first)
+                    {
+                        Seek(first, cursor);
+                    }
+                    else
+                    {
+                        Advance(cursor);
+                    }
+                    if (!visit(std::string_view(out, Write(cursor, out))))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+        private:
+            static constexpr uint32_t NoSymbol = UINT32_MAX;
+            // Above this many states in all, the rule is rejected.
+            static constexpr uint64_t MaxStates = 1 << 22;
+
+            struct Cursor
+            {
+                uint32_t digits[MaxPositions];
+                uint32_t states[MaxPositions + 1];
+            };
+
+            // Last characters a state after i positions tells apart.
+            size_t Lasts(size_t i) const
+            {
+                return m_maxRepeat != 0 && i > 0 ? m_positions[i - 1].size() : 1;
+            }
+
+            // The state after taking character t at position i, or NoSymbol
+            // when that makes too long a run.
+            uint32_t Next(size_t i, uint32_t state, uint32_t t) const
+            {
+                size_t lasts = Lasts(i);
+                uint32_t last = static_cast<uint32_t>(state % lasts);
+                uint32_t run = static_cast<uint32_t>(state / lasts % m_runs) + 1;
+                uint32_t seen = static_cast<uint32_t>(state / lasts / m_runs) | m_classes[i][t];
+                run = i > 0 && m_same[i][t] == last ? run + 1 : 1;
+                if (m_maxRepeat != 0 && run > m_maxRepeat)
+                {
+                    return NoSymbol;
+                }
+                return static_cast<uint32_t>((seen * m_runs + run - 1) * Lasts(i + 1) + (m_maxRepeat != 0 ? t : 0));
+            }
+
+            // Sets positions from..end to the candidate at `index` among
+            // the completions of cursor.states[from].
+            void Seek(uint64_t index, Cursor& cursor, size_t from = 0) const
+            {
+                if (from == 0)
+                {
+                    cursor.states[0] = 0;
+                }
+                for (size_t i = from; i < m_positions.size(); ++i)
+                {
+                    for (uint32_t t = 0;; ++t)
+                    {
+                        uint32_t next = Next(i, cursor.states[i], t);
+                        uint64_t ways = next == NoSymbol ? 0 : m_completions[i + 1][next];
+                        if (index < ways)
+                        {
+                            cursor.digits[i] = t;
+                            cursor.states[i + 1] = next;
+                            break;
+                        }
+                        index -= ways;
+                    }
+                }
+            }
+
+            // Moves to the next candidate; the last one stays put.
+            void Advance(Cursor& cursor) const
+            {
+                for (size_t i = m_positions.size(); i-- > 0;)
+                {
+                    for (uint32_t t = cursor.digits[i] + 1; t < m_positions[i].size(); ++t)
+                    {
+                        uint32_t next = Next(i, cursor.states[i], t);
+                        if (next != NoSymbol && m_completions[i + 1][next] != 0)
+                        {
+                            cursor.digits[i] = t;
+                            cursor.states[i + 1] = next;
+                            Seek(0, cursor, i + 1);
+                            return;
+                        }
+                    }
+                }
+            }
+
+            size_t Write(const Cursor& cursor, char* out) const
+            {
+                char* at = out;
+                for (size_t i = 0; i < m_positions.size(); ++i)
+                {
+                    const Symbol& symbol = m_positions[i][cursor.digits[i]];
+                    std::memcpy(at, symbol.bytes, symbol.size);
+                    at += symbol.size;
+                }
+                return static_cast<size_t>(at - out);
+            }
+
+            std::vector<Charset> m_positions;
+            size_t m_maxBytes;
+            uint32_t m_maxRepeat;
+            uint32_t m_runs;
+            uint32_t m_full;                            // state bits with every class seen
+            std::vector<std::vector<uint8_t>> m_classes;    // per position and character
+            std::vector<std::vector<uint32_t>> m_same;      // the same character one position earlier
+            std::vector<std::vector<uint64_t>> m_completions;
+        };
+
+        Symbol MakeSymbol(char32_t cp)
+        {
+            std::string bytes;
+            AppendUtf8(cp, bytes);
+            Symbol symbol{};
+            std::memcpy(symbol.bytes, bytes.data(), bytes.size());
+            symbol.size = static_cast<uint8_t>(bytes.size());
+            return symbol;
+        }
+
+        // Collects the members of one position, dropping repeats so every
+        // candidate of a mask is produced exactly once.
+        class CharsetBuilder
+        {
+        public:
+            void Add(char32_t cp)
+            {
+                if (m_seen.insert(cp).second)
+                {
+                    m_charset.push_back(MakeSymbol(cp));
+                }
+            }
+
+            void Add(std::string_view ascii)
+            {
+                for (char c : ascii)
+                {
+                    Add(static_cast<char32_t>(c));
+                }
+            }
+
+            bool Empty() const { return m_charset.empty(); }
+            Charset Take() { return std::move(m_charset); }
+
+        private:
+            Charset m_charset;
+            std::unordered_set<char32_t> m_seen;
+        };
+
+        class MaskParser
+        {
+        public:
+            MaskParser(std::string_view text, size_t line)
+                : m_text(text)
+                , m_line(line)
+            {
+            }
+
+            std::vector<Charset> Parse()
+            {
+                std::vector<Charset> positions;
+                while (m_pos < m_text.size())
+                {
+                    CharsetBuilder builder;
+                    char c = m_text[m_pos];
+                    if (c == '?')
+                    {
+                        ++m_pos;
+                        AddBuiltin(builder);
+                    }
+                    else if (c == '[')
+                    {
+                        ++m_pos;
+                        ParseClass(builder);
+                    }
+                    else
+                    {
+                        builder.Add(NextChar());
+                    }
+
+                    if (positions.size() == MaxPositions)
+                    {
+                        throw RuleError(m_line, "rule is longer than " + std::to_string(MaxPositions) + " characters");
+                    }
+                    positions.push_back(builder.Take());
+                }
+                return positions;
+            }
+
+        private:
+            // A literal character, honouring the \c escape.
+            char32_t NextChar()
+            {
+                if (m_text[m_pos] == '\\')
+                {
+                    ++m_pos;
+                    if (m_pos == m_text.size())
+                    {
+                        throw RuleError(m_line, "dangling '\\' at end of rule");
+                    }
+                }
+                return DecodeUtf8(m_text, m_pos);
+            }
+
+            void AddBuiltin(CharsetBuilder& builder)
+            {
+                if (m_pos == m_text.size())
+                {
+                    throw RuleError(m_line, "dangling '?' at end of rule");
+                }
+                char set = m_text[m_pos++];
+                switch (set)
+                {
+                case 'l': builder.Add(charsets::View(charsets::Lower)); break;
+                case 'u': builder.Add(charsets::View(charsets::Upper)); break;
+                case 'd': builder.Add(charsets::View(charsets::Digits)); break;
+                case 's': builder.Add(charsets::View(charsets::Symbols)); break;
+                case 'a': builder.Add(charsets::View(charsets::All)); break;
+                case 'h': builder.Add(charsets::View(charsets::HexLower)); break;
+                case 'H': builder.Add(charsets::View(charsets::HexUpper)); break;
+                case '?': builder.Add(U'?'); break;
+                default:
+                    throw RuleError(m_line, std::string("unknown character set ?") + set);
+                }
+            }
+
+            void ParseClass(CharsetBuilder& builder)
+            {
+                while (true)
+                {
+                    if (m_pos == m_text.size())
+                    {
+                        throw RuleError(m_line, "unterminated '[' class");
+                    }
+                    char c = m_text[m_pos];
+                    if (c == ']')
+                    {
+                        ++m_pos;
+                        break;
+                    }
+                    if (c == '?')
+                    {
+                        ++m_pos;
+                        AddBuiltin(builder);
+                        continue;
+                    }
+
+                    char32_t first = NextChar();
+                    if (m_pos + 1 < m_text.size() && m_text[m_pos] == '-' && m_text[m_pos + 1] != ']')
+                    {
+                        ++m_pos;
+                        char32_t last = NextChar();
+                        if (last < first || last - first >= MaxRangeSpan)
+                        {
+                            throw RuleError(m_line, "invalid range in '[' class");
+                        }
+                        for (char32_t cp = first; cp <= last; ++cp)
+                        {
+                            builder.Add(cp);
+                        }
+                    }
+                    else
+                    {
+                        builder.Add(first);
+                    }
+                }
+                if (builder.Empty())
+                {
+                    throw RuleError(m_line, "empty '[' class");
+                }
+            }
+
+            std::string_view m_text;
+            size_t m_line;
+            size_t m_pos = 0;
+        };
+
+        std::vector<Charset> LiteralPositions(std::string_view text, size_t line)
+        {
+            std::vector<Charset> positions;
+            for (size_t pos = 0; pos < text.size();)
+            {
+                if (positions.size() == MaxPositions)
+                {
+                    throw RuleError(line, "rule is longer than " + std::to_string(MaxPositions) + " characters");
+                }
+                positions.push_back({ MakeSymbol(DecodeUtf8(text, pos)) });
+            }
+            return positions;
+        }
+
+        std::string Spell(const std::vector<Charset>& positions)
+        {
+            std::string word;
+            for (const auto& charset : positions)
+            {
+                word.append(charset[0].bytes, charset[0].size);
+            }
+            return word;
+        }
+
+        uint32_t ParseBound(std::string_view text, size_t line)
+        {
+            uint32_t value = 0;
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (error != std::errc() || end != text.data() + text.size())
+            {
+                throw RuleError(line, "'" + std::string(text) + "' is not a count");
+            }
+            return value;
+        }
+
+        // A "%" line as its name and argument.
+        std::pair<std::string_view, std::string_view> SplitDirective(std::string_view directive)
+        {
+            size_t space = directive.find(' ');
+            if (space == std::string_view::npos)
+            {
+                return { directive.substr(1), {} };
+            }
+            return { directive.substr(1, space - 1), directive.substr(space + 1) };
+        }
+
+        // Applies a "%" line to the constraints declared so far.
+        void Declare(std::string_view directive, size_t line, Constraints& declared)
+        {
+            auto [name, argument] = SplitDirective(directive);
+            if (name == "length")
+            {
+                argument = Trim(argument);
+                size_t dash = argument.find('-');
+                std::string_view low = argument.substr(0, dash);
+                std::string_view high = dash == std::string_view::npos ? low : argument.substr(dash + 1);
+                declared.minLength = low.empty() ? 0 : ParseBound(low, line);
+                declared.maxLength = high.empty() ? 0 : ParseBound(high, line);
+                if (declared.maxLength != 0 && declared.minLength > declared.maxLength)
+                {
+                    throw RuleError(line, "%length minimum is above the maximum");
+                }
+            }
+            else if (name == "require")
+            {
+                declared.required.clear();
+                for (const auto& charset : MaskParser(argument, line).Parse())
+                {
+                    if (declared.required.size() == Constraints::MaxRequired)
+                    {
+                        throw RuleError(line, "%require takes at most " + std::to_string(Constraints::MaxRequired) + " classes");
+                    }
+                    std::u32string& members = declared.required.emplace_back();
+                    for (const auto& symbol : charset)
+                    {
+                        members += CodePoint(symbol);
+                    }
+                    std::sort(members.begin(), members.end());
+                }
+            }
+            else if (name == "repeat")
+            {
+                argument = Trim(argument);
+                declared.maxRepeat = argument.empty() ? 0 : ParseBound(argument, line);
+            }
+            else if (name == "prefix")
+            {
+                declared.prefix = argument;
+            }
+            else if (name == "suffix")
+            {
+                declared.suffix = argument;
+            }
+            else
+            {
+                throw RuleError(line, "unknown constraint %" + std::string(name));
+            }
+        }
+
+        // The declared constraints within the bounds of the options.
+        Constraints Bound(const Constraints& declared, const KeyspaceOptions& options)
+        {
+            Constraints constraints = declared;
+            constraints.minLength = std::max(declared.minLength, options.minLength);
+            if (declared.maxLength == 0 || (options.maxLength != 0 && options.maxLength < declared.maxLength))
+            {
+                constraints.maxLength = options.maxLength;
+            }
+            return constraints;
+        }
+
+        // Pins the first and last positions to the %prefix and %suffix
+        // text; false when the mask cannot produce it.
+        bool Pin(std::vector<Charset>& positions, const Constraints& constraints)
+        {
+            std::u32string prefix = CodePoints(constraints.prefix);
+            std::u32string suffix = CodePoints(constraints.suffix);
+            if (prefix.size() > positions.size() || suffix.size() > positions.size())
+            {
+                return false;
+            }
+            auto keep = [](Charset& charset, char32_t cp)
+            {
+                std::erase_if(charset, [cp](const Symbol& symbol) { return CodePoint(symbol) != cp; });
+                return !charset.empty();
+            };
+            for (size_t i = 0; i < prefix.size(); ++i)
+            {
+                if (!keep(positions[i], prefix[i]))
+                {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < suffix.size(); ++i)
+            {
+                if (!keep(positions[positions.size() - suffix.size() + i], suffix[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    bool Constraints::Accepts(std::string_view candidate) const
+    {
+        if (minLength == 0 && maxLength == 0 && !Shape())
+        {
+            return true;
+        }
+        if (!candidate.starts_with(prefix) || !candidate.ends_with(suffix))
+        {
+            return false;
+        }
+        uint32_t length = 0;
+        uint32_t run = 0;
+        uint32_t seen = 0;
+        char32_t previous = 0;
+        for (size_t pos = 0; pos < candidate.size(); ++length)
+        {
+            char32_t cp = DecodeUtf8(candidate, pos);
+            run = length != 0 && cp == previous ? run + 1 : 1;
+            if (maxRepeat != 0 && run > maxRepeat)
+            {
+                return false;
+            }
+            previous = cp;
+            for (size_t k = 0; k < required.size(); ++k)
+            {
+                seen |= InClass(required[k], cp) ? 1u << k : 0u;
+            }
+        }
+        return length >= minLength && (maxLength == 0 || length <= maxLength)
+            && seen == (1u << required.size()) - 1;
+    }
+
+    RuleError::RuleError(size_t line, const std::string& message)
+        : std::runtime_error("rule line " + std::to_string(line) + ": " + message)
+        , m_line(line)
+    {
+    }
+
+    bool Segment::ForEach(uint64_t first, uint64_t last, char* out,
+        const std::function<bool(std::string_view)>& visit) const
+    {
+        for (uint64_t index = first; index < last; ++index)
+        {
+            if (!visit(View(index, out)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Segment::Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            views[i] = View(first + i, out + i * stride);
+        }
+    }
+
+    Keyspace Keyspace::Compile(std::string_view rules, const KeyspaceOptions& options)
+    {
+        Keyspace keyspace;
+        auto words = std::make_unique<WordSegment>();
+        Constraints declared;
+        Constraints constraints = Bound(declared, options);
+        MutationSet mutationRules;
+        std::shared_ptr<const MutationSet> mutations;
+
+        // Mutated and combined output is checked against the constraints
+        // as it is produced; plain words and lines are checked up front.
+        auto constrain = [&](std::unique_ptr<Segment> output) -> std::unique_ptr<Segment>
+        {
+            if (constraints.minLength == 0 && constraints.maxLength == 0 && !constraints.Shape())
+            {
+                return output;
+            }
+            return std::make_unique<FilteredSegment>(std::move(output), constraints);
+        };
+
+        // Words and word lists go through the mutation rules declared before them.
+        auto mutate = [&](std::unique_ptr<Segment> base, size_t line) -> std::unique_ptr<Segment>
+        {
+            if (!mutations)
+            {
+                return base;
+            }
+            try
+            {
+                return constrain(std::make_unique<MutatedSegment>(std::move(base), mutations));
+            }
+            catch (const std::runtime_error& e)
+            {
+                throw RuleError(line, e.what());
+            }
+        };
+
+        auto flushWords = [&](size_t line)
+        {
+            if (!words->Empty())
+            {
+                keyspace.Add(mutate(std::move(words), line), line);
+                words = std::make_unique<WordSegment>();
+            }
+        };
+
+        // The %combine block being read, from its %combine line to %end.
+        struct Combination
+        {
+            size_t line = 0;
+            bool permute = false;
+            bool reading = false;   // plain lines are tokens of the last list
+            std::vector<std::vector<std::string>> lists;
+            std::vector<std::string> separators;
+        };
+        std::optional<Combination> combination;
+
+        size_t lineNumber = 0;
+        while (!rules.empty())
+        {
+            // Lines end in '\n', "\r\n" or (from the WinUI TextBox) a bare '\r'.
+            size_t end = rules.find_first_of("\r\n");
+            std::string_view line = rules.substr(0, end);
+            if (end == std::string_view::npos)
+            {
+                rules = {};
+            }
+            else
+            {
+                bool crlf = rules[end] == '\r' && end + 1 < rules.size() && rules[end + 1] == '\n';
+                rules.remove_prefix(end + (crlf ? 2 : 1));
+            }
+            ++lineNumber;
+
+            if (line.empty() || line.front() == '#')
+            {
+                continue;
+            }
+
+            if (combination)
+            {
+                if (line.front() != '%')
+                {
+                    if (!combination->reading)
+                    {
+                        throw RuleError(lineNumber, "token outside a %tokens list");
+                    }
+                    combination->lists.back().emplace_back(line.front() == '=' ? line.substr(1) : line);
+                    continue;
+                }
+                auto [name, argument] = SplitDirective(line);
+                combination->reading = false;
+                if (name == "tokens")
+                {
+                    argument = Trim(argument);
+                    combination->lists.emplace_back();
+                    if (argument.empty())
+                    {
+                        combination->reading = true;
+                    }
+                    else if (argument.front() == '@')
+                    {
+                        try
+                        {
+                            combination->lists.back() = TokenCombinator::ReadTokens(std::string(Trim(argument.substr(1))));
+                        }
+                        catch (const std::runtime_error& e)
+                        {
+                            throw RuleError(lineNumber, e.what());
+                        }
+                    }
+                    else
+                    {
+                        throw RuleError(lineNumber, "%tokens takes nothing or @path");
+                    }
+                }
+                else if (name == "separator")
+                {
+                    combination->separators.emplace_back(argument);
+                }
+                else if (name == "end")
+                {
+                    std::unique_ptr<TokenCombinator> combined;
+                    try
+                    {
+                        combined = std::make_unique<TokenCombinator>(combination->lists, combination->separators, combination->permute);
+                    }
+                    catch (const std::runtime_error& e)
+                    {
+                        throw RuleError(combination->line, e.what());
+                    }
+                    std::unique_ptr<Segment> output = mutate(std::move(combined), combination->line);
+                    keyspace.Add(mutations ? std::move(output) : constrain(std::move(output)), combination->line);
+                    combination.reset();
+                }
+                else
+                {
+                    throw RuleError(lineNumber, "%" + std::string(name) + " inside a %combine block");
+                }
+                continue;
+            }
+
+            if (line.front() == '%' && SplitDirective(line).first == "combine")
+            {
+                std::string_view argument = Trim(SplitDirective(line).second);
+                if (!argument.empty() && argument != "permute")
+                {
+                    throw RuleError(lineNumber, "%combine takes nothing or \"permute\"");
+                }
+                flushWords(lineNumber);
+                combination.emplace();
+                combination->line = lineNumber;
+                combination->permute = !argument.empty();
+                continue;
+            }
+
+            if (line.front() == '%')
+            {
+                std::string_view name = SplitDirective(line).first;
+                if (name == "tokens" || name == "separator" || name == "end")
+                {
+                    throw RuleError(lineNumber, "%" + std::string(name) + " outside a %combine block");
+                }
+            }
+
+            if (line.front() == '%' && SplitDirective(line).first == "mutate")
+            {
+                flushWords(lineNumber);
+                std::string_view argument = SplitDirective(line).second;
+                try
+                {
+                    if (Trim(argument).empty())
+                    {
+                        mutationRules.clear();
+                    }
+                    else if (argument.front() == '@')
+                    {
+                        MutationSet loaded = LoadMutationRules(std::string(Trim(argument.substr(1))));
+                        mutationRules.insert(mutationRules.end(), loaded.begin(), loaded.end());
+                    }
+                    else if (argument.front() == '=')
+                    {
+                        mutationRules.push_back(MutationRule::Parse(argument.substr(1)));
+                    }
+                    else
+                    {
+                        mutationRules.push_back(MutationRule::Parse(argument));
+                    }
+                }
+                catch (const std::runtime_error& e)
+                {
+                    throw RuleError(lineNumber, e.what());
+                }
+                mutations = mutationRules.empty() ? nullptr : std::make_shared<const MutationSet>(mutationRules);
+                continue;
+            }
+
+            if (line.front() == '%')
+            {
+                // Mutated words are checked when they come out, against the
+                // constraints of their own lines.
+                if (mutations)
+                {
+                    flushWords(lineNumber);
+                }
+                Declare(line, lineNumber, declared);
+                constraints = Bound(declared, options);
+                continue;
+            }
+
+            if (line.front() == '@')
+            {
+                flushWords(lineNumber);
+                std::unique_ptr<Wordlist> list;
+                try
+                {
+                    list = std::make_unique<Wordlist>(std::string(line.substr(1)), mutations ? Constraints() : constraints);
+                }
+                catch (const std::runtime_error& e)
+                {
+                    throw RuleError(lineNumber, e.what());
+                }
+                keyspace.Add(mutate(std::move(list), lineNumber), lineNumber);
+                continue;
+            }
+
+            std::vector<Charset> positions = line.front() == '='
+                ? LiteralPositions(line.substr(1), lineNumber)
+                : MaskParser(line, lineNumber).Parse();
+
+            size_t length = positions.size();
+            bool literal = std::all_of(positions.begin(), positions.end(),
+                [](const Charset& charset) { return charset.size() == 1; });
+
+            if (literal)
+            {
+                std::string word = Spell(positions);
+                if (mutations || constraints.Accepts(word))
+                {
+                    words->Add(std::move(word));
+                }
+                continue;
+            }
+
+            flushWords(lineNumber);
+            size_t longest = constraints.maxLength == 0 ? length : std::min<size_t>(length, constraints.maxLength);
+            size_t shortest = constraints.minLength == 0 ? longest : std::max<size_t>(constraints.minLength, 1);
+            for (size_t prefix = shortest; prefix <= longest; ++prefix)
+            {
+                std::vector<Charset> head(positions.begin(), positions.begin() + prefix);
+                if (!Pin(head, constraints))
+                {
+                    continue;
+                }
+                uint64_t size = 1;
+                for (const auto& charset : head)
+                {
+                    if (!MultiplyChecked(size, charset.size(), size))
+                    {
+                        throw RuleError(lineNumber, "rule expands to more than 2^64 candidates");
+                    }
+                }
+                if (!constraints.required.empty() || constraints.maxRepeat != 0)
+                {
+                    // Walked in rule order, --markov or not.
+                    auto segment = std::make_unique<ConstrainedMaskSegment>(std::move(head), constraints, lineNumber);
+                    if (segment->Size() != 0)
+                    {
+                        keyspace.Add(std::move(segment), lineNumber);
+                    }
+                }
+                else if (options.order)
+                {
+                    keyspace.Add(std::make_unique<OrderedMaskSegment>(std::move(head), size, *options.order), lineNumber);
+                }
+                else
+                {
+                    keyspace.Add(std::make_unique<MaskSegment>(std::move(head), size), lineNumber);
+                }
+            }
+        }
+        if (combination)
+        {
+            throw RuleError(combination->line, "%combine without %end");
+        }
+        flushWords(lineNumber);
+        return keyspace;
+    }
+
+    void Keyspace::Add(std::unique_ptr<Segment> segment, size_t line)
+    {
+        uint64_t end = Size() + segment->Size();
+        if (end < Size())
+        {
+            throw RuleError(line, "rules expand to more than 2^64 candidates");
+        }
+        m_maxBytes = std::max(m_maxBytes, segment->MaxBytes());
+        m_offsets.push_back(end);
+        m_segments.push_back(std::move(segment));
+    }
+
+    bool Keyspace::MayRepeat() const
+    {
+        return m_segments.size() > 1 || (m_segments.size() == 1 && !m_segments[0]->Distinct());
+    }
+
+    bool Keyspace::MayReject() const
+    {
+        return std::any_of(m_segments.begin(), m_segments.end(),
+            [](const auto& segment) { return segment->MayReject(); });
+    }
+
+    const Segment& Keyspace::Locate(uint64_t& index) const
+    {
+        auto it = std::upper_bound(m_offsets.begin(), m_offsets.end(), index);
+        size_t segment = static_cast<size_t>(it - m_offsets.begin());
+        index -= segment == 0 ? 0 : m_offsets[segment - 1];
+        return *m_segments[segment];
+    }
+
+    size_t Keyspace::Generate(uint64_t index, char* out) const
+    {
+        return Locate(index).Generate(index, out);
+    }
+
+    std::string_view Keyspace::View(uint64_t index, char* out) const
+    {
+        return Locate(index).View(index, out);
+    }
+
+    std::string Keyspace::Origin(uint64_t index) const
+    {
+        return Locate(index).Origin(index);
+    }
+
+    void Keyspace::Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const
+    {
+        while (count != 0)
+        {
+            uint64_t local = first;
+            const Segment& segment = Locate(local);
+            size_t part = static_cast<size_t>(std::min<uint64_t>(count, segment.Size() - local));
+            segment.Fill(local, part, out, stride, views);
+            first += part;
+            count -= part;
+            out += part * stride;
+            views += part;
+        }
+    }
+
+    bool Keyspace::ForEach(uint64_t first, uint64_t last, char* out,
+        const std::function<bool(std::string_view)>& visit) const
+    {
+        while (first < last)
+        {
+            uint64_t local = first;
+            const Segment& segment = Locate(local);
+            uint64_t count = std::min(last - first, segment.Size() - local);
+            if (!segment.ForEach(local, local + count, out, visit))
+            {
+                return false;
+            }
+            first += count;
+        }
+        return true;
+    }
+
+    std::string Keyspace::At(uint64_t index) const
+    {
+        std::string candidate(m_maxBytes, '\0');
+        candidate.resize(Generate(index, candidate.data()));
+        return candidate;
+    }
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Rule text that does not compile; the message names the offending line.
+    class RuleError : public std::runtime_error
+    {
+    public:
+        RuleError(size_t line, const std::string& message);
+
+        size_t Line() const { return m_line; }
+
+    private:
+        size_t m_line;
+    };
+
+    class MarkovModel;
+
+    // Conditions on the candidates of the rules that follow, set by the
+    // "%" lines of the rule text on top of the KeyspaceOptions bounds.
+    // Masks are compiled so that only candidates meeting them are ever
+    // enumerated, and Size() counts exactly those; words and word list
+    // lines that miss them are dropped when the rules are compiled. The
+    // output of mutation rules and of %combine blocks cannot be counted
+    // that way: it keeps every index, and the candidates that miss the
+    // constraints come out rejected (Segment::Rejected).
+    struct Constraints
+    {
+        // A candidate needs a character of each of at most this many classes.
+        static constexpr size_t MaxRequired = 8;
+
+        uint32_t minLength = 0;                 // characters, 0 = no bound
+        uint32_t maxLength = 0;                 // characters, 0 = no bound
+        std::string prefix;                     // text every candidate starts with
+        std::string suffix;                     // and ends with
+        std::vector<std::u32string> required;   // sorted code points of each class
+        uint32_t maxRepeat = 0;                 // longest run of one character, 0 = any
+
+        // True when the constraints go beyond the length bounds.
+        bool Shape() const { return !prefix.empty() || !suffix.empty() || !required.empty() || maxRepeat != 0; }
+
+        bool Accepts(std::string_view candidate) const;
+    };
+
+    struct KeyspaceOptions
+    {
+        uint32_t minLength = 0;     // MinLengthBox, 0 = no bound
+        uint32_t maxLength = 0;     // MaxLengthBox, 0 = no bound
+
+        // Walks masks likeliest-first by this model instead of in
+        // lexicographic order; the candidates and their count are the same.
+        std::shared_ptr<const MarkovModel> order;
+    };
+
+    // One compiled rule: a dense range of candidates addressed by index.
+    //
+    // Where the constraints apply only once a candidate is built (mutated
+    // and combined output), View, Fill and ForEach hand out the candidates
+    // they rule out as rejected views, and consumers skip them; Generate
+    // writes such a candidate all the same.
+    class Segment
+    {
+    public:
+        virtual ~Segment() = default;
+
+        // A view standing for a candidate the constraints rule out.
+        static bool Rejected(std::string_view candidate) { return candidate.data() == nullptr; }
+
+        // True when some views of the segment may be rejected, so Size()
+        // is only an upper bound on its candidates.
+        virtual bool MayReject() const { return false; }
+
+        virtual uint64_t Size() const = 0;
+
+        // Upper bound on the UTF-8 length of any candidate in the segment.
+        virtual size_t MaxBytes() const = 0;
+
+        // Writes candidate index (< Size()) to out, which must hold
+        // MaxBytes() bytes, and returns its length.
+        virtual size_t Generate(uint64_t index, char* out) const = 0;
+
+        // True when no candidate of the segment appears twice in it.
+        virtual bool Distinct() const = 0;
+
+        // Candidate index as a view, either of out (filled as by Generate)
+        // or of memory the segment owns, valid while the segment lives.
+        virtual std::string_view View(uint64_t index, char* out) const
+        {
+            return std::string_view(out, Generate(index, out));
+        }
+
+        // Where candidate index comes from, for reports; empty when the
+        // rule text says all there is to say.
+        virtual std::string Origin(uint64_t) const { return {}; }
+
+        // Candidates [first, first + count) as by View, written to out at
+        // `stride`-byte intervals (stride >= MaxBytes()): the engine's batch
+        // step. Masks of single-byte characters use a compiled kernel
+        // (SelectMaskFill); the default calls View per index.
+        virtual void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const;
+
+        // Hands candidates [first, last) in order to visit, as views valid
+        // during the call, until visit returns false; returns false then.
+        // Cheaper than View per index for segments that can step from one
+        // candidate to the next.
+        virtual bool ForEach(uint64_t first, uint64_t last, char* out,
+            const std::function<bool(std::string_view)>& visit) const;
+    };
+
+    // The rules of PasswordRulesBox compiled into the concatenation of their
+    // segments. Candidate N is computed directly from N, so workers and
+    // machines can split [0, Size()) into disjoint ranges without sharing a
+    // cursor.
+    //
+    // Rule syntax, one rule per line:
+    //   # comment          ignored, as are blank lines
+    //   =text              the literal text, nothing interpreted
+    //   ?l ?u ?d ?s ?a     lower, upper, digit, symbol, all printable ASCII
+    //   ?h ?H              lower / upper case hex digit
+    //   [a-z0-9_]          custom class; may contain ranges, ?x sets and \ escapes
+    //   \c                 the character c itself
+    //   ??                 a literal '?'
+    //   @path              every line of a word list file (see Wordlist); the
+    //                      path is taken as is, relative to the working directory
+    // Anything else is a literal character; write \@ or =@ for a rule that
+    // starts with a literal '@', \% or =% for one that starts with '%'. A
+    // line made only of literals is a single word and is dropped when it
+    // falls outside the length bounds; a mask yields its prefixes whose
+    // lengths are inside the bounds.
+    //
+    // Constraint lines apply to the rules after them, until the same
+    // directive is given again (after mutation and combination, on their
+    // output); without an argument it is lifted:
+    //   %length 8-12       candidate length in characters ("8", "8-", "-12"),
+    //                      narrowing the KeyspaceOptions bounds
+    //   %require ?d?u[!#]  a character of each listed class (mask syntax,
+    //                      one class per position, at most 8)
+    //   %repeat 2          no character more than 2 times in a row
+    //   %prefix text       candidates start with the literal text
+    //   %suffix text       candidates end with the literal text
+    //
+    // "%mutate RULE" adds a mutation rule (see MutationRule), "%mutate @FILE"
+    // every rule of a file; the words and word lists after them go through
+    // each rule. "%mutate =RULE" takes the rule as is, for one that starts
+    // with '@' (purge) or '='. A bare "%mutate" drops the rules collected so
+    // far.
+    //
+    // A "%combine" ... "%end" block joins one token of each list (see
+    // TokenCombinator); "%combine permute" takes the lists in every order:
+    //   %tokens            a list of the lines that follow ("=" escapes one)
+    //   %tokens @path      a list of the lines of a file
+    //   %separator text    text between the tokens; one per candidate
+    class Keyspace
+    {
+    public:
+        static Keyspace Compile(std::string_view rules, const KeyspaceOptions& options = {});
+
+        Keyspace(Keyspace&&) noexcept = default;
+        Keyspace& operator=(Keyspace&&) noexcept = default;
+
+        uint64_t Size() const { return m_offsets.empty() ? 0 : m_offsets.back(); }
+        size_t MaxBytes() const { return m_maxBytes; }
+        size_t SegmentCount() const { return m_segments.size(); }
+
+        // False when every candidate is known to be produced only once, so
+        // filtering duplicates would be wasted work.
+        bool MayRepeat() const;
+
+        // True when some segment may reject candidates: Size() is then an
+        // upper bound, not the exact count.
+        bool MayReject() const;
+
+        // Same contracts as Segment::Generate, View and Origin for the whole
+        // keyspace.
+        size_t Generate(uint64_t index, char* out) const;
+        std::string_view View(uint64_t index, char* out) const;
+        std::string Origin(uint64_t index) const;
+        void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const;
+        bool ForEach(uint64_t first, uint64_t last, char* out,
+            const std::function<bool(std::string_view)>& visit) const;
+
+        std::string At(uint64_t index) const;
+
+    private:
+        Keyspace() = default;
+
+        void Add(std::unique_ptr<Segment> segment, size_t line);
+
+        // The segment holding index; rebases index to that segment.
+        const Segment& Locate(uint64_t& index) const;
+
+        std::vector<std::unique_ptr<Segment>> m_segments;
+        std::vector<uint64_t> m_offsets;    // m_offsets[i] = end index of segment i
+        size_t m_maxBytes = 0;
+    };
+}
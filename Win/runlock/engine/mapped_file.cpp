@@ -0,0 +1,131 @@
+#include "mapped_file.h"
+#include "text.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace runlock::engine
+{
+    MappedFile::MappedFile(const std::string& path)
+    {
+#ifdef _WIN32
+        HANDLE file = ::CreateFileW(Utf8ToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+        m_file = file;
+
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(file, &size))
+        {
+            Close();
+            throw std::runtime_error("cannot stat " + path);
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+        if (m_size == 0)
+        {
+            return;
+        }
+
+        m_mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = m_mapping != nullptr ? ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view == nullptr)
+        {
+            Close();
+            throw std::runtime_error("cannot map " + path);
+        }
+        m_data = static_cast<const uint8_t*>(view);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot stat " + path);
+        }
+        m_size = static_cast<size_t>(info.st_size);
+        if (m_size != 0)
+        {
+            void* view = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view == MAP_FAILED)
+            {
+                ::close(fd);
+                m_size = 0;
+                throw std::runtime_error("cannot map " + path);
+            }
+            m_data = static_cast<const uint8_t*>(view);
+        }
+        ::close(fd);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+            m_file = std::exchange(other.m_file, nullptr);
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    void MappedFile::Close()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+        {
+            ::UnmapViewOfFile(m_data);
+        }
+        if (m_mapping != nullptr)
+        {
+            ::CloseHandle(m_mapping);
+        }
+        if (m_file != nullptr)
+        {
+            ::CloseHandle(m_file);
+        }
+        m_file = nullptr;
+        m_mapping = nullptr;
+#else
+        if (m_data != nullptr)
+        {
+            ::munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
@@ -0,0 +1,34 @@
+#include "markov.h"
+#include "mapped_file.h"
+
+#include <cstring>
+
+namespace runlock::engine
+{
+    std::shared_ptr<const MarkovModel> MarkovModel::Train(const std::string& path)
+    {
+        MappedFile file(path);
+        const uint8_t* cursor = file.Data();
+        const uint8_t* end = cursor + file.Size();
+        if (file.Size() >= 3 && std::memcmp(cursor, "\xEF\xBB\xBF", 3) == 0)
+        {
+            cursor += 3;
+        }
+
+        auto model = std::make_shared<MarkovModel>();
+        unsigned previous = Start;
+        for (; cursor < end; ++cursor)
+        {
+            uint8_t c = *cursor;
+            if (c == '\n' || (c == '\r' && cursor + 1 < end && cursor[1] == '\n'))
+            {
+                previous = Start;
+                continue;
+            }
+            ++model->m_pairs[previous * 256 + c];
+            ++model->m_singles[c];
+            previous = c;
+        }
+        return model;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Byte bigram statistics of a sample of real passwords (one per line),
+    // used to put the likeliest characters of each mask position first.
+    // Only the order of each position's characters is taken from it, so a
+    // mask keeps exactly the same candidates whatever the sample says.
+    class MarkovModel
+    {
+    public:
+        static constexpr unsigned Start = 256;     // "previous byte" at the start of a line
+
+        // Reads the sample as Wordlist does (mapped, CRLF and BOM skipped).
+        // Throws std::runtime_error when it cannot be read.
+        static std::shared_ptr<const MarkovModel> Train(const std::string& path);
+
+        // How often byte `next` followed `previous` (or Start) in the sample.
+        uint64_t Pair(unsigned previous, uint8_t next) const { return m_pairs[previous * 256 + next]; }
+
+        // How often byte c appeared anywhere in the sample.
+        uint64_t Single(uint8_t c) const { return m_singles[c]; }
+
+    private:
+        std::vector<uint64_t> m_pairs = std::vector<uint64_t>((Start + 1) * 256);
+        std::vector<uint64_t> m_singles = std::vector<uint64_t>(256);
+    };
+}
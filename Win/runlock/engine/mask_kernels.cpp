@@ -0,0 +1,116 @@
+#include "mask_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // The last position's set, known at compile time...
+        template <const auto& Table>
+        struct FixedSet
+        {
+            static constexpr size_t Radix = Table.size();
+            static char At(const std::string&, size_t i) { return Table[i]; }
+        };
+
+        // ...or read from the compiled rule.
+        struct RuleSet
+        {
+            static constexpr size_t Radix = 0;
+            static char At(const std::string& bytes, size_t i) { return bytes[i]; }
+        };
+
+        template <size_t Length, typename Last>
+        void FillMask(const std::string* positions, uint64_t first, size_t count, char* out, size_t stride)
+        {
+            const std::string& last = positions[Length - 1];
+            const size_t radix = Last::Radix != 0 ? Last::Radix : last.size();
+
+            uint32_t digits[Length];
+            char prefix[Length];
+            for (size_t i = Length; i-- > 0;)
+            {
+                uint64_t size = positions[i].size();
+                digits[i] = static_cast<uint32_t>(first % size);
+                first /= size;
+                prefix[i] = positions[i][digits[i]];
+            }
+
+            size_t digit = digits[Length - 1];
+            while (count != 0)
+            {
+                size_t run = std::min(radix - digit, count);
+                if constexpr (Last::Radix != 0)
+                {
+                    if (run == Last::Radix)
+                    {
+                        // A whole sweep: unrolled, the characters are immediates.
+                        [&]<size_t... J>(std::index_sequence<J...>)
+                        {
+                            ((std::memcpy(out + J * stride, prefix, Length),
+                                out[J * stride + Length - 1] = Last::At(last, J)), ...);
+                        }(std::make_index_sequence<Last::Radix>());
+                        out += Last::Radix * stride;
+                    }
+                }
+                if (Last::Radix == 0 || run != Last::Radix)
+                {
+                    for (size_t j = 0; j < run; ++j, out += stride)
+                    {
+                        std::memcpy(out, prefix, Length);
+                        out[Length - 1] = Last::At(last, digit + j);
+                    }
+                }
+                count -= run;
+                digit = 0;
+
+                for (size_t i = Length - 1; i-- > 0;)
+                {
+                    if (++digits[i] < positions[i].size())
+                    {
+                        prefix[i] = positions[i][digits[i]];
+                        break;
+                    }
+                    digits[i] = 0;
+                    prefix[i] = positions[i][0];
+                }
+            }
+        }
+
+        template <typename Last, size_t... L>
+        constexpr std::array<MaskFill, sizeof...(L)> Kernels(std::index_sequence<L...>)
+        {
+            return { &FillMask<L + 1, Last>... };
+        }
+
+        template <typename Last>
+        constexpr auto KernelsFor = Kernels<Last>(std::make_index_sequence<MaxKernelLength>());
+
+        template <const auto& Table>
+        bool Matches(std::string_view last)
+        {
+            return last == charsets::View(Table);
+        }
+    }
+
+    MaskFill SelectMaskFill(size_t length, std::string_view last)
+    {
+        using namespace charsets;
+        if (length == 0 || length > MaxKernelLength)
+        {
+            return nullptr;
+        }
+        size_t at = length - 1;
+        if (Matches<Lower>(last)) { return KernelsFor<FixedSet<Lower>>[at]; }
+        if (Matches<Upper>(last)) { return KernelsFor<FixedSet<Upper>>[at]; }
+        if (Matches<Digits>(last)) { return KernelsFor<FixedSet<Digits>>[at]; }
+        if (Matches<Symbols>(last)) { return KernelsFor<FixedSet<Symbols>>[at]; }
+        if (Matches<All>(last)) { return KernelsFor<FixedSet<All>>[at]; }
+        if (Matches<HexLower>(last)) { return KernelsFor<FixedSet<HexLower>>[at]; }
+        if (Matches<HexUpper>(last)) { return KernelsFor<FixedSet<HexUpper>>[at]; }
+        return KernelsFor<RuleSet>[at];
+    }
+}
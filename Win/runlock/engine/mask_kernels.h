@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace runlock::engine
+{
+    namespace charsets
+    {
+        template <size_t N>
+        constexpr std::array<char, N - 1> Chars(const char (&text)[N])
+        {
+            std::array<char, N - 1> out{};
+            for (size_t i = 0; i + 1 < N; ++i)
+            {
+                out[i] = text[i];
+            }
+            return out;
+        }
+
+        template <size_t... N>
+        constexpr std::array<char, (N + ...)> Join(const std::array<char, N>&... parts)
+        {
+            std::array<char, (N + ...)> out{};
+            size_t at = 0;
+            ((std::copy(parts.begin(), parts.end(), out.begin() + at), at += parts.size()), ...);
+            return out;
+        }
+
+        // The built-in classes of the rule syntax, in the order they
+        // enumerate.
+        inline constexpr auto Lower = Chars("abcdefghijklmnopqrstuvwxyz");                     // ?l
+        inline constexpr auto Upper = Chars("ABCDEFGHIJKLMNOPQRSTUVWXYZ");                     // ?u
+        inline constexpr auto Digits = Chars("0123456789");                                    // ?d
+        inline constexpr auto Symbols = Chars(" !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~");          // ?s
+        inline constexpr auto All = Join(Lower, Upper, Digits, Symbols);                       // ?a
+        inline constexpr auto HexLower = Join(Digits, Chars("abcdef"));                        // ?h
+        inline constexpr auto HexUpper = Join(Digits, Chars("ABCDEF"));                        // ?H
+
+        template <size_t N>
+        constexpr std::string_view View(const std::array<char, N>& set)
+        {
+            return std::string_view(set.data(), N);
+        }
+    }
+
+    // Longest mask with a compiled fill kernel.
+    constexpr size_t MaxKernelLength = 16;
+
+    // Writes candidates [first, first + count) of a mask whose positions
+    // are all single bytes (positions[i] lists position i's bytes in order)
+    // to out, one every `stride` bytes. The first index is decoded once;
+    // after that the last position sweeps its set with no carry check and
+    // the others carry once per sweep.
+    using MaskFill = void (*)(const std::string* positions, uint64_t first, size_t count, char* out, size_t stride);
+
+    // The kernel compiled for this length (1 to MaxKernelLength) and last
+    // position: built-in classes get their table and sweep length baked
+    // in, other sets a kernel that reads them. Null for other lengths.
+    MaskFill SelectMaskFill(size_t length, std::string_view last);
+}
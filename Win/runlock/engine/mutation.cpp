@@ -0,0 +1,334 @@
+#include "mutation.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Branch-free on every byte, so the loops over a whole batch vectorize.
+        void Lower(char* bytes, size_t size)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = static_cast<char>(bytes[i] + ((static_cast<uint8_t>(bytes[i] - 'A') < 26) << 5));
+            }
+        }
+
+        void Upper(char* bytes, size_t size)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = static_cast<char>(bytes[i] - ((static_cast<uint8_t>(bytes[i] - 'a') < 26) << 5));
+            }
+        }
+
+        void Toggle(char* bytes, size_t size)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = static_cast<char>(bytes[i] ^ ((static_cast<uint8_t>((bytes[i] | 0x20) - 'a') < 26) << 5));
+            }
+        }
+
+        void Replace(char* bytes, size_t size, char from, char to)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = bytes[i] == from ? to : bytes[i];
+            }
+        }
+
+        // hashcat positions: 0-9, then A-Z for 10-35.
+        uint8_t Position(char c)
+        {
+            if (c >= '0' && c <= '9')
+            {
+                return static_cast<uint8_t>(c - '0');
+            }
+            if (c >= 'A' && c <= 'Z')
+            {
+                return static_cast<uint8_t>(c - 'A' + 10);
+            }
+            throw std::runtime_error(std::string("'") + c + "' is not a position");
+        }
+    }
+
+    MutationRule MutationRule::Parse(std::string_view text)
+    {
+        MutationRule rule;
+        rule.m_text = std::string(text);
+        std::string_view rest = rule.m_text;
+        while (!rest.empty())
+        {
+            char code = rest.front();
+            rest.remove_prefix(1);
+            size_t arguments = 0;
+            switch (code)
+            {
+            case ' ':
+                continue;
+            case ':': case 'l': case 'u': case 'c': case 'C': case 't': case 'r':
+            case 'd': case 'f': case '{': case '}': case '[': case ']':
+                break;
+            case 'T': case 'D': case '$': case '^': case '@':
+                arguments = 1;
+                break;
+            case 's':
+                arguments = 2;
+                break;
+            default:
+                throw std::runtime_error(std::string("unknown mutation function '") + code + "'");
+            }
+            if (rest.size() < arguments)
+            {
+                throw std::runtime_error(std::string("mutation function '") + code + "' is missing its argument");
+            }
+            Function function{ code, 0, 0 };
+            if (arguments != 0)
+            {
+                function.a = code == 'T' || code == 'D' ? Position(rest[0]) : static_cast<uint8_t>(rest[0]);
+                function.b = arguments == 2 ? static_cast<uint8_t>(rest[1]) : 0;
+                rest.remove_prefix(arguments);
+            }
+            if (code != ':')
+            {
+                rule.m_functions.push_back(function);
+            }
+        }
+        return rule;
+    }
+
+    size_t MutationRule::MaxBytes(size_t bytes) const
+    {
+        for (const auto& function : m_functions)
+        {
+            switch (function.code)
+            {
+            case 'd': case 'f': bytes *= 2; break;
+            case '$': case '^': bytes += 1; break;
+            default: break;
+            }
+            bytes = std::min(bytes, MaxMutatedBytes);
+        }
+        return bytes;
+    }
+
+    size_t MutationRule::ApplyOne(const Function& function, char* word, size_t size)
+    {
+        switch (function.code)
+        {
+        case 'l': Lower(word, size); break;
+        case 'u': Upper(word, size); break;
+        case 't': Toggle(word, size); break;
+        case 'c':
+            Lower(word, size);
+            Upper(word, std::min<size_t>(size, 1));
+            break;
+        case 'C':
+            Upper(word, size);
+            Lower(word, std::min<size_t>(size, 1));
+            break;
+        case 'T':
+            if (function.a < size)
+            {
+                Toggle(word + function.a, 1);
+            }
+            break;
+        case 's': Replace(word, size, static_cast<char>(function.a), static_cast<char>(function.b)); break;
+        case 'r': std::reverse(word, word + size); break;
+        case 'd':
+        {
+            size_t copy = std::min(size, MaxMutatedBytes - size);
+            std::memcpy(word + size, word, copy);
+            size += copy;
+            break;
+        }
+        case 'f':
+        {
+            size_t copy = std::min(size, MaxMutatedBytes - size);
+            std::reverse_copy(word + size - copy, word + size, word + size);
+            size += copy;
+            break;
+        }
+        case '{':
+            if (size > 1)
+            {
+                std::rotate(word, word + 1, word + size);
+            }
+            break;
+        case '}':
+            if (size > 1)
+            {
+                std::rotate(word, word + size - 1, word + size);
+            }
+            break;
+        case '$':
+            if (size < MaxMutatedBytes)
+            {
+                word[size++] = static_cast<char>(function.a);
+            }
+            break;
+        case '^':
+            if (size < MaxMutatedBytes)
+            {
+                std::memmove(word + 1, word, size++);
+                word[0] = static_cast<char>(function.a);
+            }
+            break;
+        case '[':
+            if (size != 0)
+            {
+                std::memmove(word, word + 1, --size);
+            }
+            break;
+        case ']':
+            size -= size != 0 ? 1 : 0;
+            break;
+        case 'D':
+            if (function.a < size)
+            {
+                std::memmove(word + function.a, word + function.a + 1, size - function.a - 1);
+                --size;
+            }
+            break;
+        case '@':
+            size = static_cast<size_t>(std::remove(word, word + size, static_cast<char>(function.a)) - word);
+            break;
+        default:
+            break;
+        }
+        return size;
+    }
+
+    size_t MutationRule::Apply(char* word, size_t size) const
+    {
+        for (const auto& function : m_functions)
+        {
+            size = ApplyOne(function, word, size);
+        }
+        return size;
+    }
+
+    void MutationRule::Apply(char* words, size_t count, size_t stride, size_t* sizes) const
+    {
+        // Every slot is the caller's, so bytes past a word can change too.
+        const size_t block = count * stride;
+        for (const auto& function : m_functions)
+        {
+            switch (function.code)
+            {
+            case 'l': Lower(words, block); break;
+            case 'u': Upper(words, block); break;
+            case 't': Toggle(words, block); break;
+            case 's': Replace(words, block, static_cast<char>(function.a), static_cast<char>(function.b)); break;
+            default:
+                for (size_t i = 0; i < count; ++i)
+                {
+                    sizes[i] = ApplyOne(function, words + i * stride, sizes[i]);
+                }
+                break;
+            }
+        }
+    }
+
+    MutationSet LoadMutationRules(const std::string& path)
+    {
+        MappedFile file(path);
+        std::string_view text(reinterpret_cast<const char*>(file.Data()), file.Size());
+        MutationSet rules;
+        for (size_t line = 1; !text.empty(); ++line)
+        {
+            size_t end = text.find('\n');
+            std::string_view rule = text.substr(0, end);
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+            if (!rule.empty() && rule.back() == '\r')
+            {
+                rule.remove_suffix(1);
+            }
+            if (rule.empty() || rule.front() == '#')
+            {
+                continue;
+            }
+            try
+            {
+                rules.push_back(MutationRule::Parse(rule));
+            }
+            catch (const std::runtime_error& e)
+            {
+                throw std::runtime_error(path + " line " + std::to_string(line) + ": " + e.what());
+            }
+        }
+        return rules;
+    }
+
+    MutatedSegment::MutatedSegment(std::unique_ptr<Segment> words, std::shared_ptr<const MutationSet> rules)
+        : m_words(std::move(words))
+        , m_rules(std::move(rules))
+    {
+        if (m_words->Size() != 0 && m_rules->size() > UINT64_MAX / m_words->Size())
+        {
+            throw std::runtime_error("mutated words exceed 2^64 candidates");
+        }
+        for (const auto& rule : *m_rules)
+        {
+            m_maxBytes = std::max(m_maxBytes, rule.MaxBytes(m_words->MaxBytes()));
+        }
+        // Room for the word before a rule shortens it.
+        m_maxBytes = std::max(m_maxBytes, m_words->MaxBytes());
+    }
+
+    size_t MutatedSegment::Generate(uint64_t index, char* out) const
+    {
+        uint64_t words = m_words->Size();
+        std::string_view word = m_words->View(index % words, out);
+        if (word.data() != out)
+        {
+            std::memcpy(out, word.data(), word.size());
+        }
+        return (*m_rules)[static_cast<size_t>(index / words)].Apply(out, word.size());
+    }
+
+    std::string MutatedSegment::Origin(uint64_t index) const
+    {
+        uint64_t words = m_words->Size();
+        std::string origin = m_words->Origin(index % words);
+        std::string rule = "mutation rule \"" + (*m_rules)[static_cast<size_t>(index / words)].Text() + "\"";
+        return origin.empty() ? rule : origin + ", " + rule;
+    }
+
+    void MutatedSegment::Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const
+    {
+        const uint64_t words = m_words->Size();
+        size_t sizes[256];
+        while (count != 0)
+        {
+            // One rule over consecutive words; word lists walk them in one pass.
+            const MutationRule& rule = (*m_rules)[static_cast<size_t>(first / words)];
+            uint64_t word = first % words;
+            size_t run = static_cast<size_t>(std::min<uint64_t>({ count, words - word, std::size(sizes) }));
+            m_words->Fill(word, run, out, stride, views);
+            for (size_t i = 0; i < run; ++i)
+            {
+                char* slot = out + i * stride;
+                if (views[i].data() != slot)
+                {
+                    std::memcpy(slot, views[i].data(), views[i].size());
+                }
+                sizes[i] = views[i].size();
+            }
+            rule.Apply(out, run, stride, sizes);
+            for (size_t i = 0; i < run; ++i)
+            {
+                views[i] = std::string_view(out + i * stride, sizes[i]);
+            }
+            first += run;
+            count -= run;
+            out += run * stride;
+            views += run;
+        }
+    }
+}
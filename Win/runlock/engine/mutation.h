@@ -0,0 +1,93 @@
+#pragma once
+
+#include "keyspace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Longest word a mutation can produce; growing functions stop there.
+    constexpr size_t MaxMutatedBytes = 512;
+
+    // One mutation rule: functions applied left to right to a base word,
+    // in the notation of hashcat's rule engine (the subset below, with the
+    // same meaning, so existing rule files work). Case functions act on
+    // ASCII letters only; positions N are 0-9 then A-Z for 10-35, and a
+    // function whose position is past the end of the word does nothing.
+    //   :        nothing                  l u        lower / upper case
+    //   c C      capitalize / invert it   t TN       toggle case, all / at N
+    //   r        reverse                  d f        duplicate / append reversed
+    //   { }      rotate left / right      [ ] DN     delete first / last / at N
+    //   $X ^X    append / prepend X       sXY        replace every X with Y
+    //   @X       remove every X
+    // Spaces between functions are ignored.
+    class MutationRule
+    {
+    public:
+        // Throws std::runtime_error naming the function that does not parse.
+        static MutationRule Parse(std::string_view text);
+
+        const std::string& Text() const { return m_text; }
+
+        // Longest result for a word of `bytes` bytes.
+        size_t MaxBytes(size_t bytes) const;
+
+        // Mutates the word in place (word has room for MaxBytes(size)
+        // bytes) and returns its new size.
+        size_t Apply(char* word, size_t size) const;
+
+        // The same for `count` words at `stride`-byte intervals, sizes[i]
+        // being word i's. Functions run one at a time over the whole batch,
+        // and the case and substitution functions over the batch's bytes as
+        // one block, which the compiler turns into vector code.
+        void Apply(char* words, size_t count, size_t stride, size_t* sizes) const;
+
+    private:
+        struct Function
+        {
+            char code;
+            uint8_t a;
+            uint8_t b;
+        };
+
+        static size_t ApplyOne(const Function& function, char* word, size_t size);
+
+        std::string m_text;
+        std::vector<Function> m_functions;
+    };
+
+    using MutationSet = std::vector<MutationRule>;
+
+    // Reads a rule file: one rule per line; blank lines and lines starting
+    // with '#' are skipped. Throws std::runtime_error.
+    MutationSet LoadMutationRules(const std::string& path);
+
+    // Every rule applied to every word of a base segment (word lists and
+    // words of the rule text after %mutate). Candidate N is rule
+    // N / words applied to word N % words: each rule runs over the whole
+    // list before the next, so a batch is one rule over consecutive words,
+    // and an index splits into (rule, word) for workers and checkpoints.
+    class MutatedSegment : public Segment
+    {
+    public:
+        // Throws std::runtime_error when words x rules exceeds 2^64.
+        MutatedSegment(std::unique_ptr<Segment> words, std::shared_ptr<const MutationSet> rules);
+
+        uint64_t Size() const override { return m_words->Size() * m_rules->size(); }
+        size_t MaxBytes() const override { return m_maxBytes; }
+        bool Distinct() const override { return false; }   // rules can agree on a word
+        size_t Generate(uint64_t index, char* out) const override;
+        std::string Origin(uint64_t index) const override;
+        void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const override;
+
+    private:
+        std::unique_ptr<Segment> m_words;
+        std::shared_ptr<const MutationSet> m_rules;
+        size_t m_maxBytes = 0;
+    };
+}
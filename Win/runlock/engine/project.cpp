@@ -0,0 +1,276 @@
+#include "project.h"
+#include "mapped_file.h"
+#include "text.h"
+
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Line-oriented text: a version line, "key value" lines, and
+        // length-prefixed blocks for text that may span lines. Example:
+        //
+        //   runlock-project 1
+        //   archive 1048576 D:\backup.rar
+        //   bounds 4 8
+        //   threads 16
+        //   keyspace 308915776
+        //   rules 8
+        //   ?l?l?l?l
+        //   markov D:\leaked.txt          (only when the run was ordered)
+        //   done 2
+        //   0 1200000
+        //   5000000 5100000
+        //   end
+        constexpr std::string_view Magic = "runlock-project 1";
+
+        void AppendBlock(std::string& out, std::string_view key, std::string_view text)
+        {
+            out += key;
+            out += ' ';
+            out += std::to_string(text.size());
+            out += '\n';
+            out += text;
+            out += '\n';
+        }
+
+        std::string Serialize(const Project& project)
+        {
+            std::string out(Magic);
+            out += '\n';
+            out += "archive " + std::to_string(project.archiveSize) + ' ' + project.archivePath + '\n';
+            out += "bounds " + std::to_string(project.minLength) + ' ' + std::to_string(project.maxLength) + '\n';
+            out += "threads " + std::to_string(project.threads) + '\n';
+            out += "keyspace " + std::to_string(project.keyspaceSize) + '\n';
+            AppendBlock(out, "rules", project.rules);
+            if (!project.markovPath.empty())
+            {
+                out += "markov " + project.markovPath + '\n';
+            }
+            out += "done " + std::to_string(project.done.Ranges().size()) + '\n';
+            for (const auto& range : project.done.Ranges())
+            {
+                out += std::to_string(range.first) + ' ' + std::to_string(range.last) + '\n';
+            }
+            if (project.password)
+            {
+                AppendBlock(out, "found", *project.password);
+            }
+            out += "end\n";
+            return out;
+        }
+
+        class Reader
+        {
+        public:
+            Reader(std::string_view text, const std::string& path)
+                : m_text(text)
+                , m_path(path)
+            {
+            }
+
+            std::string_view Line()
+            {
+                size_t end = m_text.find('\n', m_pos);
+                if (end == std::string_view::npos)
+                {
+                    Fail();
+                }
+                std::string_view line = m_text.substr(m_pos, end - m_pos);
+                m_pos = end + 1;
+                return line;
+            }
+
+            std::string_view Bytes(uint64_t size)
+            {
+                if (size >= m_text.size() - m_pos || m_text[m_pos + size] != '\n')
+                {
+                    Fail();
+                }
+                std::string_view bytes = m_text.substr(m_pos, static_cast<size_t>(size));
+                m_pos += static_cast<size_t>(size) + 1;
+                return bytes;
+            }
+
+            // Splits "key rest" and returns rest.
+            std::string_view Field(std::string_view line, std::string_view key)
+            {
+                if (line.size() <= key.size() || line.substr(0, key.size()) != key || line[key.size()] != ' ')
+                {
+                    Fail();
+                }
+                return line.substr(key.size() + 1);
+            }
+
+            // Parses a leading decimal number and drops it and one following
+            // space from text.
+            uint64_t Number(std::string_view& text)
+            {
+                uint64_t value = 0;
+                auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+                if (error != std::errc() || end == text.data())
+                {
+                    Fail();
+                }
+                text.remove_prefix(static_cast<size_t>(end - text.data()));
+                if (!text.empty())
+                {
+                    if (text[0] != ' ')
+                    {
+                        Fail();
+                    }
+                    text.remove_prefix(1);
+                }
+                return value;
+            }
+
+            uint32_t Number32(std::string_view& text)
+            {
+                uint64_t value = Number(text);
+                if (value > UINT32_MAX)
+                {
+                    Fail();
+                }
+                return static_cast<uint32_t>(value);
+            }
+
+            [[noreturn]] void Fail() const
+            {
+                throw std::runtime_error(m_path + ": damaged project file");
+            }
+
+        private:
+            std::string_view m_text;
+            const std::string& m_path;
+            size_t m_pos = 0;
+        };
+
+        void WriteAtomically(const std::string& path, const std::string& bytes)
+        {
+            std::string temporary = path + ".tmp";
+#ifdef _WIN32
+            std::wstring wideTemporary = Utf8ToWide(temporary);
+            HANDLE file = ::CreateFileW(wideTemporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                throw std::runtime_error("cannot create " + temporary);
+            }
+            DWORD written = 0;
+            bool ok = ::WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr)
+                && written == bytes.size()
+                && ::FlushFileBuffers(file);
+            ::CloseHandle(file);
+            if (!ok || !::MoveFileExW(wideTemporary.c_str(), Utf8ToWide(path).c_str(),
+                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            {
+                ::DeleteFileW(wideTemporary.c_str());
+                throw std::runtime_error("cannot write " + path);
+            }
+#else
+            int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+            {
+                throw std::runtime_error("cannot create " + temporary);
+            }
+            bool ok = true;
+            for (size_t done = 0; ok && done < bytes.size();)
+            {
+                ssize_t written = ::write(fd, bytes.data() + done, bytes.size() - done);
+                ok = written > 0;
+                done += ok ? static_cast<size_t>(written) : 0;
+            }
+            ok = ok && ::fsync(fd) == 0;
+            ok = ::close(fd) == 0 && ok;
+            if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+            {
+                ::unlink(temporary.c_str());
+                throw std::runtime_error("cannot write " + path);
+            }
+#endif
+        }
+    }
+
+    void SaveProject(const Project& project, const std::string& path)
+    {
+        WriteAtomically(path, Serialize(project));
+    }
+
+    Project LoadProject(const std::string& path)
+    {
+        MappedFile file(path);
+        return ParseProject(std::string_view(reinterpret_cast<const char*>(file.Data()), file.Size()), path);
+    }
+
+    std::string SerializeProject(const Project& project)
+    {
+        return Serialize(project);
+    }
+
+    Project ParseProject(std::string_view text, const std::string& path)
+    {
+        Reader reader(text, path);
+        if (text.substr(0, Magic.size() + 1) != std::string(Magic) + '\n')
+        {
+            throw std::runtime_error(path + ": not a runlock project");
+        }
+        reader.Line();
+
+        Project project;
+        std::string_view field = reader.Field(reader.Line(), "archive");
+        project.archiveSize = reader.Number(field);
+        project.archivePath = field;
+        field = reader.Field(reader.Line(), "bounds");
+        project.minLength = reader.Number32(field);
+        project.maxLength = reader.Number32(field);
+        field = reader.Field(reader.Line(), "threads");
+        project.threads = reader.Number32(field);
+        field = reader.Field(reader.Line(), "keyspace");
+        project.keyspaceSize = reader.Number(field);
+        field = reader.Field(reader.Line(), "rules");
+        project.rules = reader.Bytes(reader.Number(field));
+        std::string_view line = reader.Line();
+        if (line.substr(0, 7) == "markov ")
+        {
+            project.markovPath = reader.Field(line, "markov");
+            line = reader.Line();
+        }
+        field = reader.Field(line, "done");
+        for (uint64_t count = reader.Number(field); count > 0; --count)
+        {
+            std::string_view range = reader.Line();
+            uint64_t first = reader.Number(range);
+            uint64_t last = reader.Number(range);
+            if (first >= last || (project.keyspaceSize != 0 && last > project.keyspaceSize))
+            {
+                reader.Fail();
+            }
+            project.done.Add(first, last);
+        }
+        line = reader.Line();
+        if (line != "end")
+        {
+            field = reader.Field(line, "found");
+            project.password = std::string(reader.Bytes(reader.Number(field)));
+            if (reader.Line() != "end")
+            {
+                reader.Fail();
+            }
+        }
+        return project;
+    }
+}
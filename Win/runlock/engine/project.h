@@ -0,0 +1,42 @@
+#pragma once
+
+#include "range_set.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // A recovery job as saved by SaveProject_Click, `runlock-cli --project`
+    // and the engine's periodic checkpoints: what to run, and which
+    // candidates have already been tested.
+    struct Project
+    {
+        std::string archivePath;
+        uint64_t archiveSize = 0;       // to notice a different archive at the same path
+        std::string rules;              // PasswordRulesBox text
+        uint32_t minLength = 0;
+        uint32_t maxLength = 0;
+        std::string markovPath;         // EngineOptions::markovPath; the done ranges depend on it
+        uint32_t threads = 0;
+        uint64_t keyspaceSize = 0;      // of the compiled rules; 0 when not compiled yet
+        RangeSet done;                  // candidate indices already tested
+        std::optional<std::string> password;
+    };
+
+    // Writes the project to a temporary file next to `path`, flushes it to
+    // disk and renames it over `path`, so a crash at any point leaves either
+    // the previous or the new project. Throws std::runtime_error on failure.
+    void SaveProject(const Project& project, const std::string& path);
+
+    // Throws std::runtime_error when the file cannot be read or is not a
+    // project file.
+    Project LoadProject(const std::string& path);
+
+    // The project file format as text, for sending a job to cluster workers.
+    // ParseProject names `path` in its errors.
+    std::string SerializeProject(const Project& project);
+    Project ParseProject(std::string_view text, const std::string& path);
+}
@@ -0,0 +1,96 @@
+#include "range_set.h"
+
+#include <algorithm>
+
+namespace runlock::engine
+{
+    void RangeSet::Add(uint64_t first, uint64_t last)
+    {
+        if (first >= last)
+        {
+            return;
+        }
+        // Ranges ending before `first` stay in front; everything touching
+        // [first, last) is folded into it.
+        auto begin = std::lower_bound(m_ranges.begin(), m_ranges.end(), first,
+            [](const Range& range, uint64_t value) { return range.last < value; });
+        auto end = begin;
+        while (end != m_ranges.end() && end->first <= last)
+        {
+            first = std::min(first, end->first);
+            last = std::max(last, end->last);
+            ++end;
+        }
+        if (begin == end)
+        {
+            m_ranges.insert(begin, Range{ first, last });
+            return;
+        }
+        *begin = Range{ first, last };
+        m_ranges.erase(begin + 1, end);
+    }
+
+    void RangeSet::Add(const RangeSet& other)
+    {
+        for (const auto& range : other.m_ranges)
+        {
+            Add(range.first, range.last);
+        }
+    }
+
+    uint64_t RangeSet::Count() const
+    {
+        uint64_t count = 0;
+        for (const auto& range : m_ranges)
+        {
+            count += range.last - range.first;
+        }
+        return count;
+    }
+
+    RangeSet RangeSet::Complement(uint64_t size) const
+    {
+        RangeSet gaps;
+        uint64_t next = 0;
+        for (const auto& range : m_ranges)
+        {
+            if (range.first >= size)
+            {
+                break;
+            }
+            if (range.first > next)
+            {
+                gaps.m_ranges.push_back(Range{ next, range.first });
+            }
+            next = range.last;
+        }
+        if (next < size)
+        {
+            gaps.m_ranges.push_back(Range{ next, size });
+        }
+        return gaps;
+    }
+
+    RangeSet RangeSet::Slice(uint64_t skip, uint64_t count) const
+    {
+        RangeSet slice;
+        for (const auto& range : m_ranges)
+        {
+            if (count == 0)
+            {
+                break;
+            }
+            uint64_t size = range.last - range.first;
+            if (skip >= size)
+            {
+                skip -= size;
+                continue;
+            }
+            uint64_t take = std::min(size - skip, count);
+            slice.m_ranges.push_back(Range{ range.first + skip, range.first + skip + take });
+            count -= take;
+            skip = 0;
+        }
+        return slice;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Candidate indices as sorted, disjoint, non-adjacent half-open ranges.
+    // Records which parts of a keyspace have been tested; a run over any
+    // order of batches collapses to a handful of ranges.
+    class RangeSet
+    {
+    public:
+        struct Range
+        {
+            uint64_t first;
+            uint64_t last;
+        };
+
+        void Add(uint64_t first, uint64_t last);
+        void Add(const RangeSet& other);
+
+        bool Empty() const { return m_ranges.empty(); }
+        const std::vector<Range>& Ranges() const { return m_ranges; }
+
+        // Number of indices in the set.
+        uint64_t Count() const;
+
+        // Largest index in the set plus one, or 0 when empty.
+        uint64_t End() const { return m_ranges.empty() ? 0 : m_ranges.back().last; }
+
+        // The indices of [0, size) that are not in the set.
+        RangeSet Complement(uint64_t size) const;
+
+        // The members at positions [skip, skip + count) when the set is
+        // walked in ascending order.
+        RangeSet Slice(uint64_t skip, uint64_t count) const;
+
+    private:
+        std::vector<Range> m_ranges;
+    };
+}
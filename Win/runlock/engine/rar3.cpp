@@ -0,0 +1,599 @@
+#include "rar3.h"
+#include "aes.h"
+#include "candidate_batch.h"
+#include "crc32.h"
+#include "mapped_file.h"
+#include "rar_headers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // Enough for the block flags and Huffman tables of an LZ block.
+        constexpr size_t CompressedCheckBytes = 4096;
+
+        // Largest RAR 1.5 layout header (16-bit size), padded to AES blocks.
+        constexpr size_t HeaderCheckBytes = 0x10000;
+
+        // RAR 2.9 LZ tables: bit lengths of the code that encodes the main
+        // table lengths, then literal/length, distance, low distance and
+        // repeat length codes.
+        constexpr size_t BitLengthCodes = 20;
+        constexpr size_t TableSizes[] = { 299, 60, 17, 28 };
+        constexpr size_t MainTableSize = 299 + 60 + 17 + 28;
+
+        constexpr uint32_t MethodStored = 0x30;
+
+        size_t WholeBlocks(uint64_t size)
+        {
+            return static_cast<size_t>(size - size % AesBlockSize);
+        }
+
+        static_assert(CompressedCheckBytes <= HeaderCheckBytes);
+
+        // Decrypts the target's ciphertext on demand, so a key that fails on
+        // the first AES block costs a single block decryption. Probes keep at
+        // most HeaderCheckBytes of ciphertext, so the plaintext fits a fixed
+        // buffer (on the verifying thread's stack) and a candidate never
+        // touches the heap.
+        class PlainStream
+        {
+        public:
+            PlainStream(const Aes& aes, const uint8_t iv[AesBlockSize], const std::vector<uint8_t>& cipher)
+                : m_aes(aes)
+                , m_cipher(cipher.data())
+                , m_cipherSize(std::min(cipher.size(), HeaderCheckBytes))
+            {
+                std::memcpy(m_iv, iv, sizeof(m_iv));
+            }
+
+            // Makes the first size bytes available; false past the ciphertext.
+            bool Need(size_t size)
+            {
+                if (size <= m_ready)
+                {
+                    return true;
+                }
+                size_t want = (size + AesBlockSize - 1) / AesBlockSize * AesBlockSize;
+                if (want > m_cipherSize)
+                {
+                    return false;
+                }
+                AesCbcDecrypt(m_aes, m_iv, m_cipher + m_ready, m_plain + m_ready, want - m_ready);
+                m_ready = want;
+                return true;
+            }
+
+            const uint8_t* Data() const { return m_plain; }
+
+        private:
+            const Aes& m_aes;
+            const uint8_t* m_cipher;
+            size_t m_cipherSize;
+            size_t m_ready = 0;
+            uint8_t m_iv[AesBlockSize];
+            uint8_t m_plain[HeaderCheckBytes];
+        };
+
+        // MSB-first bit input as UnRAR's BitInput reads it.
+        class BitReader
+        {
+        public:
+            explicit BitReader(PlainStream& plain)
+                : m_plain(plain)
+            {
+            }
+
+            uint32_t Peek16()
+            {
+                size_t byte = m_bit / 8;
+                if (!m_plain.Need(byte + 3))
+                {
+                    m_ok = false;
+                    return 0;
+                }
+                const uint8_t* p = m_plain.Data() + byte;
+                uint32_t window = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+                return (window >> (8 - m_bit % 8)) & 0xffff;
+            }
+
+            uint32_t Take(uint32_t count)
+            {
+                uint32_t value = Peek16() >> (16 - count);
+                m_bit += count;
+                return value;
+            }
+
+            void Skip(uint32_t count) { m_bit += count; }
+
+            // False once a read ran past the ciphertext: the data ended before
+            // the check could decide.
+            bool Ok() const { return m_ok; }
+
+        private:
+            PlainStream& m_plain;
+            size_t m_bit = 0;
+            bool m_ok = true;
+        };
+
+        // Kraft sum of a code, in units of 2^-15. A code from a real encoder
+        // never exceeds 1 (1 << 15).
+        uint32_t KraftSum(const uint8_t* lengths, size_t count)
+        {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (lengths[i] != 0)
+                {
+                    sum += 1u << (15 - lengths[i]);
+                }
+            }
+            return sum;
+        }
+
+        // Canonical Huffman decoding laid out like UnRAR's DecodeLen /
+        // DecodePos tables, except that codes no symbol owns are reported
+        // instead of being mapped to symbol 0.
+        class HuffmanTable
+        {
+        public:
+            // False for an empty or over-subscribed code.
+            bool Build(const uint8_t* lengths, size_t count)
+            {
+                uint32_t sum = KraftSum(lengths, count);
+                if (sum == 0 || sum > (1u << 15))
+                {
+                    return false;
+                }
+
+                uint32_t counts[16] = {};
+                for (size_t i = 0; i < count; ++i)
+                {
+                    ++counts[lengths[i] & 15];
+                }
+                counts[0] = 0;
+                uint32_t upper = 0;
+                m_limit[0] = 0;
+                m_position[0] = 0;
+                for (int length = 1; length < 16; ++length)
+                {
+                    upper += counts[length];
+                    m_limit[length] = upper << (16 - length);
+                    upper *= 2;
+                    m_position[length] = m_position[length - 1] + counts[length - 1];
+                }
+
+                uint32_t next[16];
+                std::memcpy(next, m_position, sizeof(next));
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (lengths[i] != 0)
+                    {
+                        m_symbols[next[lengths[i]]++] = static_cast<uint16_t>(i);
+                    }
+                }
+                return true;
+            }
+
+            // The next symbol, or -1 for a code outside the table.
+            int Decode(BitReader& bits) const
+            {
+                uint32_t field = bits.Peek16() & 0xfffe;
+                for (uint32_t length = 1; length < 16; ++length)
+                {
+                    if (field < m_limit[length])
+                    {
+                        uint32_t offset = (field - m_limit[length - 1]) >> (16 - length);
+                        bits.Skip(length);
+                        return m_symbols[m_position[length] + offset];
+                    }
+                }
+                return -1;
+            }
+
+        private:
+            uint32_t m_limit[16];
+            uint32_t m_position[16];
+            uint16_t m_symbols[MainTableSize];
+        };
+
+        bool CheckHeader(PlainStream& plain)
+        {
+            if (!plain.Need(AesBlockSize))
+            {
+                return true;
+            }
+            const uint8_t* p = plain.Data();
+            uint32_t crc = p[0] | (uint32_t(p[1]) << 8);
+            uint8_t type = p[2];
+            uint32_t size = p[5] | (uint32_t(p[6]) << 8);
+            // File, old-style subblocks, service or end of archive.
+            if (type < 0x74 || type > 0x7b || size < 7)
+            {
+                return false;
+            }
+            if (!plain.Need(size))
+            {
+                return false;
+            }
+            return (Crc32(plain.Data() + 2, size - 2) & 0xffff) == crc;
+        }
+
+        bool ProbeConclusive(const Rar3Probe& probe)
+        {
+            return probe.method == MethodStored && probe.unpSize != 0 && probe.cipher.size() >= probe.unpSize;
+        }
+
+        bool CheckStored(const Rar3Probe& target, const Aes& aes, const Rar3Keys& keys)
+        {
+            uint8_t iv[AesBlockSize];
+            std::memcpy(iv, keys.iv, sizeof(iv));
+            uint8_t chunk[4096];
+            uint32_t crc = 0;
+            uint64_t left = target.unpSize;
+            for (size_t offset = 0; left != 0; offset += sizeof(chunk))
+            {
+                size_t size = std::min(sizeof(chunk), target.cipher.size() - offset);
+                AesCbcDecrypt(aes, iv, target.cipher.data() + offset, chunk, size);
+                size_t used = static_cast<size_t>(std::min<uint64_t>(size, left));
+                crc = Crc32(chunk, used, crc);
+                left -= used;
+            }
+            return crc == target.dataCrc;
+        }
+
+        bool Rar3Usable(const FileView& file)
+        {
+            return file.encrypted && !file.directory && file.crypt.version >= 29;
+        }
+
+        Rar3Probe ReadProbe(const BlockView& block, const FileView& file, const uint8_t* end)
+        {
+            Rar3Probe probe;
+            probe.unpSize = file.unpSize;
+            probe.dataCrc = file.dataCrc;
+            probe.method = file.method;
+            // A solid entry continues the previous entry's stream without
+            // a block header, so there is nothing to check.
+            uint64_t keep = file.solid ? 0 : CompressedCheckBytes;
+            if (file.method == MethodStored)
+            {
+                bool whole = file.packSize <= Rar3StoredCheckLimit && !file.splitBefore && !file.splitAfter;
+                keep = whole ? file.packSize : 0;
+            }
+            const uint8_t* data = block.Data();
+            keep = std::min<uint64_t>({ keep, file.packSize, static_cast<uint64_t>(end - data) });
+            probe.cipher.assign(data, data + WholeBlocks(keep));
+            return probe;
+        }
+
+        // The start of a RAR 2.9 compressed stream is a block header: a PPM
+        // flag byte, or the LZ flags followed by Huffman table lengths
+        // (Unpack::ReadTables30). Random data almost never makes a
+        // consistent set of codes.
+        bool CheckCompressed(PlainStream& plain)
+        {
+            if (!plain.Need(AesBlockSize))
+            {
+                return true;
+            }
+            uint8_t flags = plain.Data()[0];
+            if (flags & 0x80)
+            {
+                // The first PPM block of a stream resets the model, and
+                // UnRAR refuses model order 1.
+                return (flags & 0x20) && (flags & 0x1f) != 0;
+            }
+
+            BitReader bits(plain);
+            bits.Skip(2);
+            uint8_t bitLengths[BitLengthCodes] = {};
+            for (size_t i = 0; i < BitLengthCodes; ++i)
+            {
+                uint32_t length = bits.Take(4);
+                if (length == 15)
+                {
+                    uint32_t zeros = bits.Take(4);
+                    if (zeros == 0)
+                    {
+                        bitLengths[i] = 15;
+                    }
+                    else
+                    {
+                        for (zeros += 2; zeros > 0 && i < BitLengthCodes; --zeros)
+                        {
+                            bitLengths[i++] = 0;
+                        }
+                        --i;
+                    }
+                }
+                else
+                {
+                    bitLengths[i] = static_cast<uint8_t>(length);
+                }
+            }
+            if (!bits.Ok())
+            {
+                return true;
+            }
+
+            HuffmanTable lengthCode;
+            if (!lengthCode.Build(bitLengths, BitLengthCodes))
+            {
+                return false;
+            }
+            uint8_t table[MainTableSize];
+            for (size_t i = 0; i < MainTableSize;)
+            {
+                int symbol = lengthCode.Decode(bits);
+                if (!bits.Ok())
+                {
+                    return true;
+                }
+                if (symbol < 0)
+                {
+                    return false;
+                }
+                if (symbol < 16)
+                {
+                    table[i++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+                uint32_t run = symbol == 16 || symbol == 18 ? bits.Take(3) + 3 : bits.Take(7) + 11;
+                if (symbol < 18)
+                {
+                    if (i == 0)
+                    {
+                        return false;   // nothing to repeat
+                    }
+                    for (; run > 0 && i < MainTableSize; --run, ++i)
+                    {
+                        table[i] = table[i - 1];
+                    }
+                }
+                else
+                {
+                    for (; run > 0 && i < MainTableSize; --run)
+                    {
+                        table[i++] = 0;
+                    }
+                }
+            }
+            if (!bits.Ok())
+            {
+                return true;
+            }
+
+            const uint8_t* part = table;
+            for (size_t size : TableSizes)
+            {
+                if (KraftSum(part, size) > (1u << 15))
+                {
+                    return false;
+                }
+                part += size;
+            }
+            return true;
+        }
+    }
+
+    bool Rar3Target::Conclusive() const
+    {
+        return headers || std::any_of(probes.begin(), probes.end(), ProbeConclusive);
+    }
+
+    std::optional<Rar3Target> ReadRar3Target(const std::string& path, int targetIndex)
+    {
+        MappedFile archive;
+        try
+        {
+            archive = MappedFile(path);
+        }
+        catch (const std::runtime_error&)
+        {
+            return std::nullopt;
+        }
+
+        RarHeaderParser parser(archive.Data(), archive.Size());
+        if (parser.Format() != RarFormat::Rar15)
+        {
+            return std::nullopt;
+        }
+
+        // Finds the target, then takes further probes from entries that use
+        // the same salt.
+        std::optional<Rar3Target> target;
+        const uint8_t* end = archive.Data() + archive.Size();
+        int fileIndex = -1;
+        BlockView block;
+        FileView file;
+        while (!target && parser.Next(block))
+        {
+            if (block.kind != BlockKind::File || ++fileIndex < targetIndex)
+            {
+                continue;
+            }
+            if (!DecodeFile(block, file) || !Rar3Usable(file))
+            {
+                if (targetIndex < 0)
+                {
+                    continue;
+                }
+                return std::nullopt;
+            }
+            target.emplace();
+            if (file.crypt.salt != nullptr)
+            {
+                std::memcpy(target->salt, file.crypt.salt, Rar3SaltSize);
+                target->hasSalt = true;
+            }
+            target->probes.push_back(ReadProbe(block, file, end));
+        }
+        if (target)
+        {
+            RarHeaderParser others(archive.Data(), archive.Size());
+            int otherIndex = -1;
+            while (target->probes.size() < Rar3MaxProbes && others.Next(block))
+            {
+                if (block.kind != BlockKind::File || ++otherIndex == fileIndex || !DecodeFile(block, file)
+                    || !Rar3Usable(file) || (file.crypt.salt != nullptr) != target->hasSalt
+                    || (target->hasSalt && std::memcmp(file.crypt.salt, target->salt, Rar3SaltSize) != 0))
+                {
+                    continue;
+                }
+                Rar3Probe probe = ReadProbe(block, file, end);
+                if (!probe.cipher.empty())
+                {
+                    target->probes.push_back(std::move(probe));
+                }
+            }
+            return target;
+        }
+
+        if (auto encrypted = parser.EncryptedHeaders(); encrypted != nullptr && encrypted->crypt.salt != nullptr)
+        {
+            target.emplace();
+            std::memcpy(target->salt, encrypted->crypt.salt, Rar3SaltSize);
+            target->hasSalt = true;
+            target->headers = true;
+            size_t keep = std::min(encrypted->available, HeaderCheckBytes);
+            Rar3Probe probe;
+            probe.cipher.assign(encrypted->first, encrypted->first + WholeBlocks(keep));
+            target->probes.push_back(std::move(probe));
+        }
+        return target;
+    }
+
+    bool Rar3KeyPlausible(const Rar3Target& target, const Rar3Keys& keys)
+    {
+        Aes aes(keys.key, 128);
+        for (const auto& probe : target.probes)
+        {
+            if (probe.cipher.empty())
+            {
+                continue;
+            }
+            bool ok;
+            if (target.headers)
+            {
+                PlainStream plain(aes, keys.iv, probe.cipher);
+                ok = CheckHeader(plain);
+            }
+            else if (probe.method == MethodStored)
+            {
+                ok = !ProbeConclusive(probe) || CheckStored(probe, aes, keys);
+            }
+            else
+            {
+                PlainStream plain(aes, keys.iv, probe.cipher);
+                ok = CheckCompressed(plain);
+            }
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Rar3Verifier::Rar3Verifier(std::shared_ptr<const Rar3Target> target, std::unique_ptr<Verifier> confirm)
+        : m_target(target)
+        , m_kernel(SelectRar3Kernel())
+        , m_lanes(m_kernel.lanes)
+        , m_keys(m_kernel.lanes)
+    {
+        m_order.reserve(PreferredBatch());
+        Share(std::move(target), std::move(confirm));
+    }
+
+    void Rar3Verifier::Share(std::shared_ptr<const Rar3Target> target, std::unique_ptr<Verifier> confirm)
+    {
+        m_members.push_back(Member{ std::move(target), std::move(confirm) });
+    }
+
+    bool Rar3Verifier::Accept(std::string_view password, const Rar3Keys& keys)
+    {
+        for (auto& member : m_members)
+        {
+            if (Rar3KeyPlausible(*member.target, keys) && (member.confirm == nullptr || member.confirm->Verify(password)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Rar3Verifier::Verify(std::string_view password)
+    {
+        Rar3Keys keys;
+        DeriveRar3Keys(password, m_target->hasSalt ? m_target->salt : nullptr, keys);
+        return Accept(password, keys);
+    }
+
+    size_t Rar3Verifier::VerifyBatch(CandidateBatch& batch, size_t first, size_t count)
+    {
+        // The batch encodes its candidates once, however many calls it takes.
+        m_order.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_order[i] = first + i;
+        }
+        std::sort(m_order.begin(), m_order.end(), [&](size_t a, size_t b)
+            {
+                size_t sizeA = batch.Utf16Size(a);
+                size_t sizeB = batch.Utf16Size(b);
+                return sizeA != sizeB ? sizeA < sizeB : a < b;
+            });
+
+        // Derive every group of equal-length candidates; collect the few
+        // plausible keys and confirm them in candidate order.
+        const uint8_t* salt = m_target->hasSalt ? m_target->salt : nullptr;
+        m_plausible.clear();
+        for (size_t begin = 0; begin < count;)
+        {
+            size_t size = batch.Utf16Size(m_order[begin]);
+            size_t end = begin + 1;
+            while (end < count && end - begin < m_kernel.lanes && batch.Utf16Size(m_order[end]) == size)
+            {
+                ++end;
+            }
+            for (size_t lane = 0; lane < m_kernel.lanes; ++lane)
+            {
+                m_lanes[lane] = batch.Utf16(m_order[std::min(begin + lane, end - 1)]);
+            }
+            m_kernel.derive(m_lanes.data(), size, salt, m_keys.data());
+            for (size_t k = begin; k < end; ++k)
+            {
+                for (size_t m = 0; m < m_members.size(); ++m)
+                {
+                    if (Rar3KeyPlausible(*m_members[m].target, m_keys[k - begin]))
+                    {
+                        m_plausible.emplace_back(m_order[k], m);
+                    }
+                }
+            }
+            begin = end;
+        }
+
+        std::sort(m_plausible.begin(), m_plausible.end());
+        for (auto [index, m] : m_plausible)
+        {
+            if (m_members[m].confirm == nullptr || m_members[m].confirm->Verify(batch[index]))
+            {
+                return index;
+            }
+        }
+        return NoMatch;
+    }
+
+    size_t Rar3Verifier::PreferredBatch() const
+    {
+        // Wider than the kernel so candidates of mixed lengths still fill lanes.
+        return m_kernel.lanes * 4;
+    }
+}
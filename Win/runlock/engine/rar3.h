@@ -0,0 +1,95 @@
+#pragma once
+
+#include "rar3_kdf.h"
+#include "verifier.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Stored entries up to this size are decrypted whole and CRC-checked.
+    constexpr uint64_t Rar3StoredCheckLimit = 1 << 20;
+
+    // At most this many entries sharing the target's salt are checked.
+    constexpr size_t Rar3MaxProbes = 8;
+
+    // The leading ciphertext of one encrypted entry (or of the first
+    // encrypted header) and what is known about its plaintext. Only as much
+    // ciphertext as the check can use is kept.
+    struct Rar3Probe
+    {
+        std::vector<uint8_t> cipher;    // whole AES blocks from the start of the data
+        uint64_t unpSize = 0;
+        uint32_t dataCrc = 0;
+        uint32_t method = 0;            // 0x30 (stored) to 0x35
+    };
+
+    // What a RAR 2.9-4.x key is tried against: the first encrypted header
+    // of an archive with encrypted headers, or the target entry followed by
+    // other entries that use the same salt. Key and IV depend only on the
+    // password and the salt, so every extra probe is an independent test
+    // that costs no extra key derivation.
+    struct Rar3Target
+    {
+        uint8_t salt[Rar3SaltSize] = {};
+        bool hasSalt = false;
+        bool headers = false;
+        std::vector<Rar3Probe> probes;
+
+        // True when a passing check includes a CRC match rather than only
+        // plausibility tests of compressed data.
+        bool Conclusive() const;
+    };
+
+    // Reads the target entry (as ReadRar5Crypto does) of a RAR 1.5 layout
+    // archive whose entries or headers use the RAR 2.9 AES scheme. Returns
+    // nullopt for anything else, including the older RAR 1.5 / 2.0 ciphers.
+    std::optional<Rar3Target> ReadRar3Target(const std::string& path, int targetIndex);
+
+    // Decrypts the start of every probe with the derived keys and checks
+    // it: header type, size and CRC for encrypted headers; the CRC for small
+    // stored entries; the block flags and Huffman tables of the first LZ
+    // block, or the PPM model flags, for compressed ones. Most wrong keys
+    // fail on the first AES block.
+    bool Rar3KeyPlausible(const Rar3Target& target, const Rar3Keys& keys);
+
+    // Runs the key schedule over whole batches (grouped by encoded length,
+    // which the multi-lane kernels require) and passes only keys that
+    // survive Rar3KeyPlausible() to the confirming verifier.
+    class Rar3Verifier : public Verifier
+    {
+    public:
+        Rar3Verifier(std::shared_ptr<const Rar3Target> target, std::unique_ptr<Verifier> confirm);
+
+        // Adds another archive with the same salt (batch runs): every
+        // derived key is checked against its probes as well.
+        void Share(std::shared_ptr<const Rar3Target> target, std::unique_ptr<Verifier> confirm);
+
+        bool Verify(std::string_view password) override;
+        size_t VerifyBatch(CandidateBatch& batch, size_t first, size_t count) override;
+        size_t PreferredBatch() const override;
+
+    private:
+        struct Member
+        {
+            std::shared_ptr<const Rar3Target> target;
+            std::unique_ptr<Verifier> confirm;
+        };
+
+        bool Accept(std::string_view password, const Rar3Keys& keys);
+
+        std::shared_ptr<const Rar3Target> m_target;     // the first member's, for the salt
+        std::vector<Member> m_members;
+        const Rar3KdfKernel& m_kernel;
+        std::vector<size_t> m_order;
+        std::vector<const uint8_t*> m_lanes;
+        std::vector<Rar3Keys> m_keys;
+        std::vector<std::pair<size_t, size_t>> m_plausible;     // (candidate, member)
+    };
+}
@@ -0,0 +1,133 @@
+#include "rar3_kdf.h"
+#include "kdf_kernels.h"
+#include "sha1.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // The portable kernel is the lane template with one scalar lane.
+        constexpr size_t Lanes = 1;
+        using Vec = uint32_t;
+
+        inline Vec Set1(uint32_t x) { return x; }
+        inline Vec Add(Vec a, Vec b) { return a + b; }
+        inline Vec Xor(Vec a, Vec b) { return a ^ b; }
+        inline Vec Xor3(Vec a, Vec b, Vec c) { return a ^ b ^ c; }
+        inline Vec Ch(Vec e, Vec f, Vec g) { return g ^ (e & (f ^ g)); }
+        inline Vec Maj(Vec a, Vec b, Vec c) { return (a & b) | (c & (a | b)); }
+        template<int N> Vec Rotr(Vec x) { return (x >> N) | (x << (32 - N)); }
+        inline Vec Load(const uint32_t* p) { return *p; }
+        inline void Store(uint32_t* p, Vec v) { *p = v; }
+
+#include "rar3_kdf_lanes.inl"
+
+        const Rar3KdfKernel ScalarKernel{ "scalar", 1, DeriveRar3KeysScalar };
+#ifdef RUNLOCK_X86
+        const Rar3KdfKernel Avx2Kernel{ "avx2", Avx2Lanes, DeriveRar3KeysAvx2 };
+        const Rar3KdfKernel Avx512Kernel{ "avx512", Avx512Lanes, DeriveRar3KeysAvx512 };
+#endif
+
+        double Measure(const Rar3KdfKernel& kernel)
+        {
+            const uint8_t salt[Rar3SaltSize] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+            std::vector<std::string> passwords(kernel.lanes);
+            std::vector<const uint8_t*> pointers(kernel.lanes);
+            for (size_t lane = 0; lane < kernel.lanes; ++lane)
+            {
+                passwords[lane] = EncodeRar3Password("calib-" + std::to_string(lane % 10));
+                pointers[lane] = reinterpret_cast<const uint8_t*>(passwords[lane].data());
+            }
+            const size_t size = passwords[0].size();
+
+            // A derivation takes milliseconds, so only the outer lanes are
+            // checked against the portable kernel.
+            std::vector<Rar3Keys> out(kernel.lanes);
+            kernel.derive(pointers.data(), size, salt, out.data());
+            for (size_t lane : { size_t(0), kernel.lanes - 1 })
+            {
+                Rar3Keys expected;
+                DeriveRar3KeysScalar(&pointers[lane], size, salt, &expected);
+                if (std::memcmp(&expected, &out[lane], sizeof(expected)) != 0)
+                {
+                    return 0;
+                }
+            }
+            return MeasureThroughput(kernel.lanes, 0,
+                [&] { kernel.derive(pointers.data(), size, salt, out.data()); });
+        }
+    }
+
+    void DeriveRar3KeysScalar(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out)
+    {
+        DeriveRar3Lanes(passwords, size, salt, out);
+    }
+
+    size_t EncodeRar3Password(std::string_view password, uint8_t* out)
+    {
+        size_t size = 0;
+        auto put = [&](uint32_t unit)
+        {
+            if (size < Rar3MaxPasswordBytes)
+            {
+                out[size++] = static_cast<uint8_t>(unit & 0xff);
+                out[size++] = static_cast<uint8_t>(unit >> 8);
+            }
+        };
+        for (size_t pos = 0; pos < password.size() && size < Rar3MaxPasswordBytes;)
+        {
+            char32_t cp = DecodeUtf8(password, pos);
+            if (cp >= 0x10000)
+            {
+                put(0xd800 + ((cp - 0x10000) >> 10));
+                put(0xdc00 + ((cp - 0x10000) & 0x3ff));
+            }
+            else
+            {
+                put(cp);
+            }
+        }
+        return size;
+    }
+
+    std::string EncodeRar3Password(std::string_view password)
+    {
+        std::string encoded(std::min(2 * password.size(), Rar3MaxPasswordBytes), '\0');
+        encoded.resize(EncodeRar3Password(password, reinterpret_cast<uint8_t*>(encoded.data())));
+        return encoded;
+    }
+
+    std::vector<const Rar3KdfKernel*> AvailableRar3Kernels()
+    {
+        std::vector<const Rar3KdfKernel*> kernels{ &ScalarKernel };
+#ifdef RUNLOCK_X86
+        const CpuFeatures& cpu = DetectCpuFeatures();
+        if (cpu.avx2)
+        {
+            kernels.push_back(&Avx2Kernel);
+        }
+        if (cpu.avx512)
+        {
+            kernels.push_back(&Avx512Kernel);
+        }
+#endif
+        return kernels;
+    }
+
+    const Rar3KdfKernel& SelectRar3Kernel()
+    {
+        static const Rar3KdfKernel& kernel = ChooseKernel(AvailableRar3Kernels(), Measure);
+        return kernel;
+    }
+
+    void DeriveRar3Keys(std::string_view password, const uint8_t* salt, Rar3Keys& keys)
+    {
+        std::string encoded = EncodeRar3Password(password);
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(encoded.data());
+        DeriveRar3KeysScalar(&data, encoded.size(), salt, &keys);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    constexpr size_t Rar3SaltSize = 8;
+
+    // UnRAR keeps at most MAXPASSWORD - 1 = 511 UTF-16 units of a password.
+    constexpr size_t Rar3MaxPasswordBytes = 2 * 511;
+
+    // AES-128 key and CBC IV of a RAR 2.9-4.x encrypted entry or header.
+    struct Rar3Keys
+    {
+        uint8_t key[16];
+        uint8_t iv[16];
+    };
+
+    // The password bytes the RAR 2.9 key schedule hashes: UTF-16LE, cut at
+    // the UnRAR limit.
+    std::string EncodeRar3Password(std::string_view password);
+
+    // The same into out, which has room for min(2 * password.size(),
+    // Rar3MaxPasswordBytes) bytes; returns the size.
+    size_t EncodeRar3Password(std::string_view password, uint8_t* out);
+
+    // The RAR 2.9-4.x key schedule: 2^18 SHA-1 rounds over password, salt
+    // and a round counter, with the IV taken from intermediate digests.
+    // Works on `lanes` encoded passwords at once, all of the same size, so
+    // the lanes' block boundaries coincide. salt may be nullptr (unsalted).
+    struct Rar3KdfKernel
+    {
+        const char* name;
+        size_t lanes;
+        void (*derive)(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out);
+    };
+
+    std::vector<const Rar3KdfKernel*> AvailableRar3Kernels();
+
+    // Chosen like SelectRar5Kernel().
+    const Rar3KdfKernel& SelectRar3Kernel();
+
+    void DeriveRar3Keys(std::string_view password, const uint8_t* salt, Rar3Keys& keys);
+}
@@ -0,0 +1,208 @@
+// RAR 2.9-4.x key schedule over Lanes passwords of equal length, one per
+// vector lane. Included after the operations listed in rar5_kdf_lanes.inl.
+
+// SHA-1 compression of one block per lane. w holds the message words on
+// entry and W[64..79] on exit.
+inline void Sha1CompressLanes(Vec state[5], Vec w[16])
+{
+    Vec a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+#if defined(__GNUC__)
+#pragma GCC unroll 80
+#endif
+    for (int i = 0; i < 80; ++i)
+    {
+        if (i >= 16)
+        {
+            w[i & 15] = Rotr<31>(Xor(Xor3(w[(i - 3) & 15], w[(i - 8) & 15], w[(i - 14) & 15]), w[i & 15]));
+        }
+        Vec f;
+        uint32_t k;
+        if (i < 20)
+        {
+            f = Ch(b, c, d);
+            k = 0x5a827999;
+        }
+        else if (i < 40)
+        {
+            f = Xor3(b, c, d);
+            k = 0x6ed9eba1;
+        }
+        else if (i < 60)
+        {
+            f = Maj(b, c, d);
+            k = 0x8f1bbcdc;
+        }
+        else
+        {
+            f = Xor3(b, c, d);
+            k = 0xca62c1d6;
+        }
+        Vec t = Add(Add(Rotr<27>(a), f), Add(Add(e, Set1(k)), w[i & 15]));
+        e = d;
+        d = c;
+        c = Rotr<2>(b);
+        b = a;
+        a = t;
+    }
+    state[0] = Add(state[0], a); state[1] = Add(state[1], b); state[2] = Add(state[2], c);
+    state[3] = Add(state[3], d); state[4] = Add(state[4], e);
+}
+
+inline void LoadBlocks(Vec w[16], uint8_t* const blocks[Lanes])
+{
+    alignas(64) uint32_t words[16][Lanes];
+    for (size_t i = 0; i < Lanes; ++i)
+    {
+        const uint8_t* p = blocks[i];
+        for (int k = 0; k < 16; ++k, p += 4)
+        {
+            words[k][i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+    }
+    for (int k = 0; k < 16; ++k)
+    {
+        w[k] = Load(words[k]);
+    }
+}
+
+// Writes W[64..79] over the block in little-endian order: UnRAR's
+// sha1_process_rar29 does this to every block it hashes straight from the
+// password buffer, which changes the input of later rounds.
+inline void StoreSchedule(const Vec w[16], uint8_t* const blocks[Lanes])
+{
+    alignas(64) uint32_t words[16][Lanes];
+    for (int k = 0; k < 16; ++k)
+    {
+        Store(words[k], w[k]);
+    }
+    for (size_t i = 0; i < Lanes; ++i)
+    {
+        uint8_t* p = blocks[i];
+        for (int k = 0; k < 16; ++k, p += 4)
+        {
+            uint32_t v = words[k][i];
+            p[0] = uint8_t(v);
+            p[1] = uint8_t(v >> 8);
+            p[2] = uint8_t(v >> 16);
+            p[3] = uint8_t(v >> 24);
+        }
+    }
+}
+
+// Finishes a copy of every lane's hash and returns its digest words.
+inline void FinishLanes(const Vec state[5], const uint8_t buffer[][Sha1BlockSize], size_t used, uint64_t length,
+    uint32_t digests[][5])
+{
+    alignas(64) uint32_t words[5][Lanes];
+    for (int k = 0; k < 5; ++k)
+    {
+        Store(words[k], state[k]);
+    }
+    for (size_t i = 0; i < Lanes; ++i)
+    {
+        for (int k = 0; k < 5; ++k)
+        {
+            digests[i][k] = words[k][i];
+        }
+        Sha1Finish(digests[i], buffer[i], used, length);
+    }
+}
+
+void DeriveRar3Lanes(const uint8_t* const* passwords, size_t size, const uint8_t* salt, Rar3Keys* out)
+{
+    constexpr uint32_t Rounds = 0x40000;
+    const size_t rawSize = size + (salt != nullptr ? Rar3SaltSize : 0);
+
+    uint8_t raw[Lanes][Rar3MaxPasswordBytes + Rar3SaltSize];
+    uint8_t buffer[Lanes][Sha1BlockSize];
+    uint8_t* bufferBlocks[Lanes];
+    uint8_t* rawBlocks[Lanes];
+    for (size_t i = 0; i < Lanes; ++i)
+    {
+        std::memcpy(raw[i], passwords[i], size);
+        if (salt != nullptr)
+        {
+            std::memcpy(raw[i] + size, salt, Rar3SaltSize);
+        }
+        bufferBlocks[i] = buffer[i];
+    }
+
+    uint32_t initial[5];
+    Sha1Init(initial);
+    Vec state[5];
+    for (int k = 0; k < 5; ++k)
+    {
+        state[k] = Set1(initial[k]);
+    }
+
+    Vec w[16];
+    uint32_t digests[Lanes][5];
+    size_t used = 0;
+    uint64_t length = 0;
+    for (uint32_t round = 0; round < Rounds; ++round)
+    {
+        // Password and salt through sha1_process_rar29.
+        size_t taken = 0;
+        if (used + rawSize >= Sha1BlockSize)
+        {
+            taken = Sha1BlockSize - used;
+            for (size_t i = 0; i < Lanes; ++i)
+            {
+                std::memcpy(buffer[i] + used, raw[i], taken);
+            }
+            LoadBlocks(w, bufferBlocks);
+            Sha1CompressLanes(state, w);
+            for (; taken + Sha1BlockSize <= rawSize; taken += Sha1BlockSize)
+            {
+                for (size_t i = 0; i < Lanes; ++i)
+                {
+                    rawBlocks[i] = raw[i] + taken;
+                }
+                LoadBlocks(w, rawBlocks);
+                Sha1CompressLanes(state, w);
+                StoreSchedule(w, rawBlocks);
+            }
+            used = 0;
+        }
+        for (size_t i = 0; i < Lanes; ++i)
+        {
+            std::memcpy(buffer[i] + used, raw[i] + taken, rawSize - taken);
+        }
+        used += rawSize - taken;
+
+        // Then the 3-byte little-endian round number, hashed normally.
+        const uint8_t counter[3] = { uint8_t(round), uint8_t(round >> 8), uint8_t(round >> 16) };
+        for (uint8_t byte : counter)
+        {
+            for (size_t i = 0; i < Lanes; ++i)
+            {
+                buffer[i][used] = byte;
+            }
+            if (++used == Sha1BlockSize)
+            {
+                LoadBlocks(w, bufferBlocks);
+                Sha1CompressLanes(state, w);
+                used = 0;
+            }
+        }
+        length += rawSize + 3;
+
+        if (round % (Rounds / 16) == 0)
+        {
+            FinishLanes(state, buffer, used, length, digests);
+            for (size_t i = 0; i < Lanes; ++i)
+            {
+                out[i].iv[round / (Rounds / 16)] = static_cast<uint8_t>(digests[i][4]);
+            }
+        }
+    }
+
+    FinishLanes(state, buffer, used, length, digests);
+    for (size_t i = 0; i < Lanes; ++i)
+    {
+        for (int k = 0; k < 16; ++k)
+        {
+            out[i].key[k] = static_cast<uint8_t>(digests[i][k / 4] >> (8 * (k % 4)));
+        }
+    }
+}
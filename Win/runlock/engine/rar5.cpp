@@ -0,0 +1,175 @@
+#include "rar5.h"
+#include "candidate_batch.h"
+#include "kdf_kernels.h"
+#include "mapped_file.h"
+#include "rar5_kdf.h"
+#include "rar_headers.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        Rar5Crypto FromView(const CryptView& view)
+        {
+            Rar5Crypto crypto;
+            crypto.lg2Count = view.lg2Count;
+            std::memcpy(crypto.salt, view.salt, sizeof(crypto.salt));
+            if (view.iv != nullptr)
+            {
+                std::memcpy(crypto.iv, view.iv, sizeof(crypto.iv));
+            }
+            if (view.check != nullptr)
+            {
+                std::memcpy(crypto.check, view.check, sizeof(crypto.check));
+                crypto.hasCheck = true;
+            }
+            return crypto;
+        }
+    }
+
+    std::optional<Rar5Crypto> ReadRar5Crypto(const std::string& path, int targetIndex)
+    {
+        MappedFile archive;
+        try
+        {
+            archive = MappedFile(path);
+        }
+        catch (const std::runtime_error&)
+        {
+            return std::nullopt;
+        }
+
+        RarHeaderParser parser(archive.Data(), archive.Size());
+        if (parser.Format() != RarFormat::Rar50)
+        {
+            return std::nullopt;
+        }
+
+        int fileIndex = 0;
+        BlockView block;
+        while (parser.Next(block))
+        {
+            if (block.kind == BlockKind::Crypt)
+            {
+                CryptView crypt;
+                if (!DecodeCrypt(block, crypt))
+                {
+                    return std::nullopt;
+                }
+                Rar5Crypto crypto = FromView(crypt);
+                crypto.headers = true;
+                return crypto;
+            }
+            if (block.kind != BlockKind::File)
+            {
+                continue;
+            }
+
+            FileView file;
+            if (!DecodeFile(block, file))
+            {
+                return std::nullopt;
+            }
+            bool usable = file.encrypted && file.crypt.salt != nullptr;
+            if (targetIndex < 0 ? usable : fileIndex == targetIndex)
+            {
+                return usable ? std::optional(FromView(file.crypt)) : std::nullopt;
+            }
+            ++fileIndex;
+        }
+        return std::nullopt;
+    }
+
+    void DeriveRar5Keys(std::string_view password, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys& keys)
+    {
+        HmacSha256Key hmac;
+        PrepareHmacSha256Key(password, hmac);
+        DeriveRar5KeysScalar(&hmac, salt, lg2Count, &keys);
+    }
+
+    void FoldRar5Check(const uint8_t checkValue[32], uint8_t check[Rar5CheckSize])
+    {
+        std::memset(check, 0, Rar5CheckSize);
+        for (size_t i = 0; i < 32; ++i)
+        {
+            check[i % Rar5CheckSize] ^= checkValue[i];
+        }
+    }
+
+    Rar5Verifier::Rar5Verifier(const Rar5Crypto& crypto, std::unique_ptr<Verifier> confirm)
+        : m_crypto(crypto)
+        , m_kernel(SelectRar5Kernel())
+        , m_keys(m_kernel.lanes)
+        , m_derived(m_kernel.lanes)
+    {
+        Share(crypto, std::move(confirm));
+    }
+
+    Rar5Verifier::~Rar5Verifier() = default;
+
+    void Rar5Verifier::Share(const Rar5Crypto& crypto, std::unique_ptr<Verifier> confirm)
+    {
+        Member member;
+        std::memcpy(member.check, crypto.check, sizeof(member.check));
+        member.confirm = std::move(confirm);
+        m_members.push_back(std::move(member));
+    }
+
+    bool Rar5Verifier::Accept(std::string_view password, const Rar5Keys& keys)
+    {
+        uint8_t check[Rar5CheckSize];
+        FoldRar5Check(keys.checkValue, check);
+        for (auto& member : m_members)
+        {
+            if (std::memcmp(check, member.check, sizeof(check)) == 0
+                && (member.confirm == nullptr || member.confirm->Verify(password)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Rar5Verifier::Verify(std::string_view password)
+    {
+        Rar5Keys keys;
+        DeriveRar5Keys(password, m_crypto.salt, m_crypto.lg2Count, keys);
+        return Accept(password, keys);
+    }
+
+    size_t Rar5Verifier::VerifyBatch(CandidateBatch& batch, size_t first, size_t count)
+    {
+        const size_t lanes = m_kernel.lanes;
+        for (size_t end = first + count; first < end; first += lanes)
+        {
+            size_t used = std::min(lanes, end - first);
+            for (size_t i = 0; i < used; ++i)
+            {
+                PrepareHmacSha256Key(batch[first + i], m_keys[i]);
+            }
+            // A short tail fills the idle lanes with its last candidate.
+            std::fill(m_keys.begin() + used, m_keys.end(), m_keys[used - 1]);
+
+            m_kernel.derive(m_keys.data(), m_crypto.salt, m_crypto.lg2Count, m_derived.data());
+            for (size_t i = 0; i < used; ++i)
+            {
+                if (Accept(batch[first + i], m_derived[i]))
+                {
+                    return first + i;
+                }
+            }
+        }
+        return NoMatch;
+    }
+
+    size_t Rar5Verifier::PreferredBatch() const
+    {
+        return m_kernel.lanes;
+    }
+}
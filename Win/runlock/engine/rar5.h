@@ -0,0 +1,89 @@
+#pragma once
+
+#include "verifier.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    constexpr size_t Rar5SaltSize = 16;
+    constexpr size_t Rar5CheckSize = 8;
+    constexpr uint32_t Rar5MaxLg2Count = 24;
+
+    // Key derivation parameters of a RAR5 encryption record: either the
+    // archive encryption header (encrypted headers) or a file's encryption
+    // extra record.
+    struct Rar5Crypto
+    {
+        uint32_t lg2Count = 0;
+        uint8_t salt[Rar5SaltSize] = {};
+        uint8_t iv[16] = {};
+        uint8_t check[Rar5CheckSize] = {};
+        bool hasCheck = false;      // check value present and its checksum verified
+        bool headers = false;       // taken from the archive encryption header
+    };
+
+    // Reads the encryption record that guards the target entry (the n-th file
+    // header, or the first encrypted one when targetIndex < 0). Archives with
+    // encrypted headers return the archive encryption header instead. Returns
+    // nullopt for non-RAR5 archives and archives without such a record.
+    std::optional<Rar5Crypto> ReadRar5Crypto(const std::string& path, int targetIndex);
+
+    struct Rar5Keys
+    {
+        uint8_t key[32];            // AES-256 key
+        uint8_t hashKey[32];        // key for the tweaked (HMAC) checksums
+        uint8_t checkValue[32];     // source of the stored password check
+    };
+
+    // PBKDF2-HMAC-SHA256 as RAR5 applies it: 2^lg2Count iterations for the
+    // key, 16 more for the hash key and another 16 for the check value.
+    void DeriveRar5Keys(std::string_view password, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys& keys);
+
+    // XOR-folds a 32-byte check value into the 8 bytes stored in the archive.
+    void FoldRar5Check(const uint8_t checkValue[32], uint8_t check[Rar5CheckSize]);
+
+    struct HmacSha256Key;
+    struct Rar5KdfKernel;
+
+    // Rejects candidates by comparing the derived password check with the
+    // stored one; only the rare match goes on to the confirming verifier.
+    // Batches run through the fastest key derivation kernel for this CPU.
+    class Rar5Verifier : public Verifier
+    {
+    public:
+        Rar5Verifier(const Rar5Crypto& crypto, std::unique_ptr<Verifier> confirm);
+        ~Rar5Verifier() override;
+
+        // Adds another archive whose record has the same salt and iteration
+        // count (batch runs): the key derived for a candidate is compared
+        // with its check value as well, so the derivation is not repeated.
+        void Share(const Rar5Crypto& crypto, std::unique_ptr<Verifier> confirm);
+
+        bool Verify(std::string_view password) override;
+        size_t VerifyBatch(CandidateBatch& batch, size_t first, size_t count) override;
+        size_t PreferredBatch() const override;
+
+    private:
+        struct Member
+        {
+            uint8_t check[Rar5CheckSize];
+            std::unique_ptr<Verifier> confirm;
+        };
+
+        bool Accept(std::string_view password, const Rar5Keys& keys);
+
+        Rar5Crypto m_crypto;
+        std::vector<Member> m_members;
+        const Rar5KdfKernel& m_kernel;
+        std::vector<HmacSha256Key> m_keys;
+        std::vector<Rar5Keys> m_derived;
+    };
+}
@@ -0,0 +1,154 @@
+#include "rar5_kdf.h"
+#include "kdf_kernels.h"
+#include "sha256.h"
+
+#include <cstring>
+#include <string>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        const Rar5KdfKernel ScalarKernel{ "scalar", 1, DeriveRar5KeysScalar };
+#ifdef RUNLOCK_X86
+        const Rar5KdfKernel ShaNiKernel{ "sha-ni", ShaNiLanes, DeriveRar5KeysShaNi };
+        const Rar5KdfKernel Avx2Kernel{ "avx2", Avx2Lanes, DeriveRar5KeysAvx2 };
+        const Rar5KdfKernel Avx512Kernel{ "avx512", Avx512Lanes, DeriveRar5KeysAvx512 };
+#endif
+
+        // Candidates per second of one kernel on a short derivation, or 0
+        // when any lane disagrees with the portable kernel.
+        double Measure(const Rar5KdfKernel& kernel)
+        {
+            constexpr uint32_t lg2Count = 8;
+            uint8_t salt[Rar5SaltSize];
+            for (size_t i = 0; i < sizeof(salt); ++i)
+            {
+                salt[i] = static_cast<uint8_t>(i * 37 + 11);
+            }
+
+            std::vector<HmacSha256Key> keys(kernel.lanes);
+            for (size_t lane = 0; lane < kernel.lanes; ++lane)
+            {
+                PrepareHmacSha256Key("calibrate-" + std::to_string(lane), keys[lane]);
+            }
+            std::vector<Rar5Keys> out(kernel.lanes);
+            kernel.derive(keys.data(), salt, lg2Count, out.data());
+            for (size_t lane = 0; lane < kernel.lanes; ++lane)
+            {
+                Rar5Keys expected;
+                DeriveRar5KeysScalar(&keys[lane], salt, lg2Count, &expected);
+                if (std::memcmp(&expected, &out[lane], sizeof(expected)) != 0)
+                {
+                    return 0;
+                }
+            }
+            return MeasureThroughput(kernel.lanes, 0.02,
+                [&] { kernel.derive(keys.data(), salt, lg2Count, out.data()); });
+        }
+    }
+
+    void PrepareHmacSha256Key(std::string_view password, HmacSha256Key& key)
+    {
+        uint8_t pad[Sha256BlockSize] = {};
+        if (password.size() > Sha256BlockSize)
+        {
+            Sha256 hash;
+            hash.Update(password.data(), password.size());
+            hash.Final(pad);
+        }
+        else
+        {
+            std::memcpy(pad, password.data(), password.size());
+        }
+        for (auto& byte : pad) { byte ^= 0x36; }
+        Sha256Init(key.inner);
+        Sha256Compress(key.inner, pad);
+        for (auto& byte : pad) { byte ^= 0x36 ^ 0x5c; }
+        Sha256Init(key.outer);
+        Sha256Compress(key.outer, pad);
+    }
+
+    void Rar5FirstIteration(const HmacSha256Key& key, const uint8_t salt[Rar5SaltSize], uint32_t u[8])
+    {
+        uint32_t block[16] = {};
+        for (size_t i = 0; i < Rar5SaltSize / 4; ++i)
+        {
+            block[i] = (uint32_t(salt[i * 4]) << 24) | (uint32_t(salt[i * 4 + 1]) << 16)
+                | (uint32_t(salt[i * 4 + 2]) << 8) | salt[i * 4 + 3];
+        }
+        block[4] = 1;
+        block[5] = 0x80000000;
+        block[15] = (64 + Rar5SaltSize + 4) * 8;
+
+        uint32_t inner[8];
+        std::memcpy(inner, key.inner, sizeof(inner));
+        Sha256CompressWords(inner, block);
+
+        std::memset(block, 0, sizeof(block));
+        std::memcpy(block, inner, sizeof(inner));
+        block[8] = 0x80000000;
+        block[15] = Rar5DigestBlockBits;
+        std::memcpy(u, key.outer, sizeof(key.outer));
+        Sha256CompressWords(u, block);
+    }
+
+    void DeriveRar5KeysScalar(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+        Rar5Keys* out)
+    {
+        const HmacSha256Key& key = keys[0];
+        uint32_t u[8];
+        Rar5FirstIteration(key, salt, u);
+        uint32_t fn[8];
+        std::memcpy(fn, u, sizeof(fn));
+
+        uint32_t block[16] = {};
+        block[8] = 0x80000000;
+        block[15] = Rar5DigestBlockBits;
+        for (int stage = 0; stage < 3; ++stage)
+        {
+            for (uint32_t i = Rar5StageIterations(lg2Count, stage); i != 0; --i)
+            {
+                uint32_t inner[8];
+                std::memcpy(inner, key.inner, sizeof(inner));
+                std::memcpy(block, u, sizeof(u));
+                Sha256CompressWords(inner, block);
+                std::memcpy(block, inner, sizeof(inner));
+                std::memcpy(u, key.outer, sizeof(u));
+                Sha256CompressWords(u, block);
+                for (int k = 0; k < 8; ++k)
+                {
+                    fn[k] ^= u[k];
+                }
+            }
+            Sha256Store(fn, Rar5StageOutput(*out, stage));
+        }
+    }
+
+    std::vector<const Rar5KdfKernel*> AvailableRar5Kernels()
+    {
+        std::vector<const Rar5KdfKernel*> kernels{ &ScalarKernel };
+#ifdef RUNLOCK_X86
+        const CpuFeatures& cpu = DetectCpuFeatures();
+        if (cpu.shaNi)
+        {
+            kernels.push_back(&ShaNiKernel);
+        }
+        if (cpu.avx2)
+        {
+            kernels.push_back(&Avx2Kernel);
+        }
+        if (cpu.avx512)
+        {
+            kernels.push_back(&Avx512Kernel);
+        }
+#endif
+        return kernels;
+    }
+
+    const Rar5KdfKernel& SelectRar5Kernel()
+    {
+        static const Rar5KdfKernel& kernel = ChooseKernel(AvailableRar5Kernels(), Measure);
+        return kernel;
+    }
+}
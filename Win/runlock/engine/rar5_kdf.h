@@ -0,0 +1,41 @@
+#pragma once
+
+#include "rar5.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // Precomputed HMAC-SHA256 pads for one password, so each PBKDF2
+    // iteration costs exactly two compressions.
+    struct HmacSha256Key
+    {
+        uint32_t inner[8];
+        uint32_t outer[8];
+    };
+
+    void PrepareHmacSha256Key(std::string_view password, HmacSha256Key& key);
+
+    // A RAR5 key derivation routine that works on a fixed number of
+    // passwords at once (one per SIMD lane, or interleaved streams). Callers
+    // always pass `lanes` keys and outputs; unused lanes may repeat a key.
+    struct Rar5KdfKernel
+    {
+        const char* name;
+        size_t lanes;
+        void (*derive)(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count,
+            Rar5Keys* out);
+    };
+
+    // Kernels the running CPU supports, the portable one first.
+    std::vector<const Rar5KdfKernel*> AvailableRar5Kernels();
+
+    // The fastest available kernel, picked once per process by timing each
+    // one on a short derivation and checking its output against the portable
+    // kernel. The RUNLOCK_KDF environment variable (a kernel name) overrides
+    // the choice.
+    const Rar5KdfKernel& SelectRar5Kernel();
+}
@@ -0,0 +1,118 @@
+// RAR5 PBKDF2 over Lanes passwords, one per vector lane. Included by the
+// per-instruction-set kernels after they define, inside an anonymous
+// namespace compiled for their target:
+//
+//   constexpr size_t Lanes;
+//   using Vec = <vector of Lanes uint32_t>;
+//   Vec Set1(uint32_t), Add(Vec, Vec), Xor(Vec, Vec), Xor3(Vec, Vec, Vec),
+//   Ch(Vec, Vec, Vec), Maj(Vec, Vec, Vec), Rotr<N>(Vec), Shr<N>(Vec),
+//   Vec Load(const uint32_t*), void Store(uint32_t*, Vec)
+
+// Compresses the block every iteration after U1 hashes: eight digest words
+// followed by constant padding.
+inline void CompressDigestBlock(const Vec init[8], const Vec message[8], Vec out[8])
+{
+    Vec w[16];
+    for (int i = 0; i < 8; ++i)
+    {
+        w[i] = message[i];
+    }
+    w[8] = Set1(0x80000000);
+    for (int i = 9; i < 15; ++i)
+    {
+        w[i] = Set1(0);
+    }
+    w[15] = Set1(Rar5DigestBlockBits);
+
+    Vec a = init[0], b = init[1], c = init[2], d = init[3];
+    Vec e = init[4], f = init[5], g = init[6], h = init[7];
+#if defined(__GNUC__)
+#pragma GCC unroll 64
+#endif
+    for (int i = 0; i < 64; ++i)
+    {
+        if (i >= 16)
+        {
+            Vec w15 = w[(i - 15) & 15];
+            Vec w2 = w[(i - 2) & 15];
+            Vec s0 = Xor3(Rotr<7>(w15), Rotr<18>(w15), Shr<3>(w15));
+            Vec s1 = Xor3(Rotr<17>(w2), Rotr<19>(w2), Shr<10>(w2));
+            w[i & 15] = Add(Add(w[i & 15], s0), Add(w[(i - 7) & 15], s1));
+        }
+        Vec s1 = Xor3(Rotr<6>(e), Rotr<11>(e), Rotr<25>(e));
+        Vec t1 = Add(Add(h, s1), Add(Ch(e, f, g), Add(Set1(Sha256RoundConstants[i]), w[i & 15])));
+        Vec s0 = Xor3(Rotr<2>(a), Rotr<13>(a), Rotr<22>(a));
+        Vec t2 = Add(s0, Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+    out[0] = Add(init[0], a); out[1] = Add(init[1], b); out[2] = Add(init[2], c); out[3] = Add(init[3], d);
+    out[4] = Add(init[4], e); out[5] = Add(init[5], f); out[6] = Add(init[6], g); out[7] = Add(init[7], h);
+}
+
+// Transposes word j of every lane into one vector.
+template<typename Source>
+void Gather(Vec out[8], Source&& lane)
+{
+    alignas(64) uint32_t words[Lanes];
+    for (int j = 0; j < 8; ++j)
+    {
+        for (size_t i = 0; i < Lanes; ++i)
+        {
+            words[i] = lane(i)[j];
+        }
+        out[j] = Load(words);
+    }
+}
+
+void DeriveRar5Lanes(const HmacSha256Key* keys, const uint8_t salt[Rar5SaltSize], uint32_t lg2Count, Rar5Keys* out)
+{
+    Vec inner[8], outer[8], u[8], fn[8], t[8];
+    Gather(inner, [&](size_t i) { return keys[i].inner; });
+    Gather(outer, [&](size_t i) { return keys[i].outer; });
+
+    uint32_t first[Lanes][8];
+    for (size_t i = 0; i < Lanes; ++i)
+    {
+        Rar5FirstIteration(keys[i], salt, first[i]);
+    }
+    Gather(u, [&](size_t i) { return first[i]; });
+    for (int j = 0; j < 8; ++j)
+    {
+        fn[j] = u[j];
+    }
+
+    for (int stage = 0; stage < 3; ++stage)
+    {
+        for (uint32_t n = Rar5StageIterations(lg2Count, stage); n != 0; --n)
+        {
+            CompressDigestBlock(inner, u, t);
+            CompressDigestBlock(outer, t, u);
+            for (int j = 0; j < 8; ++j)
+            {
+                fn[j] = Xor(fn[j], u[j]);
+            }
+        }
+
+        alignas(64) uint32_t words[8][Lanes];
+        for (int j = 0; j < 8; ++j)
+        {
+            Store(words[j], fn[j]);
+        }
+        for (size_t i = 0; i < Lanes; ++i)
+        {
+            uint32_t state[8];
+            for (int j = 0; j < 8; ++j)
+            {
+                state[j] = words[j][i];
+            }
+            Sha256Store(state, Rar5StageOutput(out[i], stage));
+        }
+    }
+}
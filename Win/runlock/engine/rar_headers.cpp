@@ -0,0 +1,595 @@
+#include "rar_headers.h"
+#include "crc32.h"
+#include "sha256.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr uint8_t SignaturePrefix[] = { 'R', 'a', 'r', '!', 0x1A, 0x07 };
+        constexpr size_t MaxSfxSize = 1 << 20;
+
+        // RAR 1.5 layout
+        constexpr uint8_t Head15Marker = 0x72;
+        constexpr uint8_t Head15Main = 0x73;
+        constexpr uint8_t Head15File = 0x74;
+        constexpr uint8_t Head15Service = 0x7A;
+        constexpr uint8_t Head15End = 0x7B;
+        constexpr uint16_t Mhd15Volume = 0x0001;
+        constexpr uint16_t Mhd15Lock = 0x0004;
+        constexpr uint16_t Mhd15Solid = 0x0008;
+        constexpr uint16_t Mhd15NewNumbering = 0x0010;
+        constexpr uint16_t Mhd15Protect = 0x0040;
+        constexpr uint16_t Mhd15Password = 0x0080;
+        constexpr uint16_t Mhd15FirstVolume = 0x0100;
+        constexpr uint16_t Lhd15SplitBefore = 0x0001;
+        constexpr uint16_t Lhd15SplitAfter = 0x0002;
+        constexpr uint16_t Lhd15Password = 0x0004;
+        constexpr uint16_t Lhd15Solid = 0x0010;
+        constexpr uint16_t Lhd15WindowMask = 0x00E0;
+        constexpr uint16_t Lhd15Directory = 0x00E0;
+        constexpr uint16_t Lhd15Large = 0x0100;
+        constexpr uint16_t Lhd15Unicode = 0x0200;
+        constexpr uint16_t Lhd15Salt = 0x0400;
+        constexpr uint16_t Long15Block = 0x8000;
+        constexpr size_t Salt15Size = 8;
+
+        // RAR5 layout
+        constexpr uint64_t Head50Main = 1;
+        constexpr uint64_t Head50File = 2;
+        constexpr uint64_t Head50Service = 3;
+        constexpr uint64_t Head50Crypt = 4;
+        constexpr uint64_t Head50End = 5;
+        constexpr uint64_t Hfl50Extra = 0x0001;
+        constexpr uint64_t Hfl50Data = 0x0002;
+        constexpr uint64_t Hfl50SplitBefore = 0x0008;
+        constexpr uint64_t Hfl50SplitAfter = 0x0010;
+        constexpr uint64_t Mhfl50Volume = 0x0001;
+        constexpr uint64_t Mhfl50VolumeNumber = 0x0002;
+        constexpr uint64_t Mhfl50Solid = 0x0004;
+        constexpr uint64_t Mhfl50Protect = 0x0008;
+        constexpr uint64_t Mhfl50Lock = 0x0010;
+        constexpr uint64_t Fhfl50Directory = 0x0001;
+        constexpr uint64_t Fhfl50Time = 0x0002;
+        constexpr uint64_t Fhfl50Crc = 0x0004;
+        constexpr uint64_t Fci50Solid = 0x0040;
+        constexpr uint64_t Fhext50Crypt = 0x01;
+        constexpr uint64_t Crypt50PswCheck = 0x0001;
+        constexpr uint64_t Crypt50HashMac = 0x0002;
+        constexpr uint32_t Crypt50MaxLg2Count = 24;
+        constexpr size_t Salt50Size = 16;
+        constexpr size_t Check50Size = 8;
+        constexpr uint64_t MaxHeader50Size = 2 << 20;
+
+        uint16_t Load16(const uint8_t* p) { return uint16_t(p[0] | (p[1] << 8)); }
+        uint32_t Load32(const uint8_t* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24); }
+
+        // Bounds-checked reader over one header; a failed read poisons the
+        // cursor so callers can check once at the end.
+        class Cursor
+        {
+        public:
+            Cursor(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+            bool Ok() const { return m_ok; }
+            size_t Position() const { return m_pos; }
+            size_t Remaining() const { return m_ok ? m_size - m_pos : 0; }
+
+            uint64_t Vint()
+            {
+                uint64_t value = 0;
+                for (int shift = 0; shift < 70 && m_pos < m_size; shift += 7)
+                {
+                    uint8_t byte = m_data[m_pos++];
+                    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0)
+                    {
+                        return value;
+                    }
+                }
+                m_ok = false;
+                return 0;
+            }
+
+            const uint8_t* Take(size_t count)
+            {
+                if (!m_ok || m_size - m_pos < count)
+                {
+                    m_ok = false;
+                    return nullptr;
+                }
+                const uint8_t* p = m_data + m_pos;
+                m_pos += count;
+                return p;
+            }
+
+            uint8_t U8() { auto p = Take(1); return p != nullptr ? *p : 0; }
+            uint16_t U16() { auto p = Take(2); return p != nullptr ? Load16(p) : 0; }
+            uint32_t U32() { auto p = Take(4); return p != nullptr ? Load32(p) : 0; }
+
+        private:
+            const uint8_t* m_data;
+            size_t m_size;
+            size_t m_pos = 0;
+            bool m_ok = true;
+        };
+
+        // Version, flags, KDF count, salt [, IV], check: shared by the RAR5
+        // archive encryption header and the file encryption record.
+        bool ParseCrypt50(Cursor& cursor, bool hasIv, CryptView& crypt)
+        {
+            crypt.version = static_cast<uint32_t>(cursor.Vint());
+            uint64_t flags = cursor.Vint();
+            crypt.lg2Count = cursor.U8();
+            crypt.salt = cursor.Take(Salt50Size);
+            crypt.iv = hasIv ? cursor.Take(16) : nullptr;
+            crypt.hashMac = (flags & Crypt50HashMac) != 0;
+            crypt.check = nullptr;
+            if (!cursor.Ok() || crypt.version != 0 || crypt.lg2Count > Crypt50MaxLg2Count)
+            {
+                return false;
+            }
+            if ((flags & Crypt50PswCheck) != 0)
+            {
+                const uint8_t* check = cursor.Take(Check50Size);
+                const uint8_t* checksum = cursor.Take(4);
+                if (!cursor.Ok())
+                {
+                    return false;
+                }
+                uint8_t digest[Sha256DigestSize];
+                Sha256 hash;
+                hash.Update(check, Check50Size);
+                hash.Final(digest);
+                if (std::memcmp(digest, checksum, 4) == 0)
+                {
+                    crypt.check = check;
+                }
+            }
+            return true;
+        }
+
+        void AppendLatin1(std::string_view bytes, std::string& out)
+        {
+            for (char c : bytes)
+            {
+                AppendUtf8(static_cast<uint8_t>(c), out);
+            }
+        }
+
+        // RAR 1.5-4.x Unicode names: the OEM name, a zero byte, then the
+        // Unicode name encoded against it (EncodeFileName in unrar).
+        std::string DecodeUnicodeName(std::string_view oem, const uint8_t* enc, size_t encSize)
+        {
+            std::wstring wide;
+            size_t pos = 0;
+            uint8_t high = pos < encSize ? enc[pos++] : 0;
+            unsigned flags = 0;
+            int flagBits = 0;
+            while (pos < encSize)
+            {
+                if (flagBits == 0)
+                {
+                    flags = enc[pos++];
+                    flagBits = 8;
+                    if (pos >= encSize)
+                    {
+                        break;
+                    }
+                }
+                switch (flags >> 6)
+                {
+                case 0:
+                    wide += static_cast<wchar_t>(enc[pos++]);
+                    break;
+                case 1:
+                    wide += static_cast<wchar_t>(enc[pos++] + (high << 8));
+                    break;
+                case 2:
+                    if (pos + 1 >= encSize)
+                    {
+                        pos = encSize;
+                        break;
+                    }
+                    wide += static_cast<wchar_t>(enc[pos] + (enc[pos + 1] << 8));
+                    pos += 2;
+                    break;
+                case 3:
+                {
+                    unsigned length = enc[pos++];
+                    uint8_t correction = 0;
+                    bool corrected = (length & 0x80) != 0;
+                    if (corrected)
+                    {
+                        if (pos >= encSize)
+                        {
+                            break;
+                        }
+                        correction = enc[pos++];
+                    }
+                    for (length = (length & 0x7F) + 2; length > 0 && wide.size() < oem.size(); --length)
+                    {
+                        auto c = static_cast<uint8_t>(oem[wide.size()]);
+                        wide += corrected ? static_cast<wchar_t>(((c + correction) & 0xFF) + (high << 8)) : static_cast<wchar_t>(c);
+                    }
+                    break;
+                }
+                }
+                flags = (flags << 2) & 0xFF;
+                flagBits -= 2;
+            }
+            return WideToUtf8(wide);
+        }
+    }
+
+    RarHeaderParser::RarHeaderParser(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+        const uint8_t* end = data + std::min(size, MaxSfxSize);
+        for (const uint8_t* p = data; ; ++p)
+        {
+            p = std::search(p, end, std::begin(SignaturePrefix), std::end(SignaturePrefix));
+            if (p == end || p + 7 > data + size)
+            {
+                m_done = true;
+                m_error = "not a RAR archive";
+                return;
+            }
+            if (p[6] == 0x00)
+            {
+                m_format = RarFormat::Rar15;
+                m_pos = static_cast<size_t>(p - data);
+                return;
+            }
+            if (p[6] == 0x01 && p + 8 <= data + size && p[7] == 0x00)
+            {
+                m_format = RarFormat::Rar50;
+                m_pos = static_cast<size_t>(p - data) + 8;
+                return;
+            }
+        }
+    }
+
+    bool RarHeaderParser::Next(BlockView& block)
+    {
+        if (m_done)
+        {
+            return false;
+        }
+        if (m_pos >= m_size)
+        {
+            m_done = true;
+            return false;
+        }
+        block = BlockView{};
+        block.format = m_format;
+        block.begin = m_data + m_pos;
+        block.offset = m_pos;
+        bool ok = m_format == RarFormat::Rar15 ? NextRar15(block) : NextRar50(block);
+        if (!ok)
+        {
+            m_done = true;
+            return false;
+        }
+        if (block.dataSize > m_size - m_pos - block.headerSize)
+        {
+            return Fail("block data runs past the end of the archive");
+        }
+        m_pos += block.headerSize + static_cast<size_t>(block.dataSize);
+        if (block.kind == BlockKind::End || m_encrypted)
+        {
+            m_done = true;
+        }
+        return true;
+    }
+
+    bool RarHeaderParser::Fail(const char* message)
+    {
+        m_error = message;
+        m_done = true;
+        return false;
+    }
+
+    bool RarHeaderParser::NextRar15(BlockView& block)
+    {
+        size_t left = m_size - m_pos;
+        if (left < 7)
+        {
+            return Fail("truncated block header");
+        }
+        const uint8_t* p = block.begin;
+        block.type = p[2];
+        block.flags = Load16(p + 3);
+        block.headerSize = Load16(p + 5);
+        if (block.headerSize < 7 || block.headerSize > left)
+        {
+            return Fail("bad block header size");
+        }
+
+        uint32_t fixed = 7;
+        switch (block.type)
+        {
+        case Head15Marker:
+            block.kind = BlockKind::Marker;
+            block.crcOk = true;
+            break;
+        case Head15Main: block.kind = BlockKind::Main; break;
+        case Head15File: block.kind = BlockKind::File; break;
+        case Head15Service: block.kind = BlockKind::Service; break;
+        case Head15End: block.kind = BlockKind::End; break;
+        default: block.kind = BlockKind::Other; break;
+        }
+
+        if (block.kind == BlockKind::File || block.kind == BlockKind::Service)
+        {
+            if (block.headerSize < 7 + 25)
+            {
+                return Fail("truncated file header");
+            }
+            block.dataSize = Load32(p + 7);
+            if ((block.flags & Lhd15Large) != 0 && block.headerSize >= 7 + 25 + 8)
+            {
+                block.dataSize |= static_cast<uint64_t>(Load32(p + 7 + 25)) << 32;
+            }
+        }
+        else if ((block.flags & Long15Block) != 0 && block.kind != BlockKind::Marker)
+        {
+            if (block.headerSize < 11)
+            {
+                return Fail("truncated block header");
+            }
+            block.dataSize = Load32(p + 7);
+            fixed = 11;
+        }
+        block.body = p + fixed;
+        block.bodySize = block.headerSize - fixed;
+        if (block.kind != BlockKind::Marker)
+        {
+            block.crcOk = (Crc32(p + 2, block.headerSize - 2) & 0xFFFF) == Load16(p);
+        }
+
+        if (block.kind == BlockKind::Main && (block.flags & Mhd15Password) != 0)
+        {
+            // Every following header is an 8-byte salt and an AES-128 block
+            // chain; nothing more can be read without the password.
+            size_t next = m_pos + block.headerSize;
+            if (next + Salt15Size <= m_size)
+            {
+                m_encryptedView.crypt.salt = m_data + next;
+                m_encryptedView.crypt.version = 29;
+                m_encryptedView.first = m_data + next + Salt15Size;
+                m_encryptedView.available = m_size - next - Salt15Size;
+                m_encrypted = true;
+            }
+        }
+        return true;
+    }
+
+    bool RarHeaderParser::NextRar50(BlockView& block)
+    {
+        size_t left = m_size - m_pos;
+        Cursor prefix(block.begin, std::min<size_t>(left, 4 + 3));
+        prefix.Take(4);
+        uint64_t size = prefix.Vint();
+        if (!prefix.Ok() || size == 0 || size > MaxHeader50Size || prefix.Position() + size > left)
+        {
+            return Fail("bad block header size");
+        }
+        block.headerSize = static_cast<uint32_t>(prefix.Position() + size);
+        block.crcOk = Crc32(block.begin + 4, block.headerSize - 4) == Load32(block.begin);
+
+        Cursor cursor(block.begin + prefix.Position(), static_cast<size_t>(size));
+        block.type = static_cast<uint32_t>(cursor.Vint());
+        uint64_t flags = cursor.Vint();
+        block.flags = static_cast<uint32_t>(flags);
+        uint64_t extraSize = (flags & Hfl50Extra) != 0 ? cursor.Vint() : 0;
+        block.dataSize = (flags & Hfl50Data) != 0 ? cursor.Vint() : 0;
+        if (!cursor.Ok() || extraSize > cursor.Remaining())
+        {
+            return Fail("bad block header");
+        }
+        block.extraSize = static_cast<uint32_t>(extraSize);
+        block.body = block.begin + prefix.Position() + cursor.Position();
+        block.bodySize = static_cast<uint32_t>(cursor.Remaining());
+
+        switch (block.type)
+        {
+        case Head50Main: block.kind = BlockKind::Main; break;
+        case Head50File: block.kind = BlockKind::File; break;
+        case Head50Service: block.kind = BlockKind::Service; break;
+        case Head50Crypt: block.kind = BlockKind::Crypt; break;
+        case Head50End: block.kind = BlockKind::End; break;
+        default: block.kind = BlockKind::Other; break;
+        }
+
+        if (block.kind == BlockKind::Crypt)
+        {
+            size_t next = m_pos + block.headerSize;
+            if (DecodeCrypt(block, m_encryptedView.crypt))
+            {
+                m_encryptedView.first = m_data + next;
+                m_encryptedView.available = m_size - next;
+                m_encrypted = true;
+            }
+        }
+        return true;
+    }
+
+    bool DecodeMain(const BlockView& block, MainView& main)
+    {
+        main = MainView{};
+        if (block.kind != BlockKind::Main)
+        {
+            return false;
+        }
+        if (block.format == RarFormat::Rar15)
+        {
+            main.volume = (block.flags & Mhd15Volume) != 0;
+            main.firstVolume = (block.flags & Mhd15FirstVolume) != 0;
+            main.solid = (block.flags & Mhd15Solid) != 0;
+            main.locked = (block.flags & Mhd15Lock) != 0;
+            main.recovery = (block.flags & Mhd15Protect) != 0;
+            main.newNumbering = (block.flags & Mhd15NewNumbering) != 0;
+            main.encryptedHeaders = (block.flags & Mhd15Password) != 0;
+            return true;
+        }
+
+        Cursor cursor(block.body, block.bodySize - block.extraSize);
+        uint64_t flags = cursor.Vint();
+        main.volume = (flags & Mhfl50Volume) != 0;
+        main.solid = (flags & Mhfl50Solid) != 0;
+        main.locked = (flags & Mhfl50Lock) != 0;
+        main.recovery = (flags & Mhfl50Protect) != 0;
+        main.newNumbering = true;
+        if ((flags & Mhfl50VolumeNumber) != 0)
+        {
+            main.volumeNumber = cursor.Vint();
+        }
+        main.firstVolume = main.volume && main.volumeNumber == 0;
+        return cursor.Ok();
+    }
+
+    bool DecodeFile(const BlockView& block, FileView& file)
+    {
+        file = FileView{};
+        if (block.kind != BlockKind::File && block.kind != BlockKind::Service)
+        {
+            return false;
+        }
+        file.packSize = block.dataSize;
+        file.dataOffset = block.offset + block.headerSize;
+
+        if (block.format == RarFormat::Rar15)
+        {
+            Cursor cursor(block.body, block.bodySize);
+            cursor.U32();                               // PACK_SIZE, already in dataSize
+            uint64_t unpSize = cursor.U32();
+            cursor.U8();                                // HOST_OS
+            file.dataCrc = cursor.U32();
+            cursor.U32();                               // FTIME
+            file.version = cursor.U8();
+            file.method = cursor.U8();
+            uint16_t nameSize = cursor.U16();
+            cursor.U32();                               // ATTR
+            if ((block.flags & Lhd15Large) != 0)
+            {
+                cursor.U32();                           // HIGH_PACK_SIZE, already in dataSize
+                unpSize |= static_cast<uint64_t>(cursor.U32()) << 32;
+            }
+            const uint8_t* name = cursor.Take(nameSize);
+            if (!cursor.Ok())
+            {
+                return false;
+            }
+            file.name = std::string_view(reinterpret_cast<const char*>(name), nameSize);
+            file.unpSize = unpSize;
+            file.hasCrc = true;
+            file.encrypted = (block.flags & Lhd15Password) != 0;
+            file.solid = (block.flags & Lhd15Solid) != 0;
+            file.directory = (block.flags & Lhd15WindowMask) == Lhd15Directory;
+            file.splitBefore = (block.flags & Lhd15SplitBefore) != 0;
+            file.splitAfter = (block.flags & Lhd15SplitAfter) != 0;
+            file.unicodeName = (block.flags & Lhd15Unicode) != 0;
+            if (file.encrypted)
+            {
+                file.crypt.version = file.version;
+                if ((block.flags & Lhd15Salt) != 0)
+                {
+                    file.crypt.salt = cursor.Take(Salt15Size);
+                }
+            }
+            return cursor.Ok();
+        }
+
+        Cursor cursor(block.body, block.bodySize - block.extraSize);
+        uint64_t fileFlags = cursor.Vint();
+        file.unpSize = cursor.Vint();
+        cursor.Vint();                                  // attributes
+        if ((fileFlags & Fhfl50Time) != 0)
+        {
+            cursor.U32();
+        }
+        if ((fileFlags & Fhfl50Crc) != 0)
+        {
+            file.dataCrc = cursor.U32();
+            file.hasCrc = true;
+        }
+        uint64_t compression = cursor.Vint();
+        cursor.Vint();                                  // host OS
+        uint64_t nameSize = cursor.Vint();
+        const uint8_t* name = cursor.Ok() && nameSize <= cursor.Remaining() ? cursor.Take(static_cast<size_t>(nameSize)) : nullptr;
+        if (name == nullptr)
+        {
+            return false;
+        }
+        file.name = std::string_view(reinterpret_cast<const char*>(name), static_cast<size_t>(nameSize));
+        file.version = 50 + static_cast<uint32_t>(compression & 0x3F);
+        file.method = static_cast<uint32_t>((compression >> 7) & 7);
+        file.solid = (compression & Fci50Solid) != 0;
+        file.directory = (fileFlags & Fhfl50Directory) != 0;
+        file.splitBefore = (block.flags & Hfl50SplitBefore) != 0;
+        file.splitAfter = (block.flags & Hfl50SplitAfter) != 0;
+        file.unicodeName = true;
+
+        Cursor extra(block.body + block.bodySize - block.extraSize, block.extraSize);
+        while (extra.Ok() && extra.Remaining() > 0)
+        {
+            uint64_t size = extra.Vint();
+            if (!extra.Ok() || size == 0 || size > extra.Remaining())
+            {
+                break;
+            }
+            Cursor record(extra.Take(static_cast<size_t>(size)), static_cast<size_t>(size));
+            if (record.Vint() == Fhext50Crypt)
+            {
+                // A damaged record still marks the entry as encrypted; only
+                // the crypt view stays incomplete (salt == nullptr).
+                file.encrypted = true;
+                if (!ParseCrypt50(record, true, file.crypt))
+                {
+                    file.crypt = CryptView{};
+                }
+            }
+        }
+        return true;
+    }
+
+    bool DecodeCrypt(const BlockView& block, CryptView& crypt)
+    {
+        crypt = CryptView{};
+        if (block.kind != BlockKind::Crypt)
+        {
+            return false;
+        }
+        Cursor cursor(block.body, block.bodySize - block.extraSize);
+        return ParseCrypt50(cursor, false, crypt);
+    }
+
+    std::string DecodeFileName(const FileView& file, RarFormat format)
+    {
+        std::string name;
+        if (format == RarFormat::Rar50)
+        {
+            return std::string(file.name);
+        }
+        if (file.unicodeName)
+        {
+            size_t zero = file.name.find('\0');
+            if (zero == std::string_view::npos)
+            {
+                // RAR 3.x+ store a plain UTF-8 name under the same flag.
+                return std::string(file.name);
+            }
+            std::string_view oem = file.name.substr(0, zero);
+            auto enc = reinterpret_cast<const uint8_t*>(file.name.data()) + zero + 1;
+            return DecodeUnicodeName(oem, enc, file.name.size() - zero - 1);
+        }
+        AppendLatin1(file.name, name);
+        return name;
+    }
+}
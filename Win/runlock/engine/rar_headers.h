@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // Rar15 covers every archive with the 1.5 block layout (RAR 1.5 to 4.x).
+    enum class RarFormat { Unknown, Rar15, Rar50 };
+
+    enum class BlockKind { Marker, Main, File, Service, Crypt, End, Other };
+
+    // One block header inside the mapping. Nothing is copied: the pointers
+    // stay valid as long as the mapped archive does.
+    struct BlockView
+    {
+        const uint8_t* begin = nullptr;     // first byte of the block (its CRC field)
+        const uint8_t* body = nullptr;      // type-specific fields after the common ones
+        uint64_t offset = 0;                // of begin within the archive
+        uint64_t dataSize = 0;              // data area following the header
+        uint32_t headerSize = 0;            // whole header including CRC and size fields
+        uint32_t bodySize = 0;              // body up to the end of the header
+        uint32_t extraSize = 0;             // RAR5 extra area, the tail of the body
+        uint32_t type = 0;                  // native header type
+        uint32_t flags = 0;                 // native (RAR5: common) header flags
+        RarFormat format = RarFormat::Unknown;
+        BlockKind kind = BlockKind::Other;
+        bool crcOk = false;
+
+        const uint8_t* Data() const { return begin + headerSize; }
+    };
+
+    // Key derivation inputs of an encrypted entry or of encrypted headers.
+    struct CryptView
+    {
+        const uint8_t* salt = nullptr;      // 16 bytes (RAR5) or 8 (RAR 2.9-4.x); nullptr if unsalted
+        const uint8_t* iv = nullptr;        // RAR5 file records only
+        const uint8_t* check = nullptr;     // RAR5 8-byte password check, only if its checksum matches
+        uint32_t lg2Count = 0;              // RAR5 KDF iteration count exponent
+        uint32_t version = 0;               // RAR 1.5 layout: unpack version, which selects the cipher
+        bool hashMac = false;               // RAR5: data checksums are HMACs
+    };
+
+    struct MainView
+    {
+        bool volume = false;
+        bool firstVolume = false;
+        bool solid = false;
+        bool locked = false;
+        bool recovery = false;
+        bool newNumbering = false;
+        bool encryptedHeaders = false;
+        uint64_t volumeNumber = 0;
+    };
+
+    struct FileView
+    {
+        std::string_view name;              // raw: UTF-8 (RAR5) or OEM plus encoded Unicode (RAR 1.5)
+        uint64_t packSize = 0;
+        uint64_t unpSize = 0;
+        uint64_t dataOffset = 0;
+        uint32_t dataCrc = 0;
+        uint32_t method = 0;                // RAR5 0-5, RAR 1.5 layout 0x30-0x35
+        uint32_t version = 0;               // unpack algorithm version
+        bool hasCrc = false;
+        bool encrypted = false;
+        bool solid = false;
+        bool directory = false;
+        bool splitBefore = false;
+        bool splitAfter = false;
+        bool unicodeName = false;
+        CryptView crypt;                    // meaningful when encrypted
+    };
+
+    // Where the readable part of an archive with encrypted headers ends.
+    struct EncryptedHeadersView
+    {
+        CryptView crypt;                    // RAR5 archive encryption header, or the first block's salt
+        const uint8_t* first = nullptr;     // first encrypted header (RAR5: its IV, then ciphertext)
+        size_t available = 0;               // bytes from first to the end of the mapping
+    };
+
+    // Walks the block headers of a RAR 1.5-5.x archive held in memory
+    // (normally a MappedFile). Listing costs one pass over the headers and no
+    // allocation per entry, whatever the number of entries.
+    class RarHeaderParser
+    {
+    public:
+        RarHeaderParser(const uint8_t* data, size_t size);
+
+        RarFormat Format() const { return m_format; }
+
+        // Advances to the next block. Returns false at the end of the archive,
+        // on damage (Error() is set) and when the following headers are
+        // encrypted (EncryptedHeaders() is set).
+        bool Next(BlockView& block);
+
+        const std::string& Error() const { return m_error; }
+        const EncryptedHeadersView* EncryptedHeaders() const { return m_encrypted ? &m_encryptedView : nullptr; }
+
+    private:
+        bool NextRar15(BlockView& block);
+        bool NextRar50(BlockView& block);
+        bool Fail(const char* message);
+
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+        RarFormat m_format = RarFormat::Unknown;
+        std::string m_error;
+        EncryptedHeadersView m_encryptedView;
+        bool m_encrypted = false;
+        bool m_done = false;
+    };
+
+    bool DecodeMain(const BlockView& block, MainView& main);
+    bool DecodeFile(const BlockView& block, FileView& file);
+
+    // RAR5 archive encryption header.
+    bool DecodeCrypt(const BlockView& block, CryptView& crypt);
+
+    // File name as UTF-8; RAR 1.5 names are decoded from their Unicode
+    // encoding when present and read as Latin-1 otherwise.
+    std::string DecodeFileName(const FileView& file, RarFormat format);
+}
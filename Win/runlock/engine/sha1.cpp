@@ -0,0 +1,89 @@
+#include "sha1.h"
+
+#include <cstring>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        inline uint32_t Rotl(uint32_t x, int n)
+        {
+            return (x << n) | (x >> (32 - n));
+        }
+
+        void CompressBytes(uint32_t state[5], const uint8_t block[Sha1BlockSize])
+        {
+            uint32_t w[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                const uint8_t* p = block + i * 4;
+                w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+            }
+            Sha1Compress(state, w);
+        }
+    }
+
+    void Sha1Init(uint32_t state[5])
+    {
+        static constexpr uint32_t initial[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+        std::memcpy(state, initial, sizeof(initial));
+    }
+
+    void Sha1Compress(uint32_t state[5], uint32_t w[16])
+    {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            if (i >= 16)
+            {
+                w[i & 15] = Rotl(w[(i - 3) & 15] ^ w[(i - 8) & 15] ^ w[(i - 14) & 15] ^ w[i & 15], 1);
+            }
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = d ^ (b & (c ^ d));
+                k = 0x5a827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (d & (b | c));
+                k = 0x8f1bbcdc;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t t = Rotl(a, 5) + f + e + k + w[i & 15];
+            e = d;
+            d = c;
+            c = Rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+    }
+
+    void Sha1Finish(uint32_t state[5], const uint8_t* tail, size_t used, uint64_t length)
+    {
+        uint8_t block[Sha1BlockSize] = {};
+        std::memcpy(block, tail, used);
+        block[used++] = 0x80;
+        if (used > Sha1BlockSize - 8)
+        {
+            CompressBytes(state, block);
+            std::memset(block, 0, sizeof(block));
+        }
+        uint64_t bits = length * 8;
+        for (int i = 0; i < 8; ++i)
+        {
+            block[Sha1BlockSize - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+        CompressBytes(state, block);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace runlock::engine
+{
+    constexpr size_t Sha1DigestSize = 20;
+    constexpr size_t Sha1BlockSize = 64;
+
+    // Initial hash value H(0) from FIPS 180-4.
+    void Sha1Init(uint32_t state[5]);
+
+    // One compression of 16 big-endian message words. w doubles as the
+    // rolling message schedule and holds W[64..79] afterwards, which the RAR
+    // 2.9 key schedule depends on.
+    void Sha1Compress(uint32_t state[5], uint32_t w[16]);
+
+    // Pads and compresses the final partial block: `used` bytes of tail
+    // (less than a block) ending a message of `length` bytes in total.
+    void Sha1Finish(uint32_t state[5], const uint8_t* tail, size_t used, uint64_t length);
+}
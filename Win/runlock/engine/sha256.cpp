@@ -0,0 +1,167 @@
+#include "sha256.h"
+
+#include <cstring>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        inline uint32_t Rotr(uint32_t x, int n)
+        {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        inline uint32_t LoadBE32(const uint8_t* p)
+        {
+            return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+
+        inline void StoreBE32(uint8_t* p, uint32_t v)
+        {
+            p[0] = uint8_t(v >> 24);
+            p[1] = uint8_t(v >> 16);
+            p[2] = uint8_t(v >> 8);
+            p[3] = uint8_t(v);
+        }
+    }
+
+    void Sha256Init(uint32_t state[8])
+    {
+        static constexpr uint32_t initial[8] =
+        {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+        };
+        std::memcpy(state, initial, sizeof(initial));
+    }
+
+    void Sha256Compress(uint32_t state[8], const uint8_t block[Sha256BlockSize])
+    {
+        uint32_t words[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            words[i] = LoadBE32(block + i * 4);
+        }
+        Sha256CompressWords(state, words);
+    }
+
+    void Sha256CompressWords(uint32_t state[8], const uint32_t words[16])
+    {
+        uint32_t w[64];
+        std::memcpy(w, words, 16 * sizeof(uint32_t));
+        for (int i = 16; i < 64; ++i)
+        {
+            uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i)
+        {
+            uint32_t s1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + Sha256RoundConstants[i] + w[i];
+            uint32_t s0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    void Sha256Store(const uint32_t state[8], uint8_t digest[Sha256DigestSize])
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            StoreBE32(digest + i * 4, state[i]);
+        }
+    }
+
+    void Sha256::Update(const void* data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+        size_t used = static_cast<size_t>(m_length % Sha256BlockSize);
+        m_length += size;
+
+        if (used != 0)
+        {
+            size_t take = Sha256BlockSize - used;
+            if (size < take)
+            {
+                std::memcpy(m_buffer + used, bytes, size);
+                return;
+            }
+            std::memcpy(m_buffer + used, bytes, take);
+            Sha256Compress(m_state, m_buffer);
+            bytes += take;
+            size -= take;
+        }
+        for (; size >= Sha256BlockSize; bytes += Sha256BlockSize, size -= Sha256BlockSize)
+        {
+            Sha256Compress(m_state, bytes);
+        }
+        std::memcpy(m_buffer, bytes, size);
+    }
+
+    void Sha256::Final(uint8_t digest[Sha256DigestSize])
+    {
+        uint64_t bits = m_length * 8;
+        size_t used = static_cast<size_t>(m_length % Sha256BlockSize);
+        m_buffer[used++] = 0x80;
+        if (used > Sha256BlockSize - 8)
+        {
+            std::memset(m_buffer + used, 0, Sha256BlockSize - used);
+            Sha256Compress(m_state, m_buffer);
+            used = 0;
+        }
+        std::memset(m_buffer + used, 0, Sha256BlockSize - 8 - used);
+        StoreBE32(m_buffer + 56, static_cast<uint32_t>(bits >> 32));
+        StoreBE32(m_buffer + 60, static_cast<uint32_t>(bits));
+        Sha256Compress(m_state, m_buffer);
+        Sha256Store(m_state, digest);
+    }
+
+    void HmacSha256(const void* key, size_t keySize, const void* data, size_t dataSize,
+        uint8_t mac[Sha256DigestSize])
+    {
+        uint8_t pad[Sha256BlockSize] = {};
+        if (keySize > Sha256BlockSize)
+        {
+            Sha256 hash;
+            hash.Update(key, keySize);
+            hash.Final(pad);
+        }
+        else
+        {
+            std::memcpy(pad, key, keySize);
+        }
+
+        for (auto& byte : pad)
+        {
+            byte ^= 0x36;
+        }
+        uint8_t inner[Sha256DigestSize];
+        Sha256 innerHash;
+        innerHash.Update(pad, sizeof(pad));
+        innerHash.Update(data, dataSize);
+        innerHash.Final(inner);
+
+        for (auto& byte : pad)
+        {
+            byte ^= 0x36 ^ 0x5c;
+        }
+        Sha256 outerHash;
+        outerHash.Update(pad, sizeof(pad));
+        outerHash.Update(inner, sizeof(inner));
+        outerHash.Final(mac);
+    }
+}
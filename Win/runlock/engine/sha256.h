@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace runlock::engine
+{
+    constexpr size_t Sha256DigestSize = 32;
+    constexpr size_t Sha256BlockSize = 64;
+
+    // Round constants K from FIPS 180-4, shared with the vectorized kernels.
+    inline constexpr uint32_t Sha256RoundConstants[64] =
+    {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    // Initial hash value H(0) from FIPS 180-4.
+    void Sha256Init(uint32_t state[8]);
+
+    // One compression of a 64-byte block into state.
+    void Sha256Compress(uint32_t state[8], const uint8_t block[Sha256BlockSize]);
+
+    // Same, for a block already loaded as 16 big-endian message words.
+    void Sha256CompressWords(uint32_t state[8], const uint32_t words[16]);
+
+    // Big-endian serialization of a state into a digest.
+    void Sha256Store(const uint32_t state[8], uint8_t digest[Sha256DigestSize]);
+
+    class Sha256
+    {
+    public:
+        Sha256() { Sha256Init(m_state); }
+
+        void Update(const void* data, size_t size);
+        void Final(uint8_t digest[Sha256DigestSize]);
+
+    private:
+        uint32_t m_state[8];
+        uint8_t m_buffer[Sha256BlockSize];
+        uint64_t m_length = 0;
+    };
+
+    void HmacSha256(const void* key, size_t keySize, const void* data, size_t dataSize,
+        uint8_t mac[Sha256DigestSize]);
+}
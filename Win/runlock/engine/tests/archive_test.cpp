@@ -0,0 +1,68 @@
+#include "test.h"
+
+#include "fixtures.h"
+
+#include "archive.h"
+#include "archive_image.h"
+#include "content_check.h"
+#include "unrar_api.h"
+
+#include <string>
+
+using namespace runlock::engine;
+
+// Runs against tests/unrar_stub.cpp, whose one entry always ends in a
+// refused volume change, so the verdict rests on what came before it.
+namespace
+{
+    std::string SplitArchive()
+    {
+        LoadUnrar(RUNLOCK_UNRAR_STUB);
+        return runlock::test::WriteFile("split.part1.rar", "stub");
+    }
+}
+
+TEST(ReachingTheVolumeEndProvesNothing)
+{
+    DllVerifier verifier(SplitArchive(), 0);
+    CHECK(!verifier.Verify("wrong"));
+    CHECK(!verifier.Verify("split-ok"));    // nothing conclusive saw it either
+}
+
+TEST(AFullContentPrefixConfirmsASplitEntry)
+{
+    DllVerifier verifier(SplitArchive(), 0, ContentCheck::ForName("split.txt"));
+    CHECK(verifier.Verify("split-ok"));
+    CHECK(!verifier.Verify("wrong"));       // plausible, but too short to count
+}
+
+TEST(AKeyCheckedBeforeConfirmsASplitEntry)
+{
+    DllVerifier verifier(SplitArchive(), 0, ContentCheck(), true);
+    CHECK(verifier.Verify("split-ok"));
+}
+
+TEST(AnImageHoldsTheEntryAlone)
+{
+    for (bool rar5 : { true, false })
+    {
+        std::string archive = (runlock::test::Scratch() / (rar5 ? "image5.rar" : "image3.rar")).string();
+        runlock::bench::FixtureFile file{ "image.txt", std::string(100000, 'x') };
+        if (rar5)
+        {
+            runlock::bench::WriteRar5Fixture(archive, "pw", 6, file);
+        }
+        else
+        {
+            runlock::bench::WriteRar3Fixture(archive, "pw", file);
+        }
+        ArchiveInfo original = ListArchive(archive);
+        auto image = ArchiveImage::Build(archive, 0);
+        CHECK(image != nullptr);
+        ArchiveInfo cut = ListArchive(image->Path());
+        CHECK_EQ(cut.entries.size(), size_t(1));
+        CHECK_EQ(cut.entries[0].name, std::string("image.txt"));
+        CHECK_EQ(cut.entries[0].packSize, original.entries[0].packSize);
+        CHECK(cut.entries[0].packSize < image->Size());
+    }
+}
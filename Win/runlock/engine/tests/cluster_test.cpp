@@ -0,0 +1,192 @@
+#include "test.h"
+
+#include "fixtures.h"
+
+#include "cluster.h"
+#include "keyspace.h"
+#include "mapped_file.h"
+#include "project.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace runlock::engine;
+
+// The tests talk to the coordinator over a Unix domain socket.
+#ifndef _WIN32
+namespace
+{
+    constexpr const char* Rules = "?d?d";
+
+    Project Job(const std::string& archive)
+    {
+        Project job;
+        job.archivePath = archive;
+        job.archiveSize = MappedFile(archive).Size();
+        job.rules = Rules;
+        job.keyspaceSize = Keyspace::Compile(Rules).Size();
+        return job;
+    }
+
+    // Runs a coordinator on its own thread; stops and joins it on the way
+    // out, so a failed check does not leave it running.
+    class Serving
+    {
+    public:
+        explicit Serving(CoordinatorOptions options)
+            : m_coordinator(std::move(options))
+            , m_thread([this] { m_result = m_coordinator.Run(); })
+        {
+        }
+
+        ~Serving()
+        {
+            m_coordinator.Stop();
+            m_thread.join();
+        }
+
+        CoordinatorResult Finish()
+        {
+            m_thread.join();
+            m_thread = std::thread([] {});
+            return m_result;
+        }
+
+    private:
+        Coordinator m_coordinator;
+        CoordinatorResult m_result;
+        std::thread m_thread;
+    };
+
+    // A worker speaking the protocol by hand, as a broken or hostile one
+    // would.
+    class RawWorker
+    {
+    public:
+        explicit RawWorker(const std::string& path)
+            : m_socket(::socket(AF_UNIX, SOCK_STREAM, 0))
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+            timeval timeout{ 10, 0 };
+            ::setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            CHECK(::connect(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        }
+
+        ~RawWorker() { ::close(m_socket); }
+
+        void Send(std::string_view bytes)
+        {
+            CHECK(::send(m_socket, bytes.data(), bytes.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(bytes.size()));
+        }
+
+        // True when the coordinator closed the connection (after whatever
+        // it sent before), false on a timeout.
+        bool Dropped()
+        {
+            char chunk[4096];
+            ssize_t received;
+            while ((received = ::recv(m_socket, chunk, sizeof(chunk), 0)) > 0)
+            {
+            }
+            return received == 0;
+        }
+
+        // True once the coordinator has sent text, false when it closed the
+        // connection or timed out first.
+        bool Receives(std::string_view text)
+        {
+            char chunk[4096];
+            ssize_t received = 1;
+            while (m_received.find(text) == std::string::npos
+                && (received = ::recv(m_socket, chunk, sizeof(chunk), 0)) > 0)
+            {
+                m_received.append(chunk, static_cast<size_t>(received));
+            }
+            return m_received.find(text) != std::string::npos;
+        }
+
+    private:
+        int m_socket;
+        std::string m_received;
+    };
+}
+
+TEST(ReportsThatDoNotOpenTheArchiveAreRefused)
+{
+    std::string archive = (runlock::test::Scratch() / "cluster.rar").string();
+    runlock::bench::WriteRar5Fixture(archive, "42", 6);
+    std::string path = (runlock::test::Scratch() / "cluster.sock").string();
+
+    CoordinatorOptions options;
+    options.address = "unix:" + path;
+    options.job = Job(archive);
+    options.rangeSize = 25;
+    options.leaseSeconds = 5;
+    Serving serving(std::move(options));
+
+    {
+        // A payload size near 2^64 must not wrap the length check.
+        RawWorker evil(path);
+        evil.Send("hello runlock-cluster 1 evil\n");
+        evil.Send("found 18446744073709551615\nzzz\n");
+        CHECK(evil.Dropped());
+    }
+    {
+        RawWorker wrong(path);
+        wrong.Send("hello runlock-cluster 1 wrong\n");
+        wrong.Send("found 3\nzzz\n");
+        CHECK(wrong.Dropped());
+    }
+
+    ClusterWorkerOptions join;
+    join.address = "unix:" + path;
+    join.threads = 1;
+    join.name = "honest";
+    ClusterWorkerResult worked = ClusterWorker(std::move(join)).Run();
+    CHECK(worked.found);
+    CHECK_EQ(worked.ranges, 2u);    // "42" is in the second range; both share one setup
+
+    CoordinatorResult result = serving.Finish();
+    CHECK(result.found);
+    CHECK_EQ(result.password, std::string("42"));
+    CHECK_EQ(result.worker, std::string("honest"));
+}
+
+TEST(LateWorkersAreTurnedAwayWhileFinishing)
+{
+    std::string archive = (runlock::test::Scratch() / "finishing.rar").string();
+    runlock::bench::WriteRar5Fixture(archive, "42", 6);
+    std::string path = (runlock::test::Scratch() / "finishing.sock").string();
+
+    CoordinatorOptions options;
+    options.address = "unix:" + path;
+    options.job = Job(archive);
+    options.rangeSize = 25;
+    options.leaseSeconds = 5;
+    Serving serving(std::move(options));
+
+    // One worker holds a lease, so the coordinator waits for its report
+    // once another one has found the password.
+    RawWorker busy(path);
+    busy.Send("hello runlock-cluster 1 busy\nnext\n");
+    CHECK(busy.Receives("\nrange "));
+    RawWorker finder(path);
+    finder.Send("hello runlock-cluster 1 finder\nfound 2\n42\nnext\n");
+    CHECK(finder.Receives("\nstop\n"));
+
+    auto started = std::chrono::steady_clock::now();
+    RawWorker late(path);
+    CHECK(late.Dropped());
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+}
+#endif
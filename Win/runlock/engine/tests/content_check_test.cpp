@@ -0,0 +1,84 @@
+#include "test.h"
+
+#include "content_check.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace runlock::engine;
+
+namespace
+{
+    bool Plausible(std::string_view name, const std::string& data)
+    {
+        return ContentCheck::ForName(name).Plausible(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    }
+
+    std::string Garbage(size_t size)
+    {
+        std::mt19937 random(3);
+        std::string data(size, '\0');
+        for (char& c : data)
+        {
+            c = static_cast<char>(random());
+        }
+        return data;
+    }
+
+    std::string Utf16(std::string_view ascii, bool bigEndian)
+    {
+        std::string out;
+        for (char c : ascii)
+        {
+            out += bigEndian ? std::string{ '\0', c } : std::string{ c, '\0' };
+        }
+        return out;
+    }
+
+    std::string Text()
+    {
+        std::string text;
+        while (text.size() < 3000)
+        {
+            text += "The quick brown fox jumps over the lazy dog.\r\n";
+        }
+        return text;
+    }
+}
+
+TEST(RealPayloadsAreNeverRejected)
+{
+    std::string tail = Garbage(ContentCheck::PrefixSize);
+    CHECK(Plausible("notes.txt", Text()));
+    CHECK(Plausible("notes.txt", Utf16(Text(), false)));
+    CHECK(Plausible("notes.txt", Utf16(Text(), true)));
+    CHECK(Plausible("notes.txt", "\xFF\xFE" + Utf16(Text(), false)));
+    CHECK(Plausible("stray.log", Text() + std::string(3, '\0') + Text()));
+
+    // MPEG transport streams share .ts with TypeScript; no guess is made.
+    CHECK(!ContentCheck::ForName("clip.ts").Known());
+    CHECK(Plausible("clip.ts", "\x47" + tail));
+
+    for (const char* atom : { "ftyp", "moov", "mdat", "wide", "free", "skip", "pnot" })
+    {
+        CHECK(Plausible("movie.mov", std::string("\0\0\0\x08", 4) + atom + tail));
+    }
+    CHECK(Plausible("scan.tif", std::string("II*\0", 4) + tail));
+    CHECK(Plausible("scan.tiff", std::string("MM\0*", 4) + tail));
+    CHECK(Plausible("scan.tif", std::string("II+\0", 4) + tail));
+    CHECK(Plausible("scan.tiff", std::string("MM\0+", 4) + tail));
+    CHECK(Plausible("photo.png", "\x89PNG\r\n\x1A\n" + tail));
+    CHECK(Plausible("unknown.bin", tail));
+    CHECK(Plausible("short.png", "\x89P"));
+}
+
+TEST(GarbageIsStillRejected)
+{
+    std::string garbage = Garbage(ContentCheck::PrefixSize);
+    garbage[0] = 'x';
+    CHECK(!Plausible("notes.txt", garbage));
+    CHECK(!Plausible("photo.png", garbage));
+    CHECK(!Plausible("movie.mov", garbage));
+    CHECK(!Plausible("scan.tif", garbage));
+}
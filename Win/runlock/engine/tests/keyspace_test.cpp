@@ -0,0 +1,315 @@
+#include "test.h"
+
+#include "keyspace.h"
+#include "markov.h"
+#include "mutation.h"
+
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace runlock::engine;
+
+namespace
+{
+    // A candidate as the tests compare it; rejected ones are marked.
+    std::string Shown(std::string_view candidate)
+    {
+        return Segment::Rejected(candidate) ? std::string("(rejected)") : std::string(candidate);
+    }
+
+    std::vector<std::string> All(const Keyspace& keyspace)
+    {
+        std::vector<std::string> candidates;
+        std::vector<char> buffer(std::max<size_t>(keyspace.MaxBytes(), 1));
+        for (uint64_t i = 0; i < keyspace.Size(); ++i)
+        {
+            candidates.push_back(Shown(keyspace.View(i, buffer.data())));
+        }
+        return candidates;
+    }
+
+    std::vector<std::string> Sorted(std::vector<std::string> candidates)
+    {
+        std::sort(candidates.begin(), candidates.end());
+        return candidates;
+    }
+
+    // Fill (at several batch sizes and offsets) and ForEach must reject the
+    // candidates View rejects and produce the rest as View and At do.
+    void CheckAccessorsAgree(const Keyspace& keyspace)
+    {
+        const std::vector<std::string> expected = All(keyspace);
+        const size_t stride = std::max<size_t>(keyspace.MaxBytes(), 1);
+        std::vector<char> buffer(stride * 64);
+        for (uint64_t i = 0; i < expected.size(); ++i)
+        {
+            CHECK(keyspace.Generate(i, buffer.data()) <= keyspace.MaxBytes());
+            if (expected[i] != "(rejected)")
+            {
+                CHECK_EQ(keyspace.At(i), expected[i]);
+            }
+        }
+        for (size_t batch : { 1, 3, 17, 64 })
+        {
+            std::vector<std::string_view> views(batch);
+            for (uint64_t first = 0; first < expected.size(); first += (batch + 1) / 2)
+            {
+                size_t count = static_cast<size_t>(std::min<uint64_t>(batch, expected.size() - first));
+                keyspace.Fill(first, count, buffer.data(), stride, views.data());
+                for (size_t i = 0; i < count; ++i)
+                {
+                    CHECK_EQ(Shown(views[i]), expected[first + i]);
+                }
+            }
+        }
+        for (uint64_t first = 0; first <= expected.size(); first += 1 + expected.size() / 7)
+        {
+            uint64_t index = first;
+            keyspace.ForEach(first, expected.size(), buffer.data(), [&](std::string_view candidate)
+            {
+                CHECK_EQ(Shown(candidate), expected[index]);
+                ++index;
+                return true;
+            });
+            CHECK_EQ(index, static_cast<uint64_t>(expected.size()));
+        }
+    }
+
+    std::string Mutate(std::string_view rule, std::string_view word)
+    {
+        MutationRule parsed = MutationRule::Parse(rule);
+        std::string out(MaxMutatedBytes, '\0');
+        std::copy(word.begin(), word.end(), out.begin());
+        out.resize(parsed.Apply(out.data(), word.size()));
+        return out;
+    }
+}
+
+TEST(MaskEnumeratesPrefixesLexicographically)
+{
+    Keyspace keyspace = Keyspace::Compile("?d[ab]", { 1, 0, nullptr });
+    std::vector<std::string> expected;
+    for (char digit = '0'; digit <= '9'; ++digit)
+    {
+        expected.push_back(std::string(1, digit));
+    }
+    for (char digit = '0'; digit <= '9'; ++digit)
+    {
+        expected.push_back(std::string(1, digit) + 'a');
+        expected.push_back(std::string(1, digit) + 'b');
+    }
+    CHECK_EQ(keyspace.Size(), expected.size());
+    CHECK(All(keyspace) == expected);
+    CHECK(!Keyspace::Compile("?d[ab]").MayRepeat());
+
+    CHECK_EQ(Keyspace::Compile("?d?d?d", { 2, 2, nullptr }).Size(), 100u);
+    CHECK_EQ(Keyspace::Compile("?l?u?d?s", {}).Size(), 26u * 26u * 10u * 33u);
+    CHECK_EQ(Keyspace::Compile("=?l\nabc\n?a", {}).Size(), 2u + 95u);
+}
+
+TEST(ConstraintsCountExactlyTheMatchingCandidates)
+{
+    const std::string mask = "[ab1]?d[ab1][a1]";
+    const KeyspaceOptions options{ 1, 0, nullptr };
+    const std::vector<std::string> all = All(Keyspace::Compile(mask, options));
+
+    struct Case
+    {
+        std::string directives;
+        std::function<bool(const std::string&)> accepts;
+    };
+    const Case cases[] =
+    {
+        { "%require [a][1]", [](const std::string& s) { return s.find('a') != s.npos && s.find('1') != s.npos; } },
+        { "%repeat 1", [](const std::string& s) { return std::adjacent_find(s.begin(), s.end()) == s.end(); } },
+        { "%prefix a", [](const std::string& s) { return s.starts_with("a"); } },
+        { "%suffix 1", [](const std::string& s) { return s.ends_with("1"); } },
+        { "%length 2-3", [](const std::string& s) { return s.size() >= 2 && s.size() <= 3; } },
+        { "%length 3\n%require ?d\n%repeat 1\n%prefix b",
+            [](const std::string& s)
+            {
+                return s.size() == 3 && s.find_first_of("0123456789") != s.npos
+                    && std::adjacent_find(s.begin(), s.end()) == s.end() && s.starts_with("b");
+            } },
+    };
+    for (const auto& test : cases)
+    {
+        std::vector<std::string> expected;
+        std::copy_if(all.begin(), all.end(), std::back_inserter(expected), test.accepts);
+        Keyspace constrained = Keyspace::Compile(test.directives + "\n" + mask, options);
+        CHECK_EQ(constrained.Size(), expected.size());
+        CHECK(Sorted(All(constrained)) == Sorted(expected));
+        CheckAccessorsAgree(constrained);
+    }
+}
+
+TEST(MarkovOrderKeepsTheCandidates)
+{
+    std::string sample = runlock::test::WriteFile("sample.txt", "password\n123456\nqwerty\nabc123\npass1\n");
+    auto model = MarkovModel::Train(sample);
+    Keyspace plain = Keyspace::Compile("?l?d?l", { 1, 0, nullptr });
+    Keyspace ordered = Keyspace::Compile("?l?d?l", { 1, 0, model });
+    CHECK_EQ(ordered.Size(), plain.Size());
+    CHECK(Sorted(All(ordered)) == Sorted(All(plain)));
+    CHECK(All(ordered) != All(plain));
+    CheckAccessorsAgree(ordered);
+}
+
+TEST(WordListsSkipUnusableLines)
+{
+    std::string list = runlock::test::WriteFile("words.txt",
+        "\xEF\xBB\xBF" "alpha\r\n\nbeta\r\n" + std::string(600, 'x') + "\ngamma");
+    CHECK(All(Keyspace::Compile("@" + list)) == (std::vector<std::string>{ "alpha", "beta", "gamma" }));
+    CHECK(All(Keyspace::Compile("@" + list, { 5, 0, nullptr })) == (std::vector<std::string>{ "alpha", "gamma" }));
+    CHECK(Keyspace::Compile("@" + list).MayRepeat());
+
+    // RAR's limit is 127 characters, not bytes.
+    std::string wide;
+    for (int i = 0; i < 127; ++i)
+    {
+        wide += "\xC3\xA4";
+    }
+    std::string limits = runlock::test::WriteFile("limits.txt",
+        std::string(127, 'a') + "\n" + std::string(128, 'b') + "\n" + wide + "\n" + wide + "\xC3\xA4\n");
+    CHECK(All(Keyspace::Compile("@" + limits)) == (std::vector<std::string>{ std::string(127, 'a'), wide }));
+    CHECK_THROWS(Keyspace::Compile("@" + list + ".missing"), RuleError);
+}
+
+TEST(AccessorsAgreeForEverySegmentKind)
+{
+    std::string list = runlock::test::WriteFile("list.txt", "one\ntwo\r\nthree\nfour\n");
+    std::string sample = runlock::test::WriteFile("markov.txt", "zebra\nzz9\n");
+    const std::string rules[] =
+    {
+        "?d?d?d",
+        "[äöü]?d[€$]",
+        "alpha\nbeta\n=?d\n?d?l\ngamma",
+        "@" + list,
+        "%require ?d\n%repeat 1\n?l?d[ab]?d",
+        "%mutate :\n%mutate c $1\n%mutate r\nword\n@" + list,
+        "%combine permute\n%tokens\nab\n=x\n%tokens\ncd\n%separator\n%separator -\n%end",
+    };
+    for (const auto& text : rules)
+    {
+        CheckAccessorsAgree(Keyspace::Compile(text, { 1, 0, nullptr }));
+    }
+    CheckAccessorsAgree(Keyspace::Compile("?l?d?l", { 1, 0, MarkovModel::Train(sample) }));
+}
+
+TEST(MutationRulesMatchHashcat)
+{
+    const std::pair<const char*, const char*> cases[] =
+    {
+        { ":", "password" }, { "l", "password" }, { "u", "PASSWORD" }, { "c", "Password" },
+        { "C", "pASSWORD" }, { "t", "PASSWORD" }, { "T0", "Password" }, { "r", "drowssap" },
+        { "d", "passwordpassword" }, { "f", "passworddrowssap" }, { "{", "asswordp" },
+        { "}", "dpasswor" }, { "[", "assword" }, { "]", "passwor" }, { "D2", "pasword" },
+        { "$1$2", "password12" }, { "^!", "!password" }, { "sa@", "p@ssword" }, { "@s", "paword" },
+        { "c $1 so0", "Passw0rd1" },
+    };
+    for (const auto& [rule, expected] : cases)
+    {
+        CHECK_EQ(Mutate(rule, "password"), std::string(expected));
+    }
+    CHECK_EQ(Mutate("T9", "short"), std::string("short"));
+    CHECK_THROWS(MutationRule::Parse("X"), std::runtime_error);
+    CHECK_THROWS(MutationRule::Parse("$"), std::runtime_error);
+
+    // Candidate N is rule N / words applied to word N % words.
+    Keyspace keyspace = Keyspace::Compile("%mutate :\n%mutate u\none\ntwo");
+    CHECK(All(keyspace) == (std::vector<std::string>{ "one", "two", "ONE", "TWO" }));
+
+    // "=" escapes a rule that would read as a file path.
+    Keyspace purged = Keyspace::Compile("%mutate =@a\n%mutate =@b $!\nbanana");
+    CHECK(All(purged) == (std::vector<std::string>{ "bnn", "anana!" }));
+    CHECK_THROWS(Keyspace::Compile("%mutate @missing-rules.txt\nword"), RuleError);
+}
+
+TEST(CombinationsCoverTheProduct)
+{
+    Keyspace keyspace = Keyspace::Compile(
+        "%combine permute\n%tokens\nab\n=x\n%tokens\ncd\nzz\n%separator\n%separator -\n%end");
+    const std::vector<std::string> expected =
+    {
+        "abcd", "abzz", "xcd", "xzz", "ab-cd", "ab-zz", "x-cd", "x-zz",
+        "cdab", "zzab", "cdx", "zzx", "cd-ab", "zz-ab", "cd-x", "zz-x",
+    };
+    CHECK(All(keyspace) == expected);
+    CHECK_EQ(keyspace.Origin(8), std::string("token lists in order 2, 1"));
+
+    std::string big = "%combine permute\n";
+    for (int list = 0; list < 4; ++list)
+    {
+        big += "%tokens\n";
+        for (int token = 0; token <= list; ++token)
+        {
+            big += 't';
+            big += std::to_string(list * 10 + token);
+            big += '\n';
+        }
+    }
+    big += "%separator _\n%separator .\n%end\n";
+    Keyspace product = Keyspace::Compile(big);
+    CHECK_EQ(product.Size(), 1u * 2u * 3u * 4u * 2u * 24u);
+    std::vector<std::string> all = All(product);
+    CHECK_EQ(std::set<std::string>(all.begin(), all.end()).size(), all.size());
+}
+
+TEST(ConstraintsApplyToMutatedAndCombinedOutput)
+{
+    // The output is checked, not the base word: "abcde" is too short, its
+    // mutation is not.
+    Keyspace mutated = Keyspace::Compile("%length 7-8\n%mutate :\n%mutate $1$2\nabcde\nabcdefg");
+    CHECK(mutated.MayReject());
+    CHECK(All(mutated) == (std::vector<std::string>{ "(rejected)", "abcdefg", "abcde12", "(rejected)" }));
+    CheckAccessorsAgree(mutated);
+
+    // The KeyspaceOptions bounds count as constraints too.
+    Keyspace bounded = Keyspace::Compile("%mutate :\n%mutate d\nabc", { 0, 4, nullptr });
+    CHECK(All(bounded) == (std::vector<std::string>{ "abc", "(rejected)" }));
+
+    // Each word is held to the constraints of its own line.
+    Keyspace changing = Keyspace::Compile("%mutate u\n%prefix A\nab\nba\n%prefix B\nab\nba");
+    CHECK(All(changing) == (std::vector<std::string>{ "AB", "(rejected)", "(rejected)", "BA" }));
+
+    std::string words = runlock::test::WriteFile("mutated.txt", "pass\nword\n");
+    Keyspace listed = Keyspace::Compile("%require ?d\n%mutate :\n%mutate $7\n@" + words);
+    CHECK(All(listed) == (std::vector<std::string>{ "(rejected)", "(rejected)", "pass7", "word7" }));
+    CheckAccessorsAgree(listed);
+
+    Keyspace combined = Keyspace::Compile("%require ?d\n%repeat 1\n%combine\n%tokens\nab\n1b\n%tokens\nx\nbb\n2\n%end");
+    CHECK(All(combined) == (std::vector<std::string>{ "(rejected)", "(rejected)", "ab2", "1bx", "(rejected)", "1b2" }));
+    CheckAccessorsAgree(combined);
+
+    // Without mutation or combination nothing is rejected.
+    CHECK(!Keyspace::Compile("%length 7-\nabcde\n?d").MayReject());
+}
+
+TEST(BadRulesNameTheirLine)
+{
+    const std::pair<const char*, size_t> cases[] =
+    {
+        { "?l\n?x", 2 },
+        { "[a-", 1 },
+        { "ok\n%length x", 2 },
+        { "%combine\n%tokens\nab\n", 1 },
+        { "%tokens", 1 },
+        { "%combine\n%tokens\n%end", 1 },
+        { "%mutate X", 1 },
+    };
+    for (const auto& [rules, line] : cases)
+    {
+        try
+        {
+            Keyspace::Compile(rules);
+            runlock::test::Fail(__FILE__, __LINE__, std::string("compiled: ") + rules);
+        }
+        catch (const RuleError& e)
+        {
+            CHECK_EQ(e.Line(), line);
+        }
+    }
+}
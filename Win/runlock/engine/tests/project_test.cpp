@@ -0,0 +1,86 @@
+#include "test.h"
+
+#include "project.h"
+
+#include <fstream>
+#include <stdexcept>
+
+using namespace runlock::engine;
+
+namespace
+{
+    Project Sample()
+    {
+        Project project;
+        project.archivePath = "D:\\backup files\\secret.rar";
+        project.archiveSize = 1048576;
+        project.rules = "# names\n?u?l?l?l\n%length 6-\n@words.txt\n=line with\ttab\n";
+        project.minLength = 4;
+        project.maxLength = 12;
+        project.markovPath = "leaked passwords.txt";
+        project.threads = 16;
+        project.keyspaceSize = 308915776;
+        project.done.Add(0, 1200000);
+        project.done.Add(5000000, 5100000);
+        project.password = "pass\nword with a newline";
+        return project;
+    }
+
+    void CheckSame(const Project& loaded, const Project& saved)
+    {
+        CHECK_EQ(loaded.archivePath, saved.archivePath);
+        CHECK_EQ(loaded.archiveSize, saved.archiveSize);
+        CHECK_EQ(loaded.rules, saved.rules);
+        CHECK_EQ(loaded.minLength, saved.minLength);
+        CHECK_EQ(loaded.maxLength, saved.maxLength);
+        CHECK_EQ(loaded.markovPath, saved.markovPath);
+        CHECK_EQ(loaded.threads, saved.threads);
+        CHECK_EQ(loaded.keyspaceSize, saved.keyspaceSize);
+        CHECK_EQ(loaded.done.Ranges().size(), saved.done.Ranges().size());
+        for (size_t i = 0; i < saved.done.Ranges().size(); ++i)
+        {
+            CHECK_EQ(loaded.done.Ranges()[i].first, saved.done.Ranges()[i].first);
+            CHECK_EQ(loaded.done.Ranges()[i].last, saved.done.Ranges()[i].last);
+        }
+        CHECK_EQ(loaded.password.has_value(), saved.password.has_value());
+        if (saved.password)
+        {
+            CHECK_EQ(*loaded.password, *saved.password);
+        }
+    }
+}
+
+TEST(SaveAndLoadRoundTrip)
+{
+    std::string path = (runlock::test::Scratch() / "job.runlock").string();
+    Project saved = Sample();
+    SaveProject(saved, path);
+    CheckSame(LoadProject(path), saved);
+
+    // Saving again replaces the file in place.
+    saved.password.reset();
+    saved.markovPath.clear();
+    saved.done.Add(1200000, 5000000);
+    SaveProject(saved, path);
+    CheckSame(LoadProject(path), saved);
+}
+
+TEST(SerializeAndParseRoundTrip)
+{
+    Project saved = Sample();
+    CheckSame(ParseProject(SerializeProject(saved), "job"), saved);
+
+    Project empty;
+    CheckSame(ParseProject(SerializeProject(empty), "job"), empty);
+}
+
+TEST(RejectsOtherFiles)
+{
+    std::string path = runlock::test::WriteFile("notes.txt", "not a project\n");
+    CHECK_THROWS(LoadProject(path), std::runtime_error);
+    CHECK_THROWS(LoadProject((runlock::test::Scratch() / "missing.runlock").string()), std::runtime_error);
+
+    // A truncated project is as bad as a foreign file.
+    std::string text = SerializeProject(Sample());
+    CHECK_THROWS(ParseProject(text.substr(0, text.size() / 2), "job"), std::runtime_error);
+}
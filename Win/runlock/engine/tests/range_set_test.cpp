@@ -0,0 +1,128 @@
+#include "test.h"
+
+#include "range_set.h"
+
+#include <random>
+#include <vector>
+
+using namespace runlock::engine;
+
+namespace
+{
+    constexpr uint64_t Universe = 200;
+
+    std::vector<bool> Members(const RangeSet& set)
+    {
+        std::vector<bool> members(Universe);
+        uint64_t previousLast = 0;
+        bool first = true;
+        for (const auto& range : set.Ranges())
+        {
+            // Sorted, disjoint, non-adjacent and non-empty.
+            CHECK(range.first < range.last);
+            CHECK(first || range.first > previousLast);
+            first = false;
+            previousLast = range.last;
+            for (uint64_t i = range.first; i < range.last; ++i)
+            {
+                members[i] = true;
+            }
+        }
+        return members;
+    }
+
+    uint64_t Count(const std::vector<bool>& members)
+    {
+        uint64_t count = 0;
+        for (bool member : members)
+        {
+            count += member;
+        }
+        return count;
+    }
+}
+
+TEST(AddMergesOverlappingAndAdjacentRanges)
+{
+    RangeSet set;
+    set.Add(10, 20);
+    set.Add(20, 30);
+    set.Add(5, 12);
+    set.Add(40, 40);
+    CHECK_EQ(set.Ranges().size(), 1u);
+    CHECK_EQ(set.Ranges()[0].first, 5u);
+    CHECK_EQ(set.Ranges()[0].last, 30u);
+    set.Add(31, 35);
+    CHECK_EQ(set.Ranges().size(), 2u);
+    CHECK_EQ(set.Count(), 29u);
+    CHECK_EQ(set.End(), 35u);
+}
+
+TEST(RandomOperationsMatchBruteForce)
+{
+    std::mt19937_64 random(7);
+    for (int round = 0; round < 200; ++round)
+    {
+        RangeSet set;
+        std::vector<bool> expected(Universe);
+        for (int step = 0; step < 12; ++step)
+        {
+            uint64_t a = random() % Universe;
+            uint64_t b = random() % Universe;
+            uint64_t first = std::min(a, b);
+            uint64_t last = std::max(a, b);
+            if (random() % 2)
+            {
+                set.Add(first, last);
+            }
+            else
+            {
+                RangeSet other;
+                other.Add(first, last);
+                other.Add(last / 2, last / 2 + 3);
+                set.Add(other);
+                for (uint64_t i = last / 2; i < last / 2 + 3; ++i)
+                {
+                    expected[i] = true;
+                }
+            }
+            for (uint64_t i = first; i < last; ++i)
+            {
+                expected[i] = true;
+            }
+        }
+        CHECK(Members(set) == expected);
+        CHECK_EQ(set.Count(), Count(expected));
+
+        std::vector<bool> complement = Members(set.Complement(Universe));
+        for (uint64_t i = 0; i < Universe; ++i)
+        {
+            CHECK(complement[i] != expected[i]);
+        }
+
+        uint64_t skip = random() % (Count(expected) + 1);
+        uint64_t count = random() % (Universe / 2);
+        std::vector<bool> slice(Universe);
+        uint64_t position = 0;
+        for (uint64_t i = 0; i < Universe; ++i)
+        {
+            if (expected[i])
+            {
+                slice[i] = position >= skip && position < skip + count;
+                ++position;
+            }
+        }
+        CHECK(Members(set.Slice(skip, count)) == slice);
+    }
+}
+
+TEST(ComplementOfEmptyIsEverything)
+{
+    RangeSet empty;
+    CHECK(empty.Empty());
+    CHECK_EQ(empty.End(), 0u);
+    RangeSet all = empty.Complement(Universe);
+    CHECK_EQ(all.Ranges().size(), 1u);
+    CHECK_EQ(all.Count(), Universe);
+    CHECK(all.Complement(Universe).Empty());
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A minimal harness, so the tests build wherever the engine does: each
+// tests/*_test.cpp is one executable and one CTest entry, made of TEST
+// cases that run in file order. A failed CHECK ends its case; the
+// executable reports every case and exits non-zero if any failed.
+namespace runlock::test
+{
+    struct Case
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    std::vector<Case>& Cases();
+
+    struct Registration
+    {
+        Registration(const char* name, void (*run)()) { Cases().push_back({ name, run }); }
+    };
+
+    [[noreturn]] void Fail(const char* file, int line, const std::string& message);
+
+    // An empty directory for the running executable, removed when it exits.
+    const std::filesystem::path& Scratch();
+
+    // Writes text to a file in Scratch() and returns its path.
+    std::string WriteFile(std::string_view name, std::string_view text);
+
+    template <typename A, typename B>
+    void CheckEqual(const A& actual, const B& expected, const char* text, const char* file, int line)
+    {
+        if (!(actual == expected))
+        {
+            std::ostringstream message;
+            message << text << ": got " << actual << ", expected " << expected;
+            Fail(file, line, message.str());
+        }
+    }
+}
+
+#define TEST(name)                                                                          \
+    static void name();                                                                     \
+    static const runlock::test::Registration name##Registration(#name, name);               \
+    static void name()
+
+#define CHECK(condition)                                                                    \
+    do                                                                                      \
+    {                                                                                       \
+        if (!(condition))                                                                   \
+        {                                                                                   \
+            runlock::test::Fail(__FILE__, __LINE__, #condition);                            \
+        }                                                                                   \
+    } while (false)
+
+#define CHECK_EQ(actual, expected)                                                          \
+    runlock::test::CheckEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expression, type)                                                      \
+    do                                                                                      \
+    {                                                                                       \
+        bool thrown = false;                                                                \
+        try                                                                                 \
+        {                                                                                   \
+            (void)(expression);                                                             \
+        }                                                                                   \
+        catch (const type&)                                                                 \
+        {                                                                                   \
+            thrown = true;                                                                  \
+        }                                                                                   \
+        if (!thrown)                                                                        \
+        {                                                                                   \
+            runlock::test::Fail(__FILE__, __LINE__, #expression " did not throw " #type);  \
+        }                                                                                   \
+    } while (false)
@@ -0,0 +1,85 @@
+#include "test.h"
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+namespace runlock::test
+{
+    namespace
+    {
+        struct Failure : std::runtime_error
+        {
+            using std::runtime_error::runtime_error;
+        };
+
+        struct ScratchDirectory
+        {
+            ScratchDirectory()
+            {
+                std::random_device random;
+                path = std::filesystem::temp_directory_path() / ("runlock-test-" + std::to_string(random()));
+                std::filesystem::create_directories(path);
+            }
+
+            ~ScratchDirectory()
+            {
+                std::error_code ignored;
+                std::filesystem::remove_all(path, ignored);
+            }
+
+            std::filesystem::path path;
+        };
+    }
+
+    std::vector<Case>& Cases()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    void Fail(const char* file, int line, const std::string& message)
+    {
+        throw Failure(std::string(file) + ":" + std::to_string(line) + ": " + message);
+    }
+
+    const std::filesystem::path& Scratch()
+    {
+        static ScratchDirectory scratch;
+        return scratch.path;
+    }
+
+    std::string WriteFile(std::string_view name, std::string_view text)
+    {
+        std::string path = (Scratch() / name).string();
+        std::ofstream file(path, std::ios::binary);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!file.flush())
+        {
+            throw std::runtime_error("cannot write " + path);
+        }
+        return path;
+    }
+}
+
+int main()
+{
+    int failed = 0;
+    for (const auto& test : runlock::test::Cases())
+    {
+        try
+        {
+            test.run();
+            std::printf("ok    %s\n", test.name);
+        }
+        catch (const std::exception& e)
+        {
+            ++failed;
+            std::printf("FAIL  %s\n      %s\n", test.name, e.what());
+        }
+    }
+    std::printf("%zu cases, %d failed\n", runlock::test::Cases().size(), failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+// A stand-in for the UnRAR library, loaded by the archive test in place of
+// the real one. Every archive holds one text entry that continues in the
+// next volume. Testing it delivers some data and then asks for that volume,
+// and the test ends with ERAR_EOPEN once the request is refused, whatever
+// the password: like a RAR 2.9 entry, where a wrong key decodes garbage up
+// to the end of the volume.
+
+#include "unrar_api.h"
+
+#include <cstring>
+#include <cwchar>
+#include <string>
+
+namespace
+{
+    constexpr const wchar_t* RightPassword = L"split-ok";
+
+    struct StubArchive
+    {
+        UNRARCALLBACK callback = nullptr;
+        LPARAM userData = 0;
+        bool headerRead = false;
+    };
+
+    int Send(StubArchive& archive, UINT msg, LPARAM p1, LPARAM p2)
+    {
+        return archive.callback == nullptr ? -1 : archive.callback(msg, archive.userData, p1, p2);
+    }
+}
+
+extern "C"
+{
+    HANDLE PASCAL RAROpenArchiveEx(struct RAROpenArchiveDataEx* data)
+    {
+        auto archive = new StubArchive;
+        archive->callback = data->Callback;
+        archive->userData = data->UserData;
+        data->OpenResult = ERAR_SUCCESS;
+        data->Flags = ROADF_VOLUME | ROADF_FIRSTVOLUME;
+        return archive;
+    }
+
+    int PASCAL RARCloseArchive(HANDLE handle)
+    {
+        delete static_cast<StubArchive*>(handle);
+        return ERAR_SUCCESS;
+    }
+
+    int PASCAL RARReadHeaderEx(HANDLE handle, struct RARHeaderDataEx* header)
+    {
+        auto archive = static_cast<StubArchive*>(handle);
+        if (archive->headerRead)
+        {
+            return ERAR_END_ARCHIVE;
+        }
+        archive->headerRead = true;
+        std::memset(header, 0, sizeof(*header));
+        std::wcscpy(header->FileNameW, L"split.txt");
+        std::strcpy(header->FileName, "split.txt");
+        header->Flags = RHDF_SPLITAFTER | RHDF_ENCRYPTED;
+        return ERAR_SUCCESS;
+    }
+
+    int PASCAL RARProcessFile(HANDLE handle, int operation, char*, char*)
+    {
+        auto archive = static_cast<StubArchive*>(handle);
+        if (operation != RAR_TEST)
+        {
+            return ERAR_SUCCESS;
+        }
+
+        wchar_t password[128] = {};
+        if (Send(*archive, UCM_NEEDPASSWORDW, reinterpret_cast<LPARAM>(password), 128) < 0)
+        {
+            return ERAR_MISSING_PASSWORD;
+        }
+
+        // The right password decodes a full content prefix of text before
+        // the volume ends, a wrong one only a few bytes.
+        std::string data(std::wcscmp(password, RightPassword) == 0 ? 4096 : 16, 'a');
+        if (Send(*archive, UCM_PROCESSDATA, reinterpret_cast<LPARAM>(data.data()), static_cast<LPARAM>(data.size())) < 0)
+        {
+            return ERAR_UNKNOWN;
+        }
+
+        wchar_t next[] = L"split.part2.rar";
+        Send(*archive, UCM_CHANGEVOLUMEW, reinterpret_cast<LPARAM>(next), RAR_VOL_ASK);
+        return ERAR_EOPEN;
+    }
+
+    void PASCAL RARSetCallback(HANDLE handle, UNRARCALLBACK callback, LPARAM userData)
+    {
+        auto archive = static_cast<StubArchive*>(handle);
+        archive->callback = callback;
+        archive->userData = userData;
+    }
+
+    int PASCAL RARGetDllVersion()
+    {
+        return RAR_DLL_VERSION;
+    }
+}
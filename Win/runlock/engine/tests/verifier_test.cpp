@@ -0,0 +1,217 @@
+#include "test.h"
+
+#include "fixtures.h"
+
+#include "archive.h"
+#include "engine.h"
+#include "rar3.h"
+#include "rar3_kdf.h"
+#include "unrar_api.h"
+#include "verifier.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace runlock::engine;
+
+namespace
+{
+    // Cheap enough for a test, and the derivation is still the real one.
+    constexpr uint32_t Lg2Count = 6;
+
+    std::string Rar5(const std::string& name, const std::string& password, const runlock::bench::FixtureFile& file = {})
+    {
+        std::string path = (runlock::test::Scratch() / name).string();
+        runlock::bench::WriteRar5Fixture(path, password, Lg2Count, file);
+        return path;
+    }
+
+    std::string Rar3(const std::string& name, const std::string& password, const runlock::bench::FixtureFile& file = {})
+    {
+        std::string path = (runlock::test::Scratch() / name).string();
+        runlock::bench::WriteRar3Fixture(path, password, file);
+        return path;
+    }
+
+    EngineResult Recover(const std::string& archive, const std::string& rules, std::vector<std::string> batch = {})
+    {
+        EngineOptions options;
+        options.archivePath = archive;
+        options.batchPaths = std::move(batch);
+        options.rules = rules;
+        options.threads = 2;
+        options.progressMilliseconds = 50;
+        return Engine(std::move(options)).Run();
+    }
+
+    void CheckFactory(const std::string& archive, const std::string& password)
+    {
+        VerifierFactory factory(ListArchive(archive), 0);
+        auto verifier = factory.Create();
+        CHECK(verifier->Verify(password));
+        CHECK(!verifier->Verify(password + "x"));
+        CHECK(!verifier->Verify(""));
+    }
+}
+
+TEST(Rar5CheckValueFindsThePassword)
+{
+    std::string archive = Rar5("rar5.rar", "zq7");
+    CheckFactory(archive, "zq7");
+    EngineResult result = Recover(archive, "?l?l?d");
+    CHECK(result.found);
+    CHECK_EQ(result.password, std::string("zq7"));
+    CHECK_EQ(result.verification.find("rar5"), size_t(0));
+}
+
+TEST(Rar3StoredCrcFindsThePassword)
+{
+    std::string archive = Rar3("rar3.rar", "pw-3");
+    CheckFactory(archive, "pw-3");
+    EngineResult result = Recover(archive, "pw-1\npw-2\npw-?d\nother");
+    CHECK(result.found);
+    CHECK_EQ(result.password, std::string("pw-3"));
+    CHECK_EQ(result.verification.find("rar3"), size_t(0));
+}
+
+TEST(Rar3CompressedEntryPassesTheTableCheck)
+{
+    std::string archive = (runlock::test::Scratch() / "rar3lz.rar").string();
+    runlock::bench::WriteRar3CompressedFixture(archive, "lz-5");
+    std::optional<Rar3Target> target = ReadRar3Target(archive, 0);
+    CHECK(target.has_value());
+    CHECK_EQ(target->probes.size(), 2u);
+    CHECK_EQ(target->probes[0].method, 0x33u);
+
+    // The compressed probe alone: the right key decodes its tables, and the
+    // wrong ones nearly all fail them.
+    Rar3Target compressed = *target;
+    compressed.probes.resize(1);
+    Rar3Keys keys;
+    DeriveRar3Keys("lz-5", target->salt, keys);
+    CHECK(Rar3KeyPlausible(compressed, keys));
+    size_t passed = 0;
+    for (const char* wrong : { "lz-0", "lz-1", "lz-2", "lz-3", "lz-4", "lz-6", "lz-7", "lz-8" })
+    {
+        DeriveRar3Keys(wrong, target->salt, keys);
+        passed += Rar3KeyPlausible(compressed, keys) ? 1 : 0;
+    }
+    CHECK(passed <= 1);
+
+    CheckFactory(archive, "lz-5");
+    EngineResult result = Recover(archive, "lz-?d");
+    CHECK(result.found);
+    CHECK_EQ(result.password, std::string("lz-5"));
+}
+
+TEST(RejectedCandidatesAreSkippedNotTested)
+{
+    // ab abc abcd ab9 abc9 abcd9: three rejected before the hit, one after.
+    std::string archive = Rar5("rejected.rar", "abc9");
+    EngineOptions options;
+    options.archivePath = archive;
+    options.rules = "%length 4\n%mutate :\n%mutate $9\nab\nabc\nabcd";
+    options.threads = 1;
+    EngineResult result = Engine(std::move(options)).Run();
+    CHECK(result.found);
+    CHECK_EQ(result.password, std::string("abc9"));
+    CHECK_EQ(result.keyspace, 6u);
+    CHECK_EQ(result.done.Count(), 5u);
+    CHECK_EQ(result.rejected, 3u);
+    CHECK_EQ(result.tested, 2u);
+    CHECK_EQ(result.duplicates, 0u);
+}
+
+TEST(ResumingOverAChangedWordListIsRefused)
+{
+    std::string archive = Rar5("resume.rar", "gamma");
+    std::string list = runlock::test::WriteFile("resume.txt", "alpha\nbeta\n");
+    EngineOptions options;
+    options.archivePath = archive;
+    options.rules = "@" + list;
+    options.threads = 1;
+    EngineResult first = Engine(options).Run();
+    CHECK(!first.found);
+    CHECK_EQ(first.keyspace, 2u);
+
+    // "gamma" would take index 1 and count as tested.
+    runlock::test::WriteFile("resume.txt", "alpha\ngamma\nbeta\n");
+    options.done.Add(0, 1);
+    options.keyspaceSize = first.keyspace;
+    CHECK_THROWS(Engine(options).Run(), std::runtime_error);
+
+    options.keyspaceSize = 3;
+    EngineResult resumed = Engine(options).Run();
+    CHECK(resumed.found);
+    CHECK_EQ(resumed.password, std::string("gamma"));
+}
+
+TEST(BatchRunOpensEveryArchive)
+{
+    // The two RAR5 fixtures share salt and iteration count, so they share
+    // one key derivation per candidate; the RAR3 one gets its own group.
+    std::string first = Rar5("batch1.rar", "b2");
+    std::string second = Rar5("batch2.rar", "c7");
+    std::string third = Rar3("batch3.rar", "a1");
+    EngineResult result = Recover(first, "?l?d", { second, third });
+    CHECK(result.found);
+    CHECK_EQ(result.archives.size(), 3u);
+    CHECK_EQ(result.archives[0].password, std::string("b2"));
+    CHECK_EQ(result.archives[1].password, std::string("c7"));
+    CHECK_EQ(result.archives[2].password, std::string("a1"));
+}
+
+TEST(ExhaustedKeyspaceFindsNothing)
+{
+    std::string archive = Rar5("miss.rar", "absent");
+    EngineResult result = Recover(archive, "?d?d");
+    CHECK(!result.found);
+    CHECK(!result.stopped);
+    CHECK_EQ(result.tested, 100u);
+}
+
+TEST(EntriesTheContentGuessCouldMisjudgeAreFound)
+{
+    // Behind a check value or a CRC the library confirms without the
+    // content guess, and the guess itself lets these payloads through.
+    std::string utf16;
+    for (char c : std::string("plain notes, no byte order mark\r\n"))
+    {
+        utf16 += c;
+        utf16 += '\0';
+    }
+    const runlock::bench::FixtureFile files[] =
+    {
+        { "clip.ts", std::string("\x47\x40\x00\x10\x00\x00\xB0\x0D", 8) },
+        { "notes.txt", utf16 },
+        { "movie.mov", std::string("\0\0\0\x08wide\0\0\0\x10mdat", 16) },
+        { "scan.tif", std::string("II+\0\x08\0\0\0", 8) },
+    };
+    int n = 0;
+    for (const auto& file : files)
+    {
+        std::string name = "payload" + std::to_string(n++);
+        for (const std::string& archive : { Rar5(name + ".rar5.rar", "k4", file), Rar3(name + ".rar3.rar", "k4", file) })
+        {
+            EngineResult result = Recover(archive, "?l?d");
+            CHECK(result.found);
+            CHECK_EQ(result.password, std::string("k4"));
+        }
+    }
+}
+
+TEST(UnrarTestFindsThePassword)
+{
+    // The confirming path needs the UnRAR library; without it there is
+    // nothing to run.
+    if (TryLoadUnrar() == nullptr)
+    {
+        return;
+    }
+    std::string archive = Rar5("unrar.rar", "u9");
+    VerifierFactory factory(ListArchive(archive), 0);
+    auto verifier = factory.Create();
+    CHECK(verifier->Verify("u9"));
+    CHECK(!verifier->Verify("u8"));
+}
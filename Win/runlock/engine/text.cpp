@@ -0,0 +1,179 @@
+#include "text.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        constexpr char32_t ReplacementChar = 0xFFFD;
+    }
+
+    char32_t DecodeUtf8(std::string_view text, size_t& pos)
+    {
+        auto lead = static_cast<uint8_t>(text[pos++]);
+        if (lead < 0x80)
+        {
+            return lead;
+        }
+
+        size_t extra;
+        char32_t cp;
+        if ((lead & 0xE0) == 0xC0) { extra = 1; cp = lead & 0x1F; }
+        else if ((lead & 0xF0) == 0xE0) { extra = 2; cp = lead & 0x0F; }
+        else if ((lead & 0xF8) == 0xF0) { extra = 3; cp = lead & 0x07; }
+        else { return ReplacementChar; }
+
+        if (pos + extra > text.size())
+        {
+            return ReplacementChar;
+        }
+        for (size_t i = 0; i < extra; ++i)
+        {
+            auto next = static_cast<uint8_t>(text[pos + i]);
+            if ((next & 0xC0) != 0x80)
+            {
+                return ReplacementChar;
+            }
+            cp = (cp << 6) | (next & 0x3F);
+        }
+        pos += extra;
+
+        static constexpr char32_t minimum[] = { 0, 0x80, 0x800, 0x10000 };
+        if (cp < minimum[extra] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        {
+            return ReplacementChar;
+        }
+        return cp;
+    }
+
+    void AppendUtf8(char32_t cp, std::string& out)
+    {
+        if (cp < 0x80)
+        {
+            out += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    std::wstring Utf8ToWide(std::string_view utf8)
+    {
+        std::wstring wide;
+        wide.reserve(utf8.size());
+        for (size_t pos = 0; pos < utf8.size();)
+        {
+            char32_t cp = DecodeUtf8(utf8, pos);
+            if constexpr (sizeof(wchar_t) == 2)
+            {
+                if (cp >= 0x10000)
+                {
+                    cp -= 0x10000;
+                    wide += static_cast<wchar_t>(0xD800 + (cp >> 10));
+                    wide += static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+                    continue;
+                }
+            }
+            wide += static_cast<wchar_t>(cp);
+        }
+        return wide;
+    }
+
+    std::string WideToUtf8(std::wstring_view wide)
+    {
+        std::string utf8;
+        utf8.reserve(wide.size());
+        for (size_t i = 0; i < wide.size(); ++i)
+        {
+            auto cp = static_cast<char32_t>(wide[i]);
+            if constexpr (sizeof(wchar_t) == 2)
+            {
+                if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < wide.size())
+                {
+                    auto low = static_cast<char32_t>(wide[i + 1]);
+                    if (low >= 0xDC00 && low <= 0xDFFF)
+                    {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        ++i;
+                    }
+                }
+            }
+            if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+            {
+                cp = ReplacementChar;
+            }
+            AppendUtf8(cp, utf8);
+        }
+        return utf8;
+    }
+
+    size_t Utf8Length(std::string_view utf8)
+    {
+        size_t length = 0;
+        for (char c : utf8)
+        {
+            length += (static_cast<uint8_t>(c) & 0xC0) != 0x80;
+        }
+        return length;
+    }
+
+    std::string_view Trim(std::string_view text)
+    {
+        constexpr std::string_view blanks = " \t\r\n";
+        auto first = text.find_first_not_of(blanks);
+        if (first == std::string_view::npos)
+        {
+            return {};
+        }
+        auto last = text.find_last_not_of(blanks);
+        return text.substr(first, last - first + 1);
+    }
+
+    std::string FormatDuration(double seconds)
+    {
+        if (!(seconds >= 0.0))
+        {
+            return "?";
+        }
+        if (seconds >= 1e9)
+        {
+            return ">30y";
+        }
+        auto total = static_cast<uint64_t>(seconds + 0.5);
+        char text[32];
+        if (total < 60)
+        {
+            std::snprintf(text, sizeof(text), "%us", static_cast<unsigned>(total));
+        }
+        else if (total < 3600)
+        {
+            std::snprintf(text, sizeof(text), "%um%02us", static_cast<unsigned>(total / 60), static_cast<unsigned>(total % 60));
+        }
+        else if (total < 86400)
+        {
+            std::snprintf(text, sizeof(text), "%uh%02um", static_cast<unsigned>(total / 3600), static_cast<unsigned>(total / 60 % 60));
+        }
+        else
+        {
+            std::snprintf(text, sizeof(text), "%ud%02uh", static_cast<unsigned>(total / 86400), static_cast<unsigned>(total / 3600 % 24));
+        }
+        return text;
+    }
+}
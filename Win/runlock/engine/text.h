@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace runlock::engine
+{
+    // UTF-8 <-> wchar_t (UTF-16 on Windows, UTF-32 elsewhere). Invalid input
+    // bytes are replaced with U+FFFD rather than rejected: candidate text comes
+    // from user rules and must never abort a run.
+    std::wstring Utf8ToWide(std::string_view utf8);
+    std::string WideToUtf8(std::wstring_view wide);
+
+    // Decodes the code point at pos and advances past it; a malformed
+    // sequence yields U+FFFD and consumes one byte.
+    char32_t DecodeUtf8(std::string_view text, size_t& pos);
+
+    void AppendUtf8(char32_t cp, std::string& out);
+
+    // Number of code points in a UTF-8 string (continuation bytes are not counted).
+    size_t Utf8Length(std::string_view utf8);
+
+    // Removes leading/trailing spaces, tabs and line terminators.
+    std::string_view Trim(std::string_view text);
+
+    // Short duration for status lines: "45s", "12m05s", "3h20m", "4d07h";
+    // "?" for a negative (unknown) value.
+    std::string FormatDuration(double seconds);
+}
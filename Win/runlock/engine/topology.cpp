@@ -0,0 +1,281 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+#ifdef _WIN32
+        bool InGroupMask(const GROUP_AFFINITY& mask, uint32_t id)
+        {
+            return mask.Group == id / 64 && (mask.Mask & (KAFFINITY(1) << (id % 64))) != 0;
+        }
+
+        std::vector<LogicalCpu> ReadCpus()
+        {
+            DWORD bytes = 0;
+            ::GetLogicalProcessorInformationEx(RelationAll, nullptr, &bytes);
+            std::vector<uint8_t> buffer(bytes);
+            if (bytes == 0 || !::GetLogicalProcessorInformationEx(RelationAll,
+                reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &bytes))
+            {
+                return {};
+            }
+
+            std::vector<LogicalCpu> cpus;
+            std::vector<std::pair<GROUP_AFFINITY, uint32_t>> nodes;
+            uint32_t core = 0;
+            for (DWORD offset = 0; offset < bytes;)
+            {
+                auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data() + offset);
+                if (info->Relationship == RelationProcessorCore)
+                {
+                    bool primary = true;
+                    for (WORD group = 0; group < info->Processor.GroupCount; ++group)
+                    {
+                        const GROUP_AFFINITY& mask = info->Processor.GroupMask[group];
+                        for (uint32_t bit = 0; bit < 64; ++bit)
+                        {
+                            if ((mask.Mask & (KAFFINITY(1) << bit)) != 0)
+                            {
+                                // EfficiencyClass is 0 on non-hybrid CPUs and
+                                // higher on faster cores.
+                                cpus.push_back({ mask.Group * 64u + bit, core, 0, info->Processor.EfficiencyClass, primary });
+                                primary = false;
+                            }
+                        }
+                    }
+                    ++core;
+                }
+                else if (info->Relationship == RelationNumaNode)
+                {
+                    nodes.emplace_back(info->NumaNode.GroupMask, info->NumaNode.NodeNumber);
+                }
+                offset += info->Size;
+            }
+            for (auto& cpu : cpus)
+            {
+                for (const auto& [mask, node] : nodes)
+                {
+                    if (InGroupMask(mask, cpu.id))
+                    {
+                        cpu.node = node;
+                    }
+                }
+            }
+            return cpus;
+        }
+#else
+        std::string ReadLine(const std::filesystem::path& path)
+        {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+
+        uint32_t ReadNumber(const std::filesystem::path& path)
+        {
+            std::string line = ReadLine(path);
+            return line.empty() ? 0 : static_cast<uint32_t>(std::strtoul(line.c_str(), nullptr, 10));
+        }
+
+        // Online CPUs in the affinity mask, with their cores from the
+        // thread siblings lists and their nodes from the nodeN links.
+        // Speed comes from cpu_capacity (scaled by the kernel on hybrid and
+        // big.LITTLE systems), else from the highest cpufreq frequency.
+        std::vector<LogicalCpu> ReadCpus()
+        {
+            namespace fs = std::filesystem;
+            cpu_set_t allowed;
+            bool masked = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+            std::map<uint32_t, fs::path> found;
+            std::error_code error;
+            for (const auto& entry : fs::directory_iterator("/sys/devices/system/cpu", error))
+            {
+                std::string name = entry.path().filename().string();
+                if (name.size() > 3 && name.compare(0, 3, "cpu") == 0
+                    && name.find_first_not_of("0123456789", 3) == std::string::npos)
+                {
+                    found.emplace(static_cast<uint32_t>(std::stoul(name.substr(3))), entry.path());
+                }
+            }
+
+            std::vector<LogicalCpu> cpus;
+            std::map<std::string, uint32_t> cores;
+            for (const auto& [id, path] : found)
+            {
+                if (masked && (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed)))
+                {
+                    continue;
+                }
+                std::string siblings = ReadLine(path / "topology" / "thread_siblings_list");
+                if (siblings.empty())
+                {
+                    continue;       // offline: no topology directory
+                }
+                LogicalCpu cpu;
+                cpu.id = id;
+                auto [core, added] = cores.emplace(siblings, static_cast<uint32_t>(cores.size()));
+                cpu.core = core->second;
+                cpu.primary = added;
+                cpu.performance = ReadNumber(path / "cpu_capacity");
+                if (cpu.performance == 0)
+                {
+                    cpu.performance = ReadNumber(path / "cpufreq" / "cpuinfo_max_freq");
+                }
+                for (const auto& link : fs::directory_iterator(path, error))
+                {
+                    std::string name = link.path().filename().string();
+                    if (name.size() > 4 && name.compare(0, 4, "node") == 0
+                        && name.find_first_not_of("0123456789", 4) == std::string::npos)
+                    {
+                        cpu.node = static_cast<uint32_t>(std::stoul(name.substr(4)));
+                    }
+                }
+                cpus.push_back(cpu);
+            }
+            return cpus;
+        }
+#endif
+
+        // Round-robin over the nodes, each node's processors in id order.
+        void Interleave(const std::vector<LogicalCpu>& cpus, std::vector<LogicalCpu>& out)
+        {
+            std::map<uint32_t, std::vector<LogicalCpu>> byNode;
+            for (const auto& cpu : cpus)
+            {
+                byNode[cpu.node].push_back(cpu);
+            }
+            for (size_t round = 0;; ++round)
+            {
+                bool any = false;
+                for (const auto& [node, list] : byNode)
+                {
+                    if (round < list.size())
+                    {
+                        out.push_back(list[round]);
+                        any = true;
+                    }
+                }
+                if (!any)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    CpuTopology::CpuTopology(std::vector<LogicalCpu> cpus)
+        : m_cpus(std::move(cpus))
+    {
+        if (m_cpus.empty())
+        {
+            uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+            for (uint32_t i = 0; i < threads; ++i)
+            {
+                m_cpus.push_back({ i, i, 0, 0, true });
+            }
+        }
+        std::set<uint32_t> cores;
+        std::set<uint32_t> nodes;
+        std::set<uint32_t> speeds;
+        for (const auto& cpu : m_cpus)
+        {
+            cores.insert(cpu.core);
+            nodes.insert(cpu.node);
+            speeds.insert(cpu.performance);
+        }
+        m_cores = static_cast<uint32_t>(cores.size());
+        m_nodes = static_cast<uint32_t>(nodes.size());
+        m_speedClasses = static_cast<uint32_t>(speeds.size());
+    }
+
+    const CpuTopology& CpuTopology::Detect()
+    {
+        static const CpuTopology topology(ReadCpus());
+        return topology;
+    }
+
+    std::vector<LogicalCpu> CpuTopology::Place(uint32_t count, bool physicalCores) const
+    {
+        // Every core gets a worker before any core gets a second one, even
+        // a slower core: an SMT sibling adds less than an idle E-core does.
+        std::map<uint32_t, std::vector<LogicalCpu>, std::greater<>> primaries;
+        std::map<uint32_t, std::vector<LogicalCpu>, std::greater<>> siblings;
+        for (const auto& cpu : m_cpus)
+        {
+            (cpu.primary ? primaries : siblings)[cpu.performance].push_back(cpu);
+        }
+        std::vector<LogicalCpu> order;
+        order.reserve(m_cpus.size());
+        for (const auto& [speed, cpus] : primaries)
+        {
+            Interleave(cpus, order);
+        }
+        if (!physicalCores)
+        {
+            for (const auto& [speed, cpus] : siblings)
+            {
+                Interleave(cpus, order);
+            }
+        }
+
+        std::vector<LogicalCpu> placed;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            placed.push_back(order[i % order.size()]);
+        }
+        return placed;
+    }
+
+    std::string CpuTopology::Describe() const
+    {
+        std::string text = std::to_string(m_cpus.size()) + (m_cpus.size() == 1 ? " thread on " : " threads on ")
+            + std::to_string(m_cores) + (m_cores == 1 ? " core, " : " cores, ")
+            + std::to_string(m_nodes) + (m_nodes == 1 ? " NUMA node" : " NUMA nodes");
+        if (m_speedClasses > 1)
+        {
+            text += ", " + std::to_string(m_speedClasses) + " core speeds";
+        }
+        return text;
+    }
+
+    bool PinCurrentThread(const LogicalCpu& cpu)
+    {
+#ifdef _WIN32
+        GROUP_AFFINITY affinity{};
+        affinity.Group = static_cast<WORD>(cpu.id / 64);
+        affinity.Mask = KAFFINITY(1) << (cpu.id % 64);
+        return ::SetThreadGroupAffinity(::GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+        if (cpu.id >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu.id, &set);
+        return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#endif
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace runlock::engine
+{
+    // One logical processor this process may run on.
+    struct LogicalCpu
+    {
+        uint32_t id = 0;            // Linux CPU number; on Windows processor group * 64 + number in the group
+        uint32_t core = 0;          // physical core, numbered densely from 0
+        uint32_t node = 0;          // NUMA node
+        uint32_t performance = 0;   // higher is faster (P-cores over E-cores); all equal when unknown
+        bool primary = false;       // first thread of its core
+    };
+
+    // The processors, cores and NUMA nodes the process may use: sysfs and
+    // the affinity mask on Linux, GetLogicalProcessorInformationEx on
+    // Windows. When neither can be read, every hardware thread counts as a
+    // core of its own on node 0.
+    class CpuTopology
+    {
+    public:
+        // Read once per process.
+        static const CpuTopology& Detect();
+
+        const std::vector<LogicalCpu>& Cpus() const { return m_cpus; }
+        uint32_t Cores() const { return m_cores; }
+        uint32_t Nodes() const { return m_nodes; }
+        uint32_t SpeedClasses() const { return m_speedClasses; }
+
+        // Where `count` workers go, in worker order: the first thread of
+        // every core, fastest cores first and alternating between NUMA
+        // nodes, then the second threads in the same order (left out with
+        // physicalCores). Wraps around when there are more workers than
+        // processors.
+        std::vector<LogicalCpu> Place(uint32_t count, bool physicalCores) const;
+
+        // "16 threads on 8 cores, 1 NUMA node", plus speed classes on hybrid CPUs.
+        std::string Describe() const;
+
+    private:
+        explicit CpuTopology(std::vector<LogicalCpu> cpus);
+
+        std::vector<LogicalCpu> m_cpus;
+        uint32_t m_cores = 0;
+        uint32_t m_nodes = 0;
+        uint32_t m_speedClasses = 0;
+    };
+
+    // Binds the calling thread to one processor; false when the OS refuses.
+    bool PinCurrentThread(const LogicalCpu& cpu);
+}
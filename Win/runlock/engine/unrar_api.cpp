@@ -0,0 +1,92 @@
+#include "unrar_api.h"
+
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+namespace runlock::engine
+{
+    namespace
+    {
+        std::string DefaultLibraryPath()
+        {
+            if (const char* env = std::getenv("RUNLOCK_UNRAR"); env != nullptr && *env != '\0')
+            {
+                return env;
+            }
+#ifdef _WIN32
+            return sizeof(void*) == 8 ? "UnRAR64.dll" : "UnRAR.dll";
+#else
+            return "libunrar.so";
+#endif
+        }
+
+        template <typename T>
+        void Resolve(void* module, const char* name, T& target)
+        {
+#ifdef _WIN32
+            auto symbol = reinterpret_cast<void*>(::GetProcAddress(static_cast<HMODULE>(module), name));
+#else
+            auto symbol = ::dlsym(module, name);
+#endif
+            if (symbol == nullptr)
+            {
+                throw std::runtime_error(std::string("UnRAR library does not export ") + name);
+            }
+            target = reinterpret_cast<T>(symbol);
+        }
+
+        UnrarApi Load(const std::string& path)
+        {
+#ifdef _WIN32
+            void* module = ::LoadLibraryA(path.c_str());
+#else
+            void* module = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+            if (module == nullptr)
+            {
+                throw std::runtime_error("cannot load UnRAR library '" + path + "'");
+            }
+
+            UnrarApi api;
+            Resolve(module, "RAROpenArchiveEx", api.OpenArchiveEx);
+            Resolve(module, "RARCloseArchive", api.CloseArchive);
+            Resolve(module, "RARReadHeaderEx", api.ReadHeaderEx);
+            Resolve(module, "RARProcessFile", api.ProcessFile);
+            Resolve(module, "RARSetCallback", api.SetCallback);
+            Resolve(module, "RARGetDllVersion", api.GetDllVersion);
+            return api;
+        }
+
+        std::mutex s_loadMutex;
+        UnrarApi s_api;
+        bool s_loaded = false;
+    }
+
+    const UnrarApi& LoadUnrar(const std::string& libraryPath)
+    {
+        std::lock_guard lock(s_loadMutex);
+        if (!s_loaded)
+        {
+            s_api = Load(libraryPath.empty() ? DefaultLibraryPath() : libraryPath);
+            s_loaded = true;
+        }
+        return s_api;
+    }
+
+    const UnrarApi* TryLoadUnrar(const std::string& libraryPath)
+    {
+        try
+        {
+            return &LoadUnrar(libraryPath);
+        }
+        catch (const std::runtime_error&)
+        {
+            return nullptr;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Runtime binding to the UnRAR library (UnRAR.dll / UnRAR64.dll on Windows,
+// libunrar.so built from unrarsrc with "make lib" elsewhere).
+//
+// The library is resolved with LoadLibrary/dlopen instead of an import library
+// so the engine builds on any host that has unrar.h, and the header-level fast
+// paths keep working on machines where only the archive itself is available.
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif !defined(_UNIX)
+#define _UNIX
+#endif
+
+#include "unrar.h"
+
+#include <string>
+
+namespace runlock::engine
+{
+    struct UnrarApi
+    {
+        decltype(&RAROpenArchiveEx) OpenArchiveEx = nullptr;
+        decltype(&RARCloseArchive) CloseArchive = nullptr;
+        decltype(&RARReadHeaderEx) ReadHeaderEx = nullptr;
+        decltype(&RARProcessFile) ProcessFile = nullptr;
+        decltype(&RARSetCallback) SetCallback = nullptr;
+        decltype(&RARGetDllVersion) GetDllVersion = nullptr;
+    };
+
+    // Loads the library on first use and returns the shared function table.
+    // An empty path picks the platform default, overridable through the
+    // RUNLOCK_UNRAR environment variable. Throws std::runtime_error when the
+    // library or one of its exports cannot be found.
+    const UnrarApi& LoadUnrar(const std::string& libraryPath = {});
+
+    // Same as LoadUnrar() but returns nullptr instead of throwing.
+    const UnrarApi* TryLoadUnrar(const std::string& libraryPath = {});
+}
@@ -0,0 +1,179 @@
+#include "verifier.h"
+#include "archive.h"
+#include "archive_image.h"
+#include "candidate_batch.h"
+#include "rar3.h"
+#include "rar5.h"
+#include "rar5_kdf.h"
+#include "unrar_api.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace runlock::engine
+{
+    size_t Verifier::VerifyBatch(CandidateBatch& batch, size_t first, size_t count)
+    {
+        for (size_t i = first; i < first + count; ++i)
+        {
+            if (Verify(batch[i]))
+            {
+                return i;
+            }
+        }
+        return NoMatch;
+    }
+
+    VerifierFactory::VerifierFactory(const ArchiveInfo& info, int targetIndex)
+        : m_path(info.path)
+        , m_targetIndex(targetIndex)
+        , m_haveUnrar(TryLoadUnrar() != nullptr)
+    {
+        if (targetIndex >= 0 && static_cast<size_t>(targetIndex) < info.entries.size())
+        {
+            m_content = ContentCheck::ForName(info.entries[targetIndex].name);
+            m_splitTarget = info.entries[targetIndex].splitBefore || info.entries[targetIndex].splitAfter;
+        }
+        if (auto crypto = ReadRar5Crypto(info.path, targetIndex); crypto && crypto->hasCheck)
+        {
+            m_rar5 = std::make_shared<const Rar5Crypto>(*crypto);
+        }
+        else if (auto target = ReadRar3Target(info.path, targetIndex))
+        {
+            m_rar3 = std::make_shared<const Rar3Target>(std::move(*target));
+        }
+        m_conclusive = m_rar5 || (m_rar3 && m_rar3->Conclusive());
+        if (!m_conclusive && !m_haveUnrar)
+        {
+            throw std::runtime_error(info.path + ": archive has no conclusive password check and the UnRAR library is not available");
+        }
+        if (m_haveUnrar)
+        {
+            try
+            {
+                m_image = ArchiveImage::Build(info.path, targetIndex);
+            }
+            catch (const std::runtime_error&)
+            {
+                // Testing against the original archive still works, only slower.
+            }
+        }
+    }
+
+    std::unique_ptr<Verifier> VerifierFactory::CreateTest(const ContentCheck& check, bool keyChecked) const
+    {
+        if (!m_haveUnrar)
+        {
+            return nullptr;
+        }
+        if (m_image)
+        {
+            return std::make_unique<DllVerifier>(m_image, check, keyChecked);
+        }
+        return std::make_unique<DllVerifier>(m_path, m_targetIndex, check, keyChecked);
+    }
+
+    std::unique_ptr<Verifier> VerifierFactory::CreateConfirm() const
+    {
+        // After a check value or a CRC the content guess must not get a say:
+        // a wrong guess would lose the hit. After the weaker RAR 2.9 table
+        // check it is all a split target has left to be confirmed by.
+        if (m_splitTarget && !m_conclusive)
+        {
+            return CreateTest(m_content);
+        }
+        return CreateTest(ContentCheck(), m_conclusive);
+    }
+
+    std::unique_ptr<Verifier> VerifierFactory::Create() const
+    {
+        if (m_rar5)
+        {
+            return std::make_unique<Rar5Verifier>(*m_rar5, CreateConfirm());
+        }
+        if (m_rar3)
+        {
+            return std::make_unique<Rar3Verifier>(m_rar3, CreateConfirm());
+        }
+        return CreateTest(m_content);
+    }
+
+    std::string VerifierFactory::DerivationKey() const
+    {
+        if (m_rar5)
+        {
+            return "rar5 " + std::to_string(m_rar5->lg2Count) + " "
+                + std::string(reinterpret_cast<const char*>(m_rar5->salt), sizeof(m_rar5->salt));
+        }
+        if (m_rar3)
+        {
+            return "rar3 " + (m_rar3->hasSalt ? std::string(reinterpret_cast<const char*>(m_rar3->salt), sizeof(m_rar3->salt)) : "");
+        }
+        return {};
+    }
+
+    std::unique_ptr<Verifier> VerifierFactory::CreateShared(const std::vector<const VerifierFactory*>& group)
+    {
+        const VerifierFactory& first = *group.front();
+        if (first.m_rar5)
+        {
+            auto verifier = std::make_unique<Rar5Verifier>(*first.m_rar5, first.CreateConfirm());
+            for (size_t i = 1; i < group.size(); ++i)
+            {
+                verifier->Share(*group[i]->m_rar5, group[i]->CreateConfirm());
+            }
+            return verifier;
+        }
+        if (first.m_rar3)
+        {
+            auto verifier = std::make_unique<Rar3Verifier>(first.m_rar3, first.CreateConfirm());
+            for (size_t i = 1; i < group.size(); ++i)
+            {
+                verifier->Share(group[i]->m_rar3, group[i]->CreateConfirm());
+            }
+            return verifier;
+        }
+        return first.Create();
+    }
+
+    std::string VerifierFactory::Describe() const
+    {
+        std::string name = "unrar test";
+        if (m_content.Known())
+        {
+            name += std::string(" (early abort: ") + m_content.Describe() + ")";
+        }
+        if (m_rar5)
+        {
+            name = "rar5 password check (2^" + std::to_string(m_rar5->lg2Count) + " iterations, "
+                + SelectRar5Kernel().name + ")";
+        }
+        else if (m_rar3)
+        {
+            const auto& probes = m_rar3->probes;
+            bool compressed = std::any_of(probes.begin(), probes.end(),
+                [](const Rar3Probe& probe) { return probe.method != 0x30 && !probe.cipher.empty(); });
+            std::string check = m_rar3->headers ? "header crc"
+                : m_rar3->Conclusive() ? "stored data crc"
+                : compressed ? "compressed block header" : "no data check";
+            if (probes.size() > 1)
+            {
+                check += " over " + std::to_string(probes.size()) + " entries";
+            }
+            name = "rar3 key check (" + check + ", " + SelectRar3Kernel().name + ")";
+        }
+        if ((m_rar5 || m_rar3) && !m_haveUnrar)
+        {
+            name += ", unconfirmed";
+        }
+        else if (m_splitTarget && (m_conclusive || m_content.Known()))
+        {
+            name += ", split entry tested up to the end of this volume";
+        }
+        else if (m_splitTarget)
+        {
+            name += ", split entry without a conclusive check: nothing can be confirmed";
+        }
+        return name;
+    }
+}
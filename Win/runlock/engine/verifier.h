@@ -0,0 +1,88 @@
+#pragma once
+
+#include "content_check.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    class ArchiveImage;
+    struct ArchiveInfo;
+    class CandidateBatch;
+    struct Rar3Target;
+    struct Rar5Crypto;
+
+    // Decides whether a candidate opens the archive. Instances are owned by a
+    // single worker thread; construction may be expensive, Verify() is the
+    // hot path.
+    class Verifier
+    {
+    public:
+        virtual ~Verifier() = default;
+
+        virtual bool Verify(std::string_view password) = 0;
+
+        // Verifies batch[first, first + count) in order and returns the
+        // batch index of the first candidate the archive accepts, or
+        // NoMatch. Verifiers with lane-parallel kernels override this and
+        // must not allocate in it; the default calls Verify() per candidate.
+        virtual size_t VerifyBatch(CandidateBatch& batch, size_t first, size_t count);
+
+        // Batch size that keeps the verifier's kernel fully occupied.
+        virtual size_t PreferredBatch() const { return 1; }
+
+        static constexpr size_t NoMatch = SIZE_MAX;
+    };
+
+    // Inspects the archive once and hands every worker a verifier of the
+    // cheapest kind the archive supports, backed by a DllVerifier
+    // confirmation whenever the UnRAR library is available. The DllVerifiers
+    // share one ArchiveImage of the target entry when it can be cut out.
+    // Without the library only archives with a conclusive check (RAR5
+    // password check, RAR 2.9 header or stored data CRC) can be worked on.
+    class VerifierFactory
+    {
+    public:
+        // Throws std::runtime_error when the archive offers no usable check.
+        VerifierFactory(const ArchiveInfo& info, int targetIndex);
+
+        std::unique_ptr<Verifier> Create() const;
+
+        // Short name of the check Create() builds, for logs and the CLI.
+        std::string Describe() const;
+
+        // The inputs of the fast check's key derivation (format, salt and
+        // iteration count) as an opaque key; archives with equal keys derive
+        // the same key from a candidate. Empty without a fast check.
+        std::string DerivationKey() const;
+
+        // One verifier for archives with the same non-empty DerivationKey():
+        // a candidate's key is derived once and checked against each of
+        // them. It accepts a candidate that opens any of them.
+        static std::unique_ptr<Verifier> CreateShared(const std::vector<const VerifierFactory*>& group);
+
+    private:
+        // The UnRAR test, giving up early on entry content that fails check.
+        // keyChecked: a conclusive check already passed the key.
+        std::unique_ptr<Verifier> CreateTest(const ContentCheck& check, bool keyChecked = false) const;
+
+        // The UnRAR test behind a fast check: no early abort, except for a
+        // split target the fast check cannot vouch for.
+        std::unique_ptr<Verifier> CreateConfirm() const;
+
+        std::string m_path;
+        int m_targetIndex;
+        ContentCheck m_content;
+        std::shared_ptr<const Rar5Crypto> m_rar5;
+        std::shared_ptr<const Rar3Target> m_rar3;
+        std::shared_ptr<const ArchiveImage> m_image;   // target cut out for the DllVerifiers
+        bool m_haveUnrar;
+        bool m_conclusive = false;      // the fast check alone settles a key
+        bool m_splitTarget = false;     // the target continues in another volume
+    };
+}
@@ -0,0 +1,211 @@
+#include "wordlist.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace runlock::engine
+{
+    namespace
+    {
+        // RAR stops at 127 characters, 4 bytes each at most in UTF-8; the
+        // byte bound turns away most long lines without decoding them.
+        constexpr size_t MaxLineChars = 127;
+        constexpr size_t MaxLineBytes = MaxLineChars * 4;
+
+        // Files below this are scanned by one thread.
+        constexpr size_t MinChunkBytes = 4 << 20;
+
+        // The line starting at `cursor`, without its terminator; moves
+        // cursor past the terminator.
+        std::string_view NextLine(const char*& cursor, const char* end)
+        {
+            const char* start = cursor;
+            const char* newline = static_cast<const char*>(std::memchr(start, '\n', static_cast<size_t>(end - start)));
+            const char* stop = newline != nullptr ? newline : end;
+            cursor = newline != nullptr ? newline + 1 : end;
+            if (stop != start && stop[-1] == '\r')
+            {
+                --stop;
+            }
+            return std::string_view(start, static_cast<size_t>(stop - start));
+        }
+    }
+
+    Wordlist::Wordlist(const std::string& path, const Constraints& constraints)
+        : m_path(path)
+        , m_file(path)
+        , m_constraints(constraints)
+    {
+        size_t begin = 0;
+        size_t size = m_file.Size();
+        if (size >= 3 && std::memcmp(m_file.Data(), "\xEF\xBB\xBF", 3) == 0)
+        {
+            begin = 3;
+        }
+
+        // Cut points are moved forward to just past a '\n', so every line
+        // lies in exactly one chunk.
+        uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+        size_t parts = std::clamp<size_t>((size - begin) / MinChunkBytes, 1, threads);
+        const char* data = reinterpret_cast<const char*>(m_file.Data());
+        std::vector<size_t> cuts{ begin };
+        for (size_t i = 1; i < parts; ++i)
+        {
+            size_t cut = std::max(begin + (size - begin) / parts * i, cuts.back());
+            const void* newline = std::memchr(data + cut, '\n', size - cut);
+            cuts.push_back(newline != nullptr ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : size);
+        }
+        cuts.push_back(size);
+
+        m_chunks.resize(parts);
+        std::vector<std::thread> scanners;
+        for (size_t i = 1; i < parts; ++i)
+        {
+            scanners.emplace_back([this, &cuts, i] { Scan(m_chunks[i], cuts[i], cuts[i + 1]); });
+        }
+        Scan(m_chunks[0], cuts[0], cuts[1]);
+        for (auto& scanner : scanners)
+        {
+            scanner.join();
+        }
+
+        uint64_t lines = 0;
+        for (auto& chunk : m_chunks)
+        {
+            chunk.first = m_size;
+            for (auto& mark : chunk.marks)
+            {
+                mark.line += lines;
+            }
+            m_size += chunk.count;
+            lines += chunk.lines;
+            m_maxBytes = std::max(m_maxBytes, chunk.maxBytes);
+        }
+    }
+
+    void Wordlist::Scan(Chunk& chunk, size_t begin, size_t end) const
+    {
+        const char* data = reinterpret_cast<const char*>(m_file.Data());
+        const char* cursor = data + begin;
+        const char* stop = data + end;
+        while (cursor < stop)
+        {
+            const char* start = cursor;
+            std::string_view line = NextLine(cursor, stop);
+            if (Usable(line))
+            {
+                if (chunk.count % IndexStride == 0)
+                {
+                    chunk.marks.push_back(Mark{ static_cast<uint64_t>(start - data), chunk.lines });
+                }
+                ++chunk.count;
+                chunk.maxBytes = std::max(chunk.maxBytes, line.size());
+            }
+            ++chunk.lines;
+        }
+    }
+
+    bool Wordlist::Usable(std::string_view line) const
+    {
+        return !line.empty() && line.size() <= MaxLineBytes
+            && (line.size() <= MaxLineChars || Utf8Length(line) <= MaxLineChars)
+            && m_constraints.Accepts(line);
+    }
+
+    const char* Wordlist::Find(uint64_t index, uint64_t* line) const
+    {
+        auto chunk = std::upper_bound(m_chunks.begin(), m_chunks.end(), index,
+            [](uint64_t value, const Chunk& c) { return value < c.first; });
+        do
+        {
+            --chunk;
+        } while (chunk->count == 0);     // empty chunks share `first` with the next one
+
+        uint64_t local = index - chunk->first;
+        const Mark& mark = chunk->marks[static_cast<size_t>(local / IndexStride)];
+        const char* data = reinterpret_cast<const char*>(m_file.Data());
+        const char* cursor = data + mark.offset;
+        const char* end = data + m_file.Size();
+        uint64_t skip = local % IndexStride;
+        uint64_t number = mark.line;
+        while (true)
+        {
+            const char* start = cursor;
+            if (Usable(NextLine(cursor, end)) && skip-- == 0)
+            {
+                if (line != nullptr)
+                {
+                    *line = number;
+                }
+                return start;
+            }
+            ++number;
+        }
+    }
+
+    std::string_view Wordlist::Seek(uint64_t index, uint64_t* line) const
+    {
+        const char* cursor = Find(index, line);
+        return NextLine(cursor, reinterpret_cast<const char*>(m_file.Data()) + m_file.Size());
+    }
+
+    size_t Wordlist::Generate(uint64_t index, char* out) const
+    {
+        std::string_view word = Seek(index, nullptr);
+        std::memcpy(out, word.data(), word.size());
+        return word.size();
+    }
+
+    std::string_view Wordlist::View(uint64_t index, char*) const
+    {
+        return Seek(index, nullptr);
+    }
+
+    bool Wordlist::ForEach(uint64_t first, uint64_t last, char*,
+        const std::function<bool(std::string_view)>& visit) const
+    {
+        if (first >= last)
+        {
+            return true;
+        }
+        const char* cursor = Find(first, nullptr);
+        const char* end = reinterpret_cast<const char*>(m_file.Data()) + m_file.Size();
+        for (uint64_t index = first; index < last;)
+        {
+            std::string_view line = NextLine(cursor, end);
+            if (Usable(line))
+            {
+                if (!visit(line))
+                {
+                    return false;
+                }
+                ++index;
+            }
+        }
+        return true;
+    }
+
+    void Wordlist::Fill(uint64_t first, size_t count, char* out, size_t, std::string_view* views) const
+    {
+        // Views into the mapping, found with one lookup for the batch.
+        ForEach(first, first + count, out, [&](std::string_view line)
+        {
+            *views++ = line;
+            return true;
+        });
+    }
+
+    uint64_t Wordlist::LineOf(uint64_t index) const
+    {
+        uint64_t line = 0;
+        Seek(index, &line);
+        return line + 1;
+    }
+
+    std::string Wordlist::Origin(uint64_t index) const
+    {
+        return m_path + " line " + std::to_string(LineOf(index));
+    }
+}
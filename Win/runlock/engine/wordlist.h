@@ -0,0 +1,78 @@
+#pragma once
+
+#include "keyspace.h"
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runlock::engine
+{
+    // A word list file as a keyspace segment (the "@file" rule): candidate N
+    // is the N-th usable line. The file is memory-mapped, never read into a
+    // string, and candidates are views straight into the mapping with the
+    // line terminator ("\n" or "\r\n") and a leading UTF-8 BOM left out.
+    //
+    // Opening makes one pass over the file, cut at line boundaries into one
+    // chunk per hardware thread and scanned in parallel, that counts the
+    // usable lines and keeps a sparse index: the offset and file line number
+    // of every IndexStride-th of them. A lookup starts at the nearest mark
+    // and walks at most IndexStride - 1 lines, so memory stays at 16 bytes
+    // per IndexStride lines however large the list is.
+    //
+    // Empty lines, lines that miss the constraints and lines longer than a
+    // RAR password can be (127 characters) are not usable and take no index.
+    class Wordlist : public Segment
+    {
+    public:
+        static constexpr uint64_t IndexStride = 1024;
+
+        // Throws std::runtime_error when the file cannot be opened or mapped.
+        Wordlist(const std::string& path, const Constraints& constraints);
+
+        uint64_t Size() const override { return m_size; }
+        size_t MaxBytes() const override { return m_maxBytes; }
+        bool Distinct() const override { return false; }    // lists often repeat words
+        size_t Generate(uint64_t index, char* out) const override;
+        std::string_view View(uint64_t index, char* out) const override;
+        std::string Origin(uint64_t index) const override;
+        bool ForEach(uint64_t first, uint64_t last, char* out,
+            const std::function<bool(std::string_view)>& visit) const override;
+        void Fill(uint64_t first, size_t count, char* out, size_t stride, std::string_view* views) const override;
+
+        // 1-based line of the file holding candidate `index`.
+        uint64_t LineOf(uint64_t index) const;
+
+    private:
+        struct Mark
+        {
+            uint64_t offset;
+            uint64_t line;      // 0-based file line at offset
+        };
+
+        struct Chunk
+        {
+            uint64_t first = 0;         // index of the chunk's first usable line
+            uint64_t count = 0;         // usable lines in the chunk
+            uint64_t lines = 0;         // all lines in the chunk
+            size_t maxBytes = 0;
+            std::vector<Mark> marks;    // marks[i]: usable line first + i * IndexStride
+        };
+
+        void Scan(Chunk& chunk, size_t begin, size_t end) const;
+        bool Usable(std::string_view line) const;
+        // Start of the line holding candidate index, and its 0-based number.
+        const char* Find(uint64_t index, uint64_t* line) const;
+        std::string_view Seek(uint64_t index, uint64_t* line) const;
+
+        std::string m_path;
+        MappedFile m_file;
+        Constraints m_constraints;
+        std::vector<Chunk> m_chunks;
+        uint64_t m_size = 0;
+        size_t m_maxBytes = 0;
+    };
+}